@@ -0,0 +1,22 @@
+/*
+ * index - create or update sidecar indices of BUFR files
+ */
+
+#include <wreport/bufr_index.h>
+#include "options.h"
+
+using namespace wreport;
+
+// Create or update the index of a BUFR file, stored in fname.idx
+void do_index(const Options& opts, const char* fname)
+{
+    if (opts.crex)
+        throw error_unimplemented("indexing is only supported for BUFR files");
+
+    std::string index_pathname(fname);
+    index_pathname += ".idx";
+
+    BufrIndex index;
+    size_t added = index.update(index_pathname, fname);
+    printf("%s: %zu messages indexed, %zu new\n", fname, index.entries.size(), added);
+}
@@ -19,7 +19,10 @@
  * Author: Enrico Zini <enrico@enricozini.com>
  */
 
+#include <wreport/vartable.h>
+#include <wreport/dtable.h>
 #include <cstdlib>
+#include <cstring>
 
 // Print information about the library
 void do_info()
@@ -28,4 +31,40 @@ void do_info()
     printf("Extra tables directory: %s (env var WREPORT_EXTRA_TABLES)\n", getenv("WREPORT_EXTRA_TABLES"));
     printf("System tables directory: %s (env var WREPORT_TABLES)\n", getenv("WREPORT_TABLES"));
     printf("Compiled-in default tables directory: %s\n", TABLE_DIR);
+    const char* cache = getenv("WREPORT_TABLE_CACHE");
+    if (!cache)
+        printf("Compiled tables directory: $XDG_CACHE_HOME/wreport or $HOME/.cache/wreport (env var WREPORT_TABLE_CACHE)\n");
+    else if (!*cache)
+        printf("Compiled tables directory: disabled (env var WREPORT_TABLE_CACHE)\n");
+    else
+        printf("Compiled tables directory: %s (env var WREPORT_TABLE_CACHE)\n", cache);
+}
+
+// Write the compiled version of a text table, choosing its type from the
+// first letter of its file name
+void do_compile_table(const Options& opts, const char* fname)
+{
+    const char* base = strrchr(fname, '/');
+    base = base ? base + 1 : fname;
+
+    std::string compiled;
+    switch (base[0])
+    {
+        case 'B':
+            if (opts.crex)
+                compiled = Vartable::compile_crex(fname);
+            else
+                compiled = Vartable::compile_bufr(fname);
+            break;
+        case 'D':
+            compiled = DTable::compile(fname);
+            break;
+        default:
+            error_consistency::throwf("cannot tell if %s is a B or a D table", fname);
+    }
+
+    if (compiled.empty())
+        throw error_consistency("compiled tables are disabled: WREPORT_TABLE_CACHE is empty, or HOME is not set");
+    if (opts.verbose)
+        fprintf(stderr, "%s: written %s\n", fname, compiled.c_str());
 }
@@ -20,6 +20,7 @@
  */
 
 #include <wreport/bulletin.h>
+#include <wreport/reader.h>
 #include "options.h"
 
 using namespace wreport;
@@ -27,34 +28,20 @@ using namespace wreport;
 // Read all BUFR messages from a file
 void read_bufr_raw(const Options& opts, const char* fname, RawHandler& handler)
 {
-    // Open the input file
-    FILE* in = fopen(fname, "rb");
-    if (in == NULL)
-        error_system::throwf("opening file %s", fname);
-
-    // Use a generic try/catch block to ensure we always close the input file,
-    // even in case of errors
-    try {
-        // String used to hold raw data read from the input file
-        string raw_data;
-
-        // (optional) offset of the start of the BUFR message read, which we
-        // pass to the decoder to have nicer error messages
-        off_t offset;
+    // Open the input file. Its contents are mapped in memory, and messages
+    // are passed to the handler without copying them
+    BufrFileReader reader(fname);
 
-        // Read all BUFR data in the input file, one message at a time. Extra
-        // data before and after each BUFR message is skipped.
-        // fname and offset are optional and we pass them just to have nicer
-        // error messages.
-        while (BufrBulletin::read(in, raw_data, fname, &offset))
-            handler.handle_raw_bufr(raw_data, fname, offset);
+    // Start, size and file offset of the BUFR message read. The offset is
+    // optional, and we pass it to the decoder to have nicer error messages
+    const char* data;
+    size_t size;
+    off_t offset;
 
-        // Cleanup
-        fclose(in);
-    } catch (...) {
-        fclose(in);
-        throw;
-    }
+    // Read all BUFR data in the input file, one message at a time. Extra
+    // data before and after each BUFR message is skipped.
+    while (reader.next(data, size, offset))
+        handler.handle_raw_bufr(data, size, fname, offset);
 }
 
 /*
@@ -62,40 +49,21 @@ void read_bufr_raw(const Options& opts, const char* fname, RawHandler& handler)
  *
  * Note that the code is basically the same as with reading BUFRs, with only
  * two changes:
- *  - it uses a CrexBulletin instead of a BufrBulletin
- *  - it uses CrexBulletin::read instead of BufrBulletin::read
+ *  - it uses a CrexFileReader instead of a BufrFileReader
+ *  - it calls handle_raw_crex instead of handle_raw_bufr
  */
 void read_crex_raw(const Options& opts, const char* fname, RawHandler& handler)
 {
     // Open the input file
-    FILE* in = fopen(fname, "rt");
-    if (in == NULL)
-        error_system::throwf("opening file %s", fname);
-
-    // Use a generic try/catch block to ensure we always close the input file,
-    // even in case of errors
-    try {
-        // Create a CREX bulletin
-        unique_ptr<Bulletin> bulletin(CrexBulletin::create());
-
-        // String used to hold raw data read from the input file
-        string raw_data;
-
-        // (optional) offset of the start of the CREX message read, which we
-        // pass to the decoder to have nicer error messages
-        off_t offset;
+    CrexFileReader reader(fname);
 
-        // Read all CREX data in the input file, one message at a time. Extra
-        // data before and after each CREX message is skipped.
-        // fname and offset are optional and we pass them just to have nicer
-        // error messages.
-        while (CrexBulletin::read(in, raw_data, fname, &offset))
-            handler.handle_raw_crex(raw_data, fname, offset);
+    // Start, size and file offset of the CREX message read
+    const char* data;
+    size_t size;
+    off_t offset;
 
-        // Cleanup
-        fclose(in);
-    } catch (...) {
-        fclose(in);
-        throw;
-    }
+    // Read all CREX data in the input file, one message at a time. Extra
+    // data before and after each CREX message is skipped.
+    while (reader.next(data, size, offset))
+        handler.handle_raw_crex(data, size, fname, offset);
 }
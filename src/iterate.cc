@@ -25,7 +25,11 @@ struct PrintVars : public BulletinFullHandler
     const std::vector<wreport::Varcode>& codes;
 
     PrintVars(const std::vector<wreport::Varcode>& codes, FILE* out=stdout)
-        : out(out), codes(codes) {}
+        : out(out), codes(codes)
+    {
+        // Skip decoding the variables that are not printed
+        decode_only = codes;
+    }
 
     const Var* find_varcode(const wreport::Subset& subset, Varcode code)
     {
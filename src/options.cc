@@ -22,6 +22,7 @@
 #include "options.h"
 #include <wreport/bulletin.h>
 #include <cstring>
+#include <cstdio>
 
 using namespace wreport;
 
@@ -36,58 +37,116 @@ void Options::init_varcodes(const char* str)
     }
 }
 
-void BulletinHeadHandler::handle_raw_bufr(const std::string& raw_data, const char* fname, long offset)
+namespace {
+
+// Return a function that reports an error in processing a message
+RawResult report_error(const char* fname, long offset, const std::exception& e)
+{
+    std::string msg(e.what());
+    return [=]() { fprintf(stderr, "%s:%ld:%s\n", fname, offset, msg.c_str()); };
+}
+
+// Return a function that passes a decoded bulletin to handler.handle()
+template<typename Handler>
+RawResult handle_decoded(Handler& handler, std::shared_ptr<Bulletin> bulletin, const char* fname, long offset)
+{
+    return [&handler, bulletin, fname, offset]() {
+        try {
+            handler.handle(*bulletin);
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s:%ld:%s\n", fname, offset, e.what());
+        }
+    };
+}
+
+}
+
+RawResult RawHandler::process_raw_bufr(const char* data, size_t size, const char* fname, long offset)
+{
+    return [=]() { handle_raw_bufr(data, size, fname, offset); };
+}
+
+RawResult RawHandler::process_raw_crex(const char* data, size_t size, const char* fname, long offset)
+{
+    return [=]() { handle_raw_crex(data, size, fname, offset); };
+}
+
+void BulletinHeadHandler::handle_raw_bufr(const char* data, size_t size, const char* fname, long offset)
+{
+    process_raw_bufr(data, size, fname, offset)();
+}
+
+void BulletinHeadHandler::handle_raw_crex(const char* data, size_t size, const char* fname, long offset)
+{
+    process_raw_crex(data, size, fname, offset)();
+}
+
+RawResult BulletinHeadHandler::process_raw_bufr(const char* data, size_t size, const char* fname, long offset)
 {
     try {
         // Decode the raw data. fname and offset are optional and we pass
         // them just to have nicer error messages
-        auto bulletin = BufrBulletin::decode_header(raw_data, fname, offset);
+        auto opts = BufrCodecOptions::create();
+        opts->decode_header_skips_tables = !needs_tables;
+        auto bulletin = BufrBulletin::decode_header(data, size, *opts, fname, offset);
 
         // Do something with the decoded information
-        handle(*bulletin);
+        return handle_decoded(*this, move(bulletin), fname, offset);
     } catch (std::exception& e) {
-        fprintf(stderr, "%s:%ld:%s\n", fname, offset, e.what());
+        return report_error(fname, offset, e);
     }
 }
 
-void BulletinHeadHandler::handle_raw_crex(const std::string& raw_data, const char* fname, long offset)
+RawResult BulletinHeadHandler::process_raw_crex(const char* data, size_t size, const char* fname, long offset)
 {
     try {
         // Decode the raw data. fname and offset are optional and we pass
         // them just to have nicer error messages
-        auto bulletin = CrexBulletin::decode(raw_data, fname, offset);
+        auto bulletin = CrexBulletin::decode(data, size, fname, offset);
 
         // Do something with the decoded information
-        handle(*bulletin);
+        return handle_decoded(*this, move(bulletin), fname, offset);
     } catch (std::exception& e) {
-        fprintf(stderr, "%s:%ld:%s\n", fname, offset, e.what());
+        return report_error(fname, offset, e);
     }
 }
 
-void BulletinFullHandler::handle_raw_bufr(const std::string& raw_data, const char* fname, long offset)
+void BulletinFullHandler::handle_raw_bufr(const char* data, size_t size, const char* fname, long offset)
+{
+    process_raw_bufr(data, size, fname, offset)();
+}
+
+void BulletinFullHandler::handle_raw_crex(const char* data, size_t size, const char* fname, long offset)
+{
+    process_raw_crex(data, size, fname, offset)();
+}
+
+RawResult BulletinFullHandler::process_raw_bufr(const char* data, size_t size, const char* fname, long offset)
 {
     try {
         // Decode the raw data. fname and offset are optional and we pass
         // them just to have nicer error messages
-        auto bulletin = BufrBulletin::decode(raw_data, fname, offset);
+        auto opts = BufrCodecOptions::create();
+        opts->decode_only = decode_only;
+        auto bulletin = BufrBulletin::decode(data, size, *opts, fname, offset);
 
         // Do something with the decoded information
-        handle(*bulletin);
+        return handle_decoded(*this, move(bulletin), fname, offset);
     } catch (std::exception& e) {
-        fprintf(stderr, "%s:%ld:%s\n", fname, offset, e.what());
+        return report_error(fname, offset, e);
     }
 }
 
-void BulletinFullHandler::handle_raw_crex(const std::string& raw_data, const char* fname, long offset)
+RawResult BulletinFullHandler::process_raw_crex(const char* data, size_t size, const char* fname, long offset)
 {
     try {
         // Decode the raw data. fname and offset are optional and we pass
         // them just to have nicer error messages
-        auto bulletin = CrexBulletin::decode(raw_data, fname, offset);
+        auto bulletin = CrexBulletin::decode(data, size, fname, offset);
 
         // Do something with the decoded information
-        handle(*bulletin);
+        return handle_decoded(*this, move(bulletin), fname, offset);
     } catch (std::exception& e) {
-        fprintf(stderr, "%s:%ld:%s\n", fname, offset, e.what());
+        return report_error(fname, offset, e);
     }
 }
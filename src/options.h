@@ -25,6 +25,7 @@
 #include <wreport/varinfo.h>
 #include <vector>
 #include <memory>
+#include <functional>
 
 namespace wreport {
 struct Bulletin;
@@ -40,6 +41,9 @@ enum Action {
     TABLES,
     FEATURES,
     LIST_TABLES,
+    INDEX,
+    COMPILE_TABLES,
+    PROFILE,
     HELP,
 };
 
@@ -50,6 +54,8 @@ struct Options
     bool crex;
     // Verbose processing
     bool verbose;
+    // Number of threads used to decode messages
+    unsigned jobs;
 
     // Action requested
     enum Action action;
@@ -59,31 +65,55 @@ struct Options
 
     // Initialise with default values
     Options()
-        : crex(false), verbose(false), action(DUMP)
+        : crex(false), verbose(false), jobs(1), action(DUMP)
     {
     }
 
     void init_varcodes(const char* str);
 };
 
+// Function that handles the result of processing a message
+typedef std::function<void()> RawResult;
+
 struct RawHandler
 {
     virtual ~RawHandler() {}
-    virtual void handle_raw_bufr(const std::string& data, const char* fname, long offset) = 0;
-    virtual void handle_raw_crex(const std::string& data, const char* fname, long offset) = 0;
+    virtual void handle_raw_bufr(const char* data, size_t size, const char* fname, long offset) = 0;
+    virtual void handle_raw_crex(const char* data, size_t size, const char* fname, long offset) = 0;
     virtual void done() {}
+
+    /**
+     * Split handling a message in a part that can run in any thread, like
+     * decoding, and a part that needs to run in input order, like output.
+     *
+     * The first part is run by process_raw_bufr, which returns the second
+     * part. The default implementation does everything in the second part.
+     */
+    virtual RawResult process_raw_bufr(const char* data, size_t size, const char* fname, long offset);
+
+    /// CREX version of process_raw_bufr
+    virtual RawResult process_raw_crex(const char* data, size_t size, const char* fname, long offset);
 };
 
 // Interface for classes that process bulletins, parsing only message headers
 struct BulletinHeadHandler : public RawHandler
 {
+    // Set to false if handle() does not need the decoding tables
+    bool needs_tables = true;
+
     virtual ~BulletinHeadHandler() {}
 
     /// Decode and handle the decoded bulletin
-    virtual void handle_raw_bufr(const std::string& raw_data, const char* fname, long offset);
+    virtual void handle_raw_bufr(const char* data, size_t size, const char* fname, long offset);
 
     /// Decode and handle the decoded bulletin
-    virtual void handle_raw_crex(const std::string& raw_data, const char* fname, long offset);
+    virtual void handle_raw_crex(const char* data, size_t size, const char* fname, long offset);
+
+    /// Decode the bulletin, and return a function that handles it
+    RawResult process_raw_bufr(const char* data, size_t size, const char* fname, long offset) override;
+
+    /// Decode the bulletin, and return a function that handles it
+    RawResult process_raw_crex(const char* data, size_t size, const char* fname, long offset) override;
 
     virtual void handle(wreport::Bulletin&) = 0;
 };
@@ -91,13 +121,22 @@ struct BulletinHeadHandler : public RawHandler
 // Interface for classes that process bulletins, parsing full messages
 struct BulletinFullHandler : public RawHandler
 {
+    // If not empty, only decode BUFR variables with these varcodes
+    std::vector<wreport::Varcode> decode_only;
+
     virtual ~BulletinFullHandler() {}
 
     /// Decode and handle the decoded bulletin
-    virtual void handle_raw_bufr(const std::string& raw_data, const char* fname, long offset);
+    virtual void handle_raw_bufr(const char* data, size_t size, const char* fname, long offset);
 
     /// Decode and handle the decoded bulletin
-    virtual void handle_raw_crex(const std::string& raw_data, const char* fname, long offset);
+    virtual void handle_raw_crex(const char* data, size_t size, const char* fname, long offset);
+
+    /// Decode the bulletin, and return a function that handles it
+    RawResult process_raw_bufr(const char* data, size_t size, const char* fname, long offset) override;
+
+    /// Decode the bulletin, and return a function that handles it
+    RawResult process_raw_crex(const char* data, size_t size, const char* fname, long offset) override;
 
     virtual void handle(wreport::Bulletin&) = 0;
 };
@@ -21,6 +21,7 @@
 
 #include <wreport/bulletin.h>
 #include <wreport/bulletin/dds-scanfeatures.h>
+#include <wreport/bulletin/profile.h>
 #include "options.h"
 #include <cstring>
 
@@ -64,7 +65,11 @@ struct PrintTables : public BulletinHeadHandler
 {
     FILE* out;
     bool header_printed;
-    PrintTables(FILE* out=stderr) : out(out), header_printed(false) {}
+    PrintTables(FILE* out=stderr) : out(out), header_printed(false)
+    {
+        // Only section 1 metadata is printed
+        needs_tables = false;
+    }
 
     /// Dump the contents of the Data Descriptor Section a message
     void handle(wreport::Bulletin& b) override
@@ -122,3 +127,27 @@ struct PrintFeatures : public BulletinHeadHandler
         fprintf(out, "\n");
     }
 };
+
+struct PrintProfile : public BulletinFullHandler
+{
+    FILE* out;
+    bulletin::Profile profile;
+    PrintProfile(FILE* out=stderr) : out(out)
+    {
+        bulletin::Profile::start(profile);
+    }
+    ~PrintProfile()
+    {
+        bulletin::Profile::stop();
+    }
+
+    /// Decoding the message is all that is needed to profile it
+    void handle(wreport::Bulletin& b) override {}
+
+    /// Print the profile of all decoded messages
+    void done() override
+    {
+        bulletin::Profile::stop();
+        profile.print(out);
+    }
+};
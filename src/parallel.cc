@@ -0,0 +1,173 @@
+/*
+ * parallel - decode messages using a pool of worker threads
+ */
+
+#include <wreport/reader.h>
+#include <wreport/notes.h>
+#include "options.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+
+// Bounded queue used to pass work between threads
+template<typename T>
+class WorkQueue
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<T> items;
+    size_t max_size;
+    bool closed = false;
+
+public:
+    WorkQueue(size_t max_size) : max_size(max_size) {}
+
+    // Append an item, waiting if the queue is full
+    void push(T&& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return items.size() < max_size; });
+        items.push_back(std::move(item));
+        changed.notify_all();
+    }
+
+    // Take the first item, waiting if the queue is empty.
+    // Returns false if the queue is empty and has been closed.
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+    // Signal that no more items will be added
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+};
+
+/*
+ * Read messages from files, and process them using a pool of worker threads.
+ *
+ * The calling thread splits the input into messages, the worker threads run
+ * the handler's process_raw_bufr or process_raw_crex, and an output thread
+ * runs their results in input order.
+ */
+class ParallelReader
+{
+    typedef std::packaged_task<RawResult()> Task;
+
+    RawHandler& handler;
+    // Messages waiting to be processed
+    WorkQueue<Task> tasks;
+    // Results of processing, in input order
+    WorkQueue<std::future<RawResult>> results;
+    std::vector<std::thread> workers;
+    std::thread output;
+
+    // Count of messages read, and of messages whose result has been handled
+    std::mutex mutex;
+    std::condition_variable progress;
+    size_t submitted = 0;
+    size_t handled = 0;
+
+    void run_worker(std::ostream* notes_target)
+    {
+        if (notes_target)
+            notes::set_target(*notes_target);
+        Task task;
+        while (tasks.pop(task))
+            task();
+    }
+
+    void run_output()
+    {
+        std::future<RawResult> result;
+        while (results.pop(result))
+        {
+            try {
+                result.get()();
+            } catch (std::exception& e) {
+                fprintf(stderr, "%s\n", e.what());
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            ++handled;
+            progress.notify_all();
+        }
+    }
+
+    void submit(Task&& task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++submitted;
+        }
+        results.push(task.get_future());
+        tasks.push(std::move(task));
+    }
+
+    // Wait until all messages read so far have been handled
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        progress.wait(lock, [&] { return handled == submitted; });
+    }
+
+public:
+    ParallelReader(RawHandler& handler, unsigned jobs)
+        : handler(handler), tasks(jobs * 4), results(jobs * 16)
+    {
+        std::ostream* notes_target = notes::get_target();
+        for (unsigned i = 0; i < jobs; ++i)
+            workers.emplace_back([=] { run_worker(notes_target); });
+        output = std::thread([=] { run_output(); });
+    }
+
+    ~ParallelReader()
+    {
+        tasks.close();
+        for (auto& w: workers)
+            w.join();
+        results.close();
+        output.join();
+    }
+
+    // Read all messages from a file
+    void read(const Options& opts, const char* fname)
+    {
+        std::unique_ptr<FileReader> reader;
+        if (opts.crex)
+            reader.reset(new CrexFileReader(fname));
+        else
+            reader.reset(new BufrFileReader(fname));
+
+        const char* data;
+        size_t size;
+        off_t offset;
+        try {
+            while (reader->next(data, size, offset))
+            {
+                if (opts.crex)
+                    submit(Task([=] { return handler.process_raw_crex(data, size, fname, offset); }));
+                else
+                    submit(Task([=] { return handler.process_raw_bufr(data, size, fname, offset); }));
+            }
+        } catch (...) {
+            // Messages point to the reader data, which needs to stay valid
+            // until they have been processed
+            flush();
+            throw;
+        }
+        flush();
+    }
+};
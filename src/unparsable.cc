@@ -27,26 +27,44 @@ struct CopyUnparsable : public RawHandler
 
     CopyUnparsable(FILE* out, FILE* log=0) : out(out), log(log), unparsed(0) {}
 
-    virtual void handle_raw_bufr(const std::string& raw_data, const char* fname, long offset)
+    virtual void handle_raw_bufr(const char* data, size_t size, const char* fname, long offset)
+    {
+        process_raw_bufr(data, size, fname, offset)();
+    }
+
+    virtual void handle_raw_crex(const char* data, size_t size, const char* fname, long offset)
+    {
+        process_raw_crex(data, size, fname, offset)();
+    }
+
+    // Return a function that copies an unparsable message to the output
+    RawResult copy_unparsable(const char* data, size_t size, const std::exception& e)
+    {
+        std::string msg(e.what());
+        return [=]() {
+            if (log) fprintf(log, "%s\n", msg.c_str());
+            fwrite(data, size, 1, out);
+            ++unparsed;
+        };
+    }
+
+    RawResult process_raw_bufr(const char* data, size_t size, const char* fname, long offset) override
     {
         try {
-            BufrBulletin::decode(raw_data, fname, offset);
+            BufrBulletin::decode(data, size, fname, offset);
         } catch (std::exception& e) {
-            if (log) fprintf(log, "%s\n", e.what());
-            fwrite(raw_data.data(), raw_data.size(), 1, out);
-            ++unparsed;
+            return copy_unparsable(data, size, e);
         }
+        return []() {};
     }
 
-    virtual void handle_raw_crex(const std::string& raw_data, const char* fname, long offset)
+    RawResult process_raw_crex(const char* data, size_t size, const char* fname, long offset) override
     {
         try {
-            CrexBulletin::decode(raw_data, fname, offset);
+            CrexBulletin::decode(data, size, fname, offset);
         } catch (std::exception& e) {
-            if (log) fprintf(log, "%s\n", e.what());
-            fwrite(raw_data.data(), raw_data.size(), 1, out);
-            ++unparsed;
+            return copy_unparsable(data, size, e);
         }
+        return []() {};
     }
 };
-
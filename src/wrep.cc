@@ -5,6 +5,7 @@
 #include <string>
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
 #include "config.h"
 
 #ifdef HAS_GETOPT_LONG
@@ -21,6 +22,8 @@ using namespace std;
 #include "output.cc"
 #include "iterate.cc"
 #include "unparsable.cc"
+#include "index.cc"
+#include "parallel.cc"
 
 void do_usage(FILE* out)
 {
@@ -47,6 +50,16 @@ void do_help(FILE* out)
         "  -T,--tables         print the version of tables used by each bulletin\n"
         "  -F,--features       print the features used by each bulletin\n"
         "  -L,--list-tables    print a list of all tables found\n"
+        "  -I,--index          create or update the index of each file, stored\n"
+        "                      in a sidecar file with an .idx extension\n"
+        "  -C,--compile-tables write the compiled version of the given B and D\n"
+        "                      table files, to speed up loading them (use -c\n"
+        "                      for CREX B tables)\n"
+        "  -P,--profile        decode all messages and print the time and input\n"
+        "                      used by each kind of opcode (requires wreport to\n"
+        "                      be built with --enable-interpreter-profile)\n"
+        "  -j,--jobs=N         decode messages using N threads; output is kept\n"
+        "                      in input order\n"
 #ifndef HAS_GETOPT_LONG
         "NOTE: long options are not supported on this system\n"
 #endif
@@ -70,6 +83,10 @@ int main(int argc, char* argv[])
         {"tables",     no_argument,       NULL, 'T'},
         {"features",   no_argument,       NULL, 'F'},
         {"list-tables", no_argument,       NULL, 'L'},
+        {"index",      no_argument,       NULL, 'I'},
+        {"compile-tables", no_argument,   NULL, 'C'},
+        {"profile",    no_argument,       NULL, 'P'},
+        {"jobs",       required_argument, NULL, 'j'},
         {"help",       no_argument,       NULL, 'h'},
         {0, 0, 0, 0}
     };
@@ -83,10 +100,10 @@ int main(int argc, char* argv[])
         int option_index = 0;
 
 #ifdef HAS_GETOPT_LONG
-        int c = getopt_long(argc, argv, "cdsDpivUTFLh:",
+        int c = getopt_long(argc, argv, "cdsDpivUTFLICPj:h:",
                 long_options, &option_index);
 #else
-        int c = getopt(argc, argv, "cdsDpivUTFLh:");
+        int c = getopt(argc, argv, "cdsDpivUTFLICPj:h:");
 #endif
 
         // Detect the end of the options
@@ -109,6 +126,17 @@ int main(int argc, char* argv[])
             case 'T': options.action = TABLES; break;
             case 'F': options.action = FEATURES; break;
             case 'L': options.action = LIST_TABLES; break;
+            case 'I': options.action = INDEX; break;
+            case 'C': options.action = COMPILE_TABLES; break;
+            case 'P': options.action = PROFILE; break;
+            case 'j':
+                options.jobs = strtoul(optarg, NULL, 10);
+                if (options.jobs == 0)
+                {
+                    fprintf(stderr, "invalid number of jobs: %s\n", optarg);
+                    return 1;
+                }
+                break;
             case 'h': options.action = HELP; break;
             default:
                 fprintf(stderr, "unknown option character %c (%d)\n", c, c);
@@ -141,6 +169,16 @@ int main(int argc, char* argv[])
         case UNPARSABLE: handler.reset(new CopyUnparsable(stdout, stderr)); break;
         case TABLES: handler.reset(new PrintTables(stdout)); break;
         case FEATURES: handler.reset(new PrintFeatures(stdout)); break;
+        case PROFILE:
+            if (!bulletin::Profile::available())
+            {
+                fprintf(stderr, "profiling is not available: wreport was built without --enable-interpreter-profile\n");
+                return 1;
+            }
+            handler.reset(new PrintProfile(stdout));
+            break;
+        case INDEX: break;
+        case COMPILE_TABLES: break;
     }
 
     // Ensure we have some file to process
@@ -154,19 +192,33 @@ int main(int argc, char* argv[])
     bulletin_reader reader = read_bufr_raw;
     if (options.crex) reader = read_crex_raw;
 
+    // Decode using multiple threads, if requested. Profiles are collected
+    // per thread, so profiling always decodes in the main thread
+    unique_ptr<ParallelReader> parallel;
+    if (handler && options.jobs > 1 && options.action != PROFILE)
+        parallel.reset(new ParallelReader(*handler, options.jobs));
+
     try {
         while (optind < argc)
         {
             if (options.verbose) fprintf(stderr, "Reading from %s\n", argv[optind]);
             const char* fname = argv[optind++];
             try {
-                reader(options, fname, *handler);
+                if (options.action == INDEX)
+                    do_index(options, fname);
+                else if (options.action == COMPILE_TABLES)
+                    do_compile_table(options, fname);
+                else if (parallel)
+                    parallel->read(options, fname);
+                else
+                    reader(options, fname, *handler);
             } catch (std::exception& e) {
                 fprintf(stderr, "%s:%s\n", fname, e.what());
             }
         }
 
-        handler->done();
+        parallel.reset();
+        if (handler) handler->done();
     } catch (std::exception& e) {
         fprintf(stderr, "%s\n", e.what());
         return 1;
@@ -0,0 +1,55 @@
+#include "tests.h"
+#include "arena.h"
+#include <cstring>
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("allocate", []() {
+            Arena arena;
+            wassert(actual(arena.allocated()) == 0u);
+            wassert(actual(arena.reserved()) == 0u);
+
+            char* a = (char*)arena.allocate(3, 1);
+            char* b = (char*)arena.allocate(5, 1);
+            wassert(actual(b - a) == 3);
+            wassert(actual(arena.allocated()) == 8u);
+            wassert(actual(arena.reserved()) == Arena::chunk_size);
+
+            double* d = arena.create<double>(1.5);
+            wassert(actual((uintptr_t)d % alignof(double)) == 0u);
+            wassert(actual(*d) == 1.5);
+        });
+        add_method("grow", []() {
+            Arena arena;
+            // Allocations bigger than a chunk
+            char* big = (char*)arena.allocate(Arena::chunk_size * 3, 1);
+            memset(big, 1, Arena::chunk_size * 3);
+            for (unsigned i = 0; i < 1000; ++i)
+                memset(arena.allocate(100), 2, 100);
+            wassert(actual(arena.allocated()) >= Arena::chunk_size * 3 + 100000);
+            size_t reserved = arena.reserved();
+
+            // clear() merges everything into one chunk, that can fit the same
+            // allocations again without growing
+            arena.clear();
+            wassert(actual(arena.allocated()) == 0u);
+            wassert(actual(arena.reserved()) == reserved);
+            arena.allocate(Arena::chunk_size * 3, 1);
+            for (unsigned i = 0; i < 1000; ++i)
+                arena.allocate(100);
+            wassert(actual(arena.reserved()) == reserved);
+        });
+    }
+} test("arena");
+
+}
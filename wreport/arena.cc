@@ -0,0 +1,60 @@
+#include "arena.h"
+#include <algorithm>
+
+namespace wreport {
+
+const size_t Arena::chunk_size;
+
+Arena::~Arena() {}
+
+void* Arena::allocate_chunk(size_t size, size_t align)
+{
+    size_t new_size = chunk_size;
+    if (!chunks.empty())
+    {
+        allocated_before += cur - (uintptr_t)chunks.back().data.get();
+        new_size = chunks.back().size + chunks.back().size / 2;
+    }
+    new_size = std::max(new_size, size + align);
+
+    chunks.emplace_back(Chunk{std::unique_ptr<char[]>(new char[new_size]), new_size});
+    cur = (uintptr_t)chunks.back().data.get();
+    end = cur + new_size;
+
+    uintptr_t res = (cur + align - 1) & ~(uintptr_t)(align - 1);
+    cur = res + size;
+    return (void*)res;
+}
+
+void Arena::clear()
+{
+    if (chunks.empty()) return;
+
+    if (chunks.size() > 1)
+    {
+        // Merge all chunks into one, so that next time everything fits
+        size_t size = reserved();
+        chunks.clear();
+        chunks.emplace_back(Chunk{std::unique_ptr<char[]>(new char[size]), size});
+    }
+
+    cur = (uintptr_t)chunks.back().data.get();
+    end = cur + chunks.back().size;
+    allocated_before = 0;
+}
+
+size_t Arena::allocated() const
+{
+    if (chunks.empty()) return 0;
+    return allocated_before + (cur - (uintptr_t)chunks.back().data.get());
+}
+
+size_t Arena::reserved() const
+{
+    size_t res = 0;
+    for (const auto& c: chunks)
+        res += c.size;
+    return res;
+}
+
+}
@@ -0,0 +1,97 @@
+#ifndef WREPORT_ARENA_H
+#define WREPORT_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace wreport {
+
+/**
+ * Bump allocator for memory that is released all at once.
+ *
+ * Memory is handed out sequentially from large chunks, and it is only given
+ * back when clear() is called or the Arena is destroyed. Destructors of
+ * objects created in an Arena are not called automatically.
+ *
+ * A Bulletin uses an Arena to store the values and attributes of the
+ * variables it decodes, so that they can be released in one step when the
+ * bulletin is cleared.
+ */
+class Arena
+{
+protected:
+    struct Chunk
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    /// Memory chunks, the last one is the one currently in use
+    std::vector<Chunk> chunks;
+
+    /// Next free byte in the current chunk
+    uintptr_t cur = 0;
+
+    /// End of the current chunk
+    uintptr_t end = 0;
+
+    /// Memory allocated from the chunks that have been filled
+    size_t allocated_before = 0;
+
+    /// Allocate a new chunk and allocate \a size bytes from it
+    void* allocate_chunk(size_t size, size_t align);
+
+public:
+    /// Size of the first chunk allocated
+    static const size_t chunk_size = 4096;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    /**
+     * Allocate \a size bytes aligned to \a align, which must be a power of
+     * two.
+     *
+     * The memory is valid until clear() is called or the Arena is destroyed.
+     */
+    void* allocate(size_t size, size_t align=alignof(std::max_align_t))
+    {
+        uintptr_t res = (cur + align - 1) & ~(uintptr_t)(align - 1);
+        if (res + size > end || !cur)
+            return allocate_chunk(size, align);
+        cur = res + size;
+        return (void*)res;
+    }
+
+    /// Construct an object of type T in memory allocated by the Arena
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Release all the memory allocated so far.
+     *
+     * The memory is kept to be reused by the following allocations: if more
+     * than one chunk has been used, they are merged into a single one big
+     * enough to hold them all.
+     */
+    void clear();
+
+    /// Number of bytes allocated since the last clear()
+    size_t allocated() const;
+
+    /// Number of bytes held by the Arena
+    size_t reserved() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Count memory allocations for the benchmarks.
+ *
+ * Linking this file into a program replaces malloc, calloc and realloc with
+ * versions that update benchmark::allocation_count and
+ * benchmark::allocation_bytes, then call the glibc implementation. free and
+ * the aligned allocation functions are left alone, as they work on the same
+ * heap.
+ */
+#include "benchmark.h"
+#include "config.h"
+#include <cstddef>
+
+#ifdef HAVE___LIBC_MALLOC
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+    wreport::benchmark::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    wreport::benchmark::allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size)
+{
+    wreport::benchmark::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    wreport::benchmark::allocation_bytes.fetch_add(nmemb * size, std::memory_order_relaxed);
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    wreport::benchmark::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    wreport::benchmark::allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+namespace {
+
+struct EnableAllocationCount
+{
+    EnableAllocationCount() { wreport::benchmark::allocations_counted = true; }
+} enable_allocation_count;
+
+}
+#endif
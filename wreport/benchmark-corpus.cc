@@ -0,0 +1,468 @@
+#include "benchmark-corpus.h"
+#include "error.h"
+#include "subset.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace wreport {
+namespace benchmark {
+
+namespace {
+
+/// Observing station, shared by all the messages that report from it
+struct Station
+{
+    int block;
+    int number;
+    string name;
+    double lat;
+    double lon;
+    int height;
+};
+
+/// Fixed list of stations, the same for every corpus
+const vector<Station>& stations()
+{
+    static vector<Station>* res = nullptr;
+    if (!res)
+    {
+        static const char* names[] = { "MOUNT", "VALLEY", "HARBOUR", "AIRPORT", "CENTRE", "LIGHTHOUSE", "PASS", "ISLAND" };
+        res = new vector<Station>;
+        mt19937 rng(0);
+        for (unsigned i = 0; i < 1000; ++i)
+        {
+            Station s;
+            s.block = 1 + i % 99;
+            s.number = 1 + i * 37 % 999;
+            s.name = string(names[rng() % 8]) + " " + to_string(i);
+            s.lat = uniform_real_distribution<double>(-80, 80)(rng);
+            s.lon = uniform_real_distribution<double>(-180, 180)(rng);
+            s.height = uniform_int_distribution<int>(-10, 3000)(rng);
+            res->push_back(s);
+        }
+    }
+    return *res;
+}
+
+double uniform(mt19937& rng, double min, double max)
+{
+    return uniform_real_distribution<double>(min, max)(rng);
+}
+
+int uniform_int(mt19937& rng, int min, int max)
+{
+    return uniform_int_distribution<int>(min, max)(rng);
+}
+
+/// Set up the header of a bulletin with a random reference time
+void init_bulletin(BufrBulletin& b, mt19937& rng, int category, int subcategory)
+{
+    b.edition_number = 4;
+    b.data_category = category;
+    b.data_subcategory = 255;
+    b.data_subcategory_local = subcategory;
+    b.rep_year = 2016;
+    b.rep_month = uniform_int(rng, 1, 12);
+    b.rep_day = uniform_int(rng, 1, 28);
+    b.rep_hour = uniform_int(rng, 0, 23);
+    b.rep_minute = 0;
+    b.rep_second = 0;
+    b.originating_centre = 98;
+    b.originating_subcentre = 0;
+    b.master_table_version_number = 14;
+    b.master_table_version_number_local = 0;
+    b.compression = false;
+}
+
+void store_time(Subset& s, const BufrBulletin& b, int second=-1)
+{
+    s.store_variable_i(WR_VAR(0, 4, 1), b.rep_year);
+    s.store_variable_i(WR_VAR(0, 4, 2), b.rep_month);
+    s.store_variable_i(WR_VAR(0, 4, 3), b.rep_day);
+    s.store_variable_i(WR_VAR(0, 4, 4), b.rep_hour);
+    s.store_variable_i(WR_VAR(0, 4, 5), b.rep_minute);
+    if (second != -1)
+        s.store_variable_i(WR_VAR(0, 4, 6), second);
+}
+
+unique_ptr<BufrBulletin> make_synop(mt19937& rng)
+{
+    auto b = BufrBulletin::create();
+    init_bulletin(*b, rng, 0, 1);
+    b->datadesc = {
+        WR_VAR(0, 1, 1), WR_VAR(0, 1, 2), WR_VAR(0, 1, 15),
+        WR_VAR(0, 4, 1), WR_VAR(0, 4, 2), WR_VAR(0, 4, 3), WR_VAR(0, 4, 4), WR_VAR(0, 4, 5),
+        WR_VAR(0, 5, 1), WR_VAR(0, 6, 1), WR_VAR(0, 7, 1),
+        WR_VAR(0, 10, 4), WR_VAR(0, 10, 51), WR_VAR(0, 10, 61), WR_VAR(0, 10, 63),
+        WR_VAR(0, 12, 101), WR_VAR(0, 12, 103), WR_VAR(0, 13, 3),
+        WR_VAR(0, 11, 1), WR_VAR(0, 11, 2), WR_VAR(0, 20, 10),
+        // Cloud layers
+        WR_VAR(1, 4, 0), WR_VAR(0, 31, 1),
+        WR_VAR(0, 8, 2), WR_VAR(0, 20, 11), WR_VAR(0, 20, 12), WR_VAR(0, 20, 13),
+        WR_VAR(0, 13, 11),
+    };
+    b->load_tables();
+
+    const auto& all_stations = stations();
+    unsigned first = rng() % all_stations.size();
+    unsigned count = uniform_int(rng, 1, 50);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const Station& st = all_stations[(first + i) % all_stations.size()];
+        Subset& s = b->obtain_subset(i);
+        s.store_variable_i(WR_VAR(0, 1, 1), st.block);
+        s.store_variable_i(WR_VAR(0, 1, 2), st.number);
+        s.store_variable_c(WR_VAR(0, 1, 15), st.name.c_str());
+        store_time(s, *b);
+        s.store_variable_d(WR_VAR(0, 5, 1), st.lat);
+        s.store_variable_d(WR_VAR(0, 6, 1), st.lon);
+        s.store_variable_i(WR_VAR(0, 7, 1), st.height);
+        double pressure = uniform(rng, 95000, 104000);
+        s.store_variable_d(WR_VAR(0, 10, 4), pressure);
+        s.store_variable_d(WR_VAR(0, 10, 51), pressure + st.height * 12);
+        s.store_variable_d(WR_VAR(0, 10, 61), uniform(rng, -500, 500));
+        s.store_variable_i(WR_VAR(0, 10, 63), uniform_int(rng, 0, 8));
+        double temperature = uniform(rng, 250, 310);
+        s.store_variable_d(WR_VAR(0, 12, 101), temperature);
+        s.store_variable_d(WR_VAR(0, 12, 103), temperature - uniform(rng, 0, 15));
+        s.store_variable_i(WR_VAR(0, 13, 3), uniform_int(rng, 10, 100));
+        s.store_variable_i(WR_VAR(0, 11, 1), uniform_int(rng, 0, 36) * 10);
+        s.store_variable_d(WR_VAR(0, 11, 2), uniform(rng, 0, 30));
+        s.store_variable_i(WR_VAR(0, 20, 10), uniform_int(rng, 0, 8) * 12);
+        unsigned layers = uniform_int(rng, 0, 4);
+        s.store_variable_i(WR_VAR(0, 31, 1), layers);
+        for (unsigned l = 0; l < layers; ++l)
+        {
+            s.store_variable_i(WR_VAR(0, 8, 2), l + 1);
+            s.store_variable_i(WR_VAR(0, 20, 11), uniform_int(rng, 1, 8));
+            s.store_variable_i(WR_VAR(0, 20, 12), uniform_int(rng, 30, 39));
+            s.store_variable_i(WR_VAR(0, 20, 13), l * 400 + uniform_int(rng, 1, 4) * 100);
+        }
+        if (rng() % 3)
+            s.store_variable_undef(WR_VAR(0, 13, 11));
+        else
+            s.store_variable_d(WR_VAR(0, 13, 11), uniform(rng, 0, 50));
+    }
+    return b;
+}
+
+unique_ptr<BufrBulletin> make_temp(mt19937& rng)
+{
+    auto b = BufrBulletin::create();
+    init_bulletin(*b, rng, 2, 4);
+    b->datadesc = {
+        WR_VAR(0, 1, 1), WR_VAR(0, 1, 2),
+        WR_VAR(0, 4, 1), WR_VAR(0, 4, 2), WR_VAR(0, 4, 3), WR_VAR(0, 4, 4), WR_VAR(0, 4, 5),
+        WR_VAR(0, 5, 1), WR_VAR(0, 6, 1), WR_VAR(0, 7, 1),
+        // Levels
+        WR_VAR(1, 6, 0), WR_VAR(0, 31, 2),
+        WR_VAR(0, 7, 4), WR_VAR(0, 10, 9), WR_VAR(0, 12, 101), WR_VAR(0, 12, 103),
+        WR_VAR(0, 11, 1), WR_VAR(0, 11, 2),
+    };
+    b->load_tables();
+
+    const Station& st = stations()[rng() % stations().size()];
+    Subset& s = b->obtain_subset(0);
+    s.store_variable_i(WR_VAR(0, 1, 1), st.block);
+    s.store_variable_i(WR_VAR(0, 1, 2), st.number);
+    store_time(s, *b);
+    s.store_variable_d(WR_VAR(0, 5, 1), st.lat);
+    s.store_variable_d(WR_VAR(0, 6, 1), st.lon);
+    s.store_variable_i(WR_VAR(0, 7, 1), st.height);
+    unsigned levels = uniform_int(rng, 30, 300);
+    s.store_variable_i(WR_VAR(0, 31, 2), levels);
+    double pressure = uniform(rng, 95000, 104000);
+    double temperature = uniform(rng, 260, 305);
+    for (unsigned l = 0; l < levels; ++l)
+    {
+        double p = pressure * (levels - l) / levels;
+        if (p < 1000) p = 1000;
+        s.store_variable_d(WR_VAR(0, 7, 4), p);
+        s.store_variable_i(WR_VAR(0, 10, 9), st.height + l * 100);
+        double t = temperature - l * 0.4;
+        if (t < 190) t = 190;
+        s.store_variable_d(WR_VAR(0, 12, 101), t);
+        if (rng() % 4)
+            s.store_variable_d(WR_VAR(0, 12, 103), t - uniform(rng, 0, 20));
+        else
+            s.store_variable_undef(WR_VAR(0, 12, 103));
+        s.store_variable_i(WR_VAR(0, 11, 1), uniform_int(rng, 0, 359));
+        s.store_variable_d(WR_VAR(0, 11, 2), uniform(rng, 0, 60));
+    }
+    return b;
+}
+
+unique_ptr<BufrBulletin> make_buoy(mt19937& rng)
+{
+    auto b = BufrBulletin::create();
+    init_bulletin(*b, rng, 1, 21);
+    b->datadesc = { WR_VAR(3, 8, 3) };
+    b->load_tables();
+
+    unsigned count = uniform_int(rng, 1, 20);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Subset& s = b->obtain_subset(i);
+        s.store_variable_i(WR_VAR(0, 1, 5), uniform_int(rng, 10000, 99999));
+        s.store_variable_i(WR_VAR(0, 1, 12), uniform_int(rng, 0, 359));
+        s.store_variable_d(WR_VAR(0, 1, 13), uniform(rng, 0, 2));
+        s.store_variable_i(WR_VAR(0, 2, 1), 0);
+        store_time(s, *b);
+        s.store_variable_d(WR_VAR(0, 5, 2), uniform(rng, -70, 70));
+        s.store_variable_d(WR_VAR(0, 6, 2), uniform(rng, -180, 180));
+        double pressure = uniform(rng, 97000, 103000);
+        s.store_variable_d(WR_VAR(0, 10, 4), pressure);
+        s.store_variable_d(WR_VAR(0, 10, 51), pressure);
+        s.store_variable_d(WR_VAR(0, 10, 61), uniform(rng, -300, 300));
+        s.store_variable_i(WR_VAR(0, 10, 63), uniform_int(rng, 0, 8));
+        s.store_variable_undef(WR_VAR(0, 11, 11));
+        s.store_variable_undef(WR_VAR(0, 11, 12));
+        double temperature = uniform(rng, 270, 305);
+        s.store_variable_d(WR_VAR(0, 12, 4), temperature);
+        s.store_variable_undef(WR_VAR(0, 12, 6));
+        s.store_variable_undef(WR_VAR(0, 13, 3));
+        s.store_variable_undef(WR_VAR(0, 20, 1));
+        s.store_variable_undef(WR_VAR(0, 20, 3));
+        s.store_variable_undef(WR_VAR(0, 20, 4));
+        s.store_variable_undef(WR_VAR(0, 20, 5));
+        s.store_variable_undef(WR_VAR(0, 20, 10));
+        s.store_variable_undef(WR_VAR(0, 8, 2));
+        s.store_variable_undef(WR_VAR(0, 20, 11));
+        s.store_variable_undef(WR_VAR(0, 20, 13));
+        s.store_variable_undef(WR_VAR(0, 20, 12));
+        s.store_variable_undef(WR_VAR(0, 20, 12));
+        s.store_variable_undef(WR_VAR(0, 20, 12));
+        s.store_variable_d(WR_VAR(0, 22, 42), temperature + uniform(rng, -2, 2));
+    }
+    return b;
+}
+
+unique_ptr<BufrBulletin> make_satellite(mt19937& rng)
+{
+    static const unsigned channels = 15;
+    auto b = BufrBulletin::create();
+    init_bulletin(*b, rng, 21, 240);
+    b->compression = true;
+    b->datadesc = {
+        WR_VAR(0, 1, 7), WR_VAR(0, 2, 19),
+        WR_VAR(0, 4, 1), WR_VAR(0, 4, 2), WR_VAR(0, 4, 3), WR_VAR(0, 4, 4), WR_VAR(0, 4, 5), WR_VAR(0, 4, 6),
+        WR_VAR(0, 5, 1), WR_VAR(0, 6, 1),
+        WR_VAR(1, 2, channels), WR_VAR(0, 5, 42), WR_VAR(0, 12, 63),
+    };
+    b->load_tables();
+
+    int satellite = uniform_int(rng, 200, 223);
+    int instrument = uniform_int(rng, 570, 621);
+    double lat = uniform(rng, -80, 70);
+    double lon = uniform(rng, -180, 170);
+    unsigned count = uniform_int(rng, 1000, 4000);
+    // Scan lines of 30 fields of view
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Subset& s = b->obtain_subset(i);
+        s.store_variable_i(WR_VAR(0, 1, 7), satellite);
+        s.store_variable_i(WR_VAR(0, 2, 19), instrument);
+        store_time(s, *b, i / 30 % 60);
+        s.store_variable_d(WR_VAR(0, 5, 1), lat + (i / 30) * 0.05);
+        s.store_variable_d(WR_VAR(0, 6, 1), lon + (i % 30) * 0.3);
+        for (unsigned c = 0; c < channels; ++c)
+        {
+            s.store_variable_i(WR_VAR(0, 5, 42), c + 1);
+            if (rng() % 20)
+                s.store_variable_d(WR_VAR(0, 12, 63), uniform(rng, 180, 300));
+            else
+                s.store_variable_undef(WR_VAR(0, 12, 63));
+        }
+    }
+    return b;
+}
+
+unique_ptr<BufrBulletin> make_bitmap(mt19937& rng)
+{
+    static string* encoded = nullptr;
+    if (!encoded)
+    {
+        const char* datadir = getenv("WREPORT_TESTDATA");
+        if (!datadir)
+            throw error_consistency("WREPORT_TESTDATA is not set: cannot load bitmap-B33035.bufr");
+        string pathname = datadir;
+        pathname += "/bufr/bitmap-B33035.bufr";
+        FILE* in = fopen(pathname.c_str(), "rb");
+        if (!in)
+            throw error_system("cannot open " + pathname);
+        encoded = new string;
+        BufrBulletin::read(in, *encoded, pathname.c_str());
+        fclose(in);
+    }
+    auto b = BufrBulletin::decode(*encoded);
+    b->rep_day = uniform_int(rng, 1, 28);
+    b->rep_hour = uniform_int(rng, 0, 23);
+    return b;
+}
+
+/// Parse a size with an optional k, M or G suffix
+size_t parse_size(const char* str)
+{
+    char* end;
+    size_t res = strtoull(str, &end, 10);
+    switch (*end)
+    {
+        case 'k': case 'K': res *= 1024; break;
+        case 'm': case 'M': res *= 1024 * 1024; break;
+        case 'g': case 'G': res *= 1024 * 1024 * 1024; break;
+        case 0: break;
+        default: error_consistency::throwf("cannot parse size '%s'", str);
+    }
+    return res;
+}
+
+}
+
+Corpus::~Corpus()
+{
+    if (data)
+        munmap((void*)data, size);
+}
+
+void Corpus::Options::from_env()
+{
+    if (const char* env = getenv("WREPORT_BENCH_CORPUS_SIZE"))
+        size = parse_size(env);
+    if (const char* env = getenv("WREPORT_BENCH_CORPUS_MIX"))
+    {
+        for (auto& m: mix)
+            m = 0;
+        string spec = env;
+        size_t pos = 0;
+        while (pos < spec.size())
+        {
+            size_t end = spec.find(',', pos);
+            if (end == string::npos) end = spec.size();
+            string item = spec.substr(pos, end - pos);
+            size_t eq = item.find('=');
+            string name = item.substr(0, eq);
+            bool found = false;
+            for (unsigned i = 0; i < KIND_COUNT; ++i)
+                if (name == kind_name((Kind)i))
+                {
+                    mix[i] = eq == string::npos ? 1 : strtoul(item.c_str() + eq + 1, nullptr, 10);
+                    found = true;
+                }
+            if (!found)
+                error_consistency::throwf("unknown kind of message '%s' in WREPORT_BENCH_CORPUS_MIX", name.c_str());
+            pos = end + 1;
+        }
+    }
+}
+
+const char* Corpus::kind_name(Kind kind)
+{
+    switch (kind)
+    {
+        case SYNOP: return "synop";
+        case TEMP: return "temp";
+        case BUOY: return "buoy";
+        case SATELLITE: return "satellite";
+        case BITMAP: return "bitmap";
+        default: return "unknown";
+    }
+}
+
+unique_ptr<BufrBulletin> Corpus::make(Kind kind, mt19937& rng)
+{
+    switch (kind)
+    {
+        case SYNOP: return make_synop(rng);
+        case TEMP: return make_temp(rng);
+        case BUOY: return make_buoy(rng);
+        case SATELLITE: return make_satellite(rng);
+        case BITMAP: return make_bitmap(rng);
+        default: error_consistency::throwf("cannot generate messages of kind %d", (int)kind);
+    }
+}
+
+size_t Corpus::count(Kind kind) const
+{
+    size_t res = 0;
+    for (const auto& e: entries)
+        if (pool_kinds[e.pool_index] == kind)
+            ++res;
+    return res;
+}
+
+void Corpus::generate(const Options& opts)
+{
+    if (data)
+    {
+        munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
+    }
+    pool.clear();
+    pool_kinds.clear();
+    entries.clear();
+
+    mt19937 rng(opts.seed);
+    discrete_distribution<unsigned> pick_kind(opts.mix, opts.mix + KIND_COUNT);
+
+    // Generate the distinct messages
+    vector<string> encoded;
+    size_t pool_size = 0;
+    size_t max_pool_size = min(opts.size, opts.pool_size);
+    while (pool_size < max_pool_size)
+    {
+        Kind kind = (Kind)pick_kind(rng);
+        pool.emplace_back(make(kind, rng));
+        pool_kinds.push_back(kind);
+        encoded.emplace_back(pool.back()->encode());
+        pool_size += encoded.back().size();
+    }
+
+    // Write the pool over and over until the corpus is big enough
+    const char* tmpdir = getenv("TMPDIR");
+    string pathname = tmpdir ? tmpdir : "/tmp";
+    pathname += "/wreport-corpus-XXXXXX";
+    int fd = mkstemp(&pathname[0]);
+    if (fd == -1)
+        throw error_system("cannot create " + pathname);
+    unlink(pathname.c_str());
+    FILE* out = fdopen(fd, "wb");
+    if (!out)
+    {
+        ::close(fd);
+        throw error_system("cannot open " + pathname);
+    }
+    for (unsigned i = 0; size < opts.size; i = (i + 1) % encoded.size())
+    {
+        if (fwrite(encoded[i].data(), encoded[i].size(), 1, out) != 1)
+        {
+            fclose(out);
+            throw error_system("cannot write to " + pathname);
+        }
+        entries.push_back(Entry{ size, encoded[i].size(), i });
+        size += encoded[i].size();
+    }
+    if (fflush(out) != 0)
+    {
+        fclose(out);
+        throw error_system("cannot write to " + pathname);
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    fclose(out);
+    if (mapped == MAP_FAILED)
+    {
+        size = 0;
+        entries.clear();
+        throw error_system("cannot map " + pathname + " in memory");
+    }
+    data = (const uint8_t*)mapped;
+}
+
+}
+}
@@ -0,0 +1,117 @@
+#ifndef WREPORT_BENCHMARK_CORPUS_H
+#define WREPORT_BENCHMARK_CORPUS_H
+
+/** @file
+ * Synthetic corpus of BUFR messages for throughput benchmarks.
+ */
+
+#include <wreport/bulletin.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace wreport {
+namespace benchmark {
+
+/**
+ * Large corpus of synthetic BUFR messages, stored in a temporary file mapped
+ * in memory.
+ *
+ * A pool of distinct messages is generated first, mixing the various kinds
+ * of messages according to the configuration. The pool is then written
+ * over and over until the corpus reaches the configured size, so that a
+ * corpus of many gigabytes can be built in the time needed to encode the
+ * pool.
+ */
+struct Corpus
+{
+    /// Kinds of generated messages
+    enum Kind
+    {
+        /// Land stations, many uncompressed subsets with delayed replication of cloud layers
+        SYNOP,
+        /// Radiosonde soundings, with delayed replication of hundreds of levels
+        TEMP,
+        /// Drifting buoys, using the D08003 sequence
+        BUOY,
+        /// Compressed satellite radiances, with thousands of subsets
+        SATELLITE,
+        /// Data present bitmaps and quality information, from a test message
+        BITMAP,
+        KIND_COUNT
+    };
+
+    /// Configuration of a corpus
+    struct Options
+    {
+        /// Approximate size of the corpus in bytes
+        size_t size = 100 * 1024 * 1024;
+        /// Maximum total size of the distinct messages that are generated
+        size_t pool_size = 2 * 1024 * 1024;
+        /// Relative number of messages of each kind
+        unsigned mix[KIND_COUNT] = { 40, 10, 20, 20, 10 };
+        /// Seed for the random number generator
+        unsigned seed = 1;
+
+        /**
+         * Read the configuration from the environment:
+         *
+         *  * `WREPORT_BENCH_CORPUS_SIZE`: size of the corpus in bytes, with an
+         *    optional k, M or G suffix
+         *  * `WREPORT_BENCH_CORPUS_MIX`: relative number of messages of each
+         *    kind, like `synop=40,temp=10,buoy=20,satellite=20,bitmap=10`.
+         *    Kinds that are not mentioned are not generated.
+         */
+        void from_env();
+    };
+
+    /// A message in the corpus
+    struct Entry
+    {
+        /// Offset of the message in data
+        size_t offset;
+        /// Size of the encoded message
+        size_t size;
+        /// Index of the message in pool
+        unsigned pool_index;
+    };
+
+    /// Distinct messages in the corpus
+    std::vector<std::unique_ptr<BufrBulletin>> pool;
+    /// Kind of each message in pool
+    std::vector<Kind> pool_kinds;
+    /// All the messages in the corpus, in the order they appear in data
+    std::vector<Entry> entries;
+    /// Encoded corpus
+    const uint8_t* data = nullptr;
+    /// Size of data
+    size_t size = 0;
+
+    Corpus() = default;
+    Corpus(const Corpus&) = delete;
+    ~Corpus();
+    Corpus& operator=(const Corpus&) = delete;
+
+    /**
+     * Generate the corpus.
+     *
+     * The temporary file is created in $TMPDIR, or /tmp, and unlinked right
+     * away.
+     */
+    void generate(const Options& opts);
+
+    /// Count the messages of the given kind in the corpus
+    size_t count(Kind kind) const;
+
+    /// Name of a kind of message
+    static const char* kind_name(Kind kind);
+
+    /// Create a bulletin of the given kind with random values
+    static std::unique_ptr<BufrBulletin> make(Kind kind, std::mt19937& rng);
+};
+
+}
+}
+
+#endif
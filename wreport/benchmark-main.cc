@@ -2,5 +2,5 @@
 
 int main (int argc, const char* argv[])
 {
-    wreport::benchmark::Registry::basic_run(argc, argv);
+    return wreport::benchmark::Registry::basic_run(argc, argv);
 }
@@ -1,35 +1,232 @@
 #include "benchmark.h"
+#include "error.h"
+#include "config.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <set>
 #include <sys/times.h>
 #include <unistd.h>
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 using namespace std;
 
 namespace {
 double ticks_per_sec = sysconf(_SC_CLK_TCK);
+
+/// Percentage of part in total, or 0 if total is 0
+double percent(double part, double total)
+{
+    return total ? part * 100.0 / total : 0.0;
+}
+
+/// Format a duration in seconds using a unit that fits its magnitude
+std::string format_duration(double secs)
+{
+    char buf[32];
+    if (secs >= 1)
+        snprintf(buf, 32, "%.3fs", secs);
+    else if (secs >= 0.001)
+        snprintf(buf, 32, "%.3fms", secs * 1000.0);
+    else
+        snprintf(buf, 32, "%.3fus", secs * 1000000.0);
+    return buf;
+}
+
+/// Format a count with a k, M or G suffix
+std::string format_count(double val)
+{
+    char buf[32];
+    if (val >= 1e9)
+        snprintf(buf, 32, "%.2fG", val / 1e9);
+    else if (val >= 1e6)
+        snprintf(buf, 32, "%.2fM", val / 1e6);
+    else if (val >= 1e3)
+        snprintf(buf, 32, "%.2fk", val / 1e3);
+    else
+        snprintf(buf, 32, "%.1f", val);
+    return buf;
+}
+
+/// Write a string as a JSON string literal
+void write_json_string(FILE* out, const std::string& str)
+{
+    putc('"', out);
+    for (char c: str)
+    {
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if ((unsigned char)c < 0x20)
+            fprintf(out, "\\u%04x", (unsigned)c);
+        else
+            putc(c, out);
+    }
+    putc('"', out);
+}
+
 }
 
 namespace wreport {
 namespace benchmark {
 
+std::atomic<size_t> allocation_count(0);
+std::atomic<size_t> allocation_bytes(0);
+bool allocations_counted = false;
+
+PerfCounters::PerfCounters()
+{
+    for (auto& fd: fds)
+        fd = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (auto fd: fds)
+        if (fd != -1)
+            ::close(fd);
+}
+
+std::string PerfCounters::open()
+{
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    static const uint64_t configs[PERF_EVENT_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (unsigned i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        if (fds[i] != -1) continue;
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        // Only count user space, which works with the default
+        // perf_event_paranoid setting
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd == -1)
+        {
+            std::string res = "cannot count ";
+            res += event_name((PerfEvent)i);
+            res += ": ";
+            res += strerror(errno);
+            for (auto& f: fds)
+                if (f != -1)
+                {
+                    ::close(f);
+                    f = -1;
+                }
+            return res;
+        }
+        fds[i] = fd;
+    }
+    return std::string();
+#else
+    return "perf_event_open is not available on this system";
+#endif
+}
+
+void PerfCounters::read(uint64_t* values) const
+{
+    for (unsigned i = 0; i < PERF_EVENT_COUNT; ++i)
+    {
+        // value, time enabled, time running
+        uint64_t buf[3];
+        if (fds[i] == -1 || ::read(fds[i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+            values[i] = 0;
+        else if (buf[1] == buf[2])
+            values[i] = buf[0];
+        else
+            values[i] = (uint64_t)((double)buf[0] * buf[1] / buf[2]);
+    }
+}
+
+const char* PerfCounters::event_name(PerfEvent event)
+{
+    switch (event)
+    {
+        case PERF_CYCLES: return "cycles";
+        case PERF_INSTRUCTIONS: return "instructions";
+        case PERF_CACHE_MISSES: return "cache misses";
+        case PERF_BRANCH_MISSES: return "branch misses";
+        default: return "unknown event";
+    }
+}
+
+PerfCounters& PerfCounters::get()
+{
+    static PerfCounters* counters = nullptr;
+    if (!counters)
+        counters = new PerfCounters;
+    return *counters;
+}
+
+Stats Stats::compute(std::vector<double> samples)
+{
+    Stats res;
+    if (samples.empty()) return res;
+    std::sort(samples.begin(), samples.end());
+    size_t size = samples.size();
+    res.min = samples[0];
+    if (size % 2)
+        res.median = samples[size / 2];
+    else
+        res.median = (samples[size / 2 - 1] + samples[size / 2]) / 2;
+    res.p95 = samples[(size_t)ceil(size * 0.95) - 1];
+    return res;
+}
+
 Task::Task(Benchmark* parent, const std::string& name)
     : parent(parent), name(name)
 {
     parent->tasks.push_back(this);
 }
 
+void Task::set_workload(size_t messages, size_t bytes)
+{
+    this->messages = messages;
+    this->bytes = bytes;
+}
+
 void Task::collect(std::function<void()> f)
 {
     run_count += 1;
 
+    const PerfCounters& counters = PerfCounters::get();
+    uint64_t events_start[PERF_EVENT_COUNT], events_end[PERF_EVENT_COUNT];
     struct tms tms_start, tms_end;
     times(&tms_start);
+    if (counters.is_open()) counters.read(events_start);
+    size_t allocations_start = allocation_count;
+    size_t allocated_bytes_start = allocation_bytes;
+    auto start = std::chrono::steady_clock::now();
     f();
+    auto end = std::chrono::steady_clock::now();
+    allocations += allocation_count - allocations_start;
+    allocated_bytes += allocation_bytes - allocated_bytes_start;
+    if (counters.is_open()) counters.read(events_end);
     times(&tms_end);
 
     utime += tms_end.tms_utime - tms_start.tms_utime;
     stime += tms_end.tms_stime - tms_start.tms_stime;
+    wall_times.push_back(std::chrono::duration<double>(end - start).count());
+    if (counters.is_open())
+        for (unsigned i = 0; i < PERF_EVENT_COUNT; ++i)
+            events[i] += events_end[i] - events_start[i];
 }
 
 void Registry::add(Benchmark* b)
@@ -74,19 +271,176 @@ void Benchmark::print_timings()
 {
     for (auto& t: tasks)
     {
-        fprintf(stdout, "%s.%s: %d runs, user: %.2fs (%.1f%%), sys: %.2fs (%.1f%%), total: %.2fs (%.1f%%)\n",
+        Stats wall = t->wall_stats();
+        fprintf(stdout, "%s.%s: %d runs, user: %.2fs (%.1f%%), sys: %.2fs (%.1f%%), total: %.2fs (%.1f%%), wall min/median/p95: %s/%s/%s",
                 name.c_str(),
                 t->name.c_str(),
                 t->run_count,
                 t->utime / ticks_per_sec,
-                t->utime * 100.0 / task_main.utime,
+                percent(t->utime, task_main.utime),
                 t->stime / ticks_per_sec,
-                t->stime * 100.0 / task_main.stime,
+                percent(t->stime, task_main.stime),
                 (t->utime + t->stime) / ticks_per_sec,
-                (t->utime + t->stime) * 100.0 / (task_main.utime + task_main.stime));
+                percent(t->utime + t->stime, task_main.utime + task_main.stime),
+                format_duration(wall.min).c_str(),
+                format_duration(wall.median).c_str(),
+                format_duration(wall.p95).c_str());
+        if (wall.median > 0)
+        {
+            if (t->messages)
+                fprintf(stdout, ", %.1f msg/s", t->messages / wall.median);
+            if (t->bytes)
+                fprintf(stdout, ", %.2f MB/s", t->bytes / wall.median / 1000000.0);
+        }
+        putc('\n', stdout);
     }
 }
 
+void Benchmark::write_csv_header(FILE* out)
+{
+    fprintf(out, "benchmark,task,run,wall,messages,bytes\n");
+}
+
+void Benchmark::write_csv(FILE* out) const
+{
+    for (const auto& t: tasks)
+        for (unsigned i = 0; i < t->wall_times.size(); ++i)
+            fprintf(out, "%s,%s,%u,%.9f,%zu,%zu\n",
+                    name.c_str(), t->name.c_str(), i, t->wall_times[i], t->messages, t->bytes);
+}
+
+void Benchmark::write_json(FILE* out) const
+{
+    fprintf(out, "{\"name\": ");
+    write_json_string(out, name);
+    fprintf(out, ", \"repetitions\": %u, \"tasks\": [", repetitions);
+    for (unsigned i = 0; i < tasks.size(); ++i)
+    {
+        const Task& t = *tasks[i];
+        Stats wall = t.wall_stats();
+        fprintf(out, "%s\n  {\"name\": ", i ? "," : "");
+        write_json_string(out, t.name);
+        fprintf(out, ", \"runs\": %u, \"user\": %.2f, \"sys\": %.2f, \"messages\": %zu, \"bytes\": %zu",
+                t.run_count, t.utime / ticks_per_sec, t.stime / ticks_per_sec, t.messages, t.bytes);
+        fprintf(out, ", \"wall\": {\"min\": %.9f, \"median\": %.9f, \"p95\": %.9f, \"samples\": [",
+                wall.min, wall.median, wall.p95);
+        for (unsigned j = 0; j < t.wall_times.size(); ++j)
+            fprintf(out, "%s%.9f", j ? ", " : "", t.wall_times[j]);
+        fprintf(out, "]}");
+        if (allocations_counted)
+            fprintf(out, ", \"allocations\": %zu, \"allocated_bytes\": %zu", t.allocations, t.allocated_bytes);
+        if (PerfCounters::get().is_open())
+        {
+            fprintf(out, ", \"events\": {");
+            for (unsigned j = 0; j < PERF_EVENT_COUNT; ++j)
+            {
+                fprintf(out, "%s", j ? ", " : "");
+                write_json_string(out, PerfCounters::event_name((PerfEvent)j));
+                fprintf(out, ": %llu", (unsigned long long)t.events[j]);
+            }
+            putc('}', out);
+        }
+        if (wall.median > 0 && t.messages)
+            fprintf(out, ", \"messages_per_second\": %.3f", t.messages / wall.median);
+        if (wall.median > 0 && t.bytes)
+            fprintf(out, ", \"mb_per_second\": %.3f", t.bytes / wall.median / 1000000.0);
+        putc('}', out);
+    }
+    fprintf(out, "]}");
+}
+
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b)
+{
+    if (a.size() < 3 || b.size() < 3) return 1.0;
+
+    // Rank all samples together, giving tied samples their average rank
+    std::vector<std::pair<double, bool>> all;
+    for (auto v: a) all.emplace_back(v, true);
+    for (auto v: b) all.emplace_back(v, false);
+    std::sort(all.begin(), all.end());
+    double rank_sum_a = 0;
+    for (size_t i = 0; i < all.size(); )
+    {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first)
+            ++j;
+        double rank = (i + 1 + j) / 2.0;
+        for ( ; i < j; ++i)
+            if (all[i].second)
+                rank_sum_a += rank;
+    }
+
+    double n1 = a.size(), n2 = b.size();
+    double u = rank_sum_a - n1 * (n1 + 1) / 2;
+    double mean = n1 * n2 / 2;
+    double sd = sqrt(n1 * n2 * (n1 + n2 + 1) / 12);
+    double z = fabs(u - mean) / sd;
+    return erfc(z / sqrt(2.0));
+}
+
+void Baseline::read_csv(const std::string& pathname)
+{
+    FILE* in = fopen(pathname.c_str(), "rt");
+    if (!in)
+        throw error_system("cannot open " + pathname);
+    char line[1024];
+    unsigned lineno = 0;
+    while (fgets(line, 1024, in))
+    {
+        ++lineno;
+        // Split benchmark,task,run,wall,...
+        std::vector<std::string> fields;
+        const char* s = line;
+        while (true)
+        {
+            size_t len = strcspn(s, ",\n");
+            fields.emplace_back(s, len);
+            if (s[len] != ',') break;
+            s += len + 1;
+        }
+        if (fields.size() < 4)
+        {
+            fclose(in);
+            error_consistency::throwf("%s:%u: expected at least 4 comma-separated fields", pathname.c_str(), lineno);
+        }
+        if (lineno == 1 && fields[0] == "benchmark")
+            continue;
+        samples[fields[0] + "." + fields[1]].push_back(strtod(fields[3].c_str(), nullptr));
+    }
+    fclose(in);
+}
+
+unsigned Baseline::compare(const Benchmark& b, FILE* out, unsigned* improvements) const
+{
+    unsigned regressions = 0;
+    for (const auto& t: b.tasks)
+    {
+        auto i = samples.find(b.name + "." + t->name);
+        if (i == samples.end()) continue;
+        double before = Stats::compute(i->second).median;
+        double after = t->wall_stats().median;
+        double change = percent(after - before, before);
+        double p = mann_whitney_p(i->second, t->wall_times);
+        const char* verdict = "unchanged";
+        if (p < max_p && fabs(change) > min_change)
+        {
+            if (change > 0)
+            {
+                verdict = "REGRESSION";
+                ++regressions;
+            } else {
+                verdict = "improvement";
+                if (improvements) ++*improvements;
+            }
+        }
+        fprintf(out, "%s.%s: median %s -> %s (%+.1f%%, p=%.4f): %s\n",
+                b.name.c_str(), t->name.c_str(),
+                format_duration(before).c_str(), format_duration(after).c_str(),
+                change, p, verdict);
+    }
+    return regressions;
+}
+
 BasicProgress::BasicProgress(FILE* out, FILE* err)
     : out(out), err(err) {}
 
@@ -108,6 +462,38 @@ void BasicProgress::end_iteration(const Benchmark& b, unsigned cur, unsigned tot
 void BasicProgress::end_benchmark(const Benchmark& b)
 {
     fprintf(out, "\r%s: done.                   \r", b.name.c_str());
+
+    bool perf = PerfCounters::get().is_open();
+    if (allocations_counted || perf)
+    {
+        for (const auto& t: b.tasks)
+        {
+            if (!t->run_count) continue;
+            double count = t->messages ? (double)t->messages * t->run_count : t->run_count;
+            std::vector<std::string> figures;
+            char buf[64];
+            if (allocations_counted)
+            {
+                snprintf(buf, 64, "%.1f allocations (%sB)", t->allocations / count,
+                         format_count(t->allocated_bytes / count).c_str());
+                figures.emplace_back(buf);
+            }
+            if (perf)
+            {
+                for (unsigned i = 0; i < PERF_EVENT_COUNT; ++i)
+                    figures.push_back(format_count(t->events[i] / count) + " " + PerfCounters::event_name((PerfEvent)i));
+                if (t->events[PERF_CYCLES])
+                {
+                    snprintf(buf, 64, "%.2f instructions per cycle", (double)t->events[PERF_INSTRUCTIONS] / t->events[PERF_CYCLES]);
+                    figures.emplace_back(buf);
+                }
+            }
+            fprintf(out, "%s.%s: per %s:", b.name.c_str(), t->name.c_str(), t->messages ? "message" : "run");
+            for (unsigned i = 0; i < figures.size(); ++i)
+                fprintf(out, "%s %s", i ? "," : "", figures[i].c_str());
+            putc('\n', out);
+        }
+    }
     fflush(out);
 }
 void BasicProgress::test_failed(const Benchmark& b, std::exception& e)
@@ -115,33 +501,133 @@ void BasicProgress::test_failed(const Benchmark& b, std::exception& e)
     fprintf(err, "\n%s: benchmark failed: %s\n", b.name.c_str(), e.what());
 }
 
-void Registry::basic_run(int argc, const char* argv[])
+int Registry::basic_run(int argc, const char* argv[])
 {
     BasicProgress progress;
+    std::string csv_pathname;
+    std::string json_pathname;
+    std::string baseline_pathname;
+    Baseline baseline;
+    std::set<std::string> selected;
 
-    // Run all benchmarks
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 6, "--csv=") == 0)
+            csv_pathname = arg.substr(6);
+        else if (arg.compare(0, 7, "--json=") == 0)
+            json_pathname = arg.substr(7);
+        else if (arg.compare(0, 11, "--baseline=") == 0)
+            baseline_pathname = arg.substr(11);
+        else if (arg.compare(0, 12, "--threshold=") == 0)
+            baseline.min_change = strtod(arg.c_str() + 12, nullptr);
+        else if (arg == "--perf")
+        {
+            std::string error = PerfCounters::get().open();
+            if (!error.empty())
+                fprintf(stderr, "hardware counters are not available: %s\n", error.c_str());
+        }
+        else if (arg.compare(0, 1, "-") == 0)
+        {
+            fprintf(stderr, "usage: %s [--csv=file] [--json=file] [--baseline=file] [--threshold=percent] [--perf] [benchmark...]\n", argv[0]);
+            return 2;
+        }
+        else
+            selected.insert(arg);
+    }
+
+    for (const auto& name: selected)
+    {
+        bool found = false;
+        for (const auto& b: get().benchmarks)
+            if (b->name == name) found = true;
+        if (!found)
+        {
+            fprintf(stderr, "%s: benchmark not found\n", name.c_str());
+            return 2;
+        }
+    }
+
+    if (!baseline_pathname.empty())
+    {
+        try {
+            baseline.read_csv(baseline_pathname);
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            return 2;
+        }
+    }
+
+    FILE* csv = nullptr;
+    if (!csv_pathname.empty())
+    {
+        if (!(csv = fopen(csv_pathname.c_str(), "wt")))
+        {
+            fprintf(stderr, "cannot open %s: %s\n", csv_pathname.c_str(), strerror(errno));
+            return 2;
+        }
+        Benchmark::write_csv_header(csv);
+    }
+
+    FILE* json = nullptr;
+    if (!json_pathname.empty())
+    {
+        if (!(json = fopen(json_pathname.c_str(), "wt")))
+        {
+            fprintf(stderr, "cannot open %s: %s\n", json_pathname.c_str(), strerror(errno));
+            if (csv) fclose(csv);
+            return 2;
+        }
+        fprintf(json, "{\"benchmarks\": [");
+    }
+
+    // Run all selected benchmarks
+    int res = 0;
+    unsigned count = 0;
+    unsigned regressions = 0;
+    unsigned improvements = 0;
     for (auto& b: get().benchmarks)
     {
+        if (!selected.empty() && selected.find(b->name) == selected.end())
+            continue;
         try {
             b->run(progress);
         } catch (std::exception& e) {
             progress.test_failed(*b, e);
+            res = 1;
             continue;
         }
         b->print_timings();
+        if (csv)
+            b->write_csv(csv);
+        if (json)
+        {
+            fprintf(json, count ? ",\n" : "\n");
+            b->write_json(json);
+        }
+        if (!baseline_pathname.empty())
+            regressions += baseline.compare(*b, stdout, &improvements);
+        ++count;
     }
-}
 
-#if 0
-void Runner::dump_csv(std::ostream& out)
-{
-    out << "Suite,Test,User,System" << endl;
-    for (auto l : log)
+    if (csv)
+        fclose(csv);
+    if (json)
     {
-        out << l.b_name << "," << l.name << "," << l.utime << "," << l.stime << endl;
+        fprintf(json, "]}\n");
+        fclose(json);
     }
+
+    if (!baseline_pathname.empty())
+    {
+        fprintf(stdout, "%u regressions and %u improvements compared to %s\n",
+                regressions, improvements, baseline_pathname.c_str());
+        if (regressions)
+            res = 1;
+    }
+
+    return res;
 }
-#endif
 
 }
 }
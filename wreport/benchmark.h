@@ -7,14 +7,95 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <atomic>
 #include <functional>
 #include <cstdio>
+#include <cstdint>
 
 namespace wreport {
 namespace benchmark {
 
 struct Benchmark;
 
+/**
+ * Number of memory allocations done so far by the whole program.
+ *
+ * This is only updated if the program is linked with benchmark-alloc.cc,
+ * which counts calls to malloc, calloc and realloc, and sets
+ * allocations_counted to true.
+ */
+extern std::atomic<size_t> allocation_count;
+
+/// Number of bytes requested by the memory allocations counted in allocation_count
+extern std::atomic<size_t> allocation_bytes;
+
+/// True if allocation_count and allocation_bytes are being updated
+extern bool allocations_counted;
+
+/// Hardware events counted by PerfCounters
+enum PerfEvent
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+};
+
+/**
+ * Hardware performance counters for the whole process, read with
+ * perf_event_open.
+ *
+ * Counters keep running once opened, and tasks read them before and after
+ * each run. Threads created after the counters are opened are counted as
+ * well.
+ */
+struct PerfCounters
+{
+    int fds[PERF_EVENT_COUNT];
+
+    PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    ~PerfCounters();
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * Start counting.
+     *
+     * @returns an empty string on success, or a description of why counters
+     * are not available
+     */
+    std::string open();
+
+    /// Check if counters have been opened successfully
+    bool is_open() const { return fds[0] != -1; }
+
+    /**
+     * Read the current value of all counters, scaled to compensate for the
+     * time they were not running because the kernel was multiplexing them
+     */
+    void read(uint64_t* values) const;
+
+    /// Name of an event, for printing
+    static const char* event_name(PerfEvent event);
+
+    /// Get the counters shared by all tasks
+    static PerfCounters& get();
+};
+
+/// Summary statistics of a set of timings
+struct Stats
+{
+    double min = 0;
+    double median = 0;
+    /// 95th percentile, computed with the nearest rank method
+    double p95 = 0;
+
+    /// Compute the statistics of the given samples
+    static Stats compute(std::vector<double> samples);
+};
+
 /// Collect timings for one task
 struct Task
 {
@@ -28,11 +109,32 @@ struct Task
     clock_t utime = 0;
     // Total system time
     clock_t stime = 0;
+    // Wall clock time of each run, in seconds, measured with a monotonic clock
+    std::vector<double> wall_times;
+    // Number of messages processed by each run, or 0 if not declared
+    size_t messages = 0;
+    // Number of bytes processed by each run, or 0 if not declared
+    size_t bytes = 0;
+    // Total memory allocations, if allocations_counted is true
+    size_t allocations = 0;
+    // Total bytes requested by memory allocations
+    size_t allocated_bytes = 0;
+    // Total hardware events, if PerfCounters::get() is open
+    uint64_t events[PERF_EVENT_COUNT] = {};
 
     Task(Benchmark* parent, const std::string& name);
 
+    /**
+     * Declare how much work is done by each run of this task, to report
+     * throughput in messages and megabytes per second
+     */
+    void set_workload(size_t messages, size_t bytes=0);
+
     // Run the given function and collect timings for it
     void collect(std::function<void()> f);
+
+    /// Summary statistics of wall_times
+    Stats wall_stats() const { return Stats::compute(wall_times); }
 };
 
 
@@ -51,7 +153,11 @@ struct Progress
 
 /**
  * Basic progress implementation writing progress information to the given
- * output stream
+ * output stream.
+ *
+ * When a benchmark ends, it also prints memory allocations and hardware
+ * events, if they were counted, normalised per message for tasks that
+ * declared their workload, and per run otherwise.
  */
 struct BasicProgress : Progress
 {
@@ -119,10 +225,64 @@ struct Benchmark
     /// Print timings to stdout
     void print_timings();
 
+    /**
+     * Write the wall clock time of each run of each task as CSV rows, with
+     * columns: benchmark, task, run, wall (in seconds), messages, bytes.
+     *
+     * The header is not written, so that the output of multiple benchmarks
+     * can be concatenated: use write_csv_header() for it.
+     */
+    void write_csv(FILE* out) const;
+
+    /// Write the CSV header line matching the output of write_csv()
+    static void write_csv_header(FILE* out);
+
+    /**
+     * Write timings and summary statistics of all tasks as a JSON object
+     */
+    void write_json(FILE* out) const;
+
     /// Main body of this benchmark
     virtual void main() = 0;
 };
 
+/**
+ * Compute the two-sided p-value of the Mann-Whitney U test, that is, the
+ * probability that the two sets of samples come from distributions with the
+ * same median.
+ *
+ * It uses the normal approximation, which is adequate from about 8 samples
+ * per set. It returns 1 if either set has less than 3 samples.
+ */
+double mann_whitney_p(const std::vector<double>& a, const std::vector<double>& b);
+
+/**
+ * Wall clock timings of a previous run, read from the output of
+ * Benchmark::write_csv(), to check new timings for regressions
+ */
+struct Baseline
+{
+    /// Wall clock samples of each task, indexed by "benchmark.task"
+    std::map<std::string, std::vector<double>> samples;
+    /// Only report differences whose p-value is below this
+    double max_p = 0.01;
+    /// Only report differences in median bigger than this percentage
+    double min_change = 5.0;
+
+    /// Read samples from a CSV file written by Benchmark::write_csv()
+    void read_csv(const std::string& pathname);
+
+    /**
+     * Compare the wall clock timings of all the tasks of \a b with the
+     * baseline, writing a line for each task to \a out.
+     *
+     * Tasks missing from the baseline are skipped.
+     *
+     * @returns the number of significant regressions found
+     */
+    unsigned compare(const Benchmark& b, FILE* out, unsigned* improvements=nullptr) const;
+};
+
 /// Collect all existing benchmarks
 struct Registry
 {
@@ -146,14 +306,29 @@ struct Registry
      *
      * int main (int argc, const char* argv[])
      * {
-     *     wreport::benchmark::Registry::basic_run(argc, argv);
+     *     return wreport::benchmark::Registry::basic_run(argc, argv);
      * }
      * \endcode
      *
+     * Arguments are names of benchmarks to run (by default, all are run), and
+     * these options:
+     *
+     *  * `--csv=file`: write the timings of each run as CSV
+     *  * `--json=file`: write timings and statistics as JSON
+     *  * `--baseline=file`: compare timings with a CSV file written by a
+     *    previous `--csv` run, and report significant differences
+     *  * `--threshold=percent`: only report differences in median wall clock
+     *    time bigger than this (default: 5)
+     *  * `--perf`: also count hardware events with perf_event_open
+     *
      * If you need different logic in your benchmark running code, you can use
      * the source code of basic_run as a template for writing your own.
+     *
+     * @returns the exit status for main: 0 if everything went well, 1 if
+     * benchmarks failed or regressions were found against the baseline, 2 on
+     * invalid arguments
      */
-    static void basic_run(int argc, const char* argv[]);
+    static int basic_run(int argc, const char* argv[]);
 };
 
 }
@@ -15,6 +15,123 @@ class Tests : public TestCase
     {
         add_method("empty", []() {
         });
+
+        add_method("all_ones", []() {
+            wassert(actual(buffers::all_ones(0)) == 0u);
+            wassert(actual(buffers::all_ones(1)) == 1u);
+            wassert(actual(buffers::all_ones(6)) == 0x3fu);
+            wassert(actual(buffers::all_ones(31)) == 0x7fffffffu);
+            wassert(actual(buffers::all_ones(32)) == 0xffffffffu);
+        });
+
+        add_method("get_bits", []() {
+            // 0xA5 0x0F 0xF0 0x81 0x00 0xFF 0x12 0x34 0x56 0x78 0x9A 0xBC
+            string buf("\xa5\x0f\xf0\x81\x00\xff\x12\x34\x56\x78\x9a\xbc", 12);
+            buffers::BufrInput in(buf);
+            wassert(actual(in.bits_left()) == 96u);
+            wassert(actual(in.get_bits(1)) == 1u);
+            wassert(actual(in.get_bits(3)) == 2u);
+            wassert(actual(in.get_bits(0)) == 0u);
+            wassert(actual(in.get_bits(4)) == 5u);
+            wassert(actual(in.offset()) == 1u);
+            wassert(actual(in.get_bits(12)) == 0x0ffu);
+            wassert(actual(in.get_bits(20)) == 0x08100u);
+            wassert(actual(in.get_bits(32)) == 0xff123456u);
+            wassert(actual(in.bits_left()) == 24u);
+            wassert(actual(in.get_bits(6)) == 0x1eu);
+            wassert(actual(in.get_bits(18)) == 0x09abcu);
+            wassert(actual(in.bits_left()) == 0u);
+            try {
+                in.get_bits(1);
+                throw TestFailed("reading past the end of the buffer should fail");
+            } catch (error_parse& e) {
+                wassert(actual(e.what()).contains("end of buffer"));
+            }
+        });
+
+        add_method("get_bits_widths", []() {
+            // Read all widths from 1 to 32 from a buffer of all ones
+            string buf(600, '\xff');
+            buffers::BufrInput in(buf);
+            for (unsigned n = 1; n <= 32; ++n)
+                wassert(actual(in.get_bits(n)) == (uint32_t)(0xffffffffu >> (32 - n)));
+            wassert(actual(in.bits_left()) == 600u * 8 - 528u);
+        });
+
+        add_method("add_bits", []() {
+            string buf;
+            buffers::BufrOutput out(buf);
+            out.add_bits(1, 1);
+            out.add_bits(2, 3);
+            out.add_bits(0, 0);
+            out.add_bits(0xf5, 4);
+            wassert(actual(out.offset()) == 1u);
+            out.add_bits(0x0ff, 12);
+            out.add_bits(0x08100, 20);
+            out.add_bits(0xff123456, 32);
+            out.add_bits(0x1e, 6);
+            out.add_bits(0x09abc, 18);
+            wassert(actual(out.offset()) == 12u);
+            out.flush();
+            wassert(actual(buf) == string("\xa5\x0f\xf0\x81\x00\xff\x12\x34\x56\x78\x9a\xbc", 12));
+
+            // flush pads the last partial byte with zeros
+            out.add_bits(3, 3);
+            out.flush();
+            wassert(actual(buf.size()) == 13u);
+            wassert(actual((unsigned)(uint8_t)buf[12]) == 0x60u);
+        });
+
+        add_method("add_bits_roundtrip", []() {
+            string buf;
+            buffers::BufrOutput out(buf);
+            for (unsigned n = 1; n <= 32; ++n)
+                out.add_bits(0x5a5a5a5a, n);
+            out.flush();
+            wassert(actual(buf.size()) == 66u);
+
+            buffers::BufrInput in(buf);
+            for (unsigned n = 1; n <= 32; ++n)
+                wassert(actual(in.get_bits(n)) == (0x5a5a5a5au & (0xffffffffu >> (32 - n))));
+        });
+
+        add_method("append_string", []() {
+            string buf;
+            buffers::BufrOutput out(buf);
+            // Byte aligned
+            out.append_string("ab", 32);
+            out.append_string("abcdef", 24);
+            // Not byte aligned
+            out.add_bits(0, 4);
+            out.append_string("xy", 24);
+            out.add_bits(0, 4);
+            // Aligned, with a trailing partial byte
+            out.append_string("z", 12);
+            out.flush();
+            wassert(actual(buf) == string("ab  abc\x07\x87\x92\x00z\x00", 13));
+        });
+
+        add_method("append_binary", []() {
+            string buf;
+            buffers::BufrOutput out(buf);
+            const unsigned char data[] = { 0x12, 0x34, 0x05 };
+            // Byte aligned, with a trailing partial byte
+            out.append_binary(data, 20);
+            // Not byte aligned
+            out.append_binary(data, 16);
+            out.add_bits(0, 4);
+            out.flush();
+            wassert(actual(buf) == string("\x12\x34\x51\x23\x40", 5));
+        });
+
+        add_method("append_missing", []() {
+            string buf;
+            buffers::BufrOutput out(buf);
+            out.append_missing(3);
+            out.append_missing(69);
+            out.flush();
+            wassert(actual(buf) == string(9, '\xff'));
+        });
     }
 } test("buffers_bufr");
 
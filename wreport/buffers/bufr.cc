@@ -1,6 +1,7 @@
 #include "bufr.h"
 #include "wreport/var.h"
 #include <cstdarg>
+#include <cstring>
 #include "config.h"
 
 // #define TRACE_INTERPRETER
@@ -26,10 +27,23 @@ const char* bufr_sec_names[] = {
     "End section"
 };
 
-// Return a value with bitlen bits set to 1
-static inline uint32_t all_ones(int bitlen)
+// Check if all ones means missing value for info: in case of delayed
+// replications, there is no missing value
+static bool has_missing_value(wreport::Varinfo info)
 {
-    return ((1 << (bitlen - 1))-1) | (1 << (bitlen - 1));
+    if (WR_VAR_X(info->code) != 31 || WR_VAR_F(info->code) != 0)
+        return true;
+    switch (WR_VAR_Y(info->code))
+    {
+        case 0:
+        case 1:
+        case 2:
+        case 11:
+        case 12:
+            return false;
+        default:
+            return true;
+    }
 }
 
 }
@@ -38,9 +52,14 @@ namespace wreport {
 namespace buffers {
 
 BufrInput::BufrInput(const std::string& in)
+    : BufrInput(in.data(), in.size())
+{
+}
+
+BufrInput::BufrInput(const void* in, size_t in_len)
 {
-    data = (const unsigned char*)in.data();
-    data_len = in.size();
+    data = (const unsigned char*)in;
+    data_len = in_len;
     for (unsigned i = 0; i < sizeof(sec)/sizeof(sec[0]); ++i)
         sec[i] = 0;
 }
@@ -77,29 +96,33 @@ void BufrInput::scan_other_sections(bool has_optional)
         scan_section_length(i);
 
     s4_cursor = sec[4] + 4;
+    pbuf = 0;
+    pbuf_len = 0;
+}
+
+void BufrInput::refill_tail(unsigned n)
+{
+    while (pbuf_len <= 56 && s4_cursor < data_len)
+    {
+        pbuf |= (uint64_t)data[s4_cursor++] << (56 - pbuf_len);
+        pbuf_len += 8;
+    }
+
+    if (pbuf_len < n)
+        parse_error("end of buffer while looking for %d bits of bit-packed data", n);
 }
 
 void BufrInput::debug_dump_next_bits(const char* desc, int count) const
 {
     fputs(desc, stderr);
-    size_t cursor = s4_cursor;
-    int pbyte = this->pbyte;
-    int pbyte_len = this->pbyte_len;
-    int i;
-
-    for (i = 0; i < count; ++i) 
+    size_t bit_cursor = (size_t)s4_cursor * 8 - pbuf_len;
+    for (int i = 0; i < count; ++i, ++bit_cursor)
     {
-        if (cursor == data_len)
+        if (bit_cursor / 8 >= data_len)
             break;
-        if (pbyte_len == 0) 
-        {
-            pbyte_len = 8;
-            pbyte = data[cursor++];
+        if (i > 0 && bit_cursor % 8 == 0)
             putc(' ', stderr);
-        }
-        putc((pbyte & 0x80) ? '1' : '0', stderr);
-        pbyte <<= 1;
-        --pbyte_len;
+        putc((data[bit_cursor / 8] & (0x80 >> (bit_cursor % 8))) ? '1' : '0', stderr);
     }
     putc('\n', stderr);
 }
@@ -115,7 +138,7 @@ void BufrInput::parse_error(const char* fmt, ...) const
         message = nullptr;
     va_end(ap);
 
-    if (asprintf(&context, "%s:%zd+%u: %s", fname, start_offset, s4_cursor, message ? message : fmt) == -1)
+    if (asprintf(&context, "%s:%zd+%u: %s", fname, start_offset, offset(), message ? message : fmt) == -1)
         context = nullptr;
     free(message);
 
@@ -226,13 +249,10 @@ void BufrInput::decode_string(Var& dest)
         dest.setc(str);
 }
 
-void BufrInput::decode_binary(Var& dest)
+bool BufrInput::decode_binary(unsigned bit_len, uint8_t* buf)
 {
-    Varinfo info = dest.info();
-
-    unsigned char buf[info->bit_len / 8 + 1];
     size_t len = 0;
-    unsigned toread = info->bit_len;
+    unsigned toread = bit_len;
     bool missing = true;
 
     while (toread > 0)
@@ -246,9 +266,18 @@ void BufrInput::decode_binary(Var& dest)
         toread -= count;
     }
 
+    return !missing;
+}
+
+void BufrInput::decode_binary(Var& dest)
+{
+    Varinfo info = dest.info();
+
+    unsigned char buf[info->bit_len / 8 + 1];
+
     /* Store the variable that we found */
     // Set the variable value
-    if (!missing)
+    if (decode_binary(info->bit_len, buf))
         dest.setc((char*)buf);
 }
 
@@ -261,22 +290,7 @@ void BufrInput::decode_number(Var& dest)
     // TRACE("datasec:decode_b_num:reading %s (%s), size %d, scale %d, starting point %d\n", info->desc, info->bufr_unit, info->bit_len, info->scale, val);
 
     // Check if there are bits which are not 1 (that is, if the value is present)
-    // In case of delayed replications, there is no missing value
-    bool missing = false;
-    if (WR_VAR_X(info->code) == 31 && WR_VAR_F(info->code) == 0)
-        switch (WR_VAR_Y(info->code))
-        {
-            case 0:
-            case 1:
-            case 2:
-            case 11:
-            case 12:
-                break;
-            default:
-                missing = (val == all_ones(info->bit_len));
-        }
-    else
-        missing = (val == all_ones(info->bit_len));
+    bool missing = has_missing_value(info) && val == all_ones(info->bit_len);
 
     // TRACE("datasec:decode_b_num:len %d val %d info-len %d info-desc %s\n", info->bit_len, val, info->bit_len, info->desc);
 
@@ -294,6 +308,21 @@ void BufrInput::decode_number(Var& dest)
     }
 }
 
+bool BufrInput::decode_number(Varinfo info, int32_t& val)
+{
+    uint32_t raw = get_bits(info->bit_len);
+
+    // Check if there are bits which are not 1 (that is, if the value is present)
+    if (has_missing_value(info) && raw == all_ones(info->bit_len))
+        return false;
+
+    if (info->bit_len == 0)
+        error_consistency::throwf("cannot decode %01d%02d%03d from binary, because the information needed is missing from the B table in use",
+                WR_VAR_FXY(info->code));
+    val = (int64_t)raw + info->bit_ref;
+    return true;
+}
+
 bool BufrInput::decode_compressed_base(Varinfo info, uint32_t& base, uint32_t& diffbits)
 {
     // Data field base value
@@ -321,7 +350,7 @@ void BufrInput::decode_compressed_number(Var& dest, uint32_t base, unsigned diff
     uint32_t diff = get_bits(diffbits);
 
     // Check if it's all 1s: in that case it's a missing value
-    if (base == all_ones(info->bit_len) || diff == all_ones(diffbits))
+    if (base == all_ones(info->bit_len) || (diffbits && diff == all_ones(diffbits)))
     {
         /* Missing value */
         //TRACE("datasec:decode_b_num:decoded[%d] as missing\n", i);
@@ -397,6 +426,39 @@ void BufrInput::decode_compressed_number(Varinfo info, unsigned associated_field
     }
 }
 
+void BufrInput::skip_compressed_value(Varinfo info, unsigned associated_field_bits, unsigned subsets)
+{
+    switch (info->type)
+    {
+        case Vartype::String:
+        {
+            // Base value, then the difference length in bytes, then the
+            // differences
+            skip_bits(info->bit_len);
+            uint32_t diffbits = get_bits(6);
+            skip_bits(subsets * diffbits * 8);
+            break;
+        }
+        case Vartype::Binary:
+            throw error_unimplemented("decode_b_binary TODO");
+        case Vartype::Integer:
+        case Vartype::Decimal:
+        {
+            // See decode_compressed_number for the layout of associated fields
+            uint32_t af_diffbits = 0;
+            if (associated_field_bits)
+            {
+                skip_bits(associated_field_bits);
+                af_diffbits = get_bits(6);
+            }
+            skip_bits(info->bit_len);
+            uint32_t diffbits = get_bits(6);
+            skip_bits(subsets * (af_diffbits + diffbits));
+            break;
+        }
+    }
+}
+
 void BufrInput::decode_compressed_semantic_number(Var& dest, unsigned subsets)
 {
     Varinfo info = dest.info();
@@ -406,7 +468,7 @@ void BufrInput::decode_compressed_semantic_number(Var& dest, unsigned subsets)
     //TRACE("datasec:decode_b_num:reading %s (%s), size %d, scale %d, starting point %d\n", info->desc, info->bufr_unit, info->bit_len, info->scale, base);
 
     // Check if there are bits which are not 1 (that is, if the value is present)
-    bool missing = (base == all_ones(info->bit_len));
+    bool missing = has_missing_value(info) && base == all_ones(info->bit_len);
 
     //TRACE("datasec:decode_b_num:len %d base %d info-len %d info-desc %s\n", info->bit_len, base, info->bit_len, info->desc);
 
@@ -571,35 +633,17 @@ void BufrInput::decode_string(Var& dest, unsigned subsets)
 
 
 BufrOutput::BufrOutput(std::string& out)
-    : out(out), pbyte(0), pbyte_len(0)
+    : out(out)
 {
 }
 
-void BufrOutput::add_bits(uint32_t val, int n)
+void BufrOutput::write_bytes()
 {
-    /* Mask for reading data out of val */
-    uint32_t mask = 1 << (n - 1);
-    int i;
-
-    for (i = 0; i < n; i++) 
+    while (pbuf_len >= 8)
     {
-        pbyte <<= 1;
-        pbyte |= ((val & mask) != 0) ? 1 : 0;
-        val <<= 1;
-        pbyte_len++;
-
-        if (pbyte_len == 8) 
-            flush();
-    }
-#if 0
-    IFTRACE {
-        /* Prewrite it when tracing, to allow to dump the buffer as it's
-         * written */
-        while (e->out->len + 1 > e->out->alloclen)
-            DBA_RUN_OR_RETURN(dba_rawmsg_expand_buffer(e->out));
-        e->out->buf[e->out->len] = e->pbyte << (8 - e->pbyte_len);
+        pbuf_len -= 8;
+        out.push_back((char)(pbuf >> pbuf_len));
     }
-#endif
 }
 
 void BufrOutput::append_string(const Var& var, unsigned len_bits)
@@ -609,6 +653,20 @@ void BufrOutput::append_string(const Var& var, unsigned len_bits)
 
 void BufrOutput::append_string(const char* val, unsigned len_bits)
 {
+    if (pbuf_len % 8 == 0)
+    {
+        // Byte aligned: copy the string and its space padding straight to the
+        // output
+        write_bytes();
+        size_t len = len_bits / 8;
+        size_t slen = strnlen(val, len);
+        out.append(val, slen);
+        out.append(len - slen, ' ');
+        if (len_bits % 8)
+            add_bits(0, len_bits % 8);
+        return;
+    }
+
     unsigned i, bi;
     bool eol = false;
     for (i = 0, bi = 0; bi < len_bits; ++i)
@@ -638,6 +696,16 @@ void BufrOutput::append_string(const char* val, unsigned len_bits)
 
 void BufrOutput::append_binary(const unsigned char* val, unsigned len_bits)
 {
+    if (pbuf_len % 8 == 0)
+    {
+        // Byte aligned: copy the data straight to the output
+        write_bytes();
+        out.append((const char*)val, len_bits / 8);
+        if (len_bits % 8)
+            add_bits(val[len_bits / 8], len_bits % 8);
+        return;
+    }
+
     unsigned i, bi;
     for (i = 0, bi = 0; bi < len_bits; ++i)
     {
@@ -683,19 +751,182 @@ void BufrOutput::append_missing(Varinfo info)
     append_missing(info->bit_len);
 }
 
-void BufrOutput::flush()
+void BufrOutput::append_compressed_base(unsigned bit_len, const std::vector<uint32_t>& values, bool missing_values, uint32_t& base, unsigned& diffbits)
+{
+    uint32_t missing = all_ones(bit_len);
+    bool has_missing = false;
+    bool has_values = false;
+    uint32_t min = 0, max = 0;
+    for (auto val: values)
+    {
+        if (missing_values && val == missing)
+        {
+            has_missing = true;
+            continue;
+        }
+        if (!has_values)
+        {
+            min = max = val;
+            has_values = true;
+        } else if (val < min)
+            min = val;
+        else if (val > max)
+            max = val;
+    }
+
+    if (!has_values)
+    {
+        // All values are missing
+        base = missing;
+        diffbits = 0;
+    } else if (!has_missing && min == max) {
+        // All values are the same
+        base = min;
+        diffbits = 0;
+    } else {
+        // Differences cannot be all ones, since that means missing value
+        base = min;
+        uint64_t range = (uint64_t)max - min + 1;
+        for (diffbits = 1; ((uint64_t)1 << diffbits) - 1 < range; ++diffbits)
+            ;
+    }
+
+    add_bits(base, bit_len);
+    add_bits(diffbits, 6);
+}
+
+void BufrOutput::append_compressed_diff(unsigned bit_len, uint32_t value, bool missing_values, uint32_t base, unsigned diffbits)
+{
+    if (!diffbits) return;
+    if (missing_values && value == all_ones(bit_len))
+        add_bits(all_ones(diffbits), diffbits);
+    else
+        add_bits(value - base, diffbits);
+}
+
+void BufrOutput::append_compressed_string(Varinfo info, const std::vector<const Var*>& vars)
+{
+    bool same = true;
+    for (unsigned i = 1; same && i < vars.size(); ++i)
+    {
+        bool isset0 = vars[0] && vars[0]->isset();
+        bool isset = vars[i] && vars[i]->isset();
+        if (isset0 != isset)
+            same = false;
+        else if (isset && strcmp(vars[0]->enqc(), vars[i]->enqc()) != 0)
+            same = false;
+    }
+
+    if (same)
+    {
+        // Encode the common value as base value, with no differences
+        if (vars.empty() || !vars[0] || !vars[0]->isset())
+            append_missing(info->bit_len);
+        else
+            append_string(vars[0]->enqc(), info->bit_len);
+        add_bits(0, 6);
+        return;
+    }
+
+    // Strings that differ are encoded with an all zeros base value, followed
+    // by the length in bytes of the difference values, which are the full
+    // strings
+    unsigned len = info->bit_len / 8;
+    if (len > 63)
+        error_unimplemented::throwf("cannot encode %01d%02d%03d in a compressed BUFR message: values differ across subsets and are %u characters long, but the maximum is 63",
+                WR_VAR_FXY(info->code), len);
+    for (unsigned bits = info->bit_len; bits > 0; )
+    {
+        unsigned n = bits > 32 ? 32 : bits;
+        add_bits(0, n);
+        bits -= n;
+    }
+    add_bits(len, 6);
+    for (auto var: vars)
+    {
+        if (var && var->isset())
+            append_string(var->enqc(), len * 8);
+        else
+            append_missing(len * 8);
+    }
+}
+
+void BufrOutput::append_compressed_var(Varinfo info, const std::vector<const Var*>& vars)
 {
-    if (pbyte_len == 0) return;
+    switch (info->type)
+    {
+        case Vartype::String:
+            append_compressed_string(info, vars);
+            break;
+        case Vartype::Binary:
+            throw error_unimplemented("encoding binary values in compressed BUFR messages is not implemented");
+        case Vartype::Integer:
+        case Vartype::Decimal:
+        {
+            compressed_values.clear();
+            uint32_t missing = all_ones(info->bit_len);
+            for (auto var: vars)
+                compressed_values.push_back(var && var->isset() ? info->encode_binary(var->enqd()) : missing);
+            bool missing_values = has_missing_value(info);
+            uint32_t base;
+            unsigned diffbits;
+            append_compressed_base(info->bit_len, compressed_values, missing_values, base, diffbits);
+            for (auto val: compressed_values)
+                append_compressed_diff(info->bit_len, val, missing_values, base, diffbits);
+            break;
+        }
+    }
+}
 
-    while (pbyte_len < 8)
+void BufrOutput::append_compressed_var(Varinfo info, const std::vector<const Var*>& vars, unsigned af_bit_len, const std::vector<uint32_t>& af_values)
+{
+    switch (info->type)
     {
-        pbyte <<= 1;
-        pbyte_len++;
+        case Vartype::String:
+        case Vartype::Binary:
+            // Match what BufrInput can decode
+            error_unimplemented::throwf("encoding associated fields for non-numeric values in compressed BUFR messages is not implemented");
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            break;
+    }
+
+    compressed_values.clear();
+    uint32_t missing = all_ones(info->bit_len);
+    for (auto var: vars)
+        compressed_values.push_back(var && var->isset() ? info->encode_binary(var->enqd()) : missing);
+
+    // The associated field base and difference bit length come first, then
+    // the variable base and difference bit length, then the associated field
+    // and variable differences for each subset. The decoder does not handle
+    // missing values for associated fields, so they are encoded as numbers.
+    uint32_t af_base, base;
+    unsigned af_diffbits, diffbits;
+    append_compressed_base(af_bit_len, af_values, false, af_base, af_diffbits);
+    append_compressed_base(info->bit_len, compressed_values, true, base, diffbits);
+    for (unsigned i = 0; i < compressed_values.size(); ++i)
+    {
+        append_compressed_diff(af_bit_len, af_values[i], false, af_base, af_diffbits);
+        append_compressed_diff(info->bit_len, compressed_values[i], true, base, diffbits);
+    }
+}
+
+void BufrOutput::append_compressed_bitmap(const char* bitmap, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i)
+    {
+        add_bits(bitmap[i] == '+' ? 0 : 1, 1);
+        add_bits(0, 6);
     }
+}
+
+void BufrOutput::flush()
+{
+    write_bytes();
+    if (pbuf_len == 0) return;
 
-    out.append((const char*)&pbyte, 1);
-    pbyte_len = 0;
-    pbyte = 0;
+    out.push_back((char)(pbuf << (8 - pbuf_len)));
+    pbuf_len = 0;
 }
 
 
@@ -5,6 +5,7 @@
 #include <wreport/var.h>
 #include <string>
 #include <functional>
+#include <vector>
 #include <cstdint>
 
 namespace wreport {
@@ -12,6 +13,12 @@ struct Var;
 
 namespace buffers {
 
+/// Return a value with the lowest \a bitlen bits set to 1, for \a bitlen up to 32
+inline uint32_t all_ones(unsigned bitlen)
+{
+    return (uint32_t)((UINT64_C(1) << bitlen) - 1);
+}
+
 /**
  * Binary buffer with bit-level read operations
  */
@@ -24,6 +31,13 @@ protected:
      */
     void scan_section_length(unsigned sec_no);
 
+    /**
+     * Fill pbuf one byte at a time when we are near the end of the buffer.
+     *
+     * Throws error_parse if there are less than \a n bits left to decode.
+     */
+    void refill_tail(unsigned n);
+
 public:
     /// Input buffer
     const uint8_t* data;
@@ -49,14 +63,19 @@ public:
      */
     size_t start_offset = 0;
 
-    /// Offset of the byte we are currently decoding
+    /// Offset of the next byte to be loaded into pbuf
     unsigned s4_cursor = 0;
 
-    /// Byte we are currently decoding
-    uint8_t pbyte = 0;
+    /**
+     * Bits read ahead from the input and not yet decoded.
+     *
+     * The next bit to decode is the most significant one. Bits past pbuf_len
+     * can contain read-ahead data and are not significant.
+     */
+    uint64_t pbuf = 0;
 
-    /// Bits left in pbyte to decode
-    int pbyte_len = 0;
+    /// Number of bits in pbuf that are left to decode
+    unsigned pbuf_len = 0;
 
     /// Offsets of the start of BUFR sections
     unsigned sec[6];
@@ -70,6 +89,16 @@ public:
      */
     BufrInput(const std::string& in);
 
+    /**
+     * Wrap a memory buffer into a BufrInput
+     *
+     * @param in
+     *   Pointer to the data to read
+     * @param in_len
+     *   Size of the data to read
+     */
+    BufrInput(const void* in, size_t in_len);
+
     /**
      * Scan the message filling in the sec[] array of start offsets of sections
      * 0 and 1.
@@ -93,10 +122,10 @@ public:
     void scan_other_sections(bool has_optional);
 
     /// Return the current decoding byte offset
-    unsigned offset() const { return s4_cursor; }
+    unsigned offset() const { return s4_cursor - pbuf_len / 8; }
 
     /// Return the number of bits left in the message to be decoded
-    unsigned bits_left() const { return (data_len - s4_cursor) * 8 + pbyte_len; }
+    unsigned bits_left() const { return (data_len - s4_cursor) * 8 + pbuf_len; }
 
     /// Read a byte value at offset \a pos
     inline unsigned read_byte(unsigned pos) const
@@ -137,32 +166,37 @@ public:
      */
     uint32_t get_bits(unsigned n)
     {
-        uint32_t result = 0;
-
-        if (s4_cursor == data_len)
-            parse_error("end of buffer while looking for %d bits of bit-packed data", n);
-
-        // TODO: review and benchmark and possibly simplify
-        // (a possible alternative approach is to keep a current bitmask that
-        // starts at 0x80 and is shifted right by 1 at each read until it
-        // reaches 0, and get rid of pbyte_len)
-        for (unsigned i = 0; i < n; i++)
+        if (pbuf_len < n)
         {
-            if (pbyte_len == 0)
+            if (s4_cursor + 8 <= data_len)
             {
-                pbyte_len = 8;
-                pbyte = data[s4_cursor++];
-            }
-            result <<= 1;
-            if (pbyte & 0x80)
-                result |= 1;
-            pbyte <<= 1;
-            pbyte_len--;
+                // Load a big endian 64 bit word and keep all the whole bytes
+                // of it that fit in pbuf
+                uint64_t word = 0;
+                for (unsigned i = 0; i < 8; ++i)
+                    word = (word << 8) | data[s4_cursor + i];
+                pbuf |= word >> pbuf_len;
+                s4_cursor += (63 - pbuf_len) >> 3;
+                pbuf_len |= 56;
+            } else
+                refill_tail(n);
         }
 
+        // Shift in two steps, to avoid an undefined 64 bit shift when n is 0
+        uint32_t result = (pbuf >> 1) >> (63 - n);
+        pbuf <<= n;
+        pbuf_len -= n;
         return result;
     }
 
+    /// Skip the next 'n' bits of the decode input, without decoding them
+    void skip_bits(unsigned n)
+    {
+        for ( ; n > 32; n -= 32)
+            get_bits(32);
+        get_bits(n);
+    }
+
     /// Dump to stderr 'count' bits of 'buf', starting at the 'ofs-th' bit
     void debug_dump_next_bits(const char* desc, int count) const;
 
@@ -229,6 +263,15 @@ public:
      */
     void decode_number(Var& dest);
 
+    /**
+     * Decode a number as described by \a info.
+     *
+     * @returns
+     *   false if the value is missing, else true, setting \a val to the
+     *   value encoded as in Var
+     */
+    bool decode_number(Varinfo info, int32_t& val);
+
     bool decode_compressed_base(Varinfo info, uint32_t& base, uint32_t& diffbits);
 
     /**
@@ -342,6 +385,15 @@ public:
      */
     void decode_compressed_number(Varinfo info, unsigned associated_field_bits, unsigned subsets, std::function<void(unsigned, Var&&, uint32_t)> dest);
 
+    /**
+     * Skip the values of all the \a subsets subsets of a compressed bufr, as
+     * described by \a info, without decoding them.
+     *
+     * \a associated_field_bits is the size of the associated field of
+     * numeric values, or 0 if there is none.
+     */
+    void skip_compressed_value(Varinfo info, unsigned associated_field_bits, unsigned subsets);
+
     /**
      * Decode a number as described by dest.info(), and set it as value for \a
      * dest. The number is decoded for \a subsets compressed datasets, and an
@@ -418,6 +470,15 @@ public:
      */
     void decode_binary(Var& dest);
 
+    /**
+     * Decode a binary value of \a bit_len bits into \a buf, which must have
+     * space for at least (bit_len + 7) / 8 bytes.
+     *
+     * @returns
+     *   true if the value is set, false if it is missing (all bits are 1)
+     */
+    bool decode_binary(unsigned bit_len, uint8_t* buf);
+
     /**
      * Decode an uncompressed bitmap of \a size bits.
      *
@@ -480,11 +541,14 @@ struct BufrOutput
     /// Output buffer to which we append encoded data
     std::string& out;
 
-    /// Byte to which we are appending bits to encode
-    uint8_t pbyte;
+    /**
+     * Bits encoded but not yet written to out, aligned to the least
+     * significant bit. Bits past pbuf_len are not significant.
+     */
+    uint64_t pbuf = 0;
 
-    /// Number of bits already encoded in pbyte
-    int pbyte_len;
+    /// Number of bits in pbuf that are waiting to be written
+    unsigned pbuf_len = 0;
 
     /**
      * Wrap a string into a BufrOutput
@@ -497,7 +561,21 @@ struct BufrOutput
     /**
      * Append n bits from 'val'.  n must be <= 32.
      */
-    void add_bits(uint32_t val, int n);
+    void add_bits(uint32_t val, int n)
+    {
+        if (n < 32)
+            val &= (1u << n) - 1;
+        pbuf = (pbuf << n) | val;
+        pbuf_len += n;
+        if (pbuf_len >= 32)
+            write_word();
+    }
+
+    /**
+     * Return the offset in the output of the next byte to be encoded,
+     * counting the whole bytes that have not been written to out yet
+     */
+    size_t offset() const { return out.size() + pbuf_len / 8; }
 
     /**
      * Append a string \a len bits long to the output buffer as it is,
@@ -505,6 +583,7 @@ struct BufrOutput
      */
     void raw_append(const char* str, int len)
     {
+        write_bytes();
         out.append(str, len);
     }
 
@@ -523,6 +602,8 @@ struct BufrOutput
     /// Append a missing value \a len_bits long
     void append_missing(unsigned len_bits)
     {
+        for ( ; len_bits > 32; len_bits -= 32)
+            add_bits(0xffffffff, 32);
         add_bits(0xffffffff, len_bits);
     }
 
@@ -541,11 +622,67 @@ struct BufrOutput
     /// Append a missing value according to \a info
     void append_missing(Varinfo info);
 
+    /**
+     * Append the values that a variable has in all the subsets of a
+     * compressed BUFR message, encoded according to \a info.
+     *
+     * @param info
+     *   Encoding information for the values
+     * @param vars
+     *   The variables, one per subset. Null pointers and unset variables are
+     *   encoded as missing values.
+     */
+    void append_compressed_var(Varinfo info, const std::vector<const Var*>& vars);
+
+    /**
+     * Same as append_compressed_var(info, vars), but also encode the values
+     * of an associated field \a af_bit_len bits long.
+     *
+     * @param af_values
+     *   Values of the associated field, one per subset
+     */
+    void append_compressed_var(Varinfo info, const std::vector<const Var*>& vars, unsigned af_bit_len, const std::vector<uint32_t>& af_values);
+
+    /**
+     * Append a bitmap as it is encoded in compressed BUFR messages, that is,
+     * with 6 bits of difference bit length after each bit.
+     *
+     * @param bitmap
+     *   \a size characters, with a '+' where data is present, and a '-'
+     *   where data is not present
+     */
+    void append_compressed_bitmap(const char* bitmap, unsigned size);
+
     /**
      * Write all bits left to the buffer, padding the last partial byte with
      * zeros if needed to make it even
      */
     void flush();
+
+protected:
+    /// Write the 32 most significant bits of pbuf to out
+    void write_word()
+    {
+        uint32_t word = pbuf >> (pbuf_len - 32);
+        char buf[4] = { (char)(word >> 24), (char)(word >> 16), (char)(word >> 8), (char)word };
+        out.append(buf, 4);
+        pbuf_len -= 32;
+    }
+
+    /// Write to out all the whole bytes in pbuf
+    void write_bytes();
+
+    /// Append the compressed base value and difference bit length for \a values
+    void append_compressed_base(unsigned bit_len, const std::vector<uint32_t>& values, bool missing_values, uint32_t& base, unsigned& diffbits);
+
+    /// Append the compressed difference value for \a value
+    void append_compressed_diff(unsigned bit_len, uint32_t value, bool missing_values, uint32_t base, unsigned diffbits);
+
+    /// Append the values of a string variable in all the subsets
+    void append_compressed_string(Varinfo info, const std::vector<const Var*>& vars);
+
+    /// Binary encoded values of the numeric variable currently being encoded
+    std::vector<uint32_t> compressed_values;
 };
 
 
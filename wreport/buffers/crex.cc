@@ -20,7 +20,12 @@ namespace wreport {
 namespace buffers {
 
 CrexInput::CrexInput(const std::string& in, const char* fname, size_t offset)
-    : data(in.c_str()), data_len(in.size()), fname(fname), offset(offset), cur(data), has_check_digit(false)
+    : CrexInput(in.data(), in.size(), fname, offset)
+{
+}
+
+CrexInput::CrexInput(const void* in, size_t in_len, const char* fname, size_t offset)
+    : data((const char*)in), data_len(in_len), fname(fname), offset(offset), cur(data), has_check_digit(false)
 {
     for (int i = 0; i < 5; ++i)
         sec[i] = 0;
@@ -62,6 +62,16 @@ struct CrexInput
      */
     CrexInput(const std::string& in, const char* fname, size_t offset);
 
+    /**
+     * Wrap a memory buffer into a CrexInput
+     *
+     * @param in
+     *   Pointer to the data to read
+     * @param in_len
+     *   Size of the data to read
+     */
+    CrexInput(const void* in, size_t in_len, const char* fname, size_t offset);
+
     /// Return true if the cursor is at the end of the buffer
     bool eof() const;
 
@@ -1,5 +1,12 @@
 #include "tests.h"
+#include "reader.h"
+#include "columns.h"
+#include "visitor.h"
+#include "bulletin/plan.h"
+#include <algorithm>
 #include <functional>
+#include <thread>
+#include <set>
 
 using namespace wreport;
 using namespace wreport::tests;
@@ -680,6 +687,410 @@ class Tests : public TestCase
 
         declare_test_decode_fail("bufr/afl-src01flip1-pos10.bufr", "looking for data descriptor list");
         declare_test_decode_fail("bufr/afl-src4824splice-rep8.bufr", "Optional section length is 3 but it must be at least 4");
+
+        add_method("decode_header_skips_tables", []() {
+            std::string raw = tests::slurpfile("bufr/obs0-1.22.bufr");
+
+            auto opts = BufrCodecOptions::create();
+            opts->decode_header_skips_tables = true;
+            auto bulletin = BufrBulletin::decode_header(raw, *opts);
+            wassert(actual(bulletin->tables.loaded()).isfalse());
+            wassert(actual(bulletin->data_category) == 0);
+            wassert(actual(bulletin->data_subcategory_local) == 1);
+            wassert(actual(bulletin->datadesc.size()) == 10u);
+
+            // decode() ignores the option
+            bulletin = BufrBulletin::decode(raw, *opts);
+            wassert(actual(bulletin->tables.loaded()).istrue());
+            wassert(actual(bulletin->subsets.size()) == 1u);
+
+            opts->decode_header_skips_tables = false;
+            bulletin = BufrBulletin::decode_header(raw, *opts);
+            wassert(actual(bulletin->tables.loaded()).istrue());
+        });
+
+        add_method("decode_only", []() {
+            // Decoding only some varcodes gives the same values as decoding
+            // everything and then picking those varcodes
+            auto opts = BufrCodecOptions::create();
+            opts->decode_only = { WR_VAR(0, 12, 101), WR_VAR(0, 1, 1), WR_VAR(0, 31, 1), WR_VAR(0, 33, 7), WR_VAR(0, 5, 1), WR_VAR(0, 4, 4) };
+            unsigned compressed = 0;
+            unsigned selected = 0;
+            for (const auto& msg: tests::all_bufr_messages())
+            {
+                unique_ptr<BufrBulletin> full;
+                try {
+                    full = BufrBulletin::decode(msg.data, msg.fname.c_str());
+                } catch (std::exception&) {
+                    continue;
+                }
+
+                auto bulletin = BufrBulletin::decode(msg.data, *opts, msg.fname.c_str());
+                if (bulletin->compression) ++compressed;
+                wassert(actual(bulletin->subsets.size()) == full->subsets.size());
+                for (unsigned i = 0; i < full->subsets.size(); ++i)
+                {
+                    Subset expected(full->tables);
+                    for (const auto& var: full->subsets[i])
+                        if (find(opts->decode_only.begin(), opts->decode_only.end(), var.code()) != opts->decode_only.end())
+                            expected.store_variable(var);
+                    wassert(actual(bulletin->subsets[i].diff(expected)) == 0u);
+                    selected += expected.size();
+                }
+
+                if (!bulletin->compression) continue;
+                Columns columns;
+                BufrBulletin::decode_columns(msg.data.data(), msg.data.size(), columns, *opts, msg.fname.c_str());
+                wassert(actual(columns.subset_count) == bulletin->subsets.size());
+                for (unsigned i = 0; i < columns.subset_count; ++i)
+                {
+                    Subset subset(bulletin->tables);
+                    columns.to_subset(i, subset);
+                    wassert(actual(subset.diff(bulletin->subsets[i])) == 0u);
+                }
+            }
+            wassert(actual(compressed) > 10u);
+            wassert(actual(selected) > 1000u);
+        });
+
+        add_method("decode_reuse", []() {
+            // Decoding into the same bulletin gives the same results as
+            // decoding into a new one
+            auto messages = tests::all_bufr_messages();
+            auto bulletin = BufrBulletin::create();
+            unsigned decoded = 0;
+            unsigned failed = 0;
+            // Go through the messages twice, the second time in reverse order
+            for (unsigned i = 0; i < messages.size() * 2; ++i)
+            {
+                const string& msg = (i < messages.size() ? messages[i] : messages[messages.size() * 2 - i - 1]).data;
+                unique_ptr<BufrBulletin> expected;
+                try {
+                    expected = BufrBulletin::decode(msg);
+                } catch (std::exception&) {
+                }
+
+                if (!expected)
+                {
+                    try {
+                        BufrBulletin::decode(msg.data(), msg.size(), *bulletin);
+                        throw TestFailed("decoding into an existing bulletin should have failed");
+                    } catch (TestFailed&) {
+                        throw;
+                    } catch (std::exception&) {
+                    }
+                    wassert(actual(bulletin->subsets.empty()).istrue());
+                    ++failed;
+                    continue;
+                }
+
+                BufrBulletin::decode(msg.data(), msg.size(), *bulletin);
+                wassert(actual(bulletin->diff(*expected)) == 0u);
+                ++decoded;
+            }
+            wassert(actual(decoded) > 200u);
+            wassert(actual(failed) > 0u);
+        });
+
+        add_method("shared_values", []() {
+            // Strings with the same value in all the subsets of a compressed
+            // message are stored only once
+            std::string raw = tests::slurpfile("bufr/ed4.bufr");
+            auto bulletin = BufrBulletin::decode(raw);
+            wassert(actual(bulletin->subsets.size()) == 128u);
+            wassert(actual_varcode(bulletin->subsets[0][0].code()) == WR_VAR(0, 1, 19));
+            const char* name = bulletin->subsets[0][0].enqc();
+            wassert(actual(name) == "LEICESTER CENTRE");
+            for (const auto& subset: bulletin->subsets)
+                wassert(actual(subset[0].enqc() == name).istrue());
+
+            // Changing a shared value does not change the others
+            bulletin->subsets[1][0].setc("LEICESTER");
+            wassert(actual(bulletin->subsets[1][0].enqc()) == "LEICESTER");
+            wassert(actual(bulletin->subsets[0][0].enqc()) == "LEICESTER CENTRE");
+            wassert(actual(bulletin->subsets[2][0].enqc()) == "LEICESTER CENTRE");
+
+            // Copies do not share values
+            Subset copy(bulletin->subsets[0]);
+            wassert(actual(copy[0].enqc() == name).isfalse());
+            wassert(actual(copy[0].enqc()) == "LEICESTER CENTRE");
+
+            // Decoding again into the same bulletin
+            BufrBulletin::decode(raw.data(), raw.size(), *bulletin);
+            name = bulletin->subsets[0][0].enqc();
+            wassert(actual(name) == "LEICESTER CENTRE");
+            for (const auto& subset: bulletin->subsets)
+                wassert(actual(subset[0].enqc()) == "LEICESTER CENTRE");
+            wassert(actual(copy[0].enqc()) == "LEICESTER CENTRE");
+
+            // Values stay shared when the subsets grow past their reserved
+            // size while decoding
+            unique_ptr<BufrBulletin> big(BufrBulletin::create());
+            big->edition_number = 4;
+            big->data_category = 0;
+            big->data_subcategory = 255;
+            big->data_subcategory_local = 0;
+            big->originating_centre = 98;
+            big->master_table_version_number = 14;
+            big->compression = true;
+            big->rep_year = 2008;
+            big->rep_month = 5;
+            big->rep_day = 3;
+            big->load_tables();
+            big->datadesc.push_back(WR_VAR(0, 1, 15));
+            for (unsigned i = 0; i < 200; ++i)
+                big->datadesc.push_back(WR_VAR(0, 12, 101));
+            for (unsigned s = 0; s < 500; ++s)
+            {
+                Subset& subset = big->obtain_subset(s);
+                subset.store_variable_c(WR_VAR(0, 1, 15), "BUDAPEST LORINC");
+                for (unsigned i = 0; i < 200; ++i)
+                    subset.store_variable_d(WR_VAR(0, 12, 101), 273.15 + (s + i) % 50);
+            }
+            raw = big->encode();
+            BufrBulletin::decode(raw.data(), raw.size(), *bulletin);
+            wassert(actual(bulletin->subsets.size()) == 500u);
+            set<const char*> buffers;
+            for (const auto& subset: bulletin->subsets)
+            {
+                wassert(actual(subset.size()) == 201u);
+                wassert(actual(subset[0].enqc()) == "BUDAPEST LORINC");
+                buffers.insert(subset[0].enqc());
+            }
+            wassert(actual(buffers.size()) == 1u);
+        });
+
+        add_method("move_out", []() {
+            // Variables and subsets moved out of a bulletin stay valid after
+            // the bulletin is destroyed, once detached from its arena
+            for (const char* fname: { "bufr/synop-longname.bufr", "bufr/ed4.bufr", "bufr/C04004.bufr", "bufr/bitmap-B33035.bufr" })
+            {
+                WREPORT_TEST_INFO(test_info);
+                test_info() << fname;
+                std::string raw = tests::slurpfile(fname);
+                auto bulletin = BufrBulletin::decode(raw);
+
+                // Variables using Varinfos local to the bulletin tables do
+                // not outlive it anyway
+                auto independent = [&](const Var& var) {
+                    if (bulletin->tables.is_local(var.info())) return false;
+                    for (const Var* a = var.next_attr(); a; a = a->next_attr())
+                        if (bulletin->tables.is_local(a->info())) return false;
+                    return true;
+                };
+
+                vector<Var> expected_vars;
+                vector<Var> vars;
+                for (auto& var: bulletin->subsets[0])
+                    if (independent(var))
+                    {
+                        expected_vars.push_back(var);
+                        vars.push_back(std::move(var));
+                        vars.back().detach_arena();
+                    }
+
+                Subset expected_subset(bulletin->tables);
+                unique_ptr<Subset> subset;
+                if (bulletin->subsets.size() > 1)
+                {
+                    Subset& source = bulletin->subsets[1];
+                    source.erase(std::remove_if(source.begin(), source.end(), [&](const Var& v) { return !independent(v); }), source.end());
+                    expected_subset = source;
+                    subset.reset(new Subset(std::move(source)));
+                    for (auto& var: *subset)
+                        var.detach_arena();
+                }
+
+                bulletin.reset();
+
+                wassert(actual(vars.size()) == expected_vars.size());
+                for (unsigned i = 0; i < vars.size(); ++i)
+                    wassert(actual(vars[i] == expected_vars[i]).istrue());
+                // Subset::tables still points to the bulletin, so only the
+                // variables can be used
+                if (subset)
+                {
+                    wassert(actual(subset->size()) == expected_subset.size());
+                    for (unsigned i = 0; i < subset->size(); ++i)
+                        wassert(actual((*subset)[i] == expected_subset[i]).istrue());
+                }
+            }
+        });
+
+        add_method("decode_visit", []() {
+            // Record what is sent to a DecodeVisitor
+            struct Recorder : public DecodeVisitor
+            {
+                const Tables* tables = nullptr;
+                vector<Subset> subsets;
+                vector<vector<Varcode>> replications;
+                unsigned open_subsets = 0;
+                unsigned replication_count = 0;
+                bool ended = false;
+
+                void begin_bulletin(const BufrBulletin& bulletin, unsigned subset_count) override
+                {
+                    tables = &bulletin.tables;
+                    replications.resize(subset_count);
+                }
+                void begin_subset(unsigned subset) override
+                {
+                    wassert(actual(subset) == subsets.size());
+                    subsets.emplace_back(*tables);
+                    ++open_subsets;
+                }
+                void value(unsigned subset, const DecodedValue& val) override
+                {
+                    subsets.at(subset).store_variable(val.var());
+                }
+                void attribute(unsigned subset, unsigned pos, const DecodedValue& val) override
+                {
+                    subsets.at(subset).at(pos).seta(val.var());
+                }
+                void begin_replication(unsigned subset, Varcode code, unsigned count) override
+                {
+                    replications.at(subset).push_back(code);
+                    ++replication_count;
+                }
+                void end_replication(unsigned subset, Varcode code) override
+                {
+                    wassert(actual(replications.at(subset).empty()).isfalse());
+                    wassert(actual(replications[subset].back()) == code);
+                    replications[subset].pop_back();
+                }
+                void end_subset(unsigned subset) override
+                {
+                    wassert(actual(replications.at(subset).empty()).istrue());
+                    --open_subsets;
+                }
+                void end_bulletin() override
+                {
+                    wassert(actual(open_subsets) == 0u);
+                    ended = true;
+                }
+            };
+
+            unsigned checked = 0;
+            unsigned replications = 0;
+            for (const auto& msg: tests::all_bufr_messages())
+            {
+                unique_ptr<BufrBulletin> full;
+                try {
+                    full = BufrBulletin::decode(msg.data, msg.fname.c_str());
+                } catch (std::exception&) {
+                    continue;
+                }
+
+                // The bulletin owns the Varinfos of bitmaps, and needs to
+                // outlive the recorded variables
+                unique_ptr<BufrBulletin> bulletin;
+                Recorder recorder;
+                bulletin = BufrBulletin::decode_visit(msg.data.data(), msg.data.size(), recorder, msg.fname.c_str());
+                wassert(actual(bulletin->subsets.empty()).istrue());
+                wassert(actual(recorder.ended).istrue());
+                wassert(actual(recorder.subsets.size()) == full->subsets.size());
+                for (unsigned i = 0; i < full->subsets.size(); ++i)
+                    wassert(actual(recorder.subsets[i].diff(full->subsets[i])) == 0u);
+                replications += recorder.replication_count;
+                ++checked;
+            }
+            wassert(actual(checked) > 100u);
+            wassert(actual(replications) > 1000u);
+        });
+
+        add_method("header_scanner", []() {
+            // Concatenate multiple messages, with garbage in between
+            std::string raw = "garbage";
+            raw += tests::slurpfile("bufr/ed4.bufr");
+            raw += "BUFgarbage";
+            raw += tests::slurpfile("bufr/obs0-1.22.bufr");
+            raw += "garbage";
+
+            BufrHeaderScanner scanner(raw, "test", 100);
+            BufrHeader header;
+            unsigned count = 0;
+            while (scanner.next(header))
+            {
+                // The header matches what is decoded by decode_header
+                std::string msg = raw.substr(header.offset - 100, header.size);
+                auto bulletin = BufrBulletin::decode_header(msg);
+                wassert(actual(bulletin->edition_number) == header.edition_number);
+                wassert(actual(bulletin->originating_centre) == header.originating_centre);
+                wassert(actual(bulletin->originating_subcentre) == header.originating_subcentre);
+                wassert(actual(bulletin->master_table_version_number) == header.master_table_version_number);
+                wassert(actual(bulletin->data_category) == header.data_category);
+                wassert(actual(bulletin->data_subcategory) == header.data_subcategory);
+                wassert(actual(bulletin->data_subcategory_local) == header.data_subcategory_local);
+                wassert(actual(bulletin->rep_year) == header.rep_year);
+                wassert(actual(bulletin->rep_minute) == header.rep_minute);
+                wassert(actual(bulletin->compression) == header.compression);
+                ++count;
+            }
+            wassert(actual(count) == 715u);
+            wassert(actual(header.offset) == (off_t)(raw.size() - 7 - header.size + 100));
+            wassert(actual(header.data_category) == 0);
+            wassert(actual(header.subset_count) == 1u);
+            wassert(actual(header.compression).isfalse());
+        });
+
+        add_method("header_scanner_corrupted", []() {
+            // A broken message followed by a good one
+            std::string raw("BUFR\0\0\x0a\x04", 8);
+            raw += tests::slurpfile("bufr/obs0-1.22.bufr");
+
+            BufrHeaderScanner scanner(raw);
+            BufrHeader header;
+            try {
+                scanner.next(header);
+                throw TestFailed("scanning a corrupted message should fail");
+            } catch (error_parse& e) {
+                wassert(actual(e.what()).contains("less than the minimum of 12"));
+            }
+
+            // Scanning resumes after the broken message
+            wassert(actual(scanner.next(header)).istrue());
+            wassert(actual(header.offset) == 8);
+            wassert(actual(scanner.next(header)).isfalse());
+        });
+
+        add_method("threads", []() {
+            // Decode the same messages from multiple threads, and compare
+            // the results with those of decoding them sequentially
+            vector<string> messages;
+            for (const char* fname: { "bufr/ed4.bufr", "bufr/obs0-1.22.bufr", "bufr/synop-evapo.bufr", "bufr/C04004.bufr", "bufr/bitmap-B33035.bufr" })
+            {
+                BufrFileReader reader(tests::datafile(fname));
+                const char* data;
+                size_t size;
+                off_t offset;
+                while (reader.next(data, size, offset))
+                    messages.emplace_back(data, size);
+            }
+
+            vector<unique_ptr<BufrBulletin>> expected;
+            for (const auto& msg: messages)
+                expected.emplace_back(BufrBulletin::decode(msg));
+
+            vector<unsigned> mismatches(4, 0);
+            vector<thread> threads;
+            for (unsigned i = 0; i < mismatches.size(); ++i)
+                threads.emplace_back([&, i]() {
+                    for (unsigned round = 0; round < 3; ++round)
+                        for (unsigned m = 0; m < messages.size(); ++m)
+                        {
+                            // Start each thread from a different message
+                            unsigned idx = (m + i * messages.size() / mismatches.size()) % messages.size();
+                            auto bulletin = BufrBulletin::decode(messages[idx]);
+                            if (bulletin->diff(*expected[idx]) != 0)
+                                ++mismatches[i];
+                        }
+                });
+            for (auto& t: threads)
+                t.join();
+
+            for (auto m: mismatches)
+                wassert(actual(m) == 0u);
+        });
     }
 } testnewtg("bufr_decoder");
 
@@ -1,6 +1,13 @@
 #include "bulletin.h"
+#include "columns.h"
+#include "visitor.h"
 #include "bulletin/internals.h"
 #include "buffers/bufr.h"
+#include "tableinfo.h"
+#include "reader.h"
+#include "bulletin/profile.h"
+#include "internals/metrics.h"
+#include <algorithm>
 #include <cstring>
 #include "config.h"
 
@@ -19,10 +26,113 @@ using namespace std;
 namespace wreport {
 namespace {
 
-// Return a value with bitlen bits set to 1
-static inline uint32_t all_ones(int bitlen)
+template<typename Header>
+void decode_sec1ed3(buffers::BufrInput& in, Header& out)
 {
-    return ((1 << (bitlen - 1))-1) | (1 << (bitlen - 1));
+    // master table number in sec1[3]
+    out.master_table_number = in.read_byte(1, 3);
+    // has_optional in sec1[7]
+    // Once we know if the optional section is available, we can scan
+    // section lengths for the rest of the message
+    in.scan_other_sections(in.read_byte(1, 7) & 0x80);
+    // subcentre in sec1[4]
+    out.originating_subcentre = in.read_byte(1, 4);
+    // centre in sec1[5]
+    out.originating_centre = in.read_byte(1, 5);
+    // Update sequence number sec1[6]
+    out.update_sequence_number = in.read_byte(1, 6);
+    out.master_table_version_number = in.read_byte(1, 10);
+    out.master_table_version_number_local = in.read_byte(1, 11);
+    out.data_category = in.read_byte(1, 8);
+    out.data_subcategory = 0xff;
+    out.data_subcategory_local = in.read_byte(1, 9);
+
+    out.rep_year = in.read_byte(1, 12);
+    // Fix the century with a bit of euristics
+    if (out.rep_year > 50)
+        out.rep_year += 1900;
+    else
+        out.rep_year += 2000;
+    out.rep_month = in.read_byte(1, 13);
+    out.rep_day = in.read_byte(1, 14);
+    out.rep_hour = in.read_byte(1, 15);
+    out.rep_minute = in.read_byte(1, 16);
+    if (in.read_byte(1, 17) != 0)
+        out.rep_year = in.read_byte(1, 17) * 100 + (out.rep_year % 100);
+}
+
+template<typename Header>
+void decode_sec1ed4(buffers::BufrInput& in, Header& out)
+{
+    // master table number in sec1[3]
+    out.master_table_number = in.read_byte(1, 3);
+    // centre in sec1[4-5]
+    out.originating_centre = in.read_number(1, 4, 2);
+    // subcentre in sec1[6-7]
+    out.originating_subcentre = in.read_number(1, 6, 2);
+    // update sequence number sec1[8]
+    out.update_sequence_number = in.read_byte(1, 8);
+    // has_optional in sec1[9]
+    // Once we know if the optional section is available, we can scan
+    // section lengths for the rest of the message
+    in.scan_other_sections(in.read_byte(1, 9) & 0x80);
+    // category in sec1[10]
+    out.data_category = in.read_byte(1, 10);
+    // international data sub-category in sec1[11]
+    out.data_subcategory = in.read_byte(1, 11);
+    // local data sub-category in sec1[12]
+    out.data_subcategory_local = in.read_byte(1, 12);
+    // version number of master table in sec1[13]
+    out.master_table_version_number = in.read_byte(1, 13);
+    // version number of local table in sec1[14]
+    out.master_table_version_number_local = in.read_byte(1, 14);
+    // year in sec1[15-16]
+    out.rep_year = in.read_number(1, 15, 2);
+    // month in sec1[17]
+    out.rep_month = in.read_byte(1, 17);
+    // day in sec1[18]
+    out.rep_day = in.read_byte(1, 18);
+    // hour in sec1[19]
+    out.rep_hour = in.read_byte(1, 19);
+    // minute in sec1[20]
+    out.rep_minute = in.read_byte(1, 20);
+    // sec in sec1[21]
+    out.rep_second = in.read_byte(1, 21);
+}
+
+/**
+ * Decode sections 0 and 1 of a BUFR message into \a out, and scan the start
+ * offsets of all the other sections.
+ *
+ * This is shared by the decoder, which decodes into a BufrBulletin, and by the
+ * header scanner, which decodes into a BufrHeader.
+ */
+template<typename Header>
+void decode_lead_sections(buffers::BufrInput& in, Header& out)
+{
+    // Read BUFR section 0 (Indicator section)
+    if (memcmp(in.data + in.sec[0], "BUFR", 4) != 0)
+        in.parse_error(0, 0, "data does not start with BUFR header (\"%.4s\" was read instead)", in.data + in.sec[0]);
+
+    // Check the BUFR edition number
+    out.edition_number = in.read_byte(0, 7);
+    if (out.edition_number != 2 && out.edition_number != 3 && out.edition_number != 4)
+        in.parse_error(0, 7, "Only BUFR edition 2, 3, and 4 are supported (this message is edition %d)", out.edition_number);
+
+    // Looks like a BUFR, scan section starts
+    in.scan_lead_sections();
+
+    // Read bufr section 1 (Identification section)
+    in.check_available_data(1, 0, out.edition_number == 4 ? 22 : 18, "section 1 of BUFR message (identification section)");
+
+    switch (out.edition_number)
+    {
+        case 2: decode_sec1ed3(in, out); break;
+        case 3: decode_sec1ed3(in, out); break;
+        case 4: decode_sec1ed4(in, out); break;
+        default:
+            error_consistency::throwf("BUFR edition is %d, but I can only decode 2, 3 and 4", out.edition_number);
+    }
 }
 
 struct Decoder
@@ -37,9 +147,11 @@ struct Decoder
     bool conf_add_undef_attrs = false;
     /// Optional section length decoded from the message
     unsigned optional_section_length = 0;
+    /// If not empty, only decode variables with these varcodes (sorted)
+    std::vector<Varcode> decode_only;
 
-    Decoder(const std::string& buf, const char* fname, size_t offset, BufrBulletin& out)
-        : in(buf), out(out)
+    Decoder(const void* data, size_t size, const char* fname, size_t offset, BufrBulletin& out)
+        : in(data, size), out(out)
     {
         in.fname = fname;
         in.start_offset = offset;
@@ -48,112 +160,22 @@ struct Decoder
     void read_options(const BufrCodecOptions& opts)
     {
         conf_add_undef_attrs = opts.decode_adds_undef_attrs;
+        decode_only = opts.decode_only;
+        std::sort(decode_only.begin(), decode_only.end());
     }
 
-    void decode_sec1ed3()
+    /**
+     * Decode the message header only.
+     *
+     * Decoding tables are not loaded: the caller needs to call
+     * out.load_tables() before decoding the data section.
+     */
+    void decode_header()
     {
-        // master table number in sec1[3]
-        out.master_table_number = in.read_byte(1, 3);
-        // has_optional in sec1[7]
-        // Once we know if the optional section is available, we can scan
-        // section lengths for the rest of the message
-        in.scan_other_sections(in.read_byte(1, 7) & 0x80);
-        optional_section_length = in.sec[3] - in.sec[2];
-        if (optional_section_length)
-            optional_section_length -= 4;
-        // subcentre in sec1[4]
-        out.originating_subcentre = in.read_byte(1, 4);
-        // centre in sec1[5]
-        out.originating_centre = in.read_byte(1, 5);
-        // Update sequence number sec1[6]
-        out.update_sequence_number = in.read_byte(1, 6);
-        out.master_table_version_number = in.read_byte(1, 10);
-        out.master_table_version_number_local = in.read_byte(1, 11);
-        out.data_category = in.read_byte(1, 8);
-        out.data_subcategory = 0xff;
-        out.data_subcategory_local = in.read_byte(1, 9);
-
-        out.rep_year = in.read_byte(1, 12);
-        // Fix the century with a bit of euristics
-        if (out.rep_year > 50)
-            out.rep_year += 1900;
-        else
-            out.rep_year += 2000;
-        out.rep_month = in.read_byte(1, 13);
-        out.rep_day = in.read_byte(1, 14);
-        out.rep_hour = in.read_byte(1, 15);
-        out.rep_minute = in.read_byte(1, 16);
-        if (in.read_byte(1, 17) != 0)
-            out.rep_year = in.read_byte(1, 17) * 100 + (out.rep_year % 100);
-    }
-
-    void decode_sec1ed4()
-    {
-        // master table number in sec1[3]
-        out.master_table_number = in.read_byte(1, 3);
-        // centre in sec1[4-5]
-        out.originating_centre = in.read_number(1, 4, 2);
-        // subcentre in sec1[6-7]
-        out.originating_subcentre = in.read_number(1, 6, 2);
-        // update sequence number sec1[8]
-        out.update_sequence_number = in.read_byte(1, 8);
-        // has_optional in sec1[9]
-        // Once we know if the optional section is available, we can scan
-        // section lengths for the rest of the message
-        in.scan_other_sections(in.read_byte(1, 9) & 0x80);
+        decode_lead_sections(in, out);
         optional_section_length = in.sec[3] - in.sec[2];
         if (optional_section_length)
             optional_section_length -= 4;
-        // category in sec1[10]
-        out.data_category = in.read_byte(1, 10);
-        // international data sub-category in sec1[11]
-        out.data_subcategory = in.read_byte(1, 11);
-        // local data sub-category in sec1[12]
-        out.data_subcategory_local = in.read_byte(1, 12);
-        // version number of master table in sec1[13]
-        out.master_table_version_number = in.read_byte(1, 13);
-        // version number of local table in sec1[14]
-        out.master_table_version_number_local = in.read_byte(1, 14);
-        // year in sec1[15-16]
-        out.rep_year = in.read_number(1, 15, 2);
-        // month in sec1[17]
-        out.rep_month = in.read_byte(1, 17);
-        // day in sec1[18]
-        out.rep_day = in.read_byte(1, 18);
-        // hour in sec1[19]
-        out.rep_hour = in.read_byte(1, 19);
-        // minute in sec1[20]
-        out.rep_minute = in.read_byte(1, 20);
-        // sec in sec1[21]
-        out.rep_second = in.read_byte(1, 21);
-    }
-
-    /* Decode the message header only */
-    void decode_header()
-    {
-        // Read BUFR section 0 (Indicator section)
-        if (memcmp(in.data + in.sec[0], "BUFR", 4) != 0)
-            in.parse_error(0, 0, "data does not start with BUFR header (\"%.4s\" was read instead)", in.data + in.sec[0]);
-
-        // Check the BUFR edition number
-        out.edition_number = in.read_byte(0, 7);
-        if (out.edition_number != 2 && out.edition_number != 3 && out.edition_number != 4)
-            in.parse_error(0, 7, "Only BUFR edition 2, 3, and 4 are supported (this message is edition %d)", out.edition_number);
-
-        // Looks like a BUFR, scan section starts
-        in.scan_lead_sections();
-
-        // Read bufr section 1 (Identification section)
-        in.check_available_data(1, 0, out.edition_number == 4 ? 22 : 18, "section 1 of BUFR message (identification section)");
-
-        switch (out.edition_number)
-        {
-            case 2: decode_sec1ed3(); break;
-            case 3: decode_sec1ed3(); break;
-            case 4: decode_sec1ed4(); break;
-            default:
-                error_consistency::throwf("BUFR edition is %d, but I can only decode 2, 3 and 4", out.edition_number);
-        }
 
         TRACE("BUFR:edition %d, optional section %ub, update sequence number %d\n",
                 out.edition, optional_section_length, out.update_sequence_number);
@@ -171,7 +193,7 @@ struct Decoder
             in.check_available_data(2, 0, s2_length, "section 2 of BUFR message (optional section)");
             if (s2_length < 4)
                 error_consistency::throwf("Optional section length is %u but it must be at least 4", s2_length);
-            out.optional_section = string((const char*)in.data + in.sec[2] + 4, s2_length - 4);
+            out.optional_section.assign((const char*)in.data + in.sec[2] + 4, s2_length - 4);
         }
 
         /* Read BUFR section 3 (Data description section) */
@@ -192,68 +214,186 @@ struct Decoder
        TRACE("\n");
        }
        */
-        // Once we filled the Bulletin header info, load decoding tables and allocate subsets
-        out.load_tables();
     }
 
     /* Decode message data section after the header has been decoded */
     void decode_data();
+
+    /* Decode message data section sending its values to a visitor */
+    void decode_data(DecodeVisitor& visitor);
+
+    /* Decode message data section into columns after the header has been decoded */
+    void decode_data(Columns& columns);
+
+    /* Check the end section, after the data section has been decoded */
+    void decode_end();
 };
 
-/// Decoder for uncompressed data
-struct UncompressedBufrDecoder : public bulletin::UncompressedDecoder
+/**
+ * Variables seen by a data section decoder, and selection of those that are
+ * sent to the DecodeVisitor.
+ *
+ * Bitmaps, attributes and substituted values refer to variables by their
+ * position among all the variables of a subset: Projection keeps track of all
+ * the variables seen, and when only some varcodes are wanted, it maps their
+ * positions to the positions of the variables that have been sent.
+ */
+struct Projection
+{
+    /// Wanted varcodes, sorted, or empty to select all variables
+    const std::vector<Varcode>& wanted;
+
+    /// Varinfo of all the variables seen so far
+    std::vector<Varinfo> infos;
+
+    /// Varcodes of all the variables seen so far, used to resolve bitmaps
+    std::vector<Varcode> codes;
+
+    /**
+     * Output position of each variable seen so far, or -1 if it was skipped.
+     *
+     * It is only filled if not all variables are selected.
+     */
+    std::vector<int> positions;
+
+    /// Number of variables selected so far
+    unsigned stored = 0;
+
+    explicit Projection(const std::vector<Varcode>& wanted) : wanted(wanted) {}
+
+    /**
+     * Account for a new variable, returning true if it is selected, or false
+     * if it needs to be skipped
+     */
+    bool add(Varinfo info)
+    {
+        infos.push_back(info);
+        codes.push_back(info->code);
+        if (wanted.empty())
+        {
+            ++stored;
+            return true;
+        }
+        if (!std::binary_search(wanted.begin(), wanted.end(), info->code))
+        {
+            positions.push_back(-1);
+            return false;
+        }
+        positions.push_back(stored++);
+        return true;
+    }
+
+    /**
+     * Return the output position of the variable at position \a pos, or -1
+     * if it was skipped
+     */
+    int output_position(unsigned pos) const
+    {
+        if (wanted.empty()) return pos;
+        return positions[pos];
+    }
+};
+
+/// Common parts of the decoders of the data section
+struct DataDecoder : public bulletin::Interpreter
 {
     /// Input buffer
     buffers::BufrInput& in;
 
-    /// If set, it is the associated field for the next variable to be decoded
-    Var* cur_associated_field = nullptr;
+    /// Receiver of the decoded values
+    DecodeVisitor& out;
+
+    /// Variables seen so far
+    Projection projection;
 
-    UncompressedBufrDecoder(Bulletin& bulletin, unsigned subset_no, buffers::BufrInput& in)
-        : bulletin::UncompressedDecoder(bulletin, subset_no), in(in)
+    /// Buffer used to decode string and binary values
+    std::vector<char> buf;
+
+    DataDecoder(BufrBulletin& bulletin, buffers::BufrInput& in, DecodeVisitor& out, const std::vector<Varcode>& decode_only)
+        : Interpreter(bulletin.tables, bulletin.datadesc), in(in), out(out), projection(decode_only)
     {
     }
 
-    ~UncompressedBufrDecoder()
+    /// Return a buffer big enough to decode a string or binary value described by \a info
+    char* value_buffer(Varinfo info)
     {
-        delete cur_associated_field;
+        buf.resize(info->bit_len / 8 + 2);
+        return buf.data();
     }
+};
 
-    Var decode_b_value(Varinfo info)
+/// Decoder for uncompressed data
+struct UncompressedBufrDecoder : public DataDecoder
+{
+    /// Index of the subset being decoded
+    unsigned subset_no;
+
+    UncompressedBufrDecoder(BufrBulletin& bulletin, unsigned subset_no, buffers::BufrInput& in, DecodeVisitor& out, const std::vector<Varcode>& decode_only)
+        : DataDecoder(bulletin, in, out, decode_only), subset_no(subset_no)
     {
-        Var var(info);
+    }
+
+    /// Decode the value described by val.info into \a val
+    void decode_value(DecodedValue& val)
+    {
+        Varinfo info = val.info;
         switch (info->type)
         {
-            case Vartype::String:
-                in.decode_string(var);
+            case Vartype::String: {
+                char* str = value_buffer(info);
+                size_t len;
+                if (in.decode_string(info->bit_len, str, len))
+                {
+                    val.missing = false;
+                    val.cval = str;
+                }
                 break;
-            case Vartype::Binary:
-                in.decode_binary(var);
+            }
+            case Vartype::Binary: {
+                char* str = value_buffer(info);
+                if (in.decode_binary(info->bit_len, (uint8_t*)str))
+                {
+                    val.missing = false;
+                    val.cval = str;
+                }
                 break;
+            }
             case Vartype::Integer:
             case Vartype::Decimal:
-                in.decode_number(var);
+                val.missing = !in.decode_number(info, val.ival);
                 break;
         }
-        return var;
     }
 
     void define_substituted_value(unsigned pos) override
     {
         // Use the details of the corrisponding variable for decoding
-        Varinfo info = output_subset[pos].info();
-        Var var = decode_b_value(info);
-        TRACE(" define_substituted_value adding var %01d%02d%03d %s as attribute to %01d%02d%03d\n",
-                WR_VAR_FXY(var.code()), var.value(), WR_VAR_FXY(output_subset[var_pos].code()));
-        output_subset[pos].seta(var);
+        DecodedValue val(projection.infos[pos]);
+        int out_pos = projection.output_position(pos);
+        if (out_pos == -1)
+        {
+            in.skip_bits(val.info->bit_len);
+            return;
+        }
+        decode_value(val);
+        TRACE(" define_substituted_value adding var %01d%02d%03d as attribute to %01d%02d%03d\n",
+                WR_VAR_FXY(val.info->code), WR_VAR_FXY(projection.codes[pos]));
+        out.attribute(subset_no, out_pos, val);
     }
 
     void define_attribute(Varinfo info, unsigned pos) override
     {
-        Var var = decode_b_value(info);
-        TRACE(" define_attribute adding var %01d%02d%03d %s as attribute to %01d%02d%03d\n",
-                WR_VAR_FXY(var.code()), var.value(), WR_VAR_FXY(output_subset[var_pos].code()));
-        output_subset[pos].seta(var);
+        int out_pos = projection.output_position(pos);
+        if (out_pos == -1)
+        {
+            in.skip_bits(info->bit_len);
+            return;
+        }
+        DecodedValue val(info);
+        decode_value(val);
+        TRACE(" define_attribute adding var %01d%02d%03d as attribute to %01d%02d%03d\n",
+                WR_VAR_FXY(info->code), WR_VAR_FXY(projection.codes[pos]));
+        out.attribute(subset_no, out_pos, val);
     }
 
     /**
@@ -261,40 +401,36 @@ struct UncompressedBufrDecoder : public bulletin::UncompressedDecoder
      */
     void define_variable(Varinfo info) override
     {
+        if (!projection.add(info))
+        {
+            in.skip_bits(associated_field.bit_count + info->bit_len);
+            return;
+        }
+
+        uint32_t associated_field_val = 0;
         if (associated_field.bit_count)
         {
-            if (cur_associated_field)
-            {
-                delete cur_associated_field;
-                cur_associated_field = 0;
-            }
             TRACE("decode_b_data:reading %d bits of C04 information\n", associated_field.bit_count);
-            uint32_t val = in.get_bits(associated_field.bit_count);
-            TRACE("decode_b_data:read C04 information %x\n", val);
-            cur_associated_field = associated_field.make_attribute(val).release();
+            associated_field_val = in.get_bits(associated_field.bit_count);
+            TRACE("decode_b_data:read C04 information %x\n", associated_field_val);
         }
 
-        output_subset.store_variable(decode_b_value(info));
-        IFTRACE {
-            TRACE(" define_variable decoded: ");
-            output_subset.back().print(stderr);
-        }
-        if (cur_associated_field)
+        DecodedValue val(info);
+        decode_value(val);
+        out.value(subset_no, val);
+
+        if (associated_field.bit_count)
         {
-            IFTRACE {
-                TRACE(" define_variable with associated field: ");
-                cur_associated_field->print(stderr);
-            }
-            unique_ptr<Var> af(cur_associated_field);
-            cur_associated_field = 0;
-            output_subset.back().seta(move(af));
+            DecodedValue af(nullptr);
+            if (associated_field.make_attribute(associated_field_val, af))
+                out.attribute(subset_no, projection.stored - 1, af);
         }
     }
 
     /**
      * Request processing of C05yyy character data
      */
-    void define_raw_character_data(Varcode code)
+    void define_raw_character_data(Varcode code) override
     {
         unsigned cdatalen = WR_VAR_Y(code);
         string buf;
@@ -309,32 +445,44 @@ struct UncompressedBufrDecoder : public bulletin::UncompressedDecoder
 
         // Add as C variable to the subset
 
-        // Create a single use varinfo to store the bitmap
+        // Create a single use varinfo to store the character data
         Varinfo info = tables.get_chardata(code, cdatalen);
 
-        // Store the character data
-        Var cdata(info, buf);
-        output_subset.store_variable(cdata);
+        // Send the character data
+        if (projection.add(info))
+        {
+            DecodedValue val(info);
+            val.missing = false;
+            val.cval = buf.c_str();
+            out.value(subset_no, val);
+        }
 
         TRACE("decode_c_data:decoded string %s\n", buf.c_str());
     }
 
     unsigned define_delayed_replication_factor(Varinfo info) override
     {
-        output_subset.store_variable(decode_b_value(info));
-        return output_subset.back().enqi();
+        DecodedValue val(info);
+        decode_value(val);
+        if (projection.add(info))
+            out.value(subset_no, val);
+        return val.enqi();
     }
 
     unsigned define_associated_field_significance(Varinfo info) override
     {
-        output_subset.store_variable(decode_b_value(info));
-        return output_subset.back().enq(63);
+        DecodedValue val(info);
+        decode_value(val);
+        if (projection.add(info))
+            out.value(subset_no, val);
+        return val.isset() ? val.enqi() : 63;
     }
 
     unsigned define_bitmap_delayed_replication_factor(Varinfo info) override
     {
-        Var rep_count = decode_b_value(info);
-        return rep_count.enqi();
+        DecodedValue val(info);
+        decode_value(val);
+        return val.enqi();
     }
 
     void define_bitmap(unsigned bitmap_size) override
@@ -351,86 +499,161 @@ struct UncompressedBufrDecoder : public bulletin::UncompressedDecoder
         // Create a single use varinfo to store the bitmap
         Varinfo info = tables.get_bitmap(code, buf);
 
-        // Store the bitmap
+        // Create the bitmap variable
         Var bmp(info, buf);
 
-        // Bitmap will stay set as a reference to the variable to use as the
-        // current bitmap. The subset(s) are taking care of memory managing it.
-
         IFTRACE {
             TRACE("Decoded bitmap count %u: ", bitmap_size);
             bmp.print(stderr);
             TRACE("\n");
         }
 
-        bitmaps.define(bmp, output_subset, output_subset.size());
+        bitmaps.define(bmp, projection.codes, projection.codes.size());
 
-        // Add var to subset(s)
-        output_subset.store_variable(move(bmp));
+        // Send the bitmap
+        if (projection.add(info))
+            out.value(subset_no, DecodedValue(bmp));
+    }
+
+    void begin_replication(Varcode code, unsigned count) override
+    {
+        out.begin_replication(subset_no, code, count);
+    }
+
+    void end_replication(Varcode code) override
+    {
+        out.end_replication(subset_no, code);
     }
 };
 
 /// Decoder for compressed data
-struct CompressedBufrDecoder : public bulletin::CompressedDecoder
+struct CompressedBufrDecoder : public DataDecoder
 {
-    /// Input buffer
-    buffers::BufrInput& in;
-
     /// Number of subsets in data section
     unsigned subset_count;
 
-    CompressedBufrDecoder(BufrBulletin& bulletin, buffers::BufrInput& in)
-        : bulletin::CompressedDecoder(bulletin), in(in), subset_count(bulletin.subsets.size())
+    CompressedBufrDecoder(BufrBulletin& bulletin, unsigned subset_count, buffers::BufrInput& in, DecodeVisitor& out, const std::vector<Varcode>& decode_only)
+        : DataDecoder(bulletin, in, out, decode_only), subset_count(subset_count)
     {
     }
 
-    template<typename Adder>
-    void decode_b_value(Varinfo info, Adder& dest)
+    /**
+     * Decode the values of a string described by val.info, calling
+     * dest(subset, val, nullptr) for each subset
+     */
+    template<typename Dest>
+    void decode_strings(DecodedValue& val, Dest& dest)
     {
-        switch (info->type)
+        Varinfo info = val.info;
+        char* str = value_buffer(info);
+        size_t len;
+        bool missing = !in.decode_string(info->bit_len, str, len);
+
+        // Decode the number of bytes (encoded in 6 bits) of each difference
+        // value
+        uint32_t diffbits = in.get_bits(6);
+
+        if (diffbits == 0)
         {
-            case Vartype::String:
-                in.decode_string(info, subset_count, dest);
-                break;
-            case Vartype::Binary:
-                throw error_unimplemented("decode_b_binary TODO");
-            case Vartype::Integer:
-            case Vartype::Decimal:
-                if (associated_field.bit_count)
-                {
-                    in.decode_compressed_number(info, associated_field.bit_count, subset_count, [&](unsigned subset_no, Var&& var, uint32_t associated_field_val) {
-                        unique_ptr<Var> af(associated_field.make_attribute(associated_field_val));
-                        if (af.get()) var.seta(move(af));
-                        dest.add_var(subset_no, move(var));
-                    });
-                }
-                else
-                    in.decode_compressed_number(info, subset_count, dest);
-                break;
+            // The same string for all the subsets
+            if (!missing)
+            {
+                val.missing = false;
+                val.cval = str;
+            }
+            for (unsigned i = 0; i < subset_count; ++i)
+                dest(i, val, nullptr);
+            return;
+        }
+
+        /* For compressed strings, the reference value must be all zeros */
+        for (size_t i = 0; i < len; ++i)
+            if (str[i] != 0)
+                error_unimplemented::throwf("compressed strings with %d bit deltas have non-zero reference value", diffbits);
+
+        /* Let's also check that the number of
+         * difference characters is the same length as
+         * the reference string */
+        if (diffbits > len)
+            error_unimplemented::throwf("compressed strings with %zd characters have %d bit deltas (deltas should not be longer than field)", len, diffbits);
+
+        for (unsigned i = 0; i < subset_count; ++i)
+        {
+            val.missing = !in.decode_string(diffbits * 8, str, len);
+            val.cval = val.missing ? nullptr : str;
+            dest(i, val, nullptr);
         }
     }
 
-    void decode_b_value(Varinfo info, std::function<void(unsigned, Var&&)> dest)
+    /**
+     * Decode the values of a number described by val.info, calling
+     * dest(subset, val, associated_field) for each subset, where
+     * associated_field is the attribute given by the associated field, or
+     * nullptr
+     */
+    template<typename Dest>
+    void decode_numbers(DecodedValue& val, Dest& dest)
     {
+        Varinfo info = val.info;
+
+        /* I could not find any specification describing the behaviour of
+         * associated fields in compressed BUFRs: see
+         * BufrInput::skip_compressed_value for the layout that we assume */
+        uint32_t af_base = 0;
+        uint32_t af_diffbits = 0;
+        if (associated_field.bit_count)
+        {
+            af_base = in.get_bits(associated_field.bit_count);
+            af_diffbits = in.get_bits(6);
+        }
+
+        // Data field base value and number of bits of the differences
+        uint32_t base;
+        uint32_t diffbits;
+        if (!in.decode_compressed_base(info, base, diffbits))
+        {
+            // This is the value of all subsets if there are no differences
+            val.missing = false;
+            val.ival = (int64_t)base + info->bit_ref;
+        }
+
+        uint32_t missing_diff = diffbits ? buffers::all_ones(diffbits) : 0;
+        DecodedValue af(nullptr);
+        for (unsigned i = 0; i < subset_count; ++i)
+        {
+            bool has_af = false;
+            if (associated_field.bit_count)
+                has_af = associated_field.make_attribute(af_base + in.get_bits(af_diffbits), af);
+            if (diffbits)
+            {
+                // Decode the difference value, where all 1s means a missing
+                // value
+                uint32_t diff = in.get_bits(diffbits);
+                val.missing = diff == missing_diff;
+                val.ival = (int64_t)base + diff + info->bit_ref;
+            }
+            dest(i, val, has_af ? &af : nullptr);
+        }
+    }
+
+    /**
+     * Decode the values of a variable described by \a info for all the
+     * subsets, calling dest(subset, val, associated_field) for each subset
+     */
+    template<typename Dest>
+    void decode_values(Varinfo info, Dest dest)
+    {
+        DecodedValue val(info);
         switch (info->type)
         {
             case Vartype::String:
-                in.decode_string(info, subset_count, dest);
+                decode_strings(val, dest);
                 break;
             case Vartype::Binary:
                 throw error_unimplemented("decode_b_binary TODO");
             case Vartype::Integer:
             case Vartype::Decimal:
-                if (associated_field.bit_count)
-                {
-                    in.decode_compressed_number(info, associated_field.bit_count, subset_count, [&](unsigned subset_no, Var&& var, uint32_t associated_field_val) {
-                        unique_ptr<Var> af(associated_field.make_attribute(associated_field_val));
-                        if (af.get()) var.seta(move(af));
-                        dest(subset_no, move(var));
-                    });
-                }
-                else
-                    in.decode_compressed_number(info, subset_count, dest);
+                decode_numbers(val, dest);
                 break;
         }
     }
@@ -458,55 +681,55 @@ struct CompressedBufrDecoder : public bulletin::CompressedDecoder
         return var;
     }
 
-    /**
-     * Add \a var to all datasets, returning a pointer to one version of \a var
-     * that is memory managed by one of the datasets.
-     */
+    /// Send \a var to all subsets, if it is selected
     void add_to_all(const Var& var)
     {
+        if (!projection.add(var.info())) return;
+        DecodedValue val(var);
         for (unsigned i = 0; i < subset_count; ++i)
-            output_bulletin.subsets[i].store_variable(var);
+            out.value(i, val);
     }
 
     void define_variable(Varinfo info) override
     {
-        struct Adder
+        if (!projection.add(info))
         {
-            Bulletin& out;
-            unsigned subset_count;
-            Adder(Bulletin& out, unsigned subset_count) : out(out), subset_count(subset_count) {}
+            in.skip_compressed_value(info, associated_field.bit_count, subset_count);
+            return;
+        }
 
-            void add_missing(Varinfo info)
-            {
-                for (unsigned i = 0; i < subset_count; ++i)
-                    out.subsets[i].store_variable_undef(info);
-            }
-            void add_same(const Var& var)
-            {
-                for (unsigned i = 0; i < subset_count; ++i)
-                    out.subsets[i].store_variable(Var(var));
-            }
-            void add_var(unsigned subset, Var&& var)
-            {
-                out.subsets[subset].store_variable(var);
-            }
-        } adder(output_bulletin, subset_count);
-        decode_b_value(info, adder);
+        unsigned pos = projection.stored - 1;
+        decode_values(info, [&](unsigned subset, const DecodedValue& val, const DecodedValue* af) {
+            out.value(subset, val);
+            if (af) out.attribute(subset, pos, *af);
+        });
     }
 
     void define_substituted_value(unsigned pos) override
     {
         // Use the details of the corrisponding variable for decoding
-        Varinfo info = output_bulletin.subset(0)[pos].info();
-        decode_b_value(info, [&](unsigned idx, Var&& var) {
-            output_bulletin.subsets[idx][pos].seta(var);
+        Varinfo info = projection.infos[pos];
+        int out_pos = projection.output_position(pos);
+        if (out_pos == -1)
+        {
+            in.skip_compressed_value(info, associated_field.bit_count, subset_count);
+            return;
+        }
+        decode_values(info, [&](unsigned subset, const DecodedValue& val, const DecodedValue*) {
+            out.attribute(subset, out_pos, val);
         });
     }
 
     void define_attribute(Varinfo info, unsigned pos) override
     {
-        decode_b_value(info, [&](unsigned idx, Var&& var) {
-            output_bulletin.subsets[idx][pos].seta(var);
+        int out_pos = projection.output_position(pos);
+        if (out_pos == -1)
+        {
+            in.skip_compressed_value(info, associated_field.bit_count, subset_count);
+            return;
+        }
+        decode_values(info, [&](unsigned subset, const DecodedValue& val, const DecodedValue*) {
+            out.attribute(subset, out_pos, val);
         });
     }
 
@@ -535,6 +758,7 @@ struct CompressedBufrDecoder : public bulletin::CompressedDecoder
         Var rep_count = decode_semantic_b_value(info);
         return rep_count.enqi();
     }
+
     void define_bitmap(unsigned bitmap_size) override
     {
         Varcode code = bitmaps.pending_definitions;
@@ -548,26 +772,162 @@ struct CompressedBufrDecoder : public bulletin::CompressedDecoder
         // Create the bitmap variable
         Var bmp(info, buf);
 
-        // Add var to subset(s)
-        add_to_all(bmp);
-
-        // Bitmap will stay set as a reference to the variable to use as the
-        // current bitmap. The subset(s) are taking care of memory managing it.
-
         IFTRACE {
             TRACE("Decoded bitmap count %u: ", bitmap_size);
             bmp.print(stderr);
             TRACE("\n");
         }
 
-        bitmaps.define(move(bmp), output_bulletin.subset(0), output_bulletin.subset(0).size());
+        bitmaps.define(bmp, projection.codes, projection.codes.size());
+
+        // Send the bitmap to all subsets
+        add_to_all(bmp);
+    }
+
+    void begin_replication(Varcode code, unsigned count) override
+    {
+        for (unsigned i = 0; i < subset_count; ++i)
+            out.begin_replication(i, code, count);
+    }
+
+    void end_replication(Varcode code) override
+    {
+        for (unsigned i = 0; i < subset_count; ++i)
+            out.end_replication(i, code);
     }
 };
 
-void Decoder::decode_data()
+/**
+ * DecodeVisitor that stores the decoded values in the subsets of a bulletin.
+ *
+ * Subsets reused from a previous message have their variables overwritten,
+ * to reuse their memory. String values and attributes that need new memory
+ * take it from the arena of the bulletin.
+ *
+ * A string value that is the same as the previous one of the same variable,
+ * as it happens when a compressed message has the same value in all subsets,
+ * shares its buffer in the arena instead of being copied again.
+ */
+struct SubsetsBuilder : public DecodeVisitor
 {
-    out.obtain_subset(expected_subsets - 1);
+    Bulletin& bulletin;
+
+    /// Number of variables stored so far in each subset
+    std::vector<unsigned> sizes;
+
+    /// Varinfo of the last string value stored in the arena
+    Varinfo last_info = nullptr;
+
+    /// Subset of the last string value stored in the arena
+    unsigned last_subset = 0;
+
+    /// Position in its subset of the last string value stored in the arena
+    unsigned last_pos = 0;
+
+    SubsetsBuilder(Bulletin& bulletin) : bulletin(bulletin) {}
+
+    /// Check if \a val has the same value as \a var
+    static bool same_value(const Var& var, const DecodedValue& val)
+    {
+        if (!var.isset()) return false;
+        if (val.info->type == Vartype::Binary)
+            return memcmp(var.enqc(), val.cval, val.info->len) == 0;
+        return strcmp(var.enqc(), val.cval) == 0;
+    }
+
+    void begin_bulletin(const BufrBulletin&, unsigned subset_count) override
+    {
+        if (subset_count)
+            bulletin.obtain_reused_subset(subset_count - 1);
+        sizes.assign(subset_count, 0);
+        last_info = nullptr;
+    }
+
+    void value(unsigned subset, const DecodedValue& val) override
+    {
+        Subset& dest = bulletin.subsets[subset];
+        unsigned& size = sizes[subset];
+        if (size < dest.size())
+        {
+            Var& var = dest[size];
+            if (var.info() == val.info)
+                var.clear_attrs();
+            else
+                var = Var(val.info);
+        } else
+            dest.emplace_back(val.info);
+        Var& var = dest[size];
+        if (!val.cval)
+            val.set(var);
+        else if (val.info == last_info && same_value(bulletin.subsets[last_subset][last_pos], val))
+            var.share_value(bulletin.subsets[last_subset][last_pos]);
+        else
+        {
+            var.use_arena(bulletin.arena);
+            val.set(var);
+            last_info = val.info;
+            last_subset = subset;
+            last_pos = size;
+        }
+        ++size;
+    }
 
+    void end_subset(unsigned subset) override
+    {
+        // Remove the variables left over by a previous message
+        Subset& dest = bulletin.subsets[subset];
+        if (sizes[subset] < dest.size())
+            dest.erase(dest.begin() + sizes[subset], dest.end());
+    }
+
+    void attribute(unsigned subset, unsigned pos, const DecodedValue& val) override
+    {
+        val.set(bulletin.subsets[subset][pos].seta(val.info, bulletin.arena));
+    }
+};
+
+/**
+ * DecodeVisitor that stores the decoded values of a compressed message in
+ * Columns
+ */
+struct ColumnsBuilder : public DecodeVisitor
+{
+    Columns& columns;
+
+    /// Attribute column that received the last attribute
+    Column* attr_column = nullptr;
+
+    ColumnsBuilder(Columns& columns) : columns(columns) {}
+
+    void begin_bulletin(const BufrBulletin&, unsigned subset_count) override
+    {
+        columns.clear();
+        columns.subset_count = subset_count;
+    }
+
+    void value(unsigned subset, const DecodedValue& val) override
+    {
+        // Compressed messages send each variable for all the subsets in turn
+        if (subset == 0)
+        {
+            // Appending can move the existing columns
+            attr_column = nullptr;
+            columns.append(val.info);
+        }
+        columns.columns.back().set(subset, val);
+    }
+
+    void attribute(unsigned subset, unsigned pos, const DecodedValue& val) override
+    {
+        // Attributes are also sent for all the subsets in turn
+        if (subset == 0 || !attr_column)
+            attr_column = &columns[pos].obtain_attr(val.info);
+        attr_column->set(subset, val);
+    }
+};
+
+void Decoder::decode_data(DecodeVisitor& visitor)
+{
     /* Read BUFR section 4 (Data section) */
     TRACE("  decode_data:section 4 is %d bytes long (%02x %02x %02x %02x)\n",
             in.read_number(4, 0, 3),
@@ -576,22 +936,65 @@ void Decoder::decode_data()
             in.read_byte(4, 2),
             in.read_byte(4, 3));
 
+#ifdef WREPORT_PROFILE_INTERPRETER
+    // Let the profiler count the bits consumed by each construct
+    struct ProfileInput
+    {
+        ProfileInput(const buffers::BufrInput& in) { bulletin::Profile::set_input(&in); }
+        ~ProfileInput() { bulletin::Profile::set_input(nullptr); }
+    } profile_input(in);
+#endif
+
+    visitor.begin_bulletin(out, expected_subsets);
     if (out.compression)
     {
         // Run only once
-        CompressedBufrDecoder dec(out, in);
+        for (unsigned i = 0; i < expected_subsets; ++i)
+            visitor.begin_subset(i);
+        CompressedBufrDecoder dec(out, expected_subsets, in, visitor, decode_only);
         dec.associated_field.skip_missing = !conf_add_undef_attrs;
-        dec.run();
+        dec.run_plan();
+        for (unsigned i = 0; i < expected_subsets; ++i)
+            visitor.end_subset(i);
     } else {
         // Run once per subset
-        for (unsigned i = 0; i < out.subsets.size(); ++i)
+        for (unsigned i = 0; i < expected_subsets; ++i)
         {
-            UncompressedBufrDecoder dec(out, i, in);
+            visitor.begin_subset(i);
+            UncompressedBufrDecoder dec(out, i, in, visitor, decode_only);
             dec.associated_field.skip_missing = !conf_add_undef_attrs;
-            dec.run();
+            dec.run_plan();
+            visitor.end_subset(i);
         }
     }
+    visitor.end_bulletin();
+
+    decode_end();
+}
+
+void Decoder::decode_data()
+{
+    SubsetsBuilder builder(out);
+    decode_data(builder);
+}
+
+void Decoder::decode_data(Columns& columns)
+{
+    if (!out.compression)
+    {
+        // Decode the subsets and transpose them
+        decode_data();
+        columns.from_subsets(out.subsets);
+        out.subsets.clear();
+        return;
+    }
+
+    ColumnsBuilder builder(columns);
+    decode_data(builder);
+}
 
+void Decoder::decode_end()
+{
     IFTRACE {
         if (in.bits_left() > 32)
         {
@@ -623,48 +1026,231 @@ void Decoder::decode_data()
 }
 
 
-std::unique_ptr<BufrBulletin> BufrBulletin::decode_header(const std::string& buf, const BufrCodecOptions& opts, const char* fname, size_t offset)
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_header(const void* data, size_t size, const BufrCodecOptions& opts, const char* fname, size_t offset)
 {
     auto res = BufrBulletin::create();
     res->fname = fname;
     res->offset = offset;
-    Decoder d(buf, fname, offset, *res);
+    Decoder d(data, size, fname, offset, *res);
     d.read_options(opts);
     d.decode_header();
+    if (!opts.decode_header_skips_tables)
+        res->load_tables();
     return res;
 }
 
-std::unique_ptr<BufrBulletin> BufrBulletin::decode(const std::string& buf, const BufrCodecOptions& opts, const char* fname, size_t offset)
+std::unique_ptr<BufrBulletin> BufrBulletin::decode(const void* data, size_t size, const BufrCodecOptions& opts, const char* fname, size_t offset)
 {
     auto res = BufrBulletin::create();
     res->fname = fname;
     res->offset = offset;
-    Decoder d(buf, fname, offset, *res);
-    d.read_options(opts);
-    d.decode_header();
-    d.decode_data();
+    metrics::measure_decode(*res, size, [&]() {
+        Decoder d(data, size, fname, offset, *res);
+        d.read_options(opts);
+        d.decode_header();
+        res->load_tables();
+        d.decode_data();
+    });
     return res;
 }
 
-std::unique_ptr<BufrBulletin> BufrBulletin::decode_header(const std::string& buf, const char* fname, size_t offset)
+void BufrBulletin::decode(const void* data, size_t size, BufrBulletin& out, const BufrCodecOptions& opts, const char* fname, size_t offset)
+{
+    out.clear();
+    out.fname = fname;
+    out.offset = offset;
+    try {
+        metrics::measure_decode(out, size, [&]() {
+            Decoder d(data, size, fname, offset, out);
+            d.read_options(opts);
+            d.decode_header();
+            out.load_tables();
+            d.decode_data();
+        });
+    } catch (...) {
+        // Do not leave behind partially decoded subsets
+        out.clear();
+        throw;
+    }
+}
+
+void BufrBulletin::decode(const void* data, size_t size, BufrBulletin& out, const char* fname, size_t offset)
+{
+    out.clear();
+    out.fname = fname;
+    out.offset = offset;
+    try {
+        metrics::measure_decode(out, size, [&]() {
+            Decoder d(data, size, fname, offset, out);
+            d.decode_header();
+            out.load_tables();
+            d.decode_data();
+        });
+    } catch (...) {
+        // Do not leave behind partially decoded subsets
+        out.clear();
+        throw;
+    }
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_header(const void* data, size_t size, const char* fname, size_t offset)
 {
     auto res = BufrBulletin::create();
     res->fname = fname;
     res->offset = offset;
-    Decoder d(buf, fname, offset, *res);
+    Decoder d(data, size, fname, offset, *res);
     d.decode_header();
+    res->load_tables();
     return res;
 }
 
-std::unique_ptr<BufrBulletin> BufrBulletin::decode(const std::string& buf, const char* fname, size_t offset)
+std::unique_ptr<BufrBulletin> BufrBulletin::decode(const void* data, size_t size, const char* fname, size_t offset)
 {
     auto res = BufrBulletin::create();
     res->fname = fname;
     res->offset = offset;
-    Decoder d(buf, fname, offset, *res);
-    d.decode_header();
-    d.decode_data();
+    metrics::measure_decode(*res, size, [&]() {
+        Decoder d(data, size, fname, offset, *res);
+        d.decode_header();
+        res->load_tables();
+        d.decode_data();
+    });
+    return res;
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_columns(const void* data, size_t size, Columns& columns, const BufrCodecOptions& opts, const char* fname, size_t offset)
+{
+    auto res = BufrBulletin::create();
+    res->fname = fname;
+    res->offset = offset;
+    metrics::measure_decode(*res, size, [&]() {
+        Decoder d(data, size, fname, offset, *res);
+        d.read_options(opts);
+        d.decode_header();
+        res->load_tables();
+        d.decode_data(columns);
+    });
+    return res;
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_columns(const void* data, size_t size, Columns& columns, const char* fname, size_t offset)
+{
+    auto res = BufrBulletin::create();
+    res->fname = fname;
+    res->offset = offset;
+    metrics::measure_decode(*res, size, [&]() {
+        Decoder d(data, size, fname, offset, *res);
+        d.decode_header();
+        res->load_tables();
+        d.decode_data(columns);
+    });
+    return res;
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_visit(const void* data, size_t size, DecodeVisitor& visitor, const BufrCodecOptions& opts, const char* fname, size_t offset)
+{
+    auto res = BufrBulletin::create();
+    res->fname = fname;
+    res->offset = offset;
+    metrics::measure_decode(*res, size, [&]() {
+        Decoder d(data, size, fname, offset, *res);
+        d.read_options(opts);
+        d.decode_header();
+        res->load_tables();
+        d.decode_data(visitor);
+    });
     return res;
 }
 
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_visit(const void* data, size_t size, DecodeVisitor& visitor, const char* fname, size_t offset)
+{
+    auto res = BufrBulletin::create();
+    res->fname = fname;
+    res->offset = offset;
+    metrics::measure_decode(*res, size, [&]() {
+        Decoder d(data, size, fname, offset, *res);
+        d.decode_header();
+        res->load_tables();
+        d.decode_data(visitor);
+    });
+    return res;
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_header(const std::string& buf, const BufrCodecOptions& opts, const char* fname, size_t offset)
+{
+    return decode_header(buf.data(), buf.size(), opts, fname, offset);
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode(const std::string& buf, const BufrCodecOptions& opts, const char* fname, size_t offset)
+{
+    return decode(buf.data(), buf.size(), opts, fname, offset);
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode_header(const std::string& buf, const char* fname, size_t offset)
+{
+    return decode_header(buf.data(), buf.size(), fname, offset);
+}
+
+std::unique_ptr<BufrBulletin> BufrBulletin::decode(const std::string& buf, const char* fname, size_t offset)
+{
+    return decode(buf.data(), buf.size(), fname, offset);
+}
+
+
+BufrTableID BufrHeader::table_id() const
+{
+    return BufrTableID(originating_centre, originating_subcentre, master_table_number, master_table_version_number, master_table_version_number_local);
+}
+
+
+BufrHeaderScanner::BufrHeaderScanner(const std::string& buf, const char* fname, size_t offset)
+    : BufrHeaderScanner(buf.data(), buf.size(), fname, offset)
+{
+}
+
+BufrHeaderScanner::BufrHeaderScanner(const void* buf, size_t size, const char* fname, size_t offset)
+    : data((const uint8_t*)buf), size(size), fname(fname), offset(offset)
+{
+}
+
+bool BufrHeaderScanner::next(BufrHeader& header)
+{
+    // Look for the start of the next message
+    size_t start = scan::find_signature((const char*)data, size, pos, "BUFR", 4);
+    if (size - start < 8)
+    {
+        pos = size;
+        return false;
+    }
+    // Skip the signature, so that after a parse error the next call resumes
+    // scanning after the broken message
+    pos = start + 4;
+
+    buffers::BufrInput in(data + start, size - start);
+    in.fname = fname;
+    in.start_offset = offset + start;
+
+    // Restrict the input to the size declared in section 0
+    in.check_available_data(0, 8, "section 0 of BUFR message (indicator section)");
+    unsigned msg_size = in.read_number(4, 3);
+    if (msg_size < 12)
+        in.parse_error(4, "the size declared by the BUFR message (%u) is less than the minimum of 12", msg_size);
+    if (msg_size > in.data_len)
+        in.parse_error(4, "the size declared by the BUFR message (%u) goes past the end of the buffer", msg_size);
+    in.data_len = msg_size;
+
+    if (memcmp(in.data + msg_size - 4, "7777", 4) != 0)
+        in.parse_error(msg_size - 4, "section 5 does not contain '7777'");
+
+    decode_lead_sections(in, header);
+    in.check_available_data(3, 0, 8, "section 3 of BUFR message (data description section)");
+    header.subset_count = in.read_number(3, 4, 2);
+    header.compression = (in.read_byte(3, 6) & 0x40) ? 1 : 0;
+    header.offset = offset + start;
+    header.size = msg_size;
+
+    pos = start + msg_size;
+    return true;
+}
+
 }
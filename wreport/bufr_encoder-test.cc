@@ -1,4 +1,5 @@
 #include "tests.h"
+#include "notes.h"
 #include <cstring>
 
 using namespace wreport;
@@ -173,6 +174,86 @@ class Tests : public TestCase
             test_info() << "reencoded";
             wassert(test(msg1));
         });
+        add_method("encode_compressed", []() {
+            // Compress a message that was originally uncompressed
+            string raw = slurpfile("bufr/C08032-toolong.bufr");
+            auto orig = BufrBulletin::decode(raw);
+            wassert(actual(orig->compression).isfalse());
+            wassert(actual(orig->subsets.size()) == 7u);
+
+            string uncompressed = wcallchecked(orig->encode());
+            orig->compression = true;
+            string compressed = wcallchecked(orig->encode());
+            wassert(actual(compressed.size()) < uncompressed.size());
+
+            // Compressed data decodes to the same values
+            auto msg = BufrBulletin::decode(compressed);
+            wassert(actual(msg->compression).istrue());
+            notes::Collect c(cerr);
+            wassert(actual(orig->diff(*msg)) == 0u);
+        });
+        add_method("encode_compressed_reencode", []() {
+            // Compressed messages are encoded again with compression
+            string raw = slurpfile("bufr/ed4.bufr");
+            auto orig = BufrBulletin::decode(raw);
+            wassert(actual(orig->compression).istrue());
+            wassert(actual(orig->subsets.size()) == 128u);
+
+            // The first message in the file is 742 bytes long
+            string encoded = wcallchecked(orig->encode());
+            wassert(actual(encoded.size()) == 742u);
+
+            auto msg = BufrBulletin::decode(encoded);
+            wassert(actual(msg->compression).istrue());
+            notes::Collect c(cerr);
+            wassert(actual(orig->diff(*msg)) == 0u);
+        });
+        add_method("encode_compressed_fallback", []() {
+            // Subsets with a different structure cannot be compressed, and
+            // are encoded uncompressed
+            string raw = slurpfile("bufr/C08022.bufr");
+            auto orig = BufrBulletin::decode(raw);
+            orig->compression = true;
+            string encoded = wcallchecked(orig->encode());
+
+            auto msg = BufrBulletin::decode(encoded);
+            wassert(actual(msg->compression).isfalse());
+            msg->compression = true;
+            notes::Collect c(cerr);
+            wassert(actual(orig->diff(*msg)) == 0u);
+        });
+        add_method("encode_compressed_unsupported", []() {
+            // Contents that cannot be compressed are encoded uncompressed
+            auto check_fallback = [](BufrBulletin& orig) {
+                orig.compression = true;
+                string encoded = wcallchecked(orig.encode());
+                auto msg = BufrBulletin::decode(encoded);
+                wassert(actual(msg->compression).isfalse());
+                msg->compression = true;
+                notes::Collect c(cerr);
+                wassert(actual(orig.diff(*msg)) == 0u);
+            };
+
+            // C05 character data
+            auto orig = BufrBulletin::decode(slurpfile("bufr/C05060.bufr"));
+            orig->subsets.push_back(orig->subsets[0]);
+            wassert(check_fallback(*orig));
+
+            // Associated field significance that differs across subsets
+            orig = BufrBulletin::decode(slurpfile("bufr/C04-B31021-1.bufr"));
+            orig->subsets.push_back(orig->subsets[0]);
+            for (auto& var: orig->subsets[1])
+                if (var.code() == WR_VAR(0, 31, 21))
+                {
+                    var.seti(var.enqi() == 1 ? 2 : 1);
+                    break;
+                }
+            orig->compression = true;
+            string encoded = wcallchecked(orig->encode());
+            auto msg = BufrBulletin::decode(encoded);
+            wassert(actual(msg->compression).isfalse());
+            wassert(actual(msg->subsets.size()) == 2u);
+        });
         add_method("var_ranges", []() {
             // Test variable ranges during encoding
             unique_ptr<BufrBulletin> pmsg(BufrBulletin::create());
@@ -1,6 +1,7 @@
 #include "bulletin.h"
 #include "bulletin/internals.h"
 #include "buffers/bufr.h"
+#include "internals/metrics.h"
 #include <netinet/in.h>
 #include <cstring>
 #include "config.h"
@@ -97,6 +98,135 @@ struct DDSEncoder : public bulletin::UncompressedEncoder
     }
 };
 
+struct CompressedBufrEncoder : public bulletin::CompressedEncoder
+{
+    buffers::BufrOutput& ob;
+    /// Number of subsets to encode
+    unsigned subset_count;
+    /// Variables with the current value in all subsets
+    std::vector<const Var*> vars;
+    /// Associated field values in all subsets
+    std::vector<uint32_t> af_values;
+
+    CompressedBufrEncoder(const Bulletin& b, buffers::BufrOutput& ob)
+        : CompressedEncoder(b), ob(ob), subset_count(b.subsets.size())
+    {
+        vars.reserve(subset_count);
+        af_values.reserve(subset_count);
+    }
+    virtual ~CompressedBufrEncoder() {}
+
+    /// Fill vars with the variables at position pos in all subsets
+    void collect_vars(unsigned pos)
+    {
+        vars.clear();
+        for (unsigned i = 0; i < subset_count; ++i)
+            vars.push_back(&get_var(i, pos));
+    }
+
+    /// Fill vars with the \a code attributes of the variables at position pos in all subsets
+    void collect_attrs(unsigned pos, Varcode code)
+    {
+        vars.clear();
+        for (unsigned i = 0; i < subset_count; ++i)
+            vars.push_back(get_var(i, pos).enqa(code));
+    }
+
+    /**
+     * Encode a value that must be the same in all subsets, like a
+     * replication count.
+     *
+     * @returns the variable with the value in the first subset
+     */
+    const Var& encode_semantic_var(Varinfo info)
+    {
+        collect_vars(current_var++);
+        for (unsigned i = 1; i < subset_count; ++i)
+            if (*vars[i] != *vars[0])
+                error_consistency::throwf("cannot encode %01d%02d%03d in a compressed BUFR message: it is a semantic value (like a repetition count) that differs across subsets",
+                        WR_VAR_FXY(info->code));
+        ob.append_compressed_var(info, vars);
+        return *vars[0];
+    }
+
+    void define_variable(Varinfo info) override
+    {
+        collect_vars(current_var++);
+
+        if (associated_field.bit_count)
+        {
+            uint32_t missing = buffers::all_ones(associated_field.bit_count);
+            af_values.clear();
+            for (auto var: vars)
+            {
+                const Var* att = associated_field.get_attribute(*var);
+                af_values.push_back(att && att->isset() ? att->enqi() : missing);
+            }
+            ob.append_compressed_var(info, vars, associated_field.bit_count, af_values);
+        } else
+            ob.append_compressed_var(info, vars);
+    }
+
+    void define_substituted_value(unsigned pos) override
+    {
+        // Use the details of the corrisponding variable for encoding
+        Varinfo info = get_var(0, pos).info();
+        collect_attrs(pos, info->code);
+        ob.append_compressed_var(info, vars);
+    }
+
+    void define_attribute(Varinfo info, unsigned pos) override
+    {
+        collect_attrs(pos, info->code);
+        ob.append_compressed_var(info, vars);
+    }
+
+    unsigned define_delayed_replication_factor(Varinfo info) override
+    {
+        return encode_semantic_var(info).enqi();
+    }
+
+    unsigned define_associated_field_significance(Varinfo info) override
+    {
+        return encode_semantic_var(info).enq(63);
+    }
+
+    unsigned define_bitmap_delayed_replication_factor(Varinfo info) override
+    {
+        const Var& var = get_var(0, current_var);
+        Var rep_var(info, (int)var.info()->len);
+        vars.assign(subset_count, &rep_var);
+        ob.append_compressed_var(info, vars);
+        return var.info()->len;
+    }
+
+    void define_bitmap(unsigned bitmap_size) override
+    {
+        const Var& var = get_var(0, current_var);
+        if (WR_VAR_F(var.code()) != 2)
+            error_consistency::throwf("variable at %u is %01d%02d%03d and not a data present bitmap",
+                    current_var, WR_VAR_FXY(var.code()));
+
+        if (var.info()->len != bitmap_size)
+            error_consistency::throwf("bitmap given is %u bits long, but we need to encode %u bits",
+                    var.info()->len, bitmap_size);
+
+        for (unsigned i = 1; i < subset_count; ++i)
+            if (strcmp(get_var(i, current_var).enqc(), var.enqc()) != 0)
+                error_consistency::throwf("cannot encode a compressed BUFR message with a data present bitmap that differs across subsets");
+
+        ob.append_compressed_bitmap(var.enqc(), bitmap_size);
+
+        ++current_var;
+        bitmaps.define(var, bulletin.subset(0), current_var);
+    }
+
+    void define_raw_character_data(Varcode code) override
+    {
+        error_unimplemented::throwf("cannot encode C05%03d character data in a compressed BUFR message", WR_VAR_Y(code));
+    }
+};
+
 
 struct Encoder
 {
@@ -113,18 +243,40 @@ struct Encoder
      */
     unsigned sec[6] = { 0, 0, 0, 0, 0, 0 };
 
-    Encoder(const BufrBulletin& in, buffers::BufrOutput& out)
-        : in(in), out(out)
+    /// True if the data section is encoded with compression
+    bool compressed;
+
+    Encoder(const BufrBulletin& in, buffers::BufrOutput& out, bool compressed)
+        : in(in), out(out), compressed(compressed)
     {
     }
 
+    /**
+     * Check if all the subsets of \a in have the same sequence of variables,
+     * which is needed to encode them with compression
+     */
+    static bool can_compress(const BufrBulletin& in)
+    {
+        if (in.subsets.empty()) return false;
+        const Subset& first = in.subsets[0];
+        for (unsigned i = 1; i < in.subsets.size(); ++i)
+        {
+            const Subset& s = in.subsets[i];
+            if (s.size() != first.size()) return false;
+            for (unsigned j = 0; j < s.size(); ++j)
+                if (s[j].code() != first[j].code())
+                    return false;
+        }
+        return true;
+    }
+
     void encode_sec0()
     {
         // Encode bufr section 0 (Indicator section)
         out.raw_append("BUFR\0\0\0", 7);
         out.append_byte(in.edition_number);
 
-        TRACE("sec0 ends at %zd\n", out.out.size());
+        TRACE("sec0 ends at %zd\n", out.offset());
     }
     void encode_sec1ed3();
     void encode_sec1ed4();
@@ -133,7 +285,7 @@ struct Encoder
     void encode_sec4();
     void encode_sec5()
     {
-        sec[5] = out.out.size();
+        sec[5] = out.offset();
 
         // Encode section 5 (End section)
         out.raw_append("7777", 4);
@@ -145,7 +297,7 @@ struct Encoder
 void Encoder::encode_sec1ed3()
 {
     // Encode bufr section 1 (Identification section)
-    sec[1] = out.out.size();
+    sec[1] = out.offset();
 
     // Length of section
     out.add_bits(18, 24);
@@ -183,13 +335,13 @@ void Encoder::encode_sec1ed3()
     // Century
     out.append_byte(in.rep_year / 100);
 
-    TRACE("sec1 ends at %zd\n", out.out.size());
+    TRACE("sec1 ends at %zd\n", out.offset());
 }
 
 void Encoder::encode_sec1ed4()
 {
     // Encode bufr section 1 (Identification section)
-    sec[1] = out.out.size();
+    sec[1] = out.offset();
 
     // Length of section
     out.add_bits(22, 24);
@@ -229,13 +381,13 @@ void Encoder::encode_sec1ed4()
     // Second
     out.append_byte(in.rep_second);
 
-    TRACE("sec1 ends at %zd\n", out.out.size());
+    TRACE("sec1 ends at %zd\n", out.offset());
 }
 
 void Encoder::encode_sec2()
 {
     // Encode BUFR section 2 (Optional section)
-    sec[2] = out.out.size();
+    sec[2] = out.offset();
 
     if (!in.optional_section.empty())
     {
@@ -257,13 +409,13 @@ void Encoder::encode_sec2()
         if (pad) out.append_byte(0);
     }
 
-    TRACE("sec2 ends at %zd\n", out.out.size());
+    TRACE("sec2 ends at %zd\n", out.offset());
 }
 
 void Encoder::encode_sec3()
 {
     // Encode BUFR section 3 (Data description section)
-    sec[3] = out.out.size();
+    sec[3] = out.offset();
 
 	if (in.subsets.empty())
 		throw error_consistency("message to encode has no data subsets");
@@ -278,7 +430,7 @@ void Encoder::encode_sec3()
     // Number of data subsets
     out.append_short(in.subsets.size());
     // Bit 0 = observed data; bit 1 = use compression
-    out.append_byte(128);
+    out.append_byte(compressed ? 128 | 64 : 128);
 
     // Data descriptors
     for (unsigned i = 0; i < in.datadesc.size(); ++i)
@@ -287,24 +439,31 @@ void Encoder::encode_sec3()
     // One padding byte to make the section even
     out.append_byte(0);
 
-    TRACE("sec3 ends at %zd\n", out.out.size());
+    TRACE("sec3 ends at %zd\n", out.offset());
 }
 
 void Encoder::encode_sec4()
 {
     // Encode BUFR section 4 (Data section)
-    sec[4] = out.out.size();
+    sec[4] = out.offset();
 
     // Length of section (currently set to 0, will be filled in later)
     out.add_bits(0, 24);
     out.append_byte(0);
 
-    // Encode all the subsets
-    for (unsigned i = 0; i < in.subsets.size(); ++i)
+    if (compressed)
     {
-        // Encode the data of this subset
-        DDSEncoder e(in, i, out);
-        e.run();
+        // Encode all the subsets at the same time
+        CompressedBufrEncoder e(in, out);
+        e.run_plan();
+    } else {
+        // Encode all the subsets
+        for (unsigned i = 0; i < in.subsets.size(); ++i)
+        {
+            // Encode the data of this subset
+            DDSEncoder e(in, i, out);
+            e.run_plan();
+        }
     }
 
     // Write all the bits and pad the data section to reach an even length
@@ -324,25 +483,24 @@ void Encoder::encode_sec4()
     TRACE("sec4 ends at %zd\n", out.out.size());
 }
 
-}
-
-string BufrBulletin::encode() const
+/// Encode \a in into \a buf, with or without compression
+void encode_bufr(const BufrBulletin& in, std::string& buf, bool compressed)
 {
-    std::string buf;
+    buf.clear();
     buf.reserve(1024);
     buffers::BufrOutput out(buf);
 
-    Encoder e(*this, out);
+    Encoder e(in, out, compressed);
 
     e.encode_sec0();
 
-    switch (edition_number)
+    switch (in.edition_number)
     {
         case 2:
         case 3: e.encode_sec1ed3(); break;
         case 4: e.encode_sec1ed4(); break;
         default:
-            error_unimplemented::throwf("Encoding BUFR edition %d is not implemented", edition_number);
+            error_unimplemented::throwf("Encoding BUFR edition %d is not implemented", in.edition_number);
     }
 
     e.encode_sec2();
@@ -365,7 +523,33 @@ string BufrBulletin::encode() const
         section_end[i] = e.sec[i + 1];
     section_end[5] = section_end[4] + 4;
 #endif
+}
+
+}
+
+string BufrBulletin::encode() const
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string buf;
+
+    if (compression && Encoder::can_compress(*this))
+    {
+        // Some contents cannot be compressed, like C05 character data or
+        // bitmaps that differ across subsets, and are only found while
+        // encoding: in that case, encode again without compression
+        try {
+            encode_bufr(*this, buf, true);
+        } catch (error_consistency& e) {
+            TRACE("cannot encode with compression: %s\n", e.what());
+            encode_bufr(*this, buf, false);
+        } catch (error_unimplemented& e) {
+            TRACE("cannot encode with compression: %s\n", e.what());
+            encode_bufr(*this, buf, false);
+        }
+    } else
+        encode_bufr(*this, buf, false);
 
+    metrics::encoded(*this, buf.size(), metrics::elapsed_ns(start));
     return buf;
 }
 
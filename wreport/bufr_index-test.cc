@@ -0,0 +1,122 @@
+#include "tests.h"
+#include "bufr_index.h"
+#include "utils/sys.h"
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("read_write", []() {
+            string archive = tests::slurpfile("bufr/obs0-1.22.bufr");
+            archive += "junk";
+            archive += tests::slurpfile("bufr/synop-evapo.bufr");
+            sys::write_file("archive.bufr", archive);
+
+            BufrIndex index;
+            wassert(actual(index.read("archive.bufr.idx")).isfalse());
+            wassert(actual(index.scan("archive.bufr")) == 2u);
+            index.write("archive.bufr.idx");
+
+            BufrIndex index1;
+            wassert(actual(index1.read("archive.bufr.idx")).istrue());
+            wassert(actual(index1.entries.size()) == 2u);
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                const BufrHeader& a = index.entries[i];
+                const BufrHeader& b = index1.entries[i];
+                wassert(actual(b.offset) == a.offset);
+                wassert(actual(b.size) == a.size);
+                wassert(actual(b.edition_number) == a.edition_number);
+                wassert(actual(b.originating_centre) == a.originating_centre);
+                wassert(actual(b.originating_subcentre) == a.originating_subcentre);
+                wassert(actual(b.data_category) == a.data_category);
+                wassert(actual(b.data_subcategory) == a.data_subcategory);
+                wassert(actual(b.data_subcategory_local) == a.data_subcategory_local);
+                wassert(actual(b.rep_year) == a.rep_year);
+                wassert(actual(b.rep_month) == a.rep_month);
+                wassert(actual(b.rep_day) == a.rep_day);
+                wassert(actual(b.rep_hour) == a.rep_hour);
+                wassert(actual(b.rep_minute) == a.rep_minute);
+                wassert(actual(b.rep_second) == a.rep_second);
+                wassert(actual(b.subset_count) == a.subset_count);
+                wassert(actual(b.compression) == a.compression);
+            }
+
+            // Messages can be read directly from their index entry
+            FILE* in = fopen("archive.bufr", "rb");
+            string buf;
+            BufrIndex::read_message(in, index1.entries[1], buf, "archive.bufr");
+            fclose(in);
+            wassert(actual(buf) == tests::slurpfile("bufr/synop-evapo.bufr"));
+        });
+
+        add_method("update", []() {
+            string msg1 = tests::slurpfile("bufr/obs0-1.22.bufr");
+            string msg2 = tests::slurpfile("bufr/synop-evapo.bufr");
+
+            // Index an archive whose last message is still being written
+            sys::write_file("archive.bufr", msg1 + msg2.substr(0, 20));
+            BufrIndex index;
+            wassert(actual(index.update("archive.bufr.idx", "archive.bufr")) == 1u);
+
+            // Complete the archive, and append more data
+            sys::write_file("archive.bufr", msg1 + msg2 + msg1);
+            wassert(actual(index.update("archive.bufr.idx", "archive.bufr")) == 2u);
+            wassert(actual(index.update("archive.bufr.idx", "archive.bufr")) == 0u);
+            wassert(actual(sys::read_file("archive.bufr.idx").size()) == 8u + 3 * 36);
+
+            BufrIndex index1;
+            wassert(actual(index1.read("archive.bufr.idx")).istrue());
+            wassert(actual(index1.entries.size()) == 3u);
+            wassert(actual(index1.entries[1].offset) == (off_t)msg1.size());
+            wassert(actual(index1.entries[1].rep_year) == BufrBulletin::decode_header(msg2)->rep_year);
+            wassert(actual(index1.entries[2].offset) == (off_t)(msg1.size() + msg2.size()));
+
+            // A shorter archive is indexed again from scratch
+            sys::write_file("archive.bufr", msg2);
+            wassert(actual(index.update("archive.bufr.idx", "archive.bufr")) == 1u);
+            wassert(actual(index1.read("archive.bufr.idx")).istrue());
+            wassert(actual(index1.entries.size()) == 1u);
+            wassert(actual(index1.entries[0].offset) == 0);
+        });
+
+        add_method("bogus_length", []() {
+            // A signature whose declared length goes past the end of the
+            // archive does not stop indexing the messages after it
+            string msg1 = tests::slurpfile("bufr/obs0-1.22.bufr");
+            string msg2 = tests::slurpfile("bufr/synop-evapo.bufr");
+            string bogus("BUFR\xff\xff\xff\x04", 8);
+
+            sys::write_file("bogus.bufr", msg1 + bogus + msg2);
+            BufrIndex index;
+            wassert(actual(index.update("bogus.bufr.idx", "bogus.bufr")) == 2u);
+            wassert(actual(index.entries[1].offset) == (off_t)(msg1.size() + bogus.size()));
+
+            sys::write_file("bogus.bufr", msg1 + bogus + msg2 + msg1);
+            wassert(actual(index.update("bogus.bufr.idx", "bogus.bufr")) == 1u);
+            wassert(actual(index.entries.size()) == 3u);
+            wassert(actual(index.entries[2].offset) == (off_t)(msg1.size() + bogus.size() + msg2.size()));
+        });
+
+        add_method("corrupted", []() {
+            sys::write_file("archive.bufr.idx", "not an index");
+            BufrIndex index;
+            try {
+                index.read("archive.bufr.idx");
+                throw TestFailed("reading a corrupted index should fail");
+            } catch (error_consistency& e) {
+                wassert(actual(e.what()).contains("not a wreport BUFR index file"));
+            }
+        });
+    }
+} test("bufr_index");
+
+}
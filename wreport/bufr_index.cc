@@ -0,0 +1,265 @@
+#include "bufr_index.h"
+#include "error.h"
+#include "utils/sys.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace wreport {
+
+namespace {
+
+/// Signature at the start of index files, including the format version
+const char index_signature[8] = { 'W', 'R', 'B', 'U', 'F', 'R', 'I', 1 };
+
+/// Size of an index record
+const size_t record_size = 36;
+
+/*
+ * Records are encoded in little endian byte order, as:
+ *
+ *  0  offset (8 bytes)
+ *  8  size (4 bytes)
+ * 12  edition_number
+ * 13  master_table_number
+ * 14  master_table_version_number
+ * 15  master_table_version_number_local
+ * 16  data_category
+ * 17  data_subcategory
+ * 18  data_subcategory_local
+ * 19  update_sequence_number
+ * 20  originating_centre (2 bytes)
+ * 22  originating_subcentre (2 bytes)
+ * 24  rep_year (2 bytes)
+ * 26  rep_month, rep_day, rep_hour, rep_minute, rep_second
+ * 31  compression
+ * 32  subset_count (2 bytes)
+ * 34  unused (2 bytes)
+ */
+
+void encode_number(uint8_t* out, uint64_t val, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i)
+    {
+        out[i] = val & 0xff;
+        val >>= 8;
+    }
+}
+
+uint64_t decode_number(const uint8_t* in, unsigned size)
+{
+    uint64_t res = 0;
+    for (unsigned i = size; i > 0; --i)
+        res = (res << 8) | in[i - 1];
+    return res;
+}
+
+void encode_record(const BufrHeader& h, uint8_t* out)
+{
+    encode_number(out, h.offset, 8);
+    encode_number(out + 8, h.size, 4);
+    out[12] = h.edition_number;
+    out[13] = h.master_table_number;
+    out[14] = h.master_table_version_number;
+    out[15] = h.master_table_version_number_local;
+    out[16] = h.data_category;
+    out[17] = h.data_subcategory;
+    out[18] = h.data_subcategory_local;
+    out[19] = h.update_sequence_number;
+    encode_number(out + 20, h.originating_centre, 2);
+    encode_number(out + 22, h.originating_subcentre, 2);
+    encode_number(out + 24, h.rep_year, 2);
+    out[26] = h.rep_month;
+    out[27] = h.rep_day;
+    out[28] = h.rep_hour;
+    out[29] = h.rep_minute;
+    out[30] = h.rep_second;
+    out[31] = h.compression ? 1 : 0;
+    encode_number(out + 32, h.subset_count, 2);
+    encode_number(out + 34, 0, 2);
+}
+
+void decode_record(const uint8_t* in, BufrHeader& h)
+{
+    h.offset = decode_number(in, 8);
+    h.size = decode_number(in + 8, 4);
+    h.edition_number = in[12];
+    h.master_table_number = in[13];
+    h.master_table_version_number = in[14];
+    h.master_table_version_number_local = in[15];
+    h.data_category = in[16];
+    h.data_subcategory = in[17];
+    h.data_subcategory_local = in[18];
+    h.update_sequence_number = in[19];
+    h.originating_centre = decode_number(in + 20, 2);
+    h.originating_subcentre = decode_number(in + 22, 2);
+    h.rep_year = decode_number(in + 24, 2);
+    h.rep_month = in[26];
+    h.rep_day = in[27];
+    h.rep_hour = in[28];
+    h.rep_minute = in[29];
+    h.rep_second = in[30];
+    h.compression = in[31] != 0;
+    h.subset_count = decode_number(in + 32, 2);
+}
+
+void encode_records(vector<BufrHeader>::const_iterator begin, vector<BufrHeader>::const_iterator end, string& out)
+{
+    size_t pos = out.size();
+    out.resize(pos + (end - begin) * record_size);
+    for ( ; begin != end; ++begin, pos += record_size)
+        encode_record(*begin, (uint8_t*)&out[pos]);
+}
+
+/// Return the offset just past the end of the last indexed message
+size_t indexed_end(const vector<BufrHeader>& entries)
+{
+    if (entries.empty()) return 0;
+    return entries.back().offset + entries.back().size;
+}
+
+}
+
+bool BufrIndex::read(const std::string& pathname)
+{
+    entries.clear();
+
+    sys::File in(pathname);
+    if (!in.open_ifexists(O_RDONLY))
+        return false;
+
+    struct stat st;
+    in.fstat(st);
+    string buf(st.st_size, 0);
+    in.read_all_or_throw(&buf[0], buf.size());
+
+    if (buf.size() < sizeof(index_signature) || memcmp(buf.data(), index_signature, sizeof(index_signature)) != 0)
+        error_consistency::throwf("%s: not a wreport BUFR index file", pathname.c_str());
+
+    size_t count = (buf.size() - sizeof(index_signature)) / record_size;
+    entries.resize(count);
+    const uint8_t* rec = (const uint8_t*)buf.data() + sizeof(index_signature);
+    for (size_t i = 0; i < count; ++i, rec += record_size)
+        decode_record(rec, entries[i]);
+    return true;
+}
+
+void BufrIndex::write(const std::string& pathname) const
+{
+    string buf(index_signature, sizeof(index_signature));
+    encode_records(entries.begin(), entries.end(), buf);
+    sys::write_file_atomically(pathname, buf, 0666);
+}
+
+size_t BufrIndex::scan(const std::string& pathname)
+{
+    size_t resume = indexed_end(entries);
+
+    sys::File in(pathname, O_RDONLY);
+    struct stat st;
+    in.fstat(st);
+    size_t size = st.st_size;
+    if (size <= resume)
+        return 0;
+
+    // Map only the part of the archive that has not been indexed yet
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t map_start = resume / page_size * page_size;
+    sys::MMap map = in.mmap(size - map_start, PROT_READ, MAP_SHARED, map_start);
+    const uint8_t* data = map;
+
+    BufrHeaderScanner scanner(data + resume - map_start, size - resume, pathname.c_str(), resume);
+    BufrHeader header;
+    size_t added = 0;
+    while (true)
+    {
+        try {
+            if (!scanner.next(header))
+                break;
+        } catch (error_parse&) {
+            // Skip the signature and keep scanning. A message that is still
+            // being written at the end of the archive is not indexed, and
+            // the next scan starts again after the last indexed message
+            continue;
+        }
+        entries.push_back(header);
+        ++added;
+    }
+    return added;
+}
+
+size_t BufrIndex::update(const std::string& index_pathname, const std::string& archive_pathname)
+{
+    bool exists = read(index_pathname);
+    size_t count = entries.size();
+
+    // If the archive was truncated or replaced, rebuild the index
+    struct stat st;
+    sys::stat(archive_pathname, st);
+    if (indexed_end(entries) > (size_t)st.st_size)
+    {
+        entries.clear();
+        exists = false;
+    }
+
+    size_t added = scan(archive_pathname);
+    if (!exists)
+    {
+        write(index_pathname);
+        return added;
+    }
+    if (!added)
+        return 0;
+
+    // Append the new records, discarding any incomplete record left by an
+    // interrupted update
+    string buf;
+    encode_records(entries.begin() + count, entries.end(), buf);
+    sys::File out(index_pathname, O_WRONLY);
+    out.ftruncate(sizeof(index_signature) + count * record_size);
+    out.lseek(0, SEEK_END);
+    out.write_all_or_throw(buf);
+    return added;
+}
+
+void BufrIndex::read_message(FILE* in, const BufrHeader& entry, std::string& buf, const char* fname)
+{
+    if (fseeko(in, entry.offset, SEEK_SET) != 0)
+    {
+        if (fname)
+            error_system::throwf("cannot seek to offset %lld in %s", (long long)entry.offset, fname);
+        else
+            error_system::throwf("cannot seek to offset %lld", (long long)entry.offset);
+    }
+
+    buf.resize(entry.size);
+    if (fread(&buf[0], entry.size, 1, in) != 1)
+    {
+        if (ferror(in))
+        {
+            if (fname)
+                error_system::throwf("cannot read %zd bytes at offset %lld in %s", entry.size, (long long)entry.offset, fname);
+            else
+                error_system::throwf("cannot read %zd bytes at offset %lld", entry.size, (long long)entry.offset);
+        } else {
+            if (fname)
+                error_consistency::throwf("%s: end of file reached reading %zd bytes at offset %lld: the index may be out of date", fname, entry.size, (long long)entry.offset);
+            else
+                error_consistency::throwf("end of file reached reading %zd bytes at offset %lld: the index may be out of date", entry.size, (long long)entry.offset);
+        }
+    }
+
+    if (memcmp(buf.data(), "BUFR", 4) != 0)
+    {
+        if (fname)
+            error_consistency::throwf("%s: no BUFR message found at offset %lld: the index may be out of date", fname, (long long)entry.offset);
+        else
+            error_consistency::throwf("no BUFR message found at offset %lld: the index may be out of date", (long long)entry.offset);
+    }
+}
+
+}
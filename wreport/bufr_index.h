@@ -0,0 +1,86 @@
+#ifndef WREPORT_BUFR_INDEX_H
+#define WREPORT_BUFR_INDEX_H
+
+#include <wreport/bulletin.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+namespace wreport {
+
+/**
+ * Index of the BUFR messages in an archive file.
+ *
+ * The index holds the BufrHeader of each message in the archive, and can be
+ * stored in a sidecar file, so that messages can be selected by their header
+ * information and read directly, without scanning the archive again.
+ *
+ * The sidecar file contains a signature followed by one fixed size binary
+ * record per message, in the order they appear in the archive. When the
+ * archive grows, the index is updated by scanning only the data after the
+ * last indexed message, and appending the new records to the sidecar file.
+ */
+struct BufrIndex
+{
+    /// Headers of the indexed messages, in archive order
+    std::vector<BufrHeader> entries;
+
+    /**
+     * Read the index from the sidecar file \a pathname, replacing the current
+     * entries.
+     *
+     * An incomplete record at the end of the file, as left by an interrupted
+     * update, is ignored.
+     *
+     * @returns false if the file does not exist
+     */
+    bool read(const std::string& pathname);
+
+    /**
+     * Write the index to the sidecar file \a pathname, replacing its
+     * contents
+     */
+    void write(const std::string& pathname) const;
+
+    /**
+     * Add to the index all the messages found in the archive \a pathname
+     * after the last message already indexed.
+     *
+     * Messages whose header cannot be parsed are skipped. A message that
+     * extends past the end of the archive stops the scan, as it may still be
+     * being written, and it will be indexed by a later scan.
+     *
+     * @returns the number of entries added
+     */
+    size_t scan(const std::string& pathname);
+
+    /**
+     * Bring the sidecar file \a index_pathname up to date with the archive
+     * \a archive_pathname, creating it if it does not exist.
+     *
+     * The existing index is read, the archive is scanned for new messages,
+     * and their records are appended to the sidecar file. If the archive is
+     * now shorter than the indexed data, the index is rebuilt from scratch.
+     *
+     * @returns the number of entries added
+     */
+    size_t update(const std::string& index_pathname, const std::string& archive_pathname);
+
+    /**
+     * Read the message described by \a entry from the archive \a in
+     *
+     * @param in
+     *   The archive to read from
+     * @param entry
+     *   The index entry of the message to read
+     * @param buf
+     *   The buffer where the message will be written
+     * @param fname
+     *   File name to use in error messages
+     */
+    static void read_message(FILE* in, const BufrHeader& entry, std::string& buf, const char* fname=0);
+};
+
+}
+
+#endif
@@ -1,6 +1,13 @@
 #include "benchmark.h"
 #include "bulletin.h"
+#include "columns.h"
+#include "visitor.h"
+#include "buffers/bufr.h"
+#include "bulletin/plan.h"
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include <cstdlib>
 #include <cassert>
 
@@ -37,10 +44,12 @@ struct TestData
 
     void decode_header(const std::string& buf)
     {
+        delete head_bulletin;
         head_bulletin = Bltn::decode_header(buf).release();
     }
     void decode(const std::string& buf)
     {
+        delete data_bulletin;
         data_bulletin = Bltn::decode(buf).release();
     }
 };
@@ -72,11 +81,27 @@ void load(const char* msgdir, vector<TestData<Bltn>>& out, vector<string> fnames
     }
 }
 
+/// Total size of the encoded messages in data
+template<typename Bltn>
+size_t total_size(const vector<TestData<Bltn>>& data)
+{
+    size_t res = 0;
+    for (const auto& d: data)
+        res += d.data.size();
+    return res;
+}
+
 struct BulletinBenchmark : Benchmark
 {
     vector<TestData<BufrBulletin>> bufr_data;
     vector<TestData<CrexBulletin>> crex_data;
+    // All BUFR test data concatenated in a single buffer
+    string bufr_concat;
     Task decode_bufr_head;
+    Task decode_bufr_head_notables;
+    Task scan_bufr_head;
+    Task read_bufr_stream;
+    Task compile_bufr_plans;
     Task decode_bufr;
     Task decode_crex_head;
     Task decode_crex;
@@ -85,7 +110,10 @@ struct BulletinBenchmark : Benchmark
 
     BulletinBenchmark(const std::string& name)
         : Benchmark(name),
-          decode_bufr_head(this, "decode_bufr_head"), decode_bufr(this, "decode_bufr"),
+          decode_bufr_head(this, "decode_bufr_head"), decode_bufr_head_notables(this, "decode_bufr_head_notables"),
+          scan_bufr_head(this, "scan_bufr_head"), read_bufr_stream(this, "read_bufr_stream"),
+          compile_bufr_plans(this, "compile_bufr_plans"),
+          decode_bufr(this, "decode_bufr"),
           decode_crex_head(this, "decode_crex_head"), decode_crex(this, "decode_crex"),
           encode_bufr(this, "encode_bufr"), encode_crex(this, "encode_crex")
     {
@@ -97,7 +125,17 @@ struct BulletinBenchmark : Benchmark
     {
         Benchmark::setup_main();
         load<BufrBulletin>("bufr", bufr_data, { "airep-old-4-142.bufr", "A_ISMN02LFPW080000RRA_C_RJTD_20140808000319_100.bufr", "ascat1.bufr", "atms1.bufr", "atms2.bufr", "bufr1", "bufr2", "bufr3", "C04004.bufr", "C04-B31021-1.bufr", "C04type21.bufr", "C05060.bufr", "C06006.bufr", "C08022.bufr", "C08032-toolong.bufr", "C23000-1.bufr", "C23000.bufr", "ed4-compr-string.bufr", "ed4date.bufr", "ed4-empty.bufr", "ed4-parseerror1.bufr", "gps_zenith.bufr", "gts-buoy1.bufr", "gts-synop-rad1.bufr", "gts-synop-rad2.bufr", "gts-synop-tchange.bufr", "new-003.bufr", "noassoc.bufr", "obs0-1.11188.bufr", "obs0-1.22.bufr", "obs0-3.504.bufr", "obs1-11.16.bufr", "obs1-13.36.bufr", "obs1-140.454.bufr", "obs1-19.3.bufr", "obs1-9.2.bufr", "obs2-101.16.bufr", "obs2-102.1.bufr", "obs2-91.2.bufr", "obs4-142.1.bufr", "obs4-144.4.bufr", "obs4-145.4.bufr", "synop-cloudbelow.bufr", "synop-evapo.bufr", "synop-groundtemp.bufr", "synop-longname.bufr", "synop-oddgust.bufr", "synop-oddprec.bufr", "synop-old-buoy.bufr", "synop-radinfo.bufr", "synop-strayvs.bufr", "synop-sunshine.bufr", "synop-tchange.bufr", "synotemp.bufr", "table17.bufr", "temp-gts1.bufr", "temp-gts2.bufr", "temp-gts3.bufr", "test-airep1.bufr", "test-buoy1.bufr", "test-soil1.bufr", "test-temp1.bufr" });
+        for (const auto& d: bufr_data)
+            bufr_concat += d.data;
         load<CrexBulletin>("crex", crex_data, { "test-mare0.crex", "test-mare1.crex", "test-mare2.crex", "test-synop0.crex", "test-synop1.crex", "test-synop2.crex", "test-synop3.crex", "test-temp0.crex" });
+
+        size_t bufr_size = total_size(bufr_data);
+        size_t crex_size = total_size(crex_data);
+        for (Task* t: { &decode_bufr_head, &decode_bufr_head_notables, &scan_bufr_head, &compile_bufr_plans, &decode_bufr, &encode_bufr })
+            t->set_workload(bufr_data.size(), bufr_size);
+        read_bufr_stream.set_workload(bufr_data.size(), bufr_size + bufr_data.size() * 4096);
+        for (Task* t: { &decode_crex_head, &decode_crex, &encode_crex })
+            t->set_workload(crex_data.size(), crex_size);
     }
 
     void teardown_main()
@@ -111,6 +149,46 @@ struct BulletinBenchmark : Benchmark
             for (auto& d: bufr_data)
                 d.decode_header(d.data);
         });
+        decode_bufr_head_notables.collect([&]() {
+            auto opts = BufrCodecOptions::create();
+            opts->decode_header_skips_tables = true;
+            for (auto& d: bufr_data)
+                BufrBulletin::decode_header(d.data, *opts);
+        });
+        scan_bufr_head.collect([&]() {
+            BufrHeaderScanner scanner(bufr_concat);
+            BufrHeader header;
+            while (scanner.next(header))
+                ;
+        });
+        // Read messages from a stream, with junk data between them
+        read_bufr_stream.collect([&]() {
+            FILE* in = tmpfile();
+            string junk(4096, 'B');
+            for (const auto& d: bufr_data)
+            {
+                fwrite(junk.data(), junk.size(), 1, in);
+                fwrite(d.data.data(), d.data.size(), 1, in);
+            }
+            rewind(in);
+            string buf;
+            while (BufrBulletin::read(in, buf))
+                ;
+            fclose(in);
+        });
+        // Compile the plan for each message layout, which is the extra cost
+        // of decoding a layout seen for the first time
+        compile_bufr_plans.collect([&]() {
+            for (auto& d: bufr_data)
+            {
+                try {
+                    bulletin::Plan plan(d.head_bulletin->tables, Opcodes(d.head_bulletin->datadesc));
+                } catch (error&) {
+                    // Some test messages have invalid data descriptors
+                }
+            }
+        });
+        // Decode with cached plans
         decode_bufr.collect([&]() {
             for (auto& d: bufr_data)
                 d.decode(d.data);
@@ -134,6 +212,502 @@ struct BulletinBenchmark : Benchmark
     }
 } test("bulletin");
 
+/**
+ * Decode the BUFR test messages sharing the work among a growing number of
+ * threads, to measure how decoding scales
+ */
+struct ThreadsBenchmark : Benchmark
+{
+    vector<TestData<BufrBulletin>> bufr_data;
+    vector<unsigned> thread_counts;
+    vector<unique_ptr<Task>> decode_tasks;
+
+    ThreadsBenchmark(const std::string& name)
+        : Benchmark(name)
+    {
+        repetitions = 10;
+        unsigned max_threads = max(4u, std::thread::hardware_concurrency());
+        for (unsigned n = 1; n <= max_threads; n *= 2)
+        {
+            thread_counts.push_back(n);
+            decode_tasks.emplace_back(new Task(this, "decode_threads_" + to_string(n)));
+        }
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        load<BufrBulletin>("bufr", bufr_data, { "ed4.bufr", "gts-synop-rad1.bufr", "obs0-1.22.bufr", "synop-evapo.bufr", "temp-gts1.bufr", "atms1.bufr" });
+        // Load tables and plans outside of timings
+        for (auto& d: bufr_data)
+            d.decode(d.data);
+        size_t size = total_size(bufr_data);
+        for (auto& t: decode_tasks)
+            t->set_workload(bufr_data.size(), size);
+    }
+
+    void teardown_main()
+    {
+        Benchmark::teardown_main();
+        double single = decode_tasks[0]->wall_stats().median;
+        for (unsigned i = 0; i < thread_counts.size(); ++i)
+        {
+            double median = decode_tasks[i]->wall_stats().median;
+            fprintf(stdout, "%s: %zu messages on %u threads: %.3fs median wall clock time, %.2fx speedup\n",
+                    name.c_str(), bufr_data.size(), thread_counts[i], median, single / median);
+        }
+    }
+
+    void decode(unsigned thread_count)
+    {
+        std::atomic<size_t> next(0);
+        vector<thread> threads;
+        for (unsigned i = 0; i < thread_count; ++i)
+            threads.emplace_back([&]() {
+                size_t pos;
+                while ((pos = next++) < bufr_data.size())
+                    BufrBulletin::decode(bufr_data[pos].data);
+            });
+        for (auto& t: threads)
+            t.join();
+    }
+
+    void main() override
+    {
+        for (unsigned i = 0; i < thread_counts.size(); ++i)
+            decode_tasks[i]->collect([&]() { decode(thread_counts[i]); });
+    }
+} test_threads("threads");
+
+/**
+ * Decode BUFR messages into new bulletins and reusing the same bulletin,
+ * counting memory allocations
+ */
+struct BufrReuseBenchmark : Benchmark
+{
+    vector<TestData<BufrBulletin>> bufr_data;
+    Task decode_new;
+    Task decode_reuse;
+
+    BufrReuseBenchmark(const std::string& name)
+        : Benchmark(name), decode_new(this, "decode_new"), decode_reuse(this, "decode_reuse")
+    {
+        repetitions = 20;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        load<BufrBulletin>("bufr", bufr_data, { "ed4.bufr", "gts-synop-rad1.bufr", "obs0-1.22.bufr", "synop-evapo.bufr", "temp-gts1.bufr", "atms1.bufr", "ascat1.bufr", "gps_zenith.bufr" });
+        // Load tables and plans outside of timings
+        for (auto& d: bufr_data)
+            d.decode(d.data);
+        size_t size = total_size(bufr_data);
+        decode_new.set_workload(bufr_data.size(), size);
+        decode_reuse.set_workload(bufr_data.size(), size);
+    }
+
+    void main() override
+    {
+        decode_new.collect([&]() {
+            for (auto& d: bufr_data)
+                BufrBulletin::decode(d.data.data(), d.data.size());
+        });
+
+        // Start each repetition with a new bulletin, whose first use does
+        // all the allocations
+        auto bulletin = BufrBulletin::create();
+        decode_reuse.collect([&]() {
+            for (auto& d: bufr_data)
+                BufrBulletin::decode(d.data.data(), d.data.size(), *bulletin);
+        });
+    }
+} test_reuse("bufr_reuse");
+
+/**
+ * Decode, copy and query BUFR messages with attributes from associated fields
+ * (C04) and substituted values (C23), counting memory allocations
+ */
+struct BufrAttributesBenchmark : Benchmark
+{
+    vector<TestData<BufrBulletin>> bufr_data;
+    Task decode_new;
+    Task decode_reuse;
+    Task copy_subsets;
+    Task enqa;
+    // The messages are small: run each task on them this many times
+    static const unsigned loops = 10;
+    size_t attributes = 0;
+    size_t found = 0;
+
+    BufrAttributesBenchmark(const std::string& name)
+        : Benchmark(name), decode_new(this, "decode_new"), decode_reuse(this, "decode_reuse"),
+          copy_subsets(this, "copy_subsets"), enqa(this, "enqa")
+    {
+        repetitions = 20;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        load<BufrBulletin>("bufr", bufr_data, { "C04004.bufr", "C04-B31021-1.bufr", "C04type21.bufr", "C23000-1.bufr", "C23000.bufr", "bitmap-B33035.bufr" });
+        for (auto& d: bufr_data)
+        {
+            d.decode(d.data);
+            for (const auto& subset: d.data_bulletin->subsets)
+                for (const auto& var: subset)
+                    for (const Var* a = var.next_attr(); a; a = a->next_attr())
+                        ++attributes;
+        }
+        size_t size = total_size(bufr_data) * loops;
+        decode_new.set_workload(bufr_data.size() * loops, size);
+        decode_reuse.set_workload(bufr_data.size() * loops, size);
+        copy_subsets.set_workload(bufr_data.size() * loops);
+        enqa.set_workload(bufr_data.size() * loops);
+    }
+
+    void teardown_main()
+    {
+        Benchmark::teardown_main();
+        fprintf(stdout, "%s: %zu messages, %.1f attributes per message\n",
+                name.c_str(), bufr_data.size(), (double)attributes / bufr_data.size());
+    }
+
+    void main() override
+    {
+        decode_new.collect([&]() {
+            for (unsigned i = 0; i < loops; ++i)
+                for (auto& d: bufr_data)
+                    BufrBulletin::decode(d.data.data(), d.data.size());
+        });
+
+        auto bulletin = BufrBulletin::create();
+        decode_reuse.collect([&]() {
+            for (unsigned i = 0; i < loops; ++i)
+                for (auto& d: bufr_data)
+                    BufrBulletin::decode(d.data.data(), d.data.size(), *bulletin);
+        });
+
+        copy_subsets.collect([&]() {
+            for (unsigned i = 0; i < loops; ++i)
+                for (auto& d: bufr_data)
+                {
+                    std::vector<Subset> copy(d.data_bulletin->subsets);
+                }
+        });
+
+        enqa.collect([&]() {
+            for (unsigned i = 0; i < loops; ++i)
+                for (auto& d: bufr_data)
+                    for (const auto& subset: d.data_bulletin->subsets)
+                        for (const auto& var: subset)
+                            for (Varcode code: { WR_VAR(0, 33, 2), WR_VAR(0, 33, 7), WR_VAR(0, 33, 50), WR_VAR(0, 31, 21) })
+                                if (var.enqa(code))
+                                    ++found;
+        });
+
+    }
+} test_attrs("bufr_attrs");
+
+/**
+ * Encode the multi-subset BUFR test messages with and without compression
+ */
+struct BufrCompressionBenchmark : Benchmark
+{
+    vector<TestData<BufrBulletin>> bufr_data;
+    size_t size_orig = 0;
+    size_t size_uncompressed = 0;
+    size_t size_compressed = 0;
+    Task encode_uncompressed;
+    Task encode_compressed;
+
+    BufrCompressionBenchmark(const std::string& name)
+        : Benchmark(name),
+          encode_uncompressed(this, "encode_uncompressed"), encode_compressed(this, "encode_compressed")
+    {
+        repetitions = 20;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        vector<TestData<BufrBulletin>> all;
+        load<BufrBulletin>("bufr", all, { "ascat1.bufr", "atms1.bufr", "atms2.bufr", "bitmap-B33035.bufr", "C08022.bufr", "C08032-toolong.bufr", "ed4-compr-string.bufr", "ed4-empty.bufr", "ed4-parseerror1.bufr", "ed4.bufr", "gps_zenith.bufr", "synop-longname.bufr" });
+        for (auto& d: all)
+        {
+            d.decode(d.data);
+            if (d.data_bulletin->subsets.size() < 2) continue;
+            size_orig += d.data.size();
+            bufr_data.emplace_back(move(d));
+        }
+        encode_uncompressed.set_workload(bufr_data.size());
+        encode_compressed.set_workload(bufr_data.size());
+    }
+
+    void teardown_main()
+    {
+        Benchmark::teardown_main();
+        fprintf(stdout, "%s: %zu messages, original: %zu bytes, uncompressed: %zu bytes, compressed: %zu bytes\n",
+                name.c_str(), bufr_data.size(), size_orig, size_uncompressed, size_compressed);
+    }
+
+    void main() override
+    {
+        encode_uncompressed.collect([&]() {
+            size_uncompressed = 0;
+            for (auto& d: bufr_data)
+            {
+                d.data_bulletin->compression = false;
+                size_uncompressed += d.data_bulletin->encode().size();
+            }
+        });
+        encode_compressed.collect([&]() {
+            size_compressed = 0;
+            for (auto& d: bufr_data)
+            {
+                d.data_bulletin->compression = true;
+                size_compressed += d.data_bulletin->encode().size();
+            }
+        });
+    }
+} test_compression("bufr_compression");
+
+/**
+ * Decode the compressed BUFR test messages into subsets, into columns, and
+ * with a DecodeVisitor
+ */
+struct BufrColumnsBenchmark : Benchmark
+{
+    /// Add all the numeric values as doubles
+    struct Summer : public DecodeVisitor
+    {
+        double sum = 0;
+
+        void value(unsigned subset, const DecodedValue& val) override
+        {
+            if (val.missing) return;
+            if (val.info->type != Vartype::Integer && val.info->type != Vartype::Decimal) return;
+            sum += val.enqd();
+        }
+    };
+
+    vector<TestData<BufrBulletin>> bufr_data;
+    Task decode_subsets;
+    Task decode_columns;
+    Task read_column;
+    Task decode_visit;
+
+    BufrColumnsBenchmark(const std::string& name)
+        : Benchmark(name),
+          decode_subsets(this, "decode_subsets"), decode_columns(this, "decode_columns"),
+          read_column(this, "read_column"), decode_visit(this, "decode_visit")
+    {
+        repetitions = 20;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        vector<TestData<BufrBulletin>> all;
+        load<BufrBulletin>("bufr", all, { "ascat1.bufr", "atms1.bufr", "atms2.bufr", "bitmap-B33035.bufr", "ed4-compr-string.bufr", "ed4.bufr", "gps_zenith.bufr" });
+        for (auto& d: all)
+        {
+            d.decode(d.data);
+            if (!d.data_bulletin->compression) continue;
+            bufr_data.emplace_back(move(d));
+        }
+        size_t size = total_size(bufr_data);
+        for (Task* t: { &decode_subsets, &decode_columns, &read_column, &decode_visit })
+            t->set_workload(bufr_data.size(), size);
+    }
+
+    void main() override
+    {
+        decode_subsets.collect([&]() {
+            for (auto& d: bufr_data)
+                BufrBulletin::decode(d.data.data(), d.data.size());
+        });
+        decode_columns.collect([&]() {
+            Columns columns;
+            for (auto& d: bufr_data)
+                BufrBulletin::decode_columns(d.data.data(), d.data.size(), columns);
+        });
+        // Decode and read all the numeric values as doubles
+        read_column.collect([&]() {
+            Columns columns;
+            double sum = 0;
+            for (auto& d: bufr_data)
+            {
+                BufrBulletin::decode_columns(d.data.data(), d.data.size(), columns);
+                for (const auto& col: columns.columns)
+                {
+                    if (col.info()->type != Vartype::Integer && col.info()->type != Vartype::Decimal) continue;
+                    for (double v: col.doubles(0))
+                        sum += v;
+                }
+            }
+            sink = sum;
+        });
+        // Read all the numeric values as doubles while decoding
+        decode_visit.collect([&]() {
+            Summer summer;
+            for (auto& d: bufr_data)
+                BufrBulletin::decode_visit(d.data.data(), d.data.size(), summer);
+            sink = summer.sum;
+        });
+    }
+
+    double sink = 0;
+} test_columns("bufr_columns");
+
+/**
+ * Decode the BUFR test messages fully and selecting only a few varcodes
+ */
+struct BufrDecodeOnlyBenchmark : Benchmark
+{
+    vector<TestData<BufrBulletin>> bufr_data;
+    std::unique_ptr<BufrCodecOptions> opts;
+    Task decode_all;
+    Task decode_only;
+    Task decode_only_columns;
+
+    BufrDecodeOnlyBenchmark(const std::string& name)
+        : Benchmark(name), opts(BufrCodecOptions::create()),
+          decode_all(this, "decode_all"), decode_only(this, "decode_only"),
+          decode_only_columns(this, "decode_only_columns")
+    {
+        repetitions = 20;
+        opts->decode_only = { WR_VAR(0, 5, 1), WR_VAR(0, 6, 1), WR_VAR(0, 4, 4), WR_VAR(0, 12, 101) };
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        load<BufrBulletin>("bufr", bufr_data, { "ascat1.bufr", "atms1.bufr", "atms2.bufr", "bitmap-B33035.bufr", "ed4-compr-string.bufr", "ed4.bufr", "gps_zenith.bufr", "synop-longname.bufr", "temp-gts1.bufr" });
+        size_t compressed = 0;
+        size_t compressed_size = 0;
+        for (auto& d: bufr_data)
+        {
+            d.decode(d.data);
+            if (!d.data_bulletin->compression) continue;
+            ++compressed;
+            compressed_size += d.data.size();
+        }
+        size_t size = total_size(bufr_data);
+        decode_all.set_workload(bufr_data.size(), size);
+        decode_only.set_workload(bufr_data.size(), size);
+        decode_only_columns.set_workload(compressed, compressed_size);
+    }
+
+    void main() override
+    {
+        decode_all.collect([&]() {
+            for (auto& d: bufr_data)
+                BufrBulletin::decode(d.data.data(), d.data.size());
+        });
+        decode_only.collect([&]() {
+            for (auto& d: bufr_data)
+                BufrBulletin::decode(d.data.data(), d.data.size(), *opts);
+        });
+        decode_only_columns.collect([&]() {
+            Columns columns;
+            for (auto& d: bufr_data)
+                if (d.data_bulletin->compression)
+                    BufrBulletin::decode_columns(d.data.data(), d.data.size(), columns, *opts);
+        });
+    }
+} test_decode_only("bufr_decode_only");
+
+/**
+ * Bit by bit reader, as used by BufrInput::get_bits before it read whole
+ * words, kept as a baseline for comparison
+ */
+struct BitwiseReader
+{
+    const uint8_t* data;
+    size_t data_len;
+    size_t cursor = 0;
+    uint8_t pbyte = 0;
+    int pbyte_len = 0;
+
+    BitwiseReader(const std::string& in)
+        : data((const uint8_t*)in.data()), data_len(in.size()) {}
+
+    uint32_t get_bits(unsigned n)
+    {
+        uint32_t result = 0;
+        if (cursor == data_len)
+            throw error_parse("end of buffer");
+        for (unsigned i = 0; i < n; i++)
+        {
+            if (pbyte_len == 0)
+            {
+                pbyte_len = 8;
+                pbyte = data[cursor++];
+            }
+            result <<= 1;
+            if (pbyte & 0x80)
+                result |= 1;
+            pbyte <<= 1;
+            pbyte_len--;
+        }
+        return result;
+    }
+};
+
+struct BufrBitsBenchmark : Benchmark
+{
+    string data;
+    // Bit widths commonly found in section 4 of BUFR messages
+    vector<unsigned> widths;
+    unsigned reads;
+    uint32_t sink = 0;
+    Task get_bits_bitwise;
+    Task get_bits;
+
+    BufrBitsBenchmark(const std::string& name)
+        : Benchmark(name),
+          get_bits_bitwise(this, "get_bits_bitwise"), get_bits(this, "get_bits")
+    {
+        repetitions = 20;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        widths = { 1, 6, 7, 8, 10, 12, 14, 15, 16, 17, 19, 20, 24, 26, 32 };
+        unsigned bits = 0;
+        for (auto w: widths) bits += w;
+        data.resize(4 * 1024 * 1024);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = random();
+        reads = (data.size() * 8 - 64) / bits * widths.size();
+        get_bits_bitwise.set_workload(0, data.size());
+        get_bits.set_workload(0, data.size());
+    }
+
+    template<typename Reader>
+    void read_all(Reader& in)
+    {
+        uint32_t res = 0;
+        for (unsigned i = 0; i < reads; ++i)
+            res += in.get_bits(widths[i % widths.size()]);
+        sink += res;
+    }
+
+    void main() override
+    {
+        get_bits_bitwise.collect([&]() {
+            BitwiseReader in(data);
+            read_all(in);
+        });
+        get_bits.collect([&]() {
+            buffers::BufrInput in(data);
+            read_all(in);
+        });
+    }
+} test_bits("bufr_bits");
+
 }
 
 
@@ -5,7 +5,10 @@
 #include "dtable.h"
 #include "bulletin/dds-printer.h"
 #include "notes.h"
+#include "reader.h"
 #include <netinet/in.h>
+#include <cstring>
+#include <algorithm>
 #include "config.h"
 
 using namespace std;
@@ -14,35 +17,194 @@ namespace wreport {
 
 namespace {
 
+/**
+ * Number of bytes that are scanned one character at a time, before switching
+ * to scanning in blocks.
+ *
+ * Reading with getc works inside the stdio buffer, and is the fastest way to
+ * deal with messages that follow each other with little or no junk in
+ * between. Scanning in blocks needs to seek back at the end, which discards
+ * the stdio buffer, and only pays off when there is a lot of data to skip.
+ */
+const size_t getc_scan_size = 4096;
+
+/// Seek back \a count bytes in \a fd
+void seek_back(FILE* fd, size_t count, const char* fname)
+{
+    if (fseeko(fd, -(off_t)count, SEEK_CUR) != 0)
+    {
+        if (fname)
+            error_system::throwf("cannot seek back %zd bytes in %s", count, fname);
+        else
+            error_system::throwf("cannot seek back %zd bytes", count);
+    }
+}
+
+void throw_signature_read_error(const char* sig, const char* fname)
+{
+    if (fname)
+        error_system::throwf("looking for start of %.4s data in %s:", sig, fname);
+    else
+        error_system::throwf("looking for start of %.4s data", sig);
+}
+
+/**
+ * Position the stream just after the next occurrence of \a sig.
+ *
+ * The stream is first scanned one character at a time. If the signature is
+ * not found within getc_scan_size bytes and the stream is seekable, the rest
+ * is scanned in large blocks, seeking back to the end of the signature once
+ * it is found.
+ *
+ * \a sig must not contain its first character anywhere else, like "BUFR" and
+ * "CREX++", so that a mismatch never needs to backtrack further than its
+ * first character.
+ *
+ * @returns true if the signature was found, false on end of file
+ */
 bool seek_past_signature(FILE* fd, const char* sig, unsigned sig_len, const char* fname)
 {
     unsigned got = 0;
+    size_t scanned = 0;
     int c;
+    while ((c = getc(fd)) != EOF)
+    {
+        if (c == sig[got])
+        {
+            if (++got == sig_len)
+                return true;
+        } else
+            got = c == sig[0] ? 1 : 0;
+
+        if (++scanned == getc_scan_size && ftello(fd) != -1)
+            break;
+    }
+    if (c == EOF)
+    {
+        if (ferror(fd))
+            throw_signature_read_error(sig, fname);
+        return false;
+    }
 
-    errno = 0;
+    char block[16384];
+    // Bytes kept from the end of the previous block, to find signatures
+    // that span across two blocks
+    size_t kept = got;
+    memcpy(block, sig, kept);
+    while (true)
+    {
+        size_t count = fread(block + kept, 1, sizeof(block) - kept, fd);
+        if (count == 0)
+        {
+            if (ferror(fd))
+                throw_signature_read_error(sig, fname);
+            return false;
+        }
 
-    while (got < sig_len && (c = getc(fd)) != EOF)
+        size_t size = kept + count;
+        size_t found = scan::find_signature(block, size, 0, sig, sig_len);
+        if (found != size)
+        {
+            seek_back(fd, size - found - sig_len, fname);
+            return true;
+        }
+
+        kept = min(size, (size_t)sig_len - 1);
+        memmove(block, block + size - kept, kept);
+    }
+}
+
+/**
+ * Return the position in \a buf from which to search again for the end of a
+ * CREX message, when more data is appended to it.
+ *
+ * The end of the message may be split at the end of \a buf: back up to the
+ * start of its possible beginning, but not before \a search_from.
+ */
+size_t crex_end_resume_position(const std::string& buf, size_t search_from)
+{
+    size_t i = buf.size();
+    while (i > search_from && (buf[i - 1] == '\r' || buf[i - 1] == '\n' || buf[i - 1] == '7'))
+        --i;
+    while (i > search_from && buf[i - 1] == '+')
+        --i;
+    return i;
+}
+
+/**
+ * Read the rest of a CREX message.
+ *
+ * As with seek_past_signature, the stream is first read one character at a
+ * time, then in blocks if the message is longer than getc_scan_size and the
+ * stream is seekable, seeking back to the end of the message once it is
+ * found.
+ */
+void read_crex_end(FILE* fd, std::string& buf, const char* fname)
+{
+    const char* target = "++\r\n7777";
+    static const int target_size = 8;
+    size_t message_start = buf.size();
+    size_t scanned = 0;
+    int got = 0;
+    int c;
+
+    while (got < target_size && (c = getc(fd)) != EOF)
     {
-        if (c == sig[got])
+        if (target[got] == '\r' && (c == '\n' || c == '\r'))
+            got++;
+        else if (target[got] == '\n' && (c == '\n' || c == '\r'))
+            ;
+        else if (target[got] == '\n' && c == '7')
+            got += 2;
+        else if (c == target[got])
             got++;
         else
             got = 0;
+
+        buf += (char)c;
+
+        if (got < target_size && ++scanned == getc_scan_size && ftello(fd) != -1)
+            break;
     }
 
-    if (errno != 0)
+    if (got < target_size && !ferror(fd) && !feof(fd))
+    {
+        size_t search_from = crex_end_resume_position(buf, message_start);
+        char block[4096];
+        while (true)
+        {
+            size_t count = fread(block, 1, sizeof(block), fd);
+            if (count == 0)
+                break;
+            buf.append(block, count);
+
+            size_t end;
+            if (scan::find_crex_end(buf.data(), buf.size(), search_from, end))
+            {
+                seek_back(fd, buf.size() - end, fname);
+                buf.resize(end);
+                return;
+            }
+
+            search_from = crex_end_resume_position(buf, search_from);
+        }
+    }
+
+    if (ferror(fd))
     {
         if (fname)
-            error_system::throwf("looking for start of %.4s data in %s:", sig, fname);
+            error_system::throwf("cannot find end of CREX data in %s", fname);
         else
-            error_system::throwf("looking for start of %.4s data", sig);
+            throw error_system("cannot find end of CREX data");
     }
 
-    if (got != sig_len)
+    if (got != target_size)
     {
-        /* End of file: return accordingly */
-        return false;
+        if (fname)
+            throw error_parse(fname, ftell(fd), "CREX message is incomplete");
+        else
+            throw error_parse("(unknown)", ftell(fd), "CREX message is incomplete");
     }
-    return true;
 }
 
 }
@@ -65,15 +227,55 @@ void Bulletin::clear()
     update_sequence_number = 0;
     rep_year = 0;
     rep_month = rep_day = rep_hour = rep_minute = rep_second = 0;
+
+    // Keep the subsets for reuse. Variables using the Varinfos generated by
+    // tables need to go, as tables.clear() deallocates them, and the others
+    // need to stop using the arena, as arena.clear() deallocates it
+    for (auto& subset: subsets)
+    {
+        for (auto i = subset.begin(); i != subset.end(); ++i)
+        {
+            bool local = tables.is_local(i->info());
+            for (const Var* a = i->next_attr(); !local && a; a = a->next_attr())
+                local = tables.is_local(a->info());
+            if (local)
+            {
+                subset.erase(i, subset.end());
+                break;
+            }
+            i->forget_arena();
+        }
+        spare_subsets.emplace_back(move(subset));
+    }
+    subsets.clear();
+
+    arena.clear();
     tables.clear();
     datadesc.clear();
-    subsets.clear();
 }
 
 Subset& Bulletin::obtain_subset(unsigned subsection)
+{
+    size_t old_size = subsets.size();
+    obtain_reused_subset(subsection);
+    for (size_t i = old_size; i < subsets.size(); ++i)
+        subsets[i].clear();
+    return subsets[subsection];
+}
+
+Subset& Bulletin::obtain_reused_subset(unsigned subsection)
 {
     while (subsection >= subsets.size())
-        subsets.emplace_back(tables);
+    {
+        if (spare_subsets.empty())
+        {
+            subsets.emplace_back(tables);
+            continue;
+        }
+        if (!tables.loaded()) throw error_consistency("BUFR/CREX tables not loaded");
+        subsets.emplace_back(move(spare_subsets.back()));
+        spare_subsets.pop_back();
+    }
     return subsets[subsection];
 }
 
@@ -374,15 +576,12 @@ unsigned BufrBulletin::diff_details(const Bulletin& bulletin) const
                 master_table_version_number_local, msg.master_table_version_number_local);
         ++diffs;
     }
-    /*
-    // TODO: uncomment when we implement encoding BUFR with compression
-    if (compression != m->compression)
+    if (compression != msg.compression)
     {
-    notes::logf("BUFR compression differs (first is %d, second is %d)\n",
-    compression, m->compression);
-    ++diffs;
+        notes::logf("BUFR compression differs (first is %d, second is %d)\n",
+                compression, msg.compression);
+        ++diffs;
     }
-    */
     if (optional_section.size() != msg.optional_section.size())
     {
         notes::logf("BUFR optional section lenght (first is %zd, second is %zd)\n",
@@ -421,13 +620,13 @@ bool BufrBulletin::read(FILE* fd, std::string& buf, const char* fname, off_t* of
     }
 
     // Read the message length
-    int bufrlen = ntohl(*(uint32_t*)(buf.data()+4)) >> 8;
+    size_t bufrlen = scan::bufr_length(buf.data());
     if (bufrlen < 12)
     {
         if (fname)
-            error_consistency::throwf("%s: the size declared by the BUFR message (%d) is less than the minimum of 12", fname, bufrlen);
+            error_consistency::throwf("%s: the size declared by the BUFR message (%zd) is less than the minimum of 12", fname, bufrlen);
         else
-            error_consistency::throwf("the size declared by the BUFR message (%d) is less than the minimum of 12", bufrlen);
+            error_consistency::throwf("the size declared by the BUFR message (%zd) is less than the minimum of 12", bufrlen);
     }
 
     // Allocate enough space to fit the message
@@ -566,46 +765,9 @@ bool CrexBulletin::read(FILE* fd, std::string& buf, const char* fname, off_t* of
     if (offset) *offset = ftello(fd) - 6;
 
     // Read until "\+\+(\r|\n)+7777"
-	{
-		const char* target = "++\r\n7777";
-		static const int target_size = 8;
-		int got = 0;
-		int c;
-
-		errno = 0;
-		while (got < 8 && (c = getc(fd)) != EOF)
-		{
-			if (target[got] == '\r' && (c == '\n' || c == '\r'))
-				got++;
-			else if (target[got] == '\n' && (c == '\n' || c == '\r'))
-				;
-			else if (target[got] == '\n' && c == '7')
-				got += 2;
-			else if (c == target[got])
-				got++;
-			else
-				got = 0;
-
-			buf += (char)c;
-		}
-        if (ferror(fd))
-        {
-            if (fname)
-                error_system::throwf("cannot find end of CREX data in %s", fname);
-            else
-                throw error_system("cannot find end of CREX data");
-        }
+    read_crex_end(fd, buf, fname);
 
-		if (got != target_size)
-		{
-			if (fname)
-				throw error_parse(fname, ftell(fd), "CREX message is incomplete");
-			else
-				throw error_parse("(unknown)", ftell(fd), "CREX message is incomplete");
-		}
-	}
-
-	return true;
+    return true;
 }
 
 void CrexBulletin::write(const std::string& buf, FILE* out, const char* fname)
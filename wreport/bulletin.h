@@ -2,6 +2,7 @@
 #define WREPORT_BULLETIN_H
 
 #include <wreport/var.h>
+#include <wreport/arena.h>
 #include <wreport/subset.h>
 #include <wreport/opcodes.h>
 #include <wreport/tables.h>
@@ -10,6 +11,8 @@
 
 namespace wreport {
 struct DTable;
+struct Columns;
+struct DecodeVisitor;
 
 /**
  * Storage for the decoded data of a BUFR or CREX message.
@@ -25,6 +28,10 @@ struct DTable;
  *
  * Extra values like quality control statistics or replaced values are
  * represented as 'attributes' to the wreport::Var objects.
+ *
+ * When decoding, string values and attributes are allocated in the arena of
+ * the bulletin: the decoded variables can be copied to be used after the
+ * bulletin has been cleared or destroyed.
  */
 struct Bulletin
 {
@@ -116,17 +123,32 @@ struct Bulletin
     /// Varcode and opcode tables used for encoding or decoding
     Tables tables;
 
+    /// Memory for the values and attributes of decoded variables
+    Arena arena;
+
     /// Parsed data descriptor section
     std::vector<Varcode> datadesc;
 
-    /// Decoded variables
+    /**
+     * Decoded variables.
+     *
+     * They can use memory in arena: subsets and variables copied out of the
+     * bulletin are independent from it, while those moved out keep using it
+     * until Var::detach_arena() is called on them. The vector itself must
+     * not be moved or swapped out.
+     */
     std::vector<Subset> subsets;
 
 
 	Bulletin();
 	virtual ~Bulletin();
 
-	/// Reset the bulletin
+    /**
+     * Reset the bulletin.
+     *
+     * The memory used by the subsets, their variables and the arena is kept,
+     * to be reused when filling the bulletin again.
+     */
 	virtual void clear();
 
     /// Type of source/target encoding
@@ -143,6 +165,20 @@ struct Bulletin
 	 */
 	Subset& obtain_subset(unsigned subsection);
 
+    /**
+     * Get a Subset from the message, like obtain_subset(), reusing the
+     * subsets kept by clear().
+     *
+     * A new subset that reuses one kept by clear() still contains the
+     * variables of the previous message, so that their memory can be reused
+     * too: the caller is expected to overwrite them, and to remove those in
+     * excess.
+     *
+     * @param subsection
+     *   The subsection index (starting from 0)
+     */
+    Subset& obtain_reused_subset(unsigned subsection);
+
 	/**
 	 * Get a Subset from the message.
 	 *
@@ -193,6 +229,15 @@ struct Bulletin
 
     /// Diff format-specific details
     virtual unsigned diff_details(const Bulletin& msg) const;
+
+protected:
+    /**
+     * Subsets kept by clear() for reuse.
+     *
+     * They still contain the variables of the message that was cleared,
+     * except those using Varinfos local to \a tables.
+     */
+    std::vector<Subset> spare_subsets;
 };
 
 
@@ -210,6 +255,32 @@ struct BufrCodecOptions
      */
     bool decode_adds_undef_attrs = false;
 
+    /**
+     * By default (false) BufrBulletin::decode_header() also loads the B and D
+     * tables needed to decode the message.
+     *
+     * If this is set to true, decode_header() only parses the header, and the
+     * tables of the resulting bulletin are left empty. This avoids looking up
+     * and parsing table files when only section 1 metadata is needed.
+     *
+     * BufrBulletin::decode() ignores this option, as it always needs tables.
+     */
+    bool decode_header_skips_tables = false;
+
+    /**
+     * If not empty, only decode the variables with these varcodes.
+     *
+     * The values of all other variables are skipped without being decoded,
+     * and the decoded subsets only contain the selected variables, in the
+     * order in which they appear in the message, with their attributes.
+     * Replication factors, bitmaps and C modifiers are still followed, and
+     * like all other variables they are only stored if they are selected.
+     *
+     * This is used by BufrBulletin::decode(), BufrBulletin::decode_columns()
+     * and BufrBulletin::decode_visit().
+     */
+    std::vector<Varcode> decode_only;
+
     /**
      * Create a BufrCodecOptions
      *
@@ -249,7 +320,15 @@ struct BufrBulletin : public Bulletin
      */
     uint8_t master_table_version_number_local = 0;
 
-    /// Whether the message is compressed
+    /**
+     * Whether the message is compressed.
+     *
+     * When encoding, compression is only used if all subsets contain the same
+     * sequence of variables, and if their contents can be compressed: for
+     * example, C05 character data, binary values and replication counts that
+     * differ across subsets cannot. Otherwise the message is encoded
+     * uncompressed.
+     */
     bool compression;
 
     /**
@@ -370,11 +449,271 @@ struct BufrBulletin : public Bulletin
      */
     static std::unique_ptr<BufrBulletin> decode(const std::string& raw, const BufrCodecOptions& opts, const char* fname="(memory)", size_t offset=0);
 
+    /**
+     * Parse only the header of an encoded BUFR message
+     *
+     * The data is decoded in place, without copying it.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded message
+     */
+    static std::unique_ptr<BufrBulletin> decode_header(const void* data, size_t size, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse only the header of an encoded BUFR message
+     *
+     * The data is decoded in place, without copying it.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param opts
+     *   Options used to customise encoding or decoding.
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded message
+     */
+    static std::unique_ptr<BufrBulletin> decode_header(const void* data, size_t size, const BufrCodecOptions& opts, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message
+     *
+     * The data is decoded in place, without copying it.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded message
+     */
+    static std::unique_ptr<BufrBulletin> decode(const void* data, size_t size, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message
+     *
+     * The data is decoded in place, without copying it.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param opts
+     *   Options used to customise encoding or decoding.
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded message
+     */
+    static std::unique_ptr<BufrBulletin> decode(const void* data, size_t size, const BufrCodecOptions& opts, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message into an existing bulletin, replacing its
+     * contents.
+     *
+     * The bulletin is reset with clear(), which keeps the memory of its
+     * subsets and variables: decoding a sequence of messages into the same
+     * bulletin avoids most of the memory allocations needed to decode each
+     * message into a new bulletin.
+     *
+     * If decoding fails, \a out is left cleared.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param out
+     *   The bulletin to fill
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     */
+    static void decode(const void* data, size_t size, BufrBulletin& out, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message into an existing bulletin, replacing its
+     * contents.
+     *
+     * @see decode(const void*, size_t, BufrBulletin&, const char*, size_t)
+     */
+    static void decode(const void* data, size_t size, BufrBulletin& out, const BufrCodecOptions& opts, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message, storing its data by column.
+     *
+     * Compressed messages are decoded directly into \a columns, without
+     * creating subsets. Uncompressed messages are decoded into subsets, which
+     * are then copied into \a columns.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @retval columns
+     *   The decoded data
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded header and no subsets
+     */
+    static std::unique_ptr<BufrBulletin> decode_columns(const void* data, size_t size, Columns& columns, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message, storing its data by column.
+     *
+     * @see decode_columns(const void*, size_t, Columns&, const char*, size_t)
+     */
+    static std::unique_ptr<BufrBulletin> decode_columns(const void* data, size_t size, Columns& columns, const BufrCodecOptions& opts, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message, sending its data to \a visitor as it is
+     * decoded.
+     *
+     * No subsets are created: decode() is implemented as a visitor that
+     * stores the values it receives in the subsets of a bulletin.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param visitor
+     *   The DecodeVisitor that receives the decoded data
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded header and no subsets
+     */
+    static std::unique_ptr<BufrBulletin> decode_visit(const void* data, size_t size, DecodeVisitor& visitor, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded BUFR message, sending its data to \a visitor as it is
+     * decoded.
+     *
+     * @see decode_visit(const void*, size_t, DecodeVisitor&, const char*, size_t)
+     */
+    static std::unique_ptr<BufrBulletin> decode_visit(const void* data, size_t size, DecodeVisitor& visitor, const BufrCodecOptions& opts, const char* fname="(memory)", size_t offset=0);
+
 protected:
     BufrBulletin();
 };
 
 
+/**
+ * Summary of the header of a BUFR message, as found by BufrHeaderScanner.
+ *
+ * Fields have the same meaning as the corresponding ones in Bulletin and
+ * BufrBulletin.
+ */
+struct BufrHeader
+{
+    /// Offset of the start of the message in the scanned buffer
+    off_t offset = 0;
+    /// Size of the encoded message
+    size_t size = 0;
+
+    uint8_t edition_number = 0;
+    uint8_t master_table_number = 0;
+    uint8_t master_table_version_number = 0;
+    uint8_t master_table_version_number_local = 0;
+    uint8_t data_category = 0xff;
+    uint8_t data_subcategory = 0xff;
+    uint8_t data_subcategory_local = 0xff;
+    uint16_t originating_centre = 0xffff;
+    uint16_t originating_subcentre = 0xffff;
+    uint8_t update_sequence_number = 0;
+    uint16_t rep_year = 0;
+    uint8_t rep_month = 0;
+    uint8_t rep_day = 0;
+    uint8_t rep_hour = 0;
+    uint8_t rep_minute = 0;
+    uint8_t rep_second = 0;
+
+    /// Number of subsets, as declared in section 3
+    unsigned subset_count = 0;
+    /// Whether the message is compressed
+    bool compression = false;
+
+    /// Return the ID of the tables needed to decode the message
+    BufrTableID table_id() const;
+};
+
+/**
+ * Scan a buffer containing many BUFR messages, decoding only the information
+ * in their header sections.
+ *
+ * No tables are loaded and no memory is allocated, so this can be used to
+ * quickly classify or route messages.
+ *
+ * Data between messages is skipped. If a message is found but its header
+ * cannot be parsed, next() throws error_parse; calling next() again resumes
+ * scanning after the start of the broken message.
+ */
+class BufrHeaderScanner
+{
+protected:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    const char* fname;
+    size_t offset;
+
+public:
+    /**
+     * @param buf
+     *   The buffer to scan. It is not copied, and needs to remain valid while
+     *   the scanner is in use
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the buffer, used for error
+     *   messages and added to BufrHeader::offset
+     */
+    BufrHeaderScanner(const std::string& buf, const char* fname="(memory)", size_t offset=0);
+    BufrHeaderScanner(const void* buf, size_t size, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Decode the header of the next message in the buffer.
+     *
+     * @returns true if a message was found, false if the end of the buffer
+     * was reached
+     */
+    bool next(BufrHeader& header);
+
+    /**
+     * Return the offset where the next scan will start, including the offset
+     * passed to the constructor.
+     *
+     * After next() throws, this is 4 bytes past the start of the broken
+     * message.
+     */
+    size_t position() const { return offset + pos; }
+};
+
+
 /// CREX bulletin implementation
 struct CrexBulletin : public Bulletin
 {
@@ -485,6 +824,42 @@ struct CrexBulletin : public Bulletin
      */
     static std::unique_ptr<CrexBulletin> decode(const std::string& raw, const char* fname="(memory)", size_t offset=0);
 
+    /**
+     * Parse only the header of an encoded CREX message
+     *
+     * The data is decoded in place, without copying it.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded message
+     */
+    static std::unique_ptr<CrexBulletin> decode_header(const void* data, size_t size, const char* fname="(memory)", size_t offset=0);
+
+    /**
+     * Parse an encoded CREX message
+     *
+     * The data is decoded in place, without copying it.
+     *
+     * @param data
+     *   The buffer to decode
+     * @param size
+     *   The size of the buffer
+     * @param fname
+     *   The file name to use for error messages
+     * @param offset
+     *   The offset inside the file of the start of the bulletin, used for
+     *   error messages
+     * @returns The new bulletin with the decoded message
+     */
+    static std::unique_ptr<CrexBulletin> decode(const void* data, size_t size, const char* fname="(memory)", size_t offset=0);
+
 protected:
     CrexBulletin();
 };
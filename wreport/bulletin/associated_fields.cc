@@ -2,6 +2,7 @@
 #include "wreport/var.h"
 #include "wreport/vartable.h"
 #include "wreport/notes.h"
+#include "wreport/visitor.h"
 
 using namespace std;
 
@@ -16,50 +17,58 @@ AssociatedField::~AssociatedField() {}
 
 std::unique_ptr<Var> AssociatedField::make_attribute(unsigned value) const
 {
+    DecodedValue attr(nullptr);
+    if (!make_attribute(value, attr))
+        return unique_ptr<Var>();
+    return unique_ptr<Var>(new Var(attr.var()));
+}
+
+bool AssociatedField::make_attribute(unsigned value, DecodedValue& attr) const
+{
+    Varcode code;
+    bool missing = false;
     switch (significance)
     {
         case 1:
             // Add attribute B33002=value
-            return unique_ptr<Var>(new Var(btable.query(WR_VAR(0, 33, 2)), (int)value));
+            code = WR_VAR(0, 33, 2);
+            break;
         case 2:
             // Add attribute B33003=value
-            return unique_ptr<Var>(new Var(btable.query(WR_VAR(0, 33, 3)), (int)value));
+            code = WR_VAR(0, 33, 3);
+            break;
         case 3:
         case 4:
         case 5:
             // Reserved: ignored
             notes::logf("Ignoring B31021=%d, which is documented as 'reserved'\n",
                     significance);
-            return unique_ptr<Var>();
+            return false;
         case 6:
             // Add attribute B33050=value
-            if (!skip_missing || value != 15)
-            {
-                unique_ptr<Var> res(new Var(btable.query(WR_VAR(0, 33, 50))));
-                if (value != 15)
-                   res->seti(value);
-                return res;
-            } else
-                return unique_ptr<Var>();
+            if (skip_missing && value == 15)
+                return false;
+            code = WR_VAR(0, 33, 50);
+            missing = value == 15;
+            break;
         case 7:
             // Add attribute B33040=value
-            return unique_ptr<Var>(new Var(btable.query(WR_VAR(0, 33, 40)), (int)value));
+            code = WR_VAR(0, 33, 40);
+            break;
         case 8:
             // Add attribute B33002=value
-            if (!skip_missing || value != 3)
-            {
-                unique_ptr<Var> res(new Var(btable.query(WR_VAR(0, 33, 2))));
-                if (value != 3)
-                   res->seti(value);
-                return res;
-            } else
-                return unique_ptr<Var>();
+            if (skip_missing && value == 3)
+                return false;
+            code = WR_VAR(0, 33, 2);
+            missing = value == 3;
+            break;
         case 21:
             // Add attribute B33041=value
-            if (!skip_missing || value != 1)
-                return unique_ptr<Var>(new Var(btable.query(WR_VAR(0, 33, 41)), 0));
-            else
-                return unique_ptr<Var>();
+            if (skip_missing && value == 1)
+                return false;
+            code = WR_VAR(0, 33, 41);
+            value = 0;
+            break;
         case 63:
             /*
              * Ignore quality information if B31021 is missing.
@@ -75,7 +84,7 @@ std::unique_ptr<Var> AssociatedField::make_attribute(unsigned value) const
              *   associated field bits by the "cancel" operator: 2
              *   04 000.
              */
-            return unique_ptr<Var>();
+            return false;
         default:
             if (significance >= 9 and significance <= 20)
                 // Reserved: ignored
@@ -86,8 +95,14 @@ std::unique_ptr<Var> AssociatedField::make_attribute(unsigned value) const
                         significance);
             else
                 error_unimplemented::throwf("C04 modifiers with B31021=%d are not supported", significance);
-            return unique_ptr<Var>();
+            return false;
     }
+
+    attr.info = btable.query(code);
+    attr.missing = missing;
+    attr.ival = missing ? 0 : (int)value;
+    attr.cval = nullptr;
+    return true;
 }
 
 const Var* AssociatedField::get_attribute(const Var& var) const
@@ -6,6 +6,7 @@
 namespace wreport {
 struct Var;
 struct Vartable;
+struct DecodedValue;
 
 namespace bulletin {
 
@@ -43,6 +44,15 @@ struct AssociatedField
      */
     std::unique_ptr<Var> make_attribute(unsigned value) const;
 
+    /**
+     * Set \a attr to the attribute for the currently defined associated field
+     * and the given value, without allocating memory.
+     *
+     * @returns false if there is no field to associate, in which case \a
+     * attr is left untouched.
+     */
+    bool make_attribute(unsigned value, DecodedValue& attr) const;
+
     /**
      * Get the attribute of var corresponding to this associated field
      * significance.
@@ -7,6 +7,17 @@ namespace bulletin {
 
 Bitmap::Bitmap(const Var& bitmap, const Subset& subset, unsigned anchor)
     : bitmap(bitmap)
+{
+    init([&](unsigned pos) { return subset[pos].code(); }, anchor);
+}
+
+Bitmap::Bitmap(const Var& bitmap, const std::vector<Varcode>& codes, unsigned anchor)
+    : bitmap(bitmap)
+{
+    init([&](unsigned pos) { return codes[pos]; }, anchor);
+}
+
+void Bitmap::init(std::function<Varcode(unsigned)> code_at, unsigned anchor)
 {
 //    /**
 //     * Anchor point of the first bitmap found since the last reset().
@@ -31,7 +42,7 @@ Bitmap::Bitmap(const Var& bitmap, const Subset& subset, unsigned anchor)
     {
         --b_cur;
         --s_cur;
-        while (WR_VAR_F(subset[s_cur].code()) != 0)
+        while (WR_VAR_F(code_at(s_cur)) != 0)
         {
             if (s_cur == 0) throw error_consistency("bitmap refers to variables before the start of the subset");
             --s_cur;
@@ -88,6 +99,12 @@ void Bitmaps::define(const Var& bitmap, const Subset& subset, unsigned anchor_po
     current = new Bitmap(bitmap, subset, anchor_point);
 }
 
+void Bitmaps::define(const Var& bitmap, const std::vector<Varcode>& codes, unsigned anchor_point)
+{
+    delete current;
+    current = new Bitmap(bitmap, codes, anchor_point);
+}
+
 void Bitmaps::reuse_last()
 {
 // Only throw an error when the bitmap is actually used
@@ -3,6 +3,7 @@
 
 #include <wreport/var.h>
 #include <vector>
+#include <functional>
 
 namespace wreport {
 struct Var;
@@ -42,6 +43,12 @@ struct Bitmap
      *   the C operator that defines or uses the bitmap)
      */
     Bitmap(const Var& bitmap, const Subset& subset, unsigned anchor);
+
+    /**
+     * Create a new bitmap referring to a sequence of variables described only
+     * by their varcodes
+     */
+    Bitmap(const Var& bitmap, const std::vector<Varcode>& codes, unsigned anchor);
     Bitmap(const Bitmap&) = delete;
     ~Bitmap();
     Bitmap& operator=(const Bitmap&) = delete;
@@ -60,6 +67,10 @@ struct Bitmap
 
     /// Reset the bitmap iterator, to reuse the bitmap another time
     void reuse();
+
+protected:
+    /// Fill refs, given a function returning the varcode at a position
+    void init(std::function<Varcode(unsigned)> code_at, unsigned anchor);
 };
 
 struct Bitmaps
@@ -80,6 +91,7 @@ struct Bitmaps
     Bitmaps& operator=(const Bitmaps&) = delete;
 
     void define(const Var& bitmap, const Subset& subset, unsigned anchor_point);
+    void define(const Var& bitmap, const std::vector<Varcode>& codes, unsigned anchor_point);
 
     void reuse_last();
 
@@ -99,6 +99,25 @@ unsigned UncompressedEncoder::define_bitmap_delayed_replication_factor(Varinfo i
 }
 
 
+CompressedEncoder::CompressedEncoder(const Bulletin& bulletin)
+    : Interpreter(bulletin.tables, bulletin.datadesc), bulletin(bulletin)
+{
+}
+
+CompressedEncoder::~CompressedEncoder()
+{
+}
+
+const Var& CompressedEncoder::get_var(unsigned subset_no, unsigned pos) const
+{
+    const Subset& subset = bulletin.subset(subset_no);
+    unsigned max_var = subset.size();
+    if (pos >= max_var)
+        error_consistency::throwf("cannot return variable #%u out of a maximum of %u in subset %u", pos, max_var, subset_no);
+    return subset[pos];
+}
+
+
 UncompressedDecoder::UncompressedDecoder(Bulletin& bulletin, unsigned subset_no)
     : Interpreter(bulletin.tables, bulletin.datadesc), output_subset(bulletin.obtain_subset(subset_no))
 {
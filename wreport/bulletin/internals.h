@@ -66,6 +66,27 @@ struct UncompressedEncoder : public bulletin::Interpreter
     virtual void encode_associated_field(const Var& var);
 };
 
+/**
+ * Base Interpreter specialisation for message encoders that work on all
+ * subsets at the same time, as needed to write compressed data.
+ *
+ * All subsets are expected to have the same structure, so that current_var
+ * refers to the same variable in all of them.
+ */
+struct CompressedEncoder : public bulletin::Interpreter
+{
+    /// Bulletin being encoded
+    const Bulletin& bulletin;
+    /// Index of the next variable to be visited
+    unsigned current_var = 0;
+
+    CompressedEncoder(const Bulletin& bulletin);
+    virtual ~CompressedEncoder();
+
+    /// Get the variable at the given position in the given subset
+    const Var& get_var(unsigned subset_no, unsigned pos) const;
+};
+
 struct UncompressedDecoder : public bulletin::Interpreter
 {
     /// Subset where decoded variables go
@@ -1,10 +1,13 @@
 #include "interpreter.h"
+#include "plan.h"
 #include "wreport/error.h"
 #include "wreport/notes.h"
 #include "wreport/dtable.h"
 #include "wreport/vartable.h"
 #include "wreport/tables.h"
 #include "wreport/var.h"
+#include "config.h"
+#include "wreport/internals/profile.h"
 
 // #define TRACE_INTERPRETER
 
@@ -27,15 +30,43 @@ Interpreter::Interpreter(const Tables& tables, const Opcodes& opcodes)
 
 Interpreter::~Interpreter() {}
 
+#ifdef WREPORT_PROFILE_INTERPRETER
+namespace {
+
+/// Profile class names of plan instructions, indexed by PlanInstruction::Type
+const char* plan_instruction_names[] = {
+    "plan variable",
+    "plan variable or attribute",
+    "plan unknown local",
+    "plan replication",
+    "plan delayed replication",
+    "plan bitmap",
+    "plan associated field",
+    "plan character data",
+    "plan bitmap pending",
+    "plan substituted value",
+    "plan bitmap reuse",
+    "plan bitmap discard",
+    "plan unsupported modifier",
+};
+
+}
+#endif
+
 void Interpreter::run()
 {
+    WREPORT_PROFILE("interpreter run", 0, true);
     Opcodes opcodes = opcode_stack.top();
     while (!opcodes.empty())
     {
         Varcode cur = opcodes.pop_left();
         switch (WR_VAR_F(cur))
         {
-            case 0: b_variable(cur); break;
+            case 0: {
+                WREPORT_PROFILE("B variable");
+                b_variable(cur);
+                break;
+            }
             case 1: {
                 // Replicate the next X elements Y times
                 Varcode delayed_replication_code = 0;
@@ -55,17 +86,24 @@ void Interpreter::run()
                     delayed_replication_code = WR_VAR(0, 31, 12);
 
                 if (bitmaps.pending_definitions)
+                {
+                    WREPORT_PROFILE("R bitmap");
                     r_bitmap(cur, delayed_replication_code, opcodes.pop_left(WR_VAR_X(cur)));
-                else
+                } else {
+                    WREPORT_PROFILE("R replication");
                     r_replication(cur, delayed_replication_code, opcodes.pop_left(WR_VAR_X(cur)));
+                }
                 break;
             }
-            case 2:
+            case 2: {
+                WREPORT_PROFILE("C modifier", cur);
                 // Generic notification
                 c_modifier(cur, opcodes);
                 break;
+            }
             case 3:
             {
+                WREPORT_PROFILE("D expansion", cur);
                 opcode_stack.push(tables.dtable->query(cur));
                 run_d_expansion(cur);
                 opcode_stack.pop();
@@ -77,6 +115,102 @@ void Interpreter::run()
     }
 }
 
+void Interpreter::run_plan()
+{
+    // When profiling, plans are skipped by default, to account time to the
+    // opcodes that the plan would have inlined
+    if (!WREPORT_PROFILE_USE_PLANS())
+    {
+        run();
+        return;
+    }
+    WREPORT_PROFILE("interpreter run", 0, true);
+    const Plan* plan = Plan::get(tables, opcode_stack.top());
+    if (!plan)
+    {
+        run();
+        return;
+    }
+    const PlanInstruction* begin = plan->instructions.data();
+    run_plan(begin, begin + plan->instructions.size());
+}
+
+void Interpreter::run_plan(const PlanInstruction* begin, const PlanInstruction* end)
+{
+    for (const PlanInstruction* i = begin; i != end; ++i)
+    {
+        WREPORT_PROFILE(plan_instruction_names[i->type]);
+        switch (i->type)
+        {
+            case PlanInstruction::VARIABLE:
+                define_variable(i->info);
+                break;
+            case PlanInstruction::VARIABLE_OR_ATTRIBUTE:
+                if (bitmaps.active())
+                {
+                    // Attribute of the variable pointed by the bitmap
+                    unsigned pos = bitmaps.next();
+                    define_attribute(i->info, pos);
+                } else
+                    define_variable(i->info);
+                break;
+            case PlanInstruction::UNKNOWN_LOCAL:
+                define_variable(tables.get_unknown(i->code, i->count));
+                break;
+            case PlanInstruction::REPLICATION:
+            case PlanInstruction::DELAYED_REPLICATION: {
+                unsigned count = i->count;
+                if (i->type == PlanInstruction::DELAYED_REPLICATION)
+                    count = define_delayed_replication_factor(i->info);
+                const PlanInstruction* body_end = i + 1 + i->length;
+                begin_replication(i->code, count);
+                for (unsigned n = 0; n < count; ++n)
+                    run_plan(i + 1, body_end);
+                end_replication(i->code);
+                i = body_end - 1;
+                break;
+            }
+            case PlanInstruction::BITMAP: {
+                unsigned count = i->count;
+                if (!count)
+                    count = define_bitmap_delayed_replication_factor(i->info);
+                define_bitmap(count);
+                bitmaps.pending_definitions = 0;
+                break;
+            }
+            case PlanInstruction::ASSOCIATED_FIELD:
+                // FIXME: nested C04 modifiers are not currently implemented
+                if (i->count && associated_field.bit_count)
+                    throw error_unimplemented("nested C04 modifiers are not yet implemented");
+                if (i->count)
+                    associated_field.significance = define_associated_field_significance(i->info);
+                associated_field.bit_count = i->count;
+                break;
+            case PlanInstruction::CHARACTER_DATA:
+                define_raw_character_data(i->code);
+                break;
+            case PlanInstruction::BITMAP_PENDING:
+                bitmaps.pending_definitions = i->code;
+                break;
+            case PlanInstruction::SUBSTITUTED_VALUE:
+                if (!bitmaps.active())
+                    error_consistency::throwf("found C23255 while there is no active bitmap");
+                define_substituted_value(bitmaps.next());
+                break;
+            case PlanInstruction::BITMAP_REUSE:
+                bitmaps.reuse_last();
+                bitmaps.pending_definitions = 0;
+                break;
+            case PlanInstruction::BITMAP_DISCARD:
+                bitmaps.discard_last();
+                break;
+            case PlanInstruction::UNSUPPORTED_MODIFIER:
+                notes::logf("ignoring unsupported C modifier %01d%02d%03d", WR_VAR_FXY(i->code));
+                break;
+        }
+    }
+}
+
 Varinfo Interpreter::get_varinfo(Varcode code)
 {
     Varinfo peek = tables.btable->query(code);
@@ -396,12 +530,14 @@ void Interpreter::r_replication(Varcode code, Varcode delayed_code, const Opcode
     }
 
     // encode_data_section on it `count' times
+    begin_replication(code, count);
     for (unsigned i = 0; i < count; ++i)
     {
         opcode_stack.push(ops);
         run_r_repetition(i, count);
         opcode_stack.pop();
     }
+    end_replication(code);
 }
 
 void Interpreter::run_r_repetition(unsigned cur, unsigned total)
@@ -409,6 +545,14 @@ void Interpreter::run_r_repetition(unsigned cur, unsigned total)
     run();
 }
 
+void Interpreter::begin_replication(Varcode code, unsigned count)
+{
+}
+
+void Interpreter::end_replication(Varcode code)
+{
+}
+
 void Interpreter::r_bitmap(Varcode code, Varcode delayed_code, const Opcodes& ops)
 {
     // Get and check the opcode count, which must be 1
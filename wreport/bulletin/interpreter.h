@@ -14,6 +14,7 @@ struct DTable;
 struct Var;
 
 namespace bulletin {
+struct PlanInstruction;
 
 /**
  * Interpreter for data descriptor sections.
@@ -55,6 +56,9 @@ protected:
      */
     Varinfo get_varinfo(Varcode code);
 
+    /// Run the plan instructions from \a begin to \a end
+    void run_plan(const PlanInstruction* begin, const PlanInstruction* end);
+
 public:
     Interpreter(const Tables& tables, const Opcodes& opcodes);
     virtual ~Interpreter();
@@ -65,6 +69,18 @@ public:
     /// Run the interpreter
     void run();
 
+    /**
+     * Run the interpreter using the cached Plan for its tables and opcodes,
+     * compiling it if needed, or using run() if the opcodes cannot be
+     * compiled.
+     *
+     * A plan has D table expansions and C modifiers already resolved, so
+     * b_variable, c_modifier, r_replication, r_bitmap, run_r_repetition and
+     * run_d_expansion are not called: only use this in interpreters that do
+     * not need to override them.
+     */
+    void run_plan();
+
     /**
      * Notify of a B variable entry
      *
@@ -116,6 +132,27 @@ public:
      */
     virtual void run_r_repetition(unsigned cur, unsigned total);
 
+    /**
+     * Notify the start of a replicated section, whose opcodes are going to be
+     * run \a count times.
+     *
+     * By default it does nothing.
+     *
+     * @param code
+     *   The R replication code
+     * @param count
+     *   The number of repetitions
+     */
+    virtual void begin_replication(Varcode code, unsigned count);
+
+    /**
+     * Notify the end of all the repetitions of the replicated section
+     * introduced by the R replication code \a code.
+     *
+     * By default it does nothing.
+     */
+    virtual void end_replication(Varcode code);
+
     /**
      * Executes the expansion of \a code, which has been put on top of the
      * opcode stack.
@@ -0,0 +1,83 @@
+#include "tests.h"
+#include "plan.h"
+#include "wreport/vartable.h"
+#include "wreport/dtable.h"
+#include "utils/string.h"
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+void load_tables(Tables& tables)
+{
+    const char* testdatadir = getenv("WREPORT_TABLES");
+    if (!testdatadir) testdatadir = TABLE_DIR;
+    tables.btable = Vartable::load_bufr(str::joinpath(testdatadir, "B0000000000000014000.txt"));
+    tables.dtable = DTable::load_bufr(str::joinpath(testdatadir, "D0000000000000014000.txt"));
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("compile", []() {
+            Tables tables;
+            load_tables(tables);
+
+            // D table expansions are inlined, and replications know how many
+            // instructions they repeat
+            vector<Varcode> ops { WR_VAR(3, 0, 10) };
+            bulletin::Plan plan(tables, ops);
+            wassert(actual(plan.instructions.size()) == 5u);
+            wassert(actual(plan.instructions[0].type) == bulletin::PlanInstruction::VARIABLE);
+            wassert(actual_varcode(plan.instructions[0].info->code) == WR_VAR(0, 0, 10));
+            wassert(actual(plan.instructions[3].type) == bulletin::PlanInstruction::DELAYED_REPLICATION);
+            wassert(actual(plan.instructions[3].length) == 1u);
+            wassert(actual_varcode(plan.instructions[3].info->code) == WR_VAR(0, 31, 1));
+            wassert(actual_varcode(plan.instructions[4].info->code) == WR_VAR(0, 0, 30));
+        });
+
+        add_method("compile_modifiers", []() {
+            Tables tables;
+            load_tables(tables);
+
+            // C modifiers are resolved at compile time
+            vector<Varcode> ops { WR_VAR(2, 1, 129), WR_VAR(0, 12, 101), WR_VAR(2, 1, 0), WR_VAR(0, 12, 101) };
+            bulletin::Plan plan(tables, ops);
+            wassert(actual(plan.instructions.size()) == 2u);
+            wassert(actual(plan.instructions[0].info->bit_len) == 17u);
+            wassert(actual(plan.instructions[1].info->bit_len) == 16u);
+
+            // Replicated sections cannot change C modifiers, since they are
+            // compiled only once
+            vector<Varcode> bad { WR_VAR(1, 2, 2), WR_VAR(2, 1, 129), WR_VAR(0, 12, 101) };
+            try {
+                bulletin::Plan plan(tables, bad);
+                throw TestFailed("compiling a replicated section that changes C modifiers should fail");
+            } catch (error_unimplemented& e) {
+                wassert(actual(e.what()).contains("changes the C modifiers"));
+            }
+        });
+
+        add_method("cache", []() {
+            Tables tables;
+            load_tables(tables);
+
+            vector<Varcode> ops1 { WR_VAR(3, 0, 10) };
+            vector<Varcode> ops2 { WR_VAR(3, 0, 10) };
+            const bulletin::Plan* plan1 = bulletin::Plan::get(tables, ops1);
+            wassert(actual(plan1 != nullptr).istrue());
+            wassert(actual(bulletin::Plan::get(tables, ops2) == plan1).istrue());
+
+            // Opcodes that cannot be compiled are left to the interpreter
+            vector<Varcode> bad { WR_VAR(1, 2, 2), WR_VAR(2, 1, 129), WR_VAR(0, 12, 101) };
+            wassert(actual(bulletin::Plan::get(tables, bad) == nullptr).istrue());
+        });
+    }
+} test("bulletin_plan");
+
+}
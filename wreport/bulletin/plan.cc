@@ -0,0 +1,364 @@
+#include "plan.h"
+#include "wreport/error.h"
+#include "wreport/dtable.h"
+#include "wreport/vartable.h"
+#include "wreport/tables.h"
+#include "wreport/internals/concurrent.h"
+#include <algorithm>
+#include <memory>
+
+// #define TRACE_PLAN
+
+#ifdef TRACE_PLAN
+#define TRACE(...) fprintf(stderr, __VA_ARGS__)
+#define IFTRACE if (1)
+#else
+#define TRACE(...) do { } while (0)
+#define IFTRACE if (0)
+#endif
+
+using namespace std;
+
+namespace wreport {
+namespace bulletin {
+
+namespace {
+
+/**
+ * Interpreter state that is known at compile time, and that affects how the
+ * opcodes are compiled
+ */
+struct CompileState
+{
+    int c_scale_change = 0;
+    int c_width_change = 0;
+    int c_scale_ref_width_increase = 0;
+    int c_string_len_override = 0;
+    Varcode bitmap_pending_definitions = 0;
+
+    bool operator==(const CompileState& o) const
+    {
+        return c_scale_change == o.c_scale_change
+            && c_width_change == o.c_width_change
+            && c_scale_ref_width_increase == o.c_scale_ref_width_increase
+            && c_string_len_override == o.c_string_len_override
+            && bitmap_pending_definitions == o.bitmap_pending_definitions;
+    }
+    bool operator!=(const CompileState& o) const { return !operator==(o); }
+};
+
+/**
+ * Compile opcodes into a plan, following the same logic as
+ * Interpreter::run()
+ */
+struct Compiler
+{
+    const Tables& tables;
+    std::vector<PlanInstruction>& out;
+    CompileState state;
+
+    Compiler(const Tables& tables, std::vector<PlanInstruction>& out)
+        : tables(tables), out(out) {}
+
+    /// Same as Interpreter::get_varinfo
+    Varinfo get_varinfo(Varcode code)
+    {
+        Varinfo peek = tables.btable->query(code);
+
+        if (!state.c_scale_change && !state.c_width_change && !state.c_string_len_override && !state.c_scale_ref_width_increase)
+            return peek;
+
+        int scale = peek->scale;
+        if (state.c_scale_change)
+            scale += state.c_scale_change;
+
+        int bit_len = peek->bit_len;
+        if (peek->type == Vartype::String && state.c_string_len_override)
+            bit_len = state.c_string_len_override * 8;
+        else if (state.c_width_change)
+            bit_len += state.c_width_change;
+
+        if (state.c_scale_ref_width_increase)
+        {
+            scale += state.c_scale_ref_width_increase;
+            bit_len += (10 * state.c_scale_ref_width_increase + 2) / 3;
+        }
+
+        return tables.btable->query_altered(code, scale, bit_len);
+    }
+
+    void compile(Opcodes opcodes)
+    {
+        while (!opcodes.empty())
+        {
+            Varcode cur = opcodes.pop_left();
+            switch (WR_VAR_F(cur))
+            {
+                case 0:
+                    if (WR_VAR_X(cur) == 33)
+                        out.emplace_back(PlanInstruction::VARIABLE_OR_ATTRIBUTE, cur, 0, 0, get_varinfo(cur));
+                    else
+                        out.emplace_back(PlanInstruction::VARIABLE, cur, 0, 0, get_varinfo(cur));
+                    break;
+                case 1: {
+                    Varcode delayed_replication_code = 0;
+                    unsigned count = WR_VAR_Y(cur);
+                    if (count == 0 && !opcodes.empty())
+                    {
+                        Varcode next_code = opcodes[0];
+                        if (WR_VAR_F(next_code) == 0 && WR_VAR_X(next_code) == 31)
+                            delayed_replication_code = opcodes.pop_left();
+                    }
+                    if (count == 0 && !delayed_replication_code)
+                        delayed_replication_code = WR_VAR(0, 31, 12);
+
+                    if (state.bitmap_pending_definitions)
+                        compile_bitmap(cur, delayed_replication_code, opcodes.pop_left(WR_VAR_X(cur)));
+                    else
+                        compile_replication(cur, delayed_replication_code, opcodes.pop_left(WR_VAR_X(cur)));
+                    break;
+                }
+                case 2:
+                    compile_c_modifier(cur, opcodes);
+                    break;
+                case 3:
+                    compile(tables.dtable->query(cur));
+                    break;
+                default:
+                    error_consistency::throwf("cannot handle opcode %01d%02d%03d", WR_VAR_FXY(cur));
+            }
+        }
+    }
+
+    void compile_replication(Varcode code, Varcode delayed_code, const Opcodes& ops)
+    {
+        size_t pos = out.size();
+        if (unsigned count = WR_VAR_Y(code))
+            out.emplace_back(PlanInstruction::REPLICATION, code, count);
+        else
+            out.emplace_back(PlanInstruction::DELAYED_REPLICATION, code, 0, 0, tables.btable->query(delayed_code));
+
+        // The replicated instructions are compiled only once, so they must
+        // leave the state as they found it
+        CompileState entry = state;
+        compile(ops);
+        if (state != entry)
+            error_unimplemented::throwf("replicated section %01d%02d%03d changes the C modifiers in effect", WR_VAR_FXY(code));
+
+        out[pos].length = out.size() - pos - 1;
+    }
+
+    void compile_bitmap(Varcode code, Varcode delayed_code, const Opcodes& ops)
+    {
+        unsigned opcode_count = WR_VAR_X(code);
+        if (opcode_count != 1)
+            error_consistency::throwf("bitmap section replicates %u descriptors instead of one", opcode_count);
+        if (ops[0] != WR_VAR(0, 31, 31))
+            error_consistency::throwf("bitmap element descriptor is %01d%02d%03d instead of B31031", WR_VAR_FXY(ops[0]));
+
+        if (unsigned count = WR_VAR_Y(code))
+            out.emplace_back(PlanInstruction::BITMAP, code, count);
+        else
+            out.emplace_back(PlanInstruction::BITMAP, code, 0, 0, tables.btable->query(delayed_code));
+        state.bitmap_pending_definitions = 0;
+    }
+
+    void compile_c_modifier(Varcode code, Opcodes& next)
+    {
+        switch (WR_VAR_X(code))
+        {
+            case 1:
+                state.c_width_change = WR_VAR_Y(code) ? WR_VAR_Y(code) - 128 : 0;
+                break;
+            case 2:
+                state.c_scale_change = WR_VAR_Y(code) ? WR_VAR_Y(code) - 128 : 0;
+                break;
+            case 4: {
+                unsigned nbits = WR_VAR_Y(code);
+                if (nbits > 32)
+                    error_unimplemented::throwf("C04 modifier wants %d bits but only at most 32 are supported", nbits);
+                if (nbits)
+                {
+                    Varcode sig_code = next.pop_left();
+                    if (sig_code != WR_VAR(0, 31, 21))
+                        error_consistency::throwf("C04%03i modifier is followed by data descriptor %01d%02d%03d instead of B31021",
+                                nbits, WR_VAR_FXY(sig_code));
+                    out.emplace_back(PlanInstruction::ASSOCIATED_FIELD, code, nbits, 0, tables.btable->query(WR_VAR(0, 31, 21)));
+                } else
+                    out.emplace_back(PlanInstruction::ASSOCIATED_FIELD, code);
+                break;
+            }
+            case 5:
+                out.emplace_back(PlanInstruction::CHARACTER_DATA, code);
+                break;
+            case 6: {
+                Varcode desc_code = next.pop_left();
+                if (unsigned nbits = WR_VAR_Y(code))
+                {
+                    if (tables.btable->contains(desc_code))
+                    {
+                        Varinfo info = get_varinfo(desc_code);
+                        if (info->bit_len == nbits)
+                        {
+                            out.emplace_back(PlanInstruction::VARIABLE, desc_code, 0, 0, info);
+                            break;
+                        }
+                    }
+                    out.emplace_back(PlanInstruction::UNKNOWN_LOCAL, desc_code, nbits);
+                }
+                break;
+            }
+            case 7:
+                state.c_scale_ref_width_increase = WR_VAR_Y(code);
+                break;
+            case 8:
+                state.c_string_len_override = WR_VAR_Y(code);
+                break;
+            case 22:
+                if (WR_VAR_Y(code) != 0)
+                    error_consistency::throwf("C modifier %d%02d%03d not yet supported", WR_VAR_FXY(code));
+                state.bitmap_pending_definitions = code;
+                out.emplace_back(PlanInstruction::BITMAP_PENDING, code);
+                break;
+            case 23:
+                switch (WR_VAR_Y(code))
+                {
+                    case 0:
+                        state.bitmap_pending_definitions = code;
+                        out.emplace_back(PlanInstruction::BITMAP_PENDING, code);
+                        break;
+                    case 255:
+                        out.emplace_back(PlanInstruction::SUBSTITUTED_VALUE, code);
+                        break;
+                    default:
+                        error_consistency::throwf("C modifier %d%02d%03d not yet supported", WR_VAR_FXY(code));
+                }
+                break;
+            case 36:
+                break;
+            case 37:
+                switch (WR_VAR_Y(code))
+                {
+                    case 0:
+                        state.bitmap_pending_definitions = 0;
+                        out.emplace_back(PlanInstruction::BITMAP_REUSE, code);
+                        break;
+                    case 255:
+                        out.emplace_back(PlanInstruction::BITMAP_DISCARD, code);
+                        break;
+                    default:
+                        error_consistency::throwf("C modifier %d%02d%03d uses unsupported y=%03d",
+                                WR_VAR_FXY(code), WR_VAR_Y(code));
+                }
+                break;
+            default:
+                out.emplace_back(PlanInstruction::UNSUPPORTED_MODIFIER, code);
+                break;
+        }
+    }
+};
+
+/**
+ * Key for the plan cache.
+ *
+ * The opcodes are not copied: keys in the cache point to the opcodes stored
+ * in CachedPlan, and keys used for lookups point to the opcodes being looked
+ * up.
+ */
+struct PlanKey
+{
+    const Vartable* btable;
+    const DTable* dtable;
+    Opcodes opcodes;
+
+    PlanKey(const Tables& tables, const Opcodes& opcodes)
+        : btable(tables.btable), dtable(tables.dtable), opcodes(opcodes) {}
+
+    bool operator<(const PlanKey& o) const
+    {
+        if (btable != o.btable) return btable < o.btable;
+        if (dtable != o.dtable) return dtable < o.dtable;
+        return std::lexicographical_compare(opcodes.begin, opcodes.end, o.opcodes.begin, o.opcodes.end);
+    }
+
+    bool operator==(const PlanKey& o) const
+    {
+        return btable == o.btable && dtable == o.dtable
+            && opcodes.size() == o.opcodes.size()
+            && std::equal(opcodes.begin, opcodes.end, o.opcodes.begin);
+    }
+};
+
+struct PlanKeyHash
+{
+    size_t operator()(const PlanKey& key) const
+    {
+        size_t res = std::hash<const void*>()(key.btable) ^ std::hash<const void*>()(key.dtable);
+        for (const Varcode* i = key.opcodes.begin; i != key.opcodes.end; ++i)
+            res = res * 31 + *i;
+        return res;
+    }
+};
+
+struct CachedPlan
+{
+    /// Copy of the opcodes used in the cache key
+    std::vector<Varcode> opcodes;
+    /// Compiled plan, or nullptr if the opcodes cannot be compiled
+    std::unique_ptr<Plan> plan;
+};
+
+typedef ConcurrentMap<PlanKey, std::unique_ptr<CachedPlan>, PlanKeyHash> PlanCache;
+
+PlanCache& plan_cache()
+{
+    static PlanCache* cache = new PlanCache(1024);
+    return *cache;
+}
+
+}
+
+Plan::Plan(const Tables& tables, const Opcodes& opcodes)
+{
+    Compiler compiler(tables, instructions);
+    compiler.compile(opcodes);
+}
+
+void Plan::print(FILE* out) const
+{
+    static const char* names[] = {
+        "variable", "variable or attribute", "unknown local", "replication",
+        "delayed replication", "bitmap", "associated field", "character data",
+        "bitmap pending", "substituted value", "bitmap reuse", "bitmap discard",
+        "unsupported modifier",
+    };
+    for (const auto& i: instructions)
+    {
+        fprintf(out, "%01d%02d%03d %s", WR_VAR_FXY(i.code), names[i.type]);
+        if (i.count) fprintf(out, " count:%u", i.count);
+        if (i.length) fprintf(out, " length:%u", i.length);
+        if (i.info) fprintf(out, " info:%01d%02d%03d bits:%u scale:%d", WR_VAR_FXY(i.info->code), i.info->bit_len, i.info->scale);
+        putc('\n', out);
+    }
+}
+
+const Plan* Plan::get(const Tables& tables, const Opcodes& opcodes)
+{
+    const auto& cached = plan_cache().obtain(PlanKey(tables, opcodes), [&]() {
+        unique_ptr<CachedPlan> cached(new CachedPlan);
+        cached->opcodes.assign(opcodes.begin, opcodes.end);
+        try {
+            cached->plan.reset(new Plan(tables, opcodes));
+        } catch (std::exception& e) {
+            // Leave the opcodes to the interpreter, which will report errors
+            // only if and when they are reached
+            TRACE("plan: cannot compile opcodes: %s\n", e.what());
+        }
+        PlanKey key(tables, Opcodes(cached->opcodes));
+        return make_pair(key, move(cached));
+    });
+    return cached->plan.get();
+}
+
+}
+}
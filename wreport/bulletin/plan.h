@@ -0,0 +1,119 @@
+#ifndef WREPORT_BULLETIN_PLAN_H
+#define WREPORT_BULLETIN_PLAN_H
+
+#include <wreport/varinfo.h>
+#include <wreport/opcodes.h>
+#include <vector>
+#include <cstdio>
+
+namespace wreport {
+struct Tables;
+
+namespace bulletin {
+
+/**
+ * Instruction in a compiled Plan
+ */
+struct PlanInstruction
+{
+    enum Type {
+        /// Data variable described by info
+        VARIABLE,
+        /**
+         * Class 33 variable described by info: it is an attribute of the
+         * variable pointed by the bitmap, if a bitmap is active, or a data
+         * variable otherwise
+         */
+        VARIABLE_OR_ATTRIBUTE,
+        /// C06 local descriptor \a code of \a count bits not found in table B
+        UNKNOWN_LOCAL,
+        /// Repeat the next \a length instructions \a count times
+        REPLICATION,
+        /**
+         * Repeat the next \a length instructions a number of times given by
+         * the delayed replication factor described by info
+         */
+        DELAYED_REPLICATION,
+        /**
+         * Data present bitmap of \a count bits, or of a length given by the
+         * delayed replication factor described by info if \a count is 0
+         */
+        BITMAP,
+        /**
+         * C04 associated field of \a count bits, with significance described
+         * by info
+         */
+        ASSOCIATED_FIELD,
+        /// C05 raw character data
+        CHARACTER_DATA,
+        /// C22000 or C23000: a data present bitmap is expected
+        BITMAP_PENDING,
+        /// C23255 substituted value
+        SUBSTITUTED_VALUE,
+        /// C37000 reuse the last defined bitmap
+        BITMAP_REUSE,
+        /// C37255 cancel reuse of the last defined bitmap
+        BITMAP_DISCARD,
+        /// C modifier that is not supported and is ignored
+        UNSUPPORTED_MODIFIER,
+    };
+
+    /// Instruction type
+    Type type;
+    /// Opcode that generated this instruction
+    Varcode code;
+    /// Repetition count or number of bits, according to type
+    unsigned count;
+    /// Number of instructions in a replicated section
+    unsigned length;
+    /// Resolved Varinfo, if type needs one
+    Varinfo info;
+
+    PlanInstruction(Type type, Varcode code, unsigned count=0, unsigned length=0, Varinfo info=nullptr)
+        : type(type), code(code), count(count), length(length), info(info) {}
+};
+
+/**
+ * Data descriptor section compiled into a flat list of instructions.
+ *
+ * D table expansions are inlined, and B table entries are resolved into
+ * Varinfos with all the relevant C modifications applied, so that running
+ * the plan does not need any table lookup.
+ *
+ * Plans are cached by B table, D table and data descriptor section, and can
+ * be reused to decode or encode all the bulletins with the same layout.
+ */
+struct Plan
+{
+    /// Compiled instructions
+    std::vector<PlanInstruction> instructions;
+
+    /**
+     * Compile the plan for \a opcodes.
+     *
+     * Throws an exception if the opcodes cannot be compiled into a plan, for
+     * example because they are invalid, or because a replicated section
+     * changes the C modifiers in effect when it is repeated.
+     */
+    Plan(const Tables& tables, const Opcodes& opcodes);
+
+    /// Print the plan instructions to \a out
+    void print(FILE* out) const;
+
+    /**
+     * Return the cached plan for \a opcodes interpreted with \a tables,
+     * compiling it if needed.
+     *
+     * This can be called from multiple threads, and takes no locks if the
+     * plan is already in the cache.
+     *
+     * @returns the plan, or nullptr if \a opcodes cannot be compiled into a
+     * plan and need to be interpreted instead
+     */
+    static const Plan* get(const Tables& tables, const Opcodes& opcodes);
+};
+
+}
+}
+
+#endif
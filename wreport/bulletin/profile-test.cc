@@ -0,0 +1,53 @@
+#include "tests.h"
+#include "profile.h"
+#include "wreport/bulletin.h"
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("decode", []() {
+            std::string raw = tests::slurpfile("bufr/obs0-1.22.bufr");
+
+            bulletin::Profile profile;
+            bulletin::Profile::start(profile);
+            try {
+                BufrBulletin::decode(raw);
+            } catch (...) {
+                bulletin::Profile::stop();
+                throw;
+            }
+            bulletin::Profile::stop();
+
+            if (!bulletin::Profile::available())
+            {
+                // Without profiling compiled in, nothing is collected
+                wassert(actual(profile.classes.empty()).istrue());
+                wassert(actual(profile.sequences.empty()).istrue());
+                return;
+            }
+
+            // Plans are skipped, and every opcode is accounted for
+            wassert(actual(profile.classes["interpreter run"].count) == 1u);
+            wassert(actual(profile.classes["B variable"].count) > 0u);
+            wassert(actual(profile.classes["B variable"].bits) > 0u);
+            wassert(actual(profile.classes["D expansion"].count) > 0u);
+            wassert(actual(profile.sequences.empty()).isfalse());
+
+            // Nothing is collected after stop()
+            auto count = profile.classes["B variable"].count;
+            BufrBulletin::decode(raw);
+            wassert(actual(profile.classes["B variable"].count) == count);
+        });
+    }
+} test("bulletin_profile");
+
+}
@@ -0,0 +1,142 @@
+#include "profile.h"
+#include "config.h"
+#include "wreport/internals/profile.h"
+#include "wreport/buffers/bufr.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+namespace wreport {
+namespace bulletin {
+
+#ifdef WREPORT_PROFILE_INTERPRETER
+namespace {
+
+/// Profiling state of a thread
+struct State
+{
+    Profile* profile = nullptr;
+    const buffers::BufrInput* input = nullptr;
+    profile::Scope* current = nullptr;
+};
+
+thread_local State state;
+
+}
+
+namespace profile {
+
+Scope::Scope(const char* name, Varcode code, bool outermost)
+{
+    if (!state.profile) return;
+    if (outermost && state.current) return;
+
+    if (WR_VAR_F(code) == 2)
+    {
+        char buf[64];
+        snprintf(buf, 64, "%s C%02d", name, WR_VAR_X(code));
+        entry = &state.profile->classes[buf];
+    } else
+        entry = &state.profile->classes[name];
+    if (WR_VAR_F(code) == 3)
+        sequence = &state.profile->sequences[code];
+    if (state.input)
+        start_bits_left = state.input->bits_left();
+    parent = state.current;
+    state.current = this;
+    start = std::chrono::steady_clock::now();
+}
+
+Scope::~Scope()
+{
+    if (!entry) return;
+    unsigned long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    unsigned long long bits = 0;
+    if (state.input && state.input->bits_left() <= start_bits_left)
+        bits = start_bits_left - state.input->bits_left();
+    unsigned long long self = elapsed > children_ns ? elapsed - children_ns : 0;
+    for (ProfileEntry* e: { entry, sequence })
+    {
+        if (!e) continue;
+        ++e->count;
+        e->bits += bits;
+        e->total_ns += elapsed;
+        e->self_ns += self;
+    }
+    if (parent)
+        parent->children_ns += elapsed;
+    state.current = parent;
+}
+
+bool use_plans()
+{
+    return !state.profile || state.profile->use_plans;
+}
+
+}
+
+bool Profile::available() { return true; }
+
+void Profile::start(Profile& profile)
+{
+    state.profile = &profile;
+    state.current = nullptr;
+}
+
+void Profile::stop()
+{
+    state.profile = nullptr;
+    state.current = nullptr;
+}
+
+void Profile::set_input(const buffers::BufrInput* in)
+{
+    state.input = in;
+}
+#else
+bool Profile::available() { return false; }
+void Profile::start(Profile& profile) {}
+void Profile::stop() {}
+void Profile::set_input(const buffers::BufrInput* in) {}
+#endif
+
+namespace {
+
+template<typename Key>
+void print_entries(FILE* out, const map<Key, ProfileEntry>& entries, std::function<string(const Key&)> format)
+{
+    vector<const typename map<Key, ProfileEntry>::value_type*> sorted;
+    unsigned long long self_total = 0;
+    for (const auto& e: entries)
+    {
+        sorted.push_back(&e);
+        self_total += e.second.self_ns;
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const typename map<Key, ProfileEntry>::value_type* a, const typename map<Key, ProfileEntry>::value_type* b) {
+        return a->second.self_ns > b->second.self_ns;
+    });
+
+    fprintf(out, "%12s %14s %12s %12s %7s  %s\n", "count", "bits", "total ms", "self ms", "self%", "name");
+    for (const auto* e: sorted)
+        fprintf(out, "%12llu %14llu %12.3f %12.3f %6.1f%%  %s\n",
+                e->second.count, e->second.bits,
+                e->second.total_ns / 1000000.0, e->second.self_ns / 1000000.0,
+                self_total ? e->second.self_ns * 100.0 / self_total : 0.0,
+                format(e->first).c_str());
+}
+
+}
+
+void Profile::print(FILE* out) const
+{
+    fprintf(out, "Time by class of construct (%s):\n", use_plans ? "running precompiled plans" : "running opcodes");
+    print_entries<string>(out, classes, [](const string& name) { return name; });
+    if (sequences.empty()) return;
+    fprintf(out, "\nTime by D sequence (total includes nested sequences):\n");
+    print_entries<Varcode>(out, sequences, [](const Varcode& code) { return varcode_format(code); });
+}
+
+}
+}
@@ -0,0 +1,79 @@
+#ifndef WREPORT_BULLETIN_PROFILE_H
+#define WREPORT_BULLETIN_PROFILE_H
+
+#include <wreport/varinfo.h>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace wreport {
+
+namespace buffers {
+class BufrInput;
+}
+
+namespace bulletin {
+
+/// Counters for one kind of data descriptor section construct
+struct ProfileEntry
+{
+    /// Number of times the construct was interpreted
+    unsigned long long count = 0;
+    /// Bits of input consumed, including nested constructs
+    unsigned long long bits = 0;
+    /// Nanoseconds spent, including nested constructs
+    unsigned long long total_ns = 0;
+    /// Nanoseconds spent, excluding nested constructs
+    unsigned long long self_ns = 0;
+};
+
+/**
+ * Time and input spent interpreting data descriptor sections, by class of
+ * opcode and by D sequence.
+ *
+ * Profiling has a cost on every opcode, and it is only compiled in if
+ * wreport is configured with --enable-interpreter-profile: otherwise,
+ * available() returns false and profiles stay empty.
+ *
+ * Profiles are collected per thread, from when start() is called until
+ * stop() is called.
+ */
+struct Profile
+{
+    /// Counters by class of construct, like "B variable" or "C04 modifier"
+    std::map<std::string, ProfileEntry> classes;
+
+    /// Counters by D sequence
+    std::map<Varcode, ProfileEntry> sequences;
+
+    /**
+     * If false, Interpreter::run_plan() runs the opcodes instead of the
+     * precompiled plan, so that D expansions, C modifiers and replications
+     * are profiled individually. If true, plans are used, and the profile
+     * shows plan instructions.
+     */
+    bool use_plans = false;
+
+    /// Print a report, sorted by time
+    void print(FILE* out) const;
+
+    /// Check if profiling has been compiled in
+    static bool available();
+
+    /// Collect profiling information for the current thread into \a profile
+    static void start(Profile& profile);
+
+    /// Stop collecting profiling information for the current thread
+    static void stop();
+
+    /**
+     * Set the input buffer that the current thread is decoding, to count the
+     * bits consumed by each construct. Use nullptr to unset it.
+     */
+    static void set_input(const buffers::BufrInput* in);
+};
+
+}
+}
+
+#endif
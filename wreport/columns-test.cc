@@ -0,0 +1,100 @@
+#include "tests.h"
+#include "columns.h"
+#include "bulletin.h"
+#include "vartable.h"
+#include <cmath>
+#include <cstring>
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("column", []() {
+            const Vartable* table = Vartable::get_bufr("B0000000000000024000");
+            Column col(table->query(WR_VAR(0, 12, 101)), 3);
+            wassert(actual(col.size()) == 3u);
+            wassert(actual(col.isset(0)).isfalse());
+
+            col.seti(0, 27315);
+            col.set(2, Var(col.info(), 280.0));
+            wassert(actual(col.isset(0)).istrue());
+            wassert(actual(col.isset(1)).isfalse());
+            wassert(actual(col.enqi(0)) == 27315);
+            wassert(actual(col.enqd(0)) == 273.15);
+            wassert(actual(col.enqd(2)) == 280.0);
+
+            vector<double> vals = col.doubles(-1);
+            wassert(actual(vals.size()) == 3u);
+            wassert(actual(vals[0]) == 273.15);
+            wassert(actual(vals[1]) == -1.0);
+            wassert(actual(vals[2]) == 280.0);
+
+            // Attributes are materialised together with the value
+            col.obtain_attr(table->query(WR_VAR(0, 33, 7))).seti(0, 70);
+            wassert(actual(col.attrs().size()) == 1u);
+            wassert(actual(col.attr(WR_VAR(0, 33, 7)) != nullptr).istrue());
+            Var var = col.var(0);
+            wassert(actual(var.enqd()) == 273.15);
+            wassert(actual(var.enqa(WR_VAR(0, 33, 7))->enqi()) == 70);
+            wassert(actual(col.var(1).isset()).isfalse());
+
+            try {
+                col.enqd(1);
+                throw TestFailed("enqd on an unset value should have failed");
+            } catch (error_notfound& e) {
+                wassert(actual(e.what()).contains("012101"));
+            }
+
+            Column str(table->query(WR_VAR(0, 1, 19)), 2);
+            str.setc(1, "test");
+            wassert(actual(str.isset(0)).isfalse());
+            wassert(actual(str.enqc(1)) == "test");
+            wassert(actual(str.var(1).enqc()) == "test");
+        });
+
+        add_method("decode", []() {
+            // Decoding by column gives the same values as decoding by subset
+            unsigned compressed = 0;
+            for (const auto& msg: tests::all_bufr_messages())
+            {
+                unique_ptr<BufrBulletin> expected;
+                try {
+                    expected = BufrBulletin::decode(msg.data, msg.fname.c_str());
+                } catch (std::exception&) {
+                    continue;
+                }
+
+                Columns columns;
+                unique_ptr<BufrBulletin> bulletin;
+                try {
+                    bulletin = BufrBulletin::decode_columns(msg.data.data(), msg.data.size(), columns, msg.fname.c_str());
+                } catch (error_consistency& e) {
+                    // Uncompressed subsets can have different structures
+                    wassert(actual(expected->compression).isfalse());
+                    wassert(actual(e.what()).contains("like subset 0"));
+                    continue;
+                }
+                wassert(actual(bulletin->subsets.empty()).istrue());
+                if (bulletin->compression) ++compressed;
+                wassert(actual(columns.subset_count) == expected->subsets.size());
+                for (unsigned i = 0; i < columns.subset_count; ++i)
+                {
+                    Subset subset(bulletin->tables);
+                    columns.to_subset(i, subset);
+                    wassert(actual(subset.diff(expected->subsets[i])) == 0u);
+                }
+            }
+            wassert(actual(compressed) > 10u);
+        });
+    }
+} test("columns");
+
+}
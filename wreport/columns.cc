@@ -0,0 +1,293 @@
+#include "columns.h"
+#include "subset.h"
+#include "visitor.h"
+#include "options.h"
+#include "error.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace wreport {
+
+Column::Column(Varinfo info, unsigned size)
+    : m_info(info), m_size(size), m_missing(size, true), m_present(size, false)
+{
+    switch (info->type)
+    {
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            m_ints.resize(size);
+            break;
+        case Vartype::String:
+        case Vartype::Binary:
+            m_strings.resize(size);
+            break;
+    }
+}
+
+void Column::check_isset(const char* func, unsigned idx) const
+{
+    if (m_missing[idx])
+        error_notfound::throwf("%s: %01d%02d%03d (%s) is not defined in subset %u",
+                func, WR_VAR_FXY(m_info->code), m_info->desc, idx);
+}
+
+int Column::enqi(unsigned idx) const
+{
+    check_isset("enqi", idx);
+    switch (m_info->type)
+    {
+        case Vartype::String:
+            error_type::throwf("enqi: %01d%02d%03d (%s) is a string",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+        case Vartype::Binary:
+            error_type::throwf("enqi: %01d%02d%03d (%s) is an opaque binary",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            return m_ints[idx];
+    }
+    error_consistency::throwf("unknown variable type %d", (int)m_info->type);
+}
+
+double Column::enqd(unsigned idx) const
+{
+    check_isset("enqd", idx);
+    switch (m_info->type)
+    {
+        case Vartype::String:
+            error_type::throwf("enqd: %01d%02d%03d (%s) is a string",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+        case Vartype::Binary:
+            error_type::throwf("enqd: %01d%02d%03d (%s) is an opaque binary",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+        case Vartype::Integer:
+            return m_ints[idx];
+        case Vartype::Decimal:
+            return m_info->decode_decimal(m_ints[idx]);
+    }
+    error_consistency::throwf("unknown variable type %d", (int)m_info->type);
+}
+
+const char* Column::enqc(unsigned idx) const
+{
+    check_isset("enqc", idx);
+    switch (m_info->type)
+    {
+        case Vartype::String:
+        case Vartype::Binary:
+            return m_strings[idx].c_str();
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            error_type::throwf("enqc: %01d%02d%03d (%s) is a number, use Column::var to format it",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+    }
+    error_consistency::throwf("unknown variable type %d", (int)m_info->type);
+}
+
+std::vector<double> Column::doubles(double missing_value) const
+{
+    std::vector<double> res;
+    res.reserve(m_size);
+    switch (m_info->type)
+    {
+        case Vartype::String:
+            error_type::throwf("doubles: %01d%02d%03d (%s) is a string",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+        case Vartype::Binary:
+            error_type::throwf("doubles: %01d%02d%03d (%s) is an opaque binary",
+                    WR_VAR_FXY(m_info->code), m_info->desc);
+        case Vartype::Integer:
+            for (unsigned i = 0; i < m_size; ++i)
+                res.push_back(m_missing[i] ? missing_value : m_ints[i]);
+            break;
+        case Vartype::Decimal:
+            for (unsigned i = 0; i < m_size; ++i)
+                res.push_back(m_missing[i] ? missing_value : m_info->decode_decimal(m_ints[i]));
+            break;
+    }
+    return res;
+}
+
+void Column::seti(unsigned idx, int32_t val)
+{
+    // Guard against overflows, like Var does
+    m_present[idx] = true;
+    if (val < m_info->imin || val > m_info->imax)
+    {
+        m_missing[idx] = true;
+        if (options::var_silent_domain_errors)
+            return;
+        error_domain::throwf("Value %i is outside the range [%i,%i] for %01d%02d%03d (%s)",
+                (int)val, m_info->imin, m_info->imax, WR_VAR_FXY(m_info->code), m_info->desc);
+    }
+    m_ints[idx] = val;
+    m_missing[idx] = false;
+}
+
+void Column::setc(unsigned idx, const char* val)
+{
+    switch (m_info->type)
+    {
+        case Vartype::String:
+            m_strings[idx] = val;
+            break;
+        case Vartype::Binary:
+            m_strings[idx].assign(val, m_info->len);
+            break;
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            set(idx, Var(m_info, val));
+            return;
+    }
+    m_missing[idx] = false;
+    m_present[idx] = true;
+}
+
+void Column::set(unsigned idx, const Var& var)
+{
+    if (!var.isset())
+    {
+        unset(idx);
+        return;
+    }
+
+    switch (m_info->type)
+    {
+        case Vartype::String:
+        case Vartype::Binary:
+            setc(idx, var.enqc());
+            break;
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            if (var.info() == m_info)
+                seti(idx, var.enqi());
+            else
+                seti(idx, Var(m_info, var).enqi());
+            break;
+    }
+}
+
+void Column::set(unsigned idx, const DecodedValue& val)
+{
+    if (val.missing)
+    {
+        unset(idx);
+        return;
+    }
+
+    switch (m_info->type)
+    {
+        case Vartype::String:
+        case Vartype::Binary:
+            setc(idx, val.cval);
+            break;
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            seti(idx, val.ival);
+            break;
+    }
+}
+
+void Column::set_all(const Var& var)
+{
+    for (unsigned i = 0; i < m_size; ++i)
+        set(i, var);
+}
+
+void Column::unset(unsigned idx)
+{
+    m_missing[idx] = true;
+    m_present[idx] = true;
+    if (!m_strings.empty())
+        m_strings[idx].clear();
+}
+
+const Column* Column::attr(Varcode code) const
+{
+    for (const auto& a: m_attrs)
+        if (a.code() == code)
+            return &a;
+    return nullptr;
+}
+
+Column& Column::obtain_attr(Varinfo info)
+{
+    auto i = lower_bound(m_attrs.begin(), m_attrs.end(), info->code, [](const Column& c, Varcode code) { return c.code() < code; });
+    if (i != m_attrs.end() && i->code() == info->code)
+        return *i;
+    return *m_attrs.emplace(i, info, m_size);
+}
+
+Var Column::var(unsigned idx) const
+{
+    Var res(m_info);
+    if (!m_missing[idx])
+    {
+        switch (m_info->type)
+        {
+            case Vartype::String:
+            case Vartype::Binary:
+                res.setc(m_strings[idx].c_str());
+                break;
+            case Vartype::Integer:
+            case Vartype::Decimal:
+                res.seti(m_ints[idx]);
+                break;
+        }
+    }
+    for (const auto& a: m_attrs)
+        if (a.present(idx))
+            res.seta(a.var(idx));
+    return res;
+}
+
+
+void Columns::clear()
+{
+    subset_count = 0;
+    columns.clear();
+}
+
+Column& Columns::append(Varinfo info)
+{
+    columns.emplace_back(info, subset_count);
+    return columns.back();
+}
+
+void Columns::from_subsets(const std::vector<Subset>& subsets)
+{
+    clear();
+    subset_count = subsets.size();
+    if (subsets.empty()) return;
+
+    const Subset& first = subsets[0];
+    for (unsigned s = 1; s < subsets.size(); ++s)
+        if (subsets[s].size() != first.size())
+            error_consistency::throwf("subset %u has %zu variables instead of %zu like subset 0", s, subsets[s].size(), first.size());
+
+    columns.reserve(first.size());
+    for (unsigned pos = 0; pos < first.size(); ++pos)
+    {
+        Column& col = append(first[pos].info());
+        for (unsigned s = 0; s < subsets.size(); ++s)
+        {
+            const Var& var = subsets[s][pos];
+            if (var.code() != col.code())
+                error_consistency::throwf("variable %u of subset %u is %01d%02d%03d instead of %01d%02d%03d like in subset 0",
+                        pos, s, WR_VAR_FXY(var.code()), WR_VAR_FXY(col.code()));
+            col.set(s, var);
+            for (const Var* a = var.next_attr(); a; a = a->next_attr())
+                col.obtain_attr(a->info()).set(s, *a);
+        }
+    }
+}
+
+void Columns::to_subset(unsigned idx, Subset& dest) const
+{
+    dest.reserve(dest.size() + columns.size());
+    for (const auto& col: columns)
+        dest.store_variable(col.var(idx));
+}
+
+}
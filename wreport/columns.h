@@ -0,0 +1,197 @@
+#ifndef WREPORT_COLUMNS_H
+#define WREPORT_COLUMNS_H
+
+#include <wreport/var.h>
+#include <vector>
+#include <string>
+
+namespace wreport {
+struct Subset;
+struct DecodedValue;
+
+/**
+ * Values of one variable in all the subsets of a bulletin.
+ *
+ * A column stores a single Varinfo for all its values, and the values
+ * themselves in typed arrays, so that reading a column does not require
+ * creating a Var for each value.
+ *
+ * Integer and decimal values are stored as in Var, as integers that can be
+ * converted to decimal values using Varinfo::decode_decimal. String and
+ * binary values are stored as strings.
+ */
+class Column
+{
+protected:
+    /// Varinfo shared by all the values
+    Varinfo m_info;
+
+    /// Number of values
+    unsigned m_size;
+
+    /// Integer and decimal values
+    std::vector<int32_t> m_ints;
+
+    /// String and binary values
+    std::vector<std::string> m_strings;
+
+    /// Missing value bitmap: true for values that are not set
+    std::vector<bool> m_missing;
+
+    /**
+     * Presence bitmap, used for attribute columns: a variable can have an
+     * attribute that is not set, or not have the attribute at all
+     */
+    std::vector<bool> m_present;
+
+    /// Attribute columns, sorted by varcode
+    std::vector<Column> m_attrs;
+
+    /// Raise error_notfound if value \a idx is not set
+    void check_isset(const char* func, unsigned idx) const;
+
+public:
+    /// Create a column of \a size unset values
+    Column(Varinfo info, unsigned size);
+
+    /// Return the Varinfo shared by all the values
+    Varinfo info() const { return m_info; }
+
+    /// Return the varcode shared by all the values
+    Varcode code() const { return m_info->code; }
+
+    /// Return the number of values, one per subset
+    unsigned size() const { return m_size; }
+
+    /// Check if value \a idx is set
+    bool isset(unsigned idx) const { return !m_missing[idx]; }
+
+    /**
+     * Check if value \a idx has been assigned, even if as unset.
+     *
+     * For attribute columns, this tells if the variable has the attribute.
+     */
+    bool present(unsigned idx) const { return m_present[idx]; }
+
+    /// Return the missing value bitmap, with true for unset values
+    const std::vector<bool>& missing() const { return m_missing; }
+
+    /**
+     * Return the integer and decimal values, encoded as in Var.
+     *
+     * The array is empty for string and binary columns. Values of unset
+     * elements are undefined.
+     */
+    const std::vector<int32_t>& ints() const { return m_ints; }
+
+    /**
+     * Return the string and binary values.
+     *
+     * The array is empty for integer and decimal columns. Values of unset
+     * elements are empty.
+     */
+    const std::vector<std::string>& strings() const { return m_strings; }
+
+    /// Get value \a idx as an integer, like Var::enqi
+    int enqi(unsigned idx) const;
+
+    /// Get value \a idx as a double, like Var::enqd
+    double enqd(unsigned idx) const;
+
+    /// Get value \a idx as a string, like Var::enqc
+    const char* enqc(unsigned idx) const;
+
+    /**
+     * Return all the values as doubles.
+     *
+     * @param missing_value
+     *   The value used for unset elements
+     */
+    std::vector<double> doubles(double missing_value) const;
+
+    /**
+     * Set value \a idx from an integer encoded as in Var.
+     *
+     * Out of range values are handled as in Var::seti.
+     */
+    void seti(unsigned idx, int32_t val);
+
+    /// Set value \a idx from a string
+    void setc(unsigned idx, const char* val);
+
+    /// Set value \a idx from the value of \a var, unsetting it if \a var is unset
+    void set(unsigned idx, const Var& var);
+
+    /// Set value \a idx from a value sent to a DecodeVisitor
+    void set(unsigned idx, const DecodedValue& val);
+
+    /// Set all values from the value of \a var
+    void set_all(const Var& var);
+
+    /// Unset value \a idx, marking it as present
+    void unset(unsigned idx);
+
+    /// Return the attribute columns, sorted by varcode
+    const std::vector<Column>& attrs() const { return m_attrs; }
+
+    /// Return the attribute column with the given code, or nullptr if missing
+    const Column* attr(Varcode code) const;
+
+    /**
+     * Return the attribute column for \a info, creating it with all values
+     * unset if it does not exist yet
+     */
+    Column& obtain_attr(Varinfo info);
+
+    /// Create a Var, including its attributes, with value \a idx
+    Var var(unsigned idx) const;
+};
+
+/**
+ * Decoded data of a bulletin stored by column.
+ *
+ * Each column corresponds to a variable position in the subsets, and
+ * contains the values that all subsets have in that position. This requires
+ * all subsets to have the same sequence of variables, as is the case with
+ * compressed BUFR messages.
+ *
+ * @see BufrBulletin::decode_columns()
+ */
+struct Columns
+{
+    /// Number of subsets, and of values in each column
+    unsigned subset_count = 0;
+
+    /// Columns, in the order in which variables appear in the subsets
+    std::vector<Column> columns;
+
+    /// Return the number of columns
+    size_t size() const { return columns.size(); }
+
+    /// Access a column
+    const Column& operator[](unsigned pos) const { return columns[pos]; }
+
+    /// Access a column
+    Column& operator[](unsigned pos) { return columns[pos]; }
+
+    /// Remove all columns
+    void clear();
+
+    /// Append a column for \a info, with all values unset
+    Column& append(Varinfo info);
+
+    /**
+     * Fill the columns with the contents of \a subsets.
+     *
+     * error_consistency is raised if the subsets do not all have the same
+     * sequence of variables.
+     */
+    void from_subsets(const std::vector<Subset>& subsets);
+
+    /// Append to \a dest the variables of subset \a idx
+    void to_subset(unsigned idx, Subset& dest) const;
+};
+
+}
+
+#endif
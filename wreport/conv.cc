@@ -250,10 +250,9 @@ struct ConvertRepository
 
 double convert_units(const char* from, const char* to, double val)
 {
-    static ConvertRepository* repo = nullptr;
+    static ConvertRepository* repo = new ConvertRepository;
     if (strcmp(from, to) == 0)
         return val;
-    if (!repo) repo = new ConvertRepository;
     const Convert* conv = repo->find(from, to);
     if (!conv)
         error_unimplemented::throwf("conversion from \"%s\" to \"%s\" is not implemented", from, to);
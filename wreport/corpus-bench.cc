@@ -0,0 +1,86 @@
+#include "benchmark.h"
+#include "benchmark-corpus.h"
+#include "bulletin.h"
+
+using namespace wreport;
+using namespace wreport::benchmark;
+using namespace std;
+
+namespace {
+
+/**
+ * Scan, decode, encode and round-trip a large synthetic corpus.
+ *
+ * The size and mix of the corpus are configured with the environment
+ * variables documented in Corpus::Options::from_env.
+ */
+struct CorpusBenchmark : Benchmark
+{
+    Corpus corpus;
+    Task scan_head;
+    Task decode;
+    Task encode;
+    Task round_trip;
+    size_t sink = 0;
+
+    CorpusBenchmark(const std::string& name)
+        : Benchmark(name),
+          scan_head(this, "scan_head"), decode(this, "decode"),
+          encode(this, "encode"), round_trip(this, "round_trip")
+    {
+        repetitions = 3;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        Corpus::Options opts;
+        opts.from_env();
+        corpus.generate(opts);
+        for (Task* t: { &scan_head, &decode, &encode, &round_trip })
+            t->set_workload(corpus.entries.size(), corpus.size);
+    }
+
+    void teardown_main()
+    {
+        Benchmark::teardown_main();
+        fprintf(stdout, "%s: %zu messages, %.1f MB, %zu distinct:", name.c_str(),
+                corpus.entries.size(), corpus.size / 1000000.0, corpus.pool.size());
+        for (unsigned i = 0; i < Corpus::KIND_COUNT; ++i)
+            fprintf(stdout, " %zu %s", corpus.count((Corpus::Kind)i), Corpus::kind_name((Corpus::Kind)i));
+        putc('\n', stdout);
+    }
+
+    void main() override
+    {
+        scan_head.collect([&]() {
+            BufrHeaderScanner scanner(corpus.data, corpus.size);
+            BufrHeader header;
+            while (scanner.next(header))
+                sink += header.subset_count;
+        });
+        // Decode reusing the same bulletin, as a long running decoder would
+        decode.collect([&]() {
+            auto bulletin = BufrBulletin::create();
+            for (const auto& e: corpus.entries)
+            {
+                BufrBulletin::decode(corpus.data + e.offset, e.size, *bulletin);
+                sink += bulletin->subsets.size();
+            }
+        });
+        encode.collect([&]() {
+            for (const auto& e: corpus.entries)
+                sink += corpus.pool[e.pool_index]->encode().size();
+        });
+        round_trip.collect([&]() {
+            auto bulletin = BufrBulletin::create();
+            for (const auto& e: corpus.entries)
+            {
+                BufrBulletin::decode(corpus.data + e.offset, e.size, *bulletin);
+                sink += bulletin->encode().size();
+            }
+        });
+    }
+} test_corpus("corpus");
+
+}
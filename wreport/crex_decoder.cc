@@ -1,6 +1,7 @@
 #include "bulletin.h"
 #include "bulletin/internals.h"
 #include "buffers/crex.h"
+#include "internals/metrics.h"
 #include <cstring>
 #include "config.h"
 
@@ -221,25 +222,37 @@ void decode_data(buffers::CrexInput& in, CrexBulletin& out)
 }
 }
 
-std::unique_ptr<CrexBulletin> CrexBulletin::decode_header(const std::string& buf, const char* fname, size_t offset)
+std::unique_ptr<CrexBulletin> CrexBulletin::decode_header(const void* data, size_t size, const char* fname, size_t offset)
 {
     auto res = CrexBulletin::create();
     res->fname = fname;
     res->offset = offset;
-    buffers::CrexInput in(buf, fname, offset);
+    buffers::CrexInput in(data, size, fname, offset);
     bulletin::decode_header(in, *res);
     return res;
 }
 
-std::unique_ptr<CrexBulletin> CrexBulletin::decode(const std::string& buf, const char* fname, size_t offset)
+std::unique_ptr<CrexBulletin> CrexBulletin::decode(const void* data, size_t size, const char* fname, size_t offset)
 {
     auto res = CrexBulletin::create();
     res->fname = fname;
     res->offset = offset;
-    buffers::CrexInput in(buf, fname, offset);
-    bulletin::decode_header(in, *res);
-    bulletin::decode_data(in, *res);
+    metrics::measure_decode(*res, size, [&]() {
+        buffers::CrexInput in(data, size, fname, offset);
+        bulletin::decode_header(in, *res);
+        bulletin::decode_data(in, *res);
+    });
     return res;
 }
 
+std::unique_ptr<CrexBulletin> CrexBulletin::decode_header(const std::string& buf, const char* fname, size_t offset)
+{
+    return decode_header(buf.data(), buf.size(), fname, offset);
+}
+
+std::unique_ptr<CrexBulletin> CrexBulletin::decode(const std::string& buf, const char* fname, size_t offset)
+{
+    return decode(buf.data(), buf.size(), fname, offset);
+}
+
 }
@@ -1,6 +1,7 @@
 #include "bulletin.h"
 #include "bulletin/internals.h"
 #include "buffers/crex.h"
+#include "internals/metrics.h"
 #include "config.h"
 
 // #define TRACE_ENCODER
@@ -128,6 +129,7 @@ void encode_sec1(const CrexBulletin& in, buffers::CrexOutput out)
 
 string CrexBulletin::encode() const
 {
+    auto start = std::chrono::steady_clock::now();
     std::string buf;
     buf.reserve(1024);
     buffers::CrexOutput out(buf);
@@ -160,6 +162,7 @@ string CrexBulletin::encode() const
     /* Encode section 4 */
     //int sec4_start = out.buf.size();
     out.raw_append("7777\r\r\n", 7);
+    metrics::encoded(*this, buf.size(), metrics::elapsed_ns(start));
     return buf;
 }
 
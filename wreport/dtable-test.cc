@@ -1,6 +1,9 @@
 #include "tests.h"
 #include "dtable.h"
 #include "utils/string.h"
+#include "utils/sys.h"
+#include "internals/tablecache.h"
+#include <cstring>
 
 using namespace wreport;
 using namespace wreport::tests;
@@ -120,6 +123,86 @@ class Tests : public TestCase
             wassert(actual_varcode(chain.head()) == 0);
             wassert(actual(chain.size()) == 0u);
         });
+
+        add_method("compiled", []() {
+            // Loading a text table writes its compiled version, which is then
+            // used by further loads
+            const char* tabledir = getenv("WREPORT_TABLES");
+            if (!tabledir) tabledir = TABLE_DIR;
+            string text = sys::read_file(str::joinpath(tabledir, "D0000000000000024000.txt"));
+            sys::write_file("D0000000000000024000.txt", text);
+            string bin = DTable::compile("D0000000000000024000.txt");
+            sys::unlink(bin);
+
+            const DTable* parsed = DTable::load_bufr("./D0000000000000024000.txt");
+            wassert(actual(sys::exists(bin)).istrue());
+
+            // Use a different pathname to skip the in-memory cache of tables
+            const DTable* compiled = DTable::load_bufr("././D0000000000000024000.txt");
+            wassert(actual(compiled != parsed).istrue());
+            for (Varcode code: { WR_VAR(3, 0, 2), WR_VAR(3, 1, 24), WR_VAR(3, 7, 80), WR_VAR(3, 40, 1) })
+            {
+                Opcodes a = parsed->query(code);
+                Opcodes b = compiled->query(code);
+                wassert(actual(b.size()) == a.size());
+                for (unsigned i = 0; i < a.size(); ++i)
+                    wassert(actual_varcode(b[i]) == a[i]);
+            }
+
+            // Changing the text table rebuilds the compiled version
+            size_t pos = text.find("\n 301002") + 1;
+            sys::write_file("D0000000000000024000.txt", text.substr(0, pos));
+            const DTable* changed = DTable::load_bufr("./././D0000000000000024000.txt");
+            wassert(actual(changed->query(WR_VAR(3, 1, 1)).size()) == 2u);
+            try {
+                changed->query(WR_VAR(3, 1, 24));
+            } catch (error_notfound& e) {
+                wassert(actual(e.what()).contains("301024"));
+            }
+            changed = DTable::load_bufr("././././D0000000000000024000.txt");
+            wassert(actual(changed->query(WR_VAR(3, 1, 1)).size()) == 2u);
+
+            // Compiled tables can be written explicitly
+            sys::unlink(bin);
+            wassert(actual(DTable::compile("./D0000000000000024000.txt")) == bin);
+            wassert(actual(sys::exists(bin)).istrue());
+        });
+
+        add_method("compiled_corrupted", []() {
+            // Corrupted compiled tables are ignored, and the text table is
+            // parsed instead
+            const char* tabledir = getenv("WREPORT_TABLES");
+            if (!tabledir) tabledir = TABLE_DIR;
+            sys::write_file("D0000000000000024000.txt", sys::read_file(str::joinpath(tabledir, "D0000000000000024000.txt")));
+            string bin = DTable::compile("D0000000000000024000.txt");
+            string compiled = sys::read_file(bin);
+            // Offset of the first entry, after the header
+            size_t first = sizeof(tablecache::Header);
+
+            string corrupted = compiled;
+            // Make the end of the first expansion point outside the pool
+            memset(&corrupted[first + 8], 0xff, 4);
+            sys::write_file(bin, corrupted);
+            const DTable* table = DTable::load_bufr("./D0000000000000024000.txt");
+            wassert(actual(table->query(WR_VAR(3, 0, 2)).size()) == 2u);
+
+            corrupted = compiled;
+            // Make the first entry sort after the second one
+            memset(&corrupted[first], 0xff, 2);
+            sys::write_file(bin, corrupted);
+            table = DTable::load_bufr("././D0000000000000024000.txt");
+            wassert(actual(table->query(WR_VAR(3, 0, 2)).size()) == 2u);
+            wassert(actual(table->query(WR_VAR(3, 40, 1)).size()) > 0u);
+        });
+
+        add_method("unsorted", []() {
+            // Entries are found also in tables that are not entirely sorted
+            const char* tabledir = getenv("WREPORT_TABLES");
+            if (!tabledir) tabledir = TABLE_DIR;
+            const DTable* table = DTable::load_bufr(str::joinpath(tabledir, "D0000000000000012000.txt"));
+            wassert(actual(table->query(WR_VAR(3, 7, 52)).size()) > 0u);
+            wassert(actual(table->query(WR_VAR(3, 7, 59)).size()) > 0u);
+        });
     }
 } test("dtable");
 
@@ -1,11 +1,14 @@
 #include "dtable.h"
 #include "config.h"
 #include "error.h"
+#include "metrics.h"
 #include "internals/tabledir.h"
+#include "internals/concurrent.h"
+#include "internals/tablecache.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <map>
+#include <algorithm>
 
 using namespace std;
 
@@ -41,6 +44,8 @@ struct fd_closer
 
 struct DTableBase : public DTable
 {
+    static constexpr const char* signature = "WRDTAB";
+
     std::string m_pathname;
 
     /**
@@ -54,9 +59,73 @@ struct DTableBase : public DTable
      */
     std::vector<Entry> entries;
 
-    DTableBase(const std::string& pathname)
-        : m_pathname(pathname)
+    /// Compiled table, if the table has been loaded from it
+    tablecache::CompiledTable compiled;
+
+    /// Expansion entries, pointing either to \a entries or to \a compiled
+    const Entry* entries_begin = nullptr;
+    /// Number of expansion entries
+    unsigned entries_count = 0;
+    /// Expansion varcodes, pointing either to \a varcodes or to \a compiled
+    const Varcode* codes = nullptr;
+
+    DTableBase(const std::string& pathname, bool use_compiled=true)
+        : m_pathname(pathname), compiled(pathname)
+    {
+        if (use_compiled && compiled.load(signature, sizeof(Entry)))
+        {
+            // Use the compiled table in place, unless it is corrupted
+            entries_begin = (const Entry*)compiled.records;
+            entries_count = compiled.record_count;
+            codes = compiled.pool;
+            if (compiled_is_valid())
+                return;
+            compiled.map.munmap();
+        }
+
+        parse();
+        entries_begin = entries.data();
+        entries_count = entries.size();
+        codes = varcodes.data();
+
+        if (use_compiled)
+        {
+            // Failing to write the compiled table only makes loading slower
+            // next time
+            try {
+                write_compiled();
+            } catch (std::exception&) {
+            }
+        }
+    }
+
+    /**
+     * Check that the entries loaded from a compiled table are sorted by code,
+     * as query() requires, and only point inside the varcode pool
+     */
+    bool compiled_is_valid() const
     {
+        for (unsigned i = 0; i < entries_count; ++i)
+        {
+            const Entry& e = entries_begin[i];
+            if (e.begin > e.end || e.end > compiled.pool_size)
+                return false;
+            if (i > 0 && entries_begin[i - 1].code > e.code)
+                return false;
+        }
+        return true;
+    }
+
+    /// Write the compiled version of the table
+    void write_compiled()
+    {
+        compiled.write(signature, entries.data(), sizeof(Entry), entries.size(), varcodes.data(), varcodes.size());
+    }
+
+    /// Parse the text table
+    void parse()
+    {
+        const std::string& pathname = m_pathname;
         FILE* in = fopen(pathname.c_str(), "rt");
         if (in == NULL) error_system::throwf("opening D table file %s", pathname.c_str());
         fd_closer closer(in); // Close `in' on exit
@@ -120,6 +189,9 @@ struct DTableBase : public DTable
         int last_count = varcodes.size() - begin;
         if (last_count != nentries_check)
             error_parse::throwf(pathname.c_str(), line_no, "advertised number of expansion items (%d) does not match the number of items found (%d)", nentries_check, last_count);
+
+        // Some tables are not entirely sorted, and query() needs them to be
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.code < b.code; });
     }
 
     ~DTableBase()
@@ -133,21 +205,21 @@ struct DTableBase : public DTable
         int begin, end;
 
         // Binary search the entry
-        begin = -1, end = entries.size();
+        begin = -1, end = entries_count;
         while (end - begin > 1)
         {
             int cur = (end + begin) / 2;
-            if (entries[cur].code > var)
+            if (entries_begin[cur].code > var)
                 end = cur;
             else
                 begin = cur;
         }
-        if (begin == -1 || entries[begin].code != var)
+        if (begin == -1 || entries_begin[begin].code != var)
             error_notfound::throwf(
                     "missing D table expansion for variable %d%02d%03d in file %s",
                     WR_VAR_F(var), WR_VAR_X(var), WR_VAR_Y(var), m_pathname.c_str());
         else
-            return Opcodes(varcodes.data() + entries[begin].begin, varcodes.data() + entries[begin].end);
+            return Opcodes(codes + entries_begin[begin].begin, codes + entries_begin[begin].end);
     }
 };
 
@@ -155,30 +227,27 @@ struct DTableBase : public DTable
 
 const DTable* DTable::load_bufr(const std::string& pathname)
 {
-    static std::map<string, DTable*>* tables = 0;
-    if (!tables) tables = new std::map<string, DTable*>;
-
-    // Return it from cache if we have it
-    auto i = tables->find(pathname);
-    if (i != tables->end())
-        return i->second;
+    static auto* tables = new ConcurrentMap<string, const DTable*>;
+    return tables->obtain(pathname, [&]() {
+        metrics::add(metrics::TABLES_LOADED);
+        return make_pair(pathname, (const DTable*)new DTableBase(pathname));
+    });
+}
 
-    // Else, instantiate it
-    return (*tables)[pathname] = new DTableBase(pathname);
+std::string DTable::compile(const std::string& pathname)
+{
+    DTableBase table(pathname, false);
+    table.write_compiled();
+    return table.compiled.pathname;
 }
 
 const DTable* DTable::load_crex(const std::string& pathname)
 {
-    static std::map<string, DTable*>* tables = 0;
-    if (!tables) tables = new std::map<string, DTable*>;
-
-    // Return it from cache if we have it
-    auto i = tables->find(pathname);
-    if (i != tables->end())
-        return i->second;
-
-    // Else, instantiate it
-    return (*tables)[pathname] = new DTableBase(pathname);
+    static auto* tables = new ConcurrentMap<string, const DTable*>;
+    return tables->obtain(pathname, [&]() {
+        metrics::add(metrics::TABLES_LOADED);
+        return make_pair(pathname, (const DTable*)new DTableBase(pathname));
+    });
 }
 
 }
@@ -43,6 +43,17 @@ struct DTable
      * further calls to load_crex() will return the cached version.
      */
     static const DTable* load_crex(const std::string& pathname);
+
+    /**
+     * Write the compiled version of a D table.
+     *
+     * Compiled tables are used as they are via mmap, and are handled like
+     * compiled B tables: see Vartable::compile_bufr().
+     *
+     * @returns the pathname of the compiled table, or an empty string if
+     * compiled tables are disabled
+     */
+    static std::string compile(const std::string& pathname);
 };
 
 
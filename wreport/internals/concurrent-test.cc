@@ -0,0 +1,88 @@
+#include "tests.h"
+#include "concurrent.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("obtain", []() {
+            ConcurrentMap<unsigned, string> map;
+            wassert(actual(map.find(1) == nullptr).istrue());
+
+            unsigned created = 0;
+            auto create = [&](unsigned key) {
+                return [&created, key]() {
+                    ++created;
+                    return make_pair(key, to_string(key));
+                };
+            };
+            const string& one = map.obtain(1, create(1));
+            wassert(actual(one) == "1");
+            wassert(actual(created) == 1u);
+            wassert(actual(map.find(1) == &one).istrue());
+
+            // Existing values are not created again
+            wassert(actual(&map.obtain(1, create(1)) == &one).istrue());
+            wassert(actual(created) == 1u);
+
+            wassert(actual(map.obtain(2, create(2))) == "2");
+            wassert(actual(created) == 2u);
+            wassert(actual(map.find(1) == &one).istrue());
+        });
+
+        add_method("threads", []() {
+            // Many threads obtain the same keys from an empty map at the same
+            // time: each value is created once, and all threads get the same
+            // instance
+            static const unsigned thread_count = 8;
+            static const unsigned key_count = 1000;
+            // Few buckets, to have long chains that are modified while being
+            // walked
+            ConcurrentMap<unsigned, unsigned> map(4);
+            atomic<unsigned> created(0);
+            atomic<bool> start(false);
+            vector<vector<const unsigned*>> results(thread_count, vector<const unsigned*>(key_count));
+
+            vector<thread> threads;
+            for (unsigned t = 0; t < thread_count; ++t)
+                threads.emplace_back([&, t]() {
+                    while (!start.load())
+                        ;
+                    for (unsigned i = 0; i < key_count; ++i)
+                    {
+                        // Start each thread at a different key
+                        unsigned key = (i + t * key_count / thread_count) % key_count;
+                        results[t][key] = &map.obtain(key, [&]() {
+                            ++created;
+                            return make_pair(key, key * 2);
+                        });
+                    }
+                });
+            start.store(true);
+            for (auto& t: threads)
+                t.join();
+
+            wassert(actual(created.load()) == key_count);
+            for (unsigned key = 0; key < key_count; ++key)
+            {
+                wassert(actual(*results[0][key]) == key * 2);
+                wassert(actual(map.find(key) == results[0][key]).istrue());
+                for (unsigned t = 1; t < thread_count; ++t)
+                    wassert(actual(results[t][key] == results[0][key]).istrue());
+            }
+        });
+    }
+} test("internals_concurrent");
+
+}
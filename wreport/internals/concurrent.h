@@ -0,0 +1,110 @@
+#ifndef WREPORT_INTERNALS_CONCURRENT_H
+#define WREPORT_INTERNALS_CONCURRENT_H
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <utility>
+
+namespace wreport {
+
+/**
+ * Insert-only hash map, for caches that are shared between threads.
+ *
+ * Lookups take no locks: they walk bucket chains that are only ever
+ * prepended to, and whose nodes are published with release semantics.
+ * Insertions are serialised by a mutex.
+ *
+ * Values are never removed: pointers to them stay valid until the map is
+ * destroyed.
+ */
+template<typename K, typename V, typename Hash=std::hash<K>, typename KeyEqual=std::equal_to<K>>
+class ConcurrentMap
+{
+protected:
+    struct Node
+    {
+        K key;
+        V value;
+        Node* next;
+
+        Node(K&& key, V&& value, Node* next)
+            : key(std::move(key)), value(std::move(value)), next(next) {}
+    };
+
+    size_t bucket_count;
+    std::unique_ptr<std::atomic<Node*>[]> buckets;
+    std::mutex mutex;
+    Hash hash;
+    KeyEqual equal;
+
+    std::atomic<Node*>& bucket(const K& key) const
+    {
+        return buckets[hash(key) % bucket_count];
+    }
+
+    /// Delete all nodes
+    void clear()
+    {
+        for (size_t i = 0; i < bucket_count; ++i)
+        {
+            Node* n = buckets[i].exchange(nullptr);
+            while (n)
+            {
+                Node* next = n->next;
+                delete n;
+                n = next;
+            }
+        }
+    }
+
+public:
+    explicit ConcurrentMap(size_t bucket_count=64)
+        : bucket_count(bucket_count), buckets(new std::atomic<Node*>[bucket_count])
+    {
+        for (size_t i = 0; i < bucket_count; ++i)
+            buckets[i].store(nullptr, std::memory_order_relaxed);
+    }
+    ConcurrentMap(const ConcurrentMap&) = delete;
+    ~ConcurrentMap() { clear(); }
+    ConcurrentMap& operator=(const ConcurrentMap&) = delete;
+
+    /// Look up a value, returning nullptr if it is not found
+    const V* find(const K& key) const
+    {
+        for (const Node* n = bucket(key).load(std::memory_order_acquire); n; n = n->next)
+            if (equal(n->key, key))
+                return &n->value;
+        return nullptr;
+    }
+
+    /**
+     * Look up a value, adding it if it is not found.
+     *
+     * \a create is called with the insertion lock held, and returns the
+     * key and value to add. Its key needs to be equal to \a key: it can differ
+     * from \a key only in owning the data it refers to.
+     */
+    template<typename Create>
+    const V& obtain(const K& key, Create create)
+    {
+        if (const V* res = find(key))
+            return *res;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (const V* res = find(key))
+            return *res;
+
+        std::pair<K, V> created = create();
+        std::atomic<Node*>& head = bucket(created.first);
+        Node* node = new Node(std::move(created.first), std::move(created.second), head.load(std::memory_order_relaxed));
+        head.store(node, std::memory_order_release);
+        return node->value;
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef WREPORT_INTERNALS_METRICS_H
+#define WREPORT_INTERNALS_METRICS_H
+
+/** @file
+ * Helpers to account decoding and encoding in wreport::metrics.
+ */
+
+#include <wreport/metrics.h>
+#include <chrono>
+
+namespace wreport {
+namespace metrics {
+
+/// Nanoseconds elapsed since \a start
+inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Run \a decode, that decodes \a size bytes into \a bulletin, and account
+ * its outcome.
+ */
+template<typename Func>
+void measure_decode(const Bulletin& bulletin, size_t size, Func decode)
+{
+    auto start = std::chrono::steady_clock::now();
+    try {
+        decode();
+    } catch (std::exception& e) {
+        decode_failed(e, elapsed_ns(start));
+        throw;
+    }
+    decoded(bulletin, size, elapsed_ns(start));
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef WREPORT_INTERNALS_PROFILE_H
+#define WREPORT_INTERNALS_PROFILE_H
+
+/** @file
+ * Hooks to collect bulletin::Profile information.
+ *
+ * They are only compiled in if config.h defines WREPORT_PROFILE_INTERPRETER,
+ * and expand to nothing otherwise.
+ */
+
+#ifdef WREPORT_PROFILE_INTERPRETER
+#include <wreport/bulletin/profile.h>
+#include <chrono>
+
+namespace wreport {
+namespace bulletin {
+namespace profile {
+
+/**
+ * Account the time and input used during the lifetime of the object to a
+ * class of constructs, and to a D sequence for D expansions.
+ *
+ * It does nothing if no profile is being collected by the current thread.
+ */
+class Scope
+{
+    ProfileEntry* entry = nullptr;
+    ProfileEntry* sequence = nullptr;
+    std::chrono::steady_clock::time_point start;
+    unsigned start_bits_left = 0;
+    unsigned long long children_ns = 0;
+    Scope* parent = nullptr;
+
+public:
+    /**
+     * @param name
+     *   The class of construct
+     * @param code
+     *   The opcode, if relevant: for C modifiers, its X value is added to the
+     *   class name; D sequences are also accounted separately
+     * @param outermost
+     *   If true, only account when no other Scope is active
+     */
+    Scope(const char* name, Varcode code=0, bool outermost=false);
+    Scope(const Scope&) = delete;
+    ~Scope();
+    Scope& operator=(const Scope&) = delete;
+};
+
+/// Check if Interpreter::run_plan should use plans
+bool use_plans();
+
+}
+}
+}
+
+#define WREPORT_PROFILE(...) wreport::bulletin::profile::Scope profile_scope(__VA_ARGS__)
+#define WREPORT_PROFILE_USE_PLANS() wreport::bulletin::profile::use_plans()
+#else
+#define WREPORT_PROFILE(...) do { } while (0)
+#define WREPORT_PROFILE_USE_PLANS() true
+#endif
+
+#endif
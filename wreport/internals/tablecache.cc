@@ -0,0 +1,155 @@
+#include "tablecache.h"
+#include "utils/string.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace wreport {
+namespace tablecache {
+
+namespace {
+
+const uint32_t byte_order = 0x01020304;
+
+/**
+ * Directory where compiled tables are stored, or an empty string if compiled
+ * tables are disabled
+ */
+std::string cache_directory()
+{
+    const char* cachedir = getenv("WREPORT_TABLE_CACHE");
+    if (cachedir)
+        return cachedir;
+
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg)
+        return str::joinpath(xdg, "wreport");
+
+    const char* home = getenv("HOME");
+    if (home && *home)
+        return str::joinpath(home, ".cache/wreport");
+
+    return string();
+}
+
+/// 64 bit FNV-1a hash of \a str
+uint64_t fnv1a(const std::string& str)
+{
+    uint64_t res = 0xcbf29ce484222325ULL;
+    for (unsigned char c: str)
+    {
+        res ^= c;
+        res *= 0x100000001b3ULL;
+    }
+    return res;
+}
+
+std::string compiled_pathname(const std::string& source)
+{
+    string cachedir = cache_directory();
+    if (cachedir.empty())
+        return string();
+
+    // Tables with the same name can exist in different directories: add a
+    // hash of the full pathname of the text table to the file name
+    string abspath = sys::abspath(source);
+    string base = str::basename(abspath);
+    if (base.size() > 4 && base.substr(base.size() - 4) == ".txt")
+        base.resize(base.size() - 4);
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)fnv1a(abspath));
+    return str::joinpath(cachedir, base + "-" + hash + ".bin");
+}
+
+/// Store \a signature in \a header, padded with zeros
+void fill_signature(const char* signature, Header& header)
+{
+    memset(header.signature, 0, sizeof(header.signature));
+    memcpy(header.signature, signature, strnlen(signature, sizeof(header.signature)));
+}
+
+void fill_source_info(const struct stat& st, Header& header)
+{
+    header.source_mtime = st.st_mtim.tv_sec;
+    header.source_mtime_nsec = st.st_mtim.tv_nsec;
+    header.source_size = st.st_size;
+}
+
+}
+
+CompiledTable::CompiledTable(const std::string& source)
+    : source(source), pathname(compiled_pathname(source)), map(MAP_FAILED, 0)
+{
+}
+
+bool CompiledTable::load(const char* signature, size_t record_size)
+{
+    if (pathname.empty()) return false;
+
+    struct stat st_source;
+    if (::stat(source.c_str(), &st_source) == -1) return false;
+
+    sys::File in(pathname);
+    if (!in.open_ifexists(O_RDONLY)) return false;
+    struct stat st;
+    in.fstat(st);
+    if ((size_t)st.st_size < sizeof(Header)) return false;
+
+    sys::MMap cur = in.mmap(st.st_size, PROT_READ, MAP_SHARED);
+    const Header* header = cur;
+    Header expected;
+    fill_signature(signature, expected);
+    fill_source_info(st_source, expected);
+
+    if (memcmp(header->signature, expected.signature, sizeof(header->signature)) != 0) return false;
+    if (header->byte_order != byte_order) return false;
+    if (header->record_size != record_size) return false;
+    if (header->source_mtime != expected.source_mtime) return false;
+    if (header->source_mtime_nsec != expected.source_mtime_nsec) return false;
+    if (header->source_size != expected.source_size) return false;
+    if ((size_t)st.st_size != sizeof(Header) + header->record_count * record_size + header->pool_size * sizeof(Varcode))
+        return false;
+
+    const char* data = cur;
+    records = data + sizeof(Header);
+    pool = (const Varcode*)(data + sizeof(Header) + header->record_count * record_size);
+    record_count = header->record_count;
+    pool_size = header->pool_size;
+    map = move(cur);
+    return true;
+}
+
+void CompiledTable::write(const char* signature, const void* records, size_t record_size, unsigned record_count, const Varcode* pool, unsigned pool_size)
+{
+    if (pathname.empty()) return;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    fill_signature(signature, header);
+    header.record_size = record_size;
+    header.record_count = record_count;
+    header.pool_size = pool_size;
+    header.byte_order = byte_order;
+    struct stat st;
+    sys::stat(source, st);
+    fill_source_info(st, header);
+
+    sys::makedirs(str::dirname(pathname));
+
+    string buf;
+    buf.reserve(sizeof(Header) + record_count * record_size + pool_size * sizeof(Varcode));
+    buf.append((const char*)&header, sizeof(header));
+    buf.append((const char*)records, record_count * record_size);
+    if (pool_size)
+        buf.append((const char*)pool, pool_size * sizeof(Varcode));
+
+    sys::write_file_atomically(pathname, buf, 0666);
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef WREPORT_INTERNALS_TABLECACHE_H
+#define WREPORT_INTERNALS_TABLECACHE_H
+
+#include <wreport/varinfo.h>
+#include <wreport/utils/sys.h>
+#include <string>
+#include <cstdint>
+
+namespace wreport {
+namespace tablecache {
+
+/**
+ * Header of a compiled table file.
+ *
+ * It is followed by an array of fixed size records, and by a pool of
+ * varcodes. Compiled tables are meant to be mapped in memory as they are, and
+ * are only valid for the build of wreport that wrote them.
+ */
+struct Header
+{
+    /// File signature, identifying the kind of table
+    char signature[8];
+    /// Size of each record, to detect files written by incompatible builds
+    uint32_t record_size;
+    /// Number of records
+    uint32_t record_count;
+    /// Number of varcodes in the pool that follows the records
+    uint32_t pool_size;
+    /// 0x01020304, written with the byte order of the machine that wrote the file
+    uint32_t byte_order;
+    /// Modification time of the text table the file was compiled from
+    int64_t source_mtime;
+    /// Nanoseconds part of the modification time of the text table
+    int64_t source_mtime_nsec;
+    /// Size of the text table the file was compiled from
+    int64_t source_size;
+};
+
+/**
+ * Compiled version of a text table.
+ *
+ * Compiled tables are stored in the directory named by the
+ * WREPORT_TABLE_CACHE environment variable, or in $XDG_CACHE_HOME/wreport,
+ * or in $HOME/.cache/wreport. Their file name is the name of the text table,
+ * with a hash of its full pathname and a .bin extension instead of .txt. If
+ * WREPORT_TABLE_CACHE is set to an empty value, or no directory can be
+ * found, compiled tables are not used.
+ */
+struct CompiledTable
+{
+    /// Pathname of the text table
+    std::string source;
+    /// Pathname of the compiled table, or empty if compiled tables are disabled
+    std::string pathname;
+    /// Memory mapped compiled table
+    sys::MMap map;
+    /// Start of the records
+    const void* records = nullptr;
+    /// Start of the varcode pool
+    const Varcode* pool = nullptr;
+    /// Number of records
+    unsigned record_count = 0;
+    /// Number of varcodes in the pool
+    unsigned pool_size = 0;
+
+    CompiledTable(const std::string& source);
+
+    /**
+     * Map the compiled table in memory.
+     *
+     * @returns false if the compiled table does not exist, has been compiled
+     * from a different version of the text table, or cannot be used by this
+     * build of wreport
+     */
+    bool load(const char* signature, size_t record_size);
+
+    /// Write the compiled table, replacing an existing one
+    void write(const char* signature, const void* records, size_t record_size, unsigned record_count, const Varcode* pool=nullptr, unsigned pool_size=0);
+};
+
+}
+}
+
+#endif
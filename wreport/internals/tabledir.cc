@@ -4,6 +4,7 @@
 #include "dtable.h"
 #include "notes.h"
 #include "fs.h"
+#include "concurrent.h"
 #include "config.h"
 #include <map>
 #include <cstddef>
@@ -281,11 +282,34 @@ struct CrexQuery : public Query
 
 }
 
+struct BufrTableIDHash
+{
+    size_t operator()(const BufrTableID& id) const
+    {
+        return ((size_t)id.originating_centre << 24) ^ ((size_t)id.originating_subcentre << 16)
+             ^ ((size_t)id.master_table_number << 12) ^ ((size_t)id.master_table_version_number << 4)
+             ^ id.master_table_version_number_local;
+    }
+};
+
+struct CrexTableIDHash
+{
+    size_t operator()(const CrexTableID& id) const
+    {
+        return ((size_t)id.originating_centre << 24) ^ ((size_t)id.originating_subcentre << 16)
+             ^ ((size_t)id.master_table_number << 12) ^ ((size_t)id.master_table_version_number << 4)
+             ^ ((size_t)id.master_table_version_number_bufr << 8) ^ ((size_t)id.edition_number << 20)
+             ^ id.master_table_version_number_local;
+    }
+};
+
 struct Index
 {
     vector<Dir> dirs;
-    map<BufrTableID, const Table*> bufr_cache;
-    map<CrexTableID, const Table*> crex_cache;
+    /// Lookup results, including failed lookups
+    ConcurrentMap<BufrTableID, const Table*, BufrTableIDHash> bufr_cache;
+    /// Lookup results, including failed lookups
+    ConcurrentMap<CrexTableID, const Table*, CrexTableIDHash> crex_cache;
 
     Index(const vector<string>& dirs)
     {
@@ -296,26 +320,20 @@ struct Index
 
     const tabledir::Table* find_bufr(const BufrTableID& id)
     {
-        // First look it up in cache
-        const auto i = bufr_cache.find(id);
-        if (i != bufr_cache.end())
-            return i->second;
-
-        // If it is the first time this combination is requested, look for the best match
-        BufrQuery query(id);
-        for (vector<Dir>::iterator d = dirs.begin(); d != dirs.end(); ++d)
-            query.search(*d);
-
-        if (auto result = query.result())
-        {
-            bufr_cache[id] = result;
-            notes::logf("Matched table %s for ce %hu sc %hu mt %hhu mtv %hhu mtlv %hhu",
-                    result->btable_id.c_str(),
-                    id.originating_centre, id.originating_subcentre,
-                    id.master_table_number, id.master_table_version_number, id.master_table_version_number_local);
-            return result;
-        }
-        return nullptr;
+        return bufr_cache.obtain(id, [&]() {
+            // If it is the first time this combination is requested, look for the best match
+            BufrQuery query(id);
+            for (vector<Dir>::iterator d = dirs.begin(); d != dirs.end(); ++d)
+                query.search(*d);
+
+            const Table* result = query.result();
+            if (result)
+                notes::logf("Matched table %s for ce %hu sc %hu mt %hhu mtv %hhu mtlv %hhu",
+                        result->btable_id.c_str(),
+                        id.originating_centre, id.originating_subcentre,
+                        id.master_table_number, id.master_table_version_number, id.master_table_version_number_local);
+            return make_pair(id, result);
+        });
     }
 
     void explain_find_bufr(const BufrTableID& id, FILE* out)
@@ -329,26 +347,20 @@ struct Index
 
     const tabledir::Table* find_crex(const CrexTableID& id)
     {
-        // First look it up in cache
-        const auto i = crex_cache.find(id);
-        if (i != crex_cache.end())
-            return i->second;
-
-        // If it is the first time this combination is requested, look for the best match
-        CrexQuery query(id);
-        for (vector<Dir>::iterator d = dirs.begin(); d != dirs.end(); ++d)
-            query.search(*d);
-
-        if (auto result = query.result())
-        {
-            crex_cache[id] = result;
-            notes::logf("Matched table %s for mt %hhu mtv %hhu mtlv %hhu",
-                    result->btable_id.c_str(),
-                    id.master_table_number, id.master_table_version_number,
-                    id.master_table_version_number_local);
-            return result;
-        }
-        return nullptr;
+        return crex_cache.obtain(id, [&]() {
+            // If it is the first time this combination is requested, look for the best match
+            CrexQuery query(id);
+            for (vector<Dir>::iterator d = dirs.begin(); d != dirs.end(); ++d)
+                query.search(*d);
+
+            const Table* result = query.result();
+            if (result)
+                notes::logf("Matched table %s for mt %hhu mtv %hhu mtlv %hhu",
+                        result->btable_id.c_str(),
+                        id.master_table_number, id.master_table_version_number,
+                        id.master_table_version_number_local);
+            return make_pair(id, result);
+        });
     }
 
     void explain_find_crex(const CrexTableID& id, FILE* out)
@@ -383,13 +395,28 @@ struct Index
 
 
 Tabledirs::Tabledirs()
-    : index(0)
+    : index(nullptr)
 {
 }
 
 Tabledirs::~Tabledirs()
 {
-    delete index;
+    delete index.load();
+    for (auto i: old_indices)
+        delete i;
+}
+
+Index& Tabledirs::get_index()
+{
+    if (Index* res = index.load(std::memory_order_acquire))
+        return *res;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Index* res = index.load(std::memory_order_relaxed))
+        return *res;
+    Index* res = new tabledir::Index(dirs);
+    index.store(res, std::memory_order_release);
+    return *res;
 }
 
 void Tabledirs::add_default_directories()
@@ -410,6 +437,8 @@ void Tabledirs::add_directory(const std::string& dir)
     if (clean_dir.empty())
         clean_dir = "/";
 
+    std::lock_guard<std::mutex> lock(mutex);
+
     // Do not add a duplicate directory
     for (vector<string>::const_iterator i = dirs.begin(); i != dirs.end(); ++i)
         if (*i == clean_dir)
@@ -417,54 +446,47 @@ void Tabledirs::add_directory(const std::string& dir)
     dirs.push_back(clean_dir);
 
     // Force a rebuild of the index
-    delete index;
-    index = 0;
+    if (Index* old = index.exchange(nullptr))
+        old_indices.push_back(old);
 }
 
 const tabledir::Table* Tabledirs::find_bufr(const BufrTableID& id)
 {
-    if (!index) index = new tabledir::Index(dirs);
-    return index->find_bufr(id);
+    return get_index().find_bufr(id);
 }
 
 const tabledir::Table* Tabledirs::find_crex(const CrexTableID& id)
 {
-    if (!index) index = new tabledir::Index(dirs);
-    return index->find_crex(id);
+    return get_index().find_crex(id);
 }
 
 const tabledir::Table* Tabledirs::find(const std::string& basename)
 {
-    if (!index) index = new tabledir::Index(dirs);
-    return index->find(basename);
+    return get_index().find(basename);
 }
 
 void Tabledirs::print(FILE* out)
 {
-    if (!index) index = new tabledir::Index(dirs);
-    index->print(out);
+    get_index().print(out);
 }
 
 void Tabledirs::explain_find_bufr(const BufrTableID& id, FILE* out)
 {
-    if (!index) index = new tabledir::Index(dirs);
-    index->explain_find_bufr(id, out);
+    get_index().explain_find_bufr(id, out);
 }
 
 void Tabledirs::explain_find_crex(const CrexTableID& id, FILE* out)
 {
-    if (!index) index = new tabledir::Index(dirs);
-    index->explain_find_crex(id, out);
+    get_index().explain_find_crex(id, out);
 }
 
 Tabledirs& Tabledirs::get()
 {
-    static Tabledirs* default_tabledir = 0;
-    if (!default_tabledir)
-    {
-        default_tabledir = new Tabledirs();
-        default_tabledir->add_default_directories();
-    }
+    static Tabledirs* default_tabledir = []() {
+        Tabledirs* res = new Tabledirs();
+        res->add_default_directories();
+        return res;
+    }();
     return *default_tabledir;
 }
 
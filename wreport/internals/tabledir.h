@@ -4,6 +4,8 @@
 #include <wreport/tableinfo.h>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <atomic>
 
 namespace wreport {
 struct Vartable;
@@ -70,7 +72,18 @@ class Tabledirs
 {
 protected:
     std::vector<std::string> dirs;
-    Index* index;
+    /// Index of dirs, created on first use
+    std::atomic<Index*> index;
+    /**
+     * Indices replaced by add_directory, kept because other threads can
+     * still be using the tables they point to
+     */
+    std::vector<Index*> old_indices;
+    /// Serialises changes to dirs and index
+    std::mutex mutex;
+
+    /// Return the index, creating it if needed
+    Index& get_index();
 
 public:
     Tabledirs();
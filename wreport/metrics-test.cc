@@ -0,0 +1,104 @@
+#include "tests.h"
+#include "metrics.h"
+#include "bulletin.h"
+#include <thread>
+#include <cstring>
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Change of a counter between two snapshots
+uint64_t delta(const metrics::Snapshot& before, const metrics::Snapshot& after, metrics::Counter counter)
+{
+    return after.counters[counter] - before.counters[counter];
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("decode_encode", []() {
+            std::string raw = tests::slurpfile("bufr/obs0-1.22.bufr");
+
+            auto before = metrics::snapshot();
+            auto bulletin = BufrBulletin::decode(raw);
+            auto after = metrics::snapshot();
+
+            size_t values = 0;
+            for (const auto& subset: bulletin->subsets)
+                values += subset.size();
+            wassert(actual(delta(before, after, metrics::MESSAGES_DECODED)) == 1u);
+            wassert(actual(delta(before, after, metrics::BYTES_DECODED)) == raw.size());
+            wassert(actual(delta(before, after, metrics::SUBSETS_DECODED)) == bulletin->subsets.size());
+            wassert(actual(delta(before, after, metrics::VALUES_DECODED)) == values);
+            wassert(actual(after.histograms[metrics::DECODE_LATENCY].count - before.histograms[metrics::DECODE_LATENCY].count) == 1u);
+
+            before = after;
+            std::string encoded = bulletin->encode();
+            after = metrics::snapshot();
+            wassert(actual(delta(before, after, metrics::MESSAGES_ENCODED)) == 1u);
+            wassert(actual(delta(before, after, metrics::BYTES_ENCODED)) == encoded.size());
+            wassert(actual(delta(before, after, metrics::VALUES_ENCODED)) == values);
+            wassert(actual(after.histograms[metrics::ENCODE_LATENCY].count - before.histograms[metrics::ENCODE_LATENCY].count) == 1u);
+        });
+
+        add_method("decode_failure", []() {
+            std::string raw = tests::slurpfile("bufr/obs0-1.22.bufr");
+            raw.resize(30);
+
+            auto before = metrics::snapshot();
+            try {
+                BufrBulletin::decode(raw);
+                throw TestFailed("decoding a truncated message should fail");
+            } catch (error_parse&) {
+            }
+            auto after = metrics::snapshot();
+
+            wassert(actual(delta(before, after, metrics::MESSAGES_DECODED)) == 0u);
+            wassert(actual(after.decode_failures[WR_ERR_PARSE] - before.decode_failures[WR_ERR_PARSE]) == 1u);
+            wassert(actual(after.histograms[metrics::DECODE_LATENCY].count - before.histograms[metrics::DECODE_LATENCY].count) == 1u);
+        });
+
+        add_method("threads", []() {
+            // Counters of threads are kept after the threads exit
+            auto before = metrics::snapshot();
+            std::thread t([]() { metrics::add(metrics::ALTERATION_HITS, 3); });
+            t.join();
+            metrics::add(metrics::ALTERATION_HITS, 2);
+            auto after = metrics::snapshot();
+            wassert(actual(delta(before, after, metrics::ALTERATION_HITS)) == 5u);
+        });
+
+        add_method("histogram", []() {
+            metrics::Snapshot::Latency l;
+            memset(&l, 0, sizeof(l));
+            wassert(actual(l.percentile(50)) == 0.0);
+            l.buckets[2] = 9;
+            l.buckets[10] = 1;
+            l.count = 10;
+            wassert(actual(l.percentile(50)) == 4.0);
+            wassert(actual(l.percentile(90)) == 4.0);
+            wassert(actual(l.percentile(100)) == 1024.0);
+        });
+
+        add_method("print", []() {
+            char* buf = nullptr;
+            size_t size = 0;
+            FILE* out = open_memstream(&buf, &size);
+            metrics::snapshot().print(out);
+            fclose(out);
+            std::string text(buf, size);
+            free(buf);
+            wassert(actual(text).contains("\nbytes_decoded "));
+            wassert(actual(text).contains("decode_failures{class=\"parse\"} "));
+            wassert(actual(text).contains("decode_latency_us_bucket{le=\"+Inf\"} "));
+        });
+    }
+} test("metrics");
+
+}
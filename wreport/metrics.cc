@@ -0,0 +1,246 @@
+#include "metrics.h"
+#include "bulletin.h"
+#include <atomic>
+#include <mutex>
+#include <set>
+
+using namespace std;
+
+namespace wreport {
+namespace metrics {
+
+namespace {
+
+/**
+ * Metrics of one thread.
+ *
+ * Values are only modified by the owning thread, so updates do not need
+ * atomic read-modify-write operations: they are atomic only so that
+ * snapshot() can read them from another thread.
+ */
+struct ThreadMetrics
+{
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<uint64_t> decode_failures[ERROR_CLASS_COUNT];
+    std::atomic<uint64_t> buckets[HISTOGRAM_COUNT][BUCKET_COUNT];
+    std::atomic<uint64_t> sum_ns[HISTOGRAM_COUNT];
+
+    ThreadMetrics()
+    {
+        for (auto& v: counters) v.store(0, memory_order_relaxed);
+        for (auto& v: decode_failures) v.store(0, memory_order_relaxed);
+        for (auto& h: buckets)
+            for (auto& v: h) v.store(0, memory_order_relaxed);
+        for (auto& v: sum_ns) v.store(0, memory_order_relaxed);
+    }
+
+    /// Add the values of these metrics to \a out
+    void add_to(Snapshot& out) const
+    {
+        for (unsigned i = 0; i < COUNTER_COUNT; ++i)
+            out.counters[i] += counters[i].load(memory_order_relaxed);
+        for (unsigned i = 0; i < ERROR_CLASS_COUNT; ++i)
+            out.decode_failures[i] += decode_failures[i].load(memory_order_relaxed);
+        for (unsigned h = 0; h < HISTOGRAM_COUNT; ++h)
+        {
+            for (unsigned i = 0; i < BUCKET_COUNT; ++i)
+            {
+                uint64_t count = buckets[h][i].load(memory_order_relaxed);
+                out.histograms[h].buckets[i] += count;
+                out.histograms[h].count += count;
+            }
+            out.histograms[h].sum_ns += sum_ns[h].load(memory_order_relaxed);
+        }
+    }
+};
+
+/// Increment a value owned by the current thread
+inline void increment(std::atomic<uint64_t>& value, uint64_t amount)
+{
+    value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+/// Metrics of all running threads, and totals of the threads that exited
+struct Registry
+{
+    std::mutex mutex;
+    std::set<const ThreadMetrics*> threads;
+    Snapshot exited;
+
+    Registry()
+    {
+        exited = Snapshot();
+    }
+};
+
+Registry& registry()
+{
+    // Allocated and never deallocated, so that it outlives all threads,
+    // including those that exit after static destructors have run
+    static Registry* res = new Registry;
+    return *res;
+}
+
+/// Registers the metrics of the current thread for the lifetime of the thread
+struct ThreadSlot
+{
+    ThreadMetrics metrics;
+
+    ThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().threads.insert(&metrics);
+    }
+
+    ~ThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        metrics.add_to(registry().exited);
+        registry().threads.erase(&metrics);
+    }
+};
+
+thread_local ThreadSlot slot;
+
+const char* counter_names[] = {
+    "messages_decoded",
+    "messages_encoded",
+    "bytes_decoded",
+    "bytes_encoded",
+    "subsets_decoded",
+    "subsets_encoded",
+    "values_decoded",
+    "values_encoded",
+    "tables_loaded",
+    "alteration_cache_hits",
+    "alteration_cache_misses",
+};
+
+const char* histogram_names[] = {
+    "decode_latency",
+    "encode_latency",
+};
+
+const char* error_class_names[] = {
+    "other",
+    "notfound",
+    "type",
+    "alloc",
+    "odbc",
+    "handles",
+    "toolong",
+    "system",
+    "consistency",
+    "parse",
+    "write",
+    "regex",
+    "unimplemented",
+    "domain",
+};
+
+/// Count the subsets and values of a bulletin
+void count_contents(const Bulletin& bulletin, Counter subsets, Counter values)
+{
+    uint64_t value_count = 0;
+    for (const auto& subset: bulletin.subsets)
+        value_count += subset.size();
+    increment(slot.metrics.counters[subsets], bulletin.subsets.size());
+    increment(slot.metrics.counters[values], value_count);
+}
+
+}
+
+double Snapshot::Latency::percentile(double p) const
+{
+    if (!count) return 0;
+    uint64_t threshold = count * p / 100.0;
+    if (threshold == 0) threshold = 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= threshold)
+            return (double)(1u << i);
+    }
+    return (double)(1u << (BUCKET_COUNT - 1));
+}
+
+void Snapshot::print(FILE* out) const
+{
+    for (unsigned i = 0; i < COUNTER_COUNT; ++i)
+        fprintf(out, "%s %llu\n", counter_names[i], (unsigned long long)counters[i]);
+    for (unsigned i = 0; i < ERROR_CLASS_COUNT; ++i)
+        fprintf(out, "decode_failures{class=\"%s\"} %llu\n", error_class_names[i], (unsigned long long)decode_failures[i]);
+    for (unsigned h = 0; h < HISTOGRAM_COUNT; ++h)
+    {
+        const Latency& l = histograms[h];
+        // Buckets are cumulative, like Prometheus histograms
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < BUCKET_COUNT - 1; ++i)
+        {
+            seen += l.buckets[i];
+            fprintf(out, "%s_us_bucket{le=\"%u\"} %llu\n", histogram_names[h], 1u << i, (unsigned long long)seen);
+        }
+        fprintf(out, "%s_us_bucket{le=\"+Inf\"} %llu\n", histogram_names[h], (unsigned long long)l.count);
+        fprintf(out, "%s_us_sum %.3f\n", histogram_names[h], l.sum_ns / 1000.0);
+        fprintf(out, "%s_us_count %llu\n", histogram_names[h], (unsigned long long)l.count);
+    }
+}
+
+const char* counter_name(Counter counter) { return counter_names[counter]; }
+const char* histogram_name(Histogram histogram) { return histogram_names[histogram]; }
+const char* error_class_name(ErrorCode code) { return error_class_names[code]; }
+
+Snapshot snapshot()
+{
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    Snapshot res = registry().exited;
+    for (const auto* t: registry().threads)
+        t->add_to(res);
+    return res;
+}
+
+void add(Counter counter, uint64_t value)
+{
+    increment(slot.metrics.counters[counter], value);
+}
+
+void record(Histogram histogram, uint64_t ns)
+{
+    uint64_t us = ns / 1000;
+    unsigned bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && us > (1u << bucket))
+        ++bucket;
+    increment(slot.metrics.buckets[histogram][bucket], 1);
+    increment(slot.metrics.sum_ns[histogram], ns);
+}
+
+void decoded(const Bulletin& bulletin, size_t size, uint64_t ns)
+{
+    add(MESSAGES_DECODED);
+    add(BYTES_DECODED, size);
+    count_contents(bulletin, SUBSETS_DECODED, VALUES_DECODED);
+    record(DECODE_LATENCY, ns);
+}
+
+void decode_failed(const std::exception& e, uint64_t ns)
+{
+    ErrorCode code = WR_ERR_NONE;
+    if (const error* err = dynamic_cast<const error*>(&e))
+        code = err->code();
+    if ((unsigned)code >= ERROR_CLASS_COUNT)
+        code = WR_ERR_NONE;
+    increment(slot.metrics.decode_failures[code], 1);
+    record(DECODE_LATENCY, ns);
+}
+
+void encoded(const Bulletin& bulletin, size_t size, uint64_t ns)
+{
+    add(MESSAGES_ENCODED);
+    add(BYTES_ENCODED, size);
+    count_contents(bulletin, SUBSETS_ENCODED, VALUES_ENCODED);
+    record(ENCODE_LATENCY, ns);
+}
+
+}
+}
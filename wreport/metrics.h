@@ -0,0 +1,137 @@
+#ifndef WREPORT_METRICS_H
+#define WREPORT_METRICS_H
+
+/** @file
+ * Counters and latency histograms of the work done by the library.
+ */
+
+#include <wreport/error.h>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+
+namespace wreport {
+struct Bulletin;
+
+/**
+ * Process-wide metrics about decoding and encoding.
+ *
+ * Metrics are always collected. Each thread updates its own counters without
+ * locking or atomic read-modify-write operations, and snapshot() adds up the
+ * counters of all threads, including those of threads that have exited.
+ */
+namespace metrics {
+
+/// Counters
+enum Counter {
+    /// Messages fully decoded
+    MESSAGES_DECODED,
+    /// Messages encoded
+    MESSAGES_ENCODED,
+    /// Size of the messages fully decoded
+    BYTES_DECODED,
+    /// Size of the messages encoded
+    BYTES_ENCODED,
+    /// Subsets decoded into Bulletin::subsets
+    SUBSETS_DECODED,
+    /// Subsets encoded
+    SUBSETS_ENCODED,
+    /// Variables decoded into Bulletin::subsets
+    VALUES_DECODED,
+    /// Variables encoded
+    VALUES_ENCODED,
+    /// B and D tables loaded from disk
+    TABLES_LOADED,
+    /// Vartable::query_altered() calls that found an existing alteration
+    ALTERATION_HITS,
+    /// Vartable::query_altered() calls that had to create a new alteration
+    ALTERATION_MISSES,
+    COUNTER_COUNT
+};
+
+/// Latency histograms
+enum Histogram {
+    /// Time taken to fully decode a message, including failed attempts
+    DECODE_LATENCY,
+    /// Time taken to encode a message
+    ENCODE_LATENCY,
+    HISTOGRAM_COUNT
+};
+
+/// Number of error classes that decode failures are counted by
+static const unsigned ERROR_CLASS_COUNT = WR_ERR_DOMAIN + 1;
+
+/**
+ * Number of histogram buckets: bucket i counts latencies up to 2**i
+ * microseconds, and the last bucket counts all longer latencies.
+ */
+static const unsigned BUCKET_COUNT = 24;
+
+/// Values of all metrics at a given time
+struct Snapshot
+{
+    /// Counter values, indexed by Counter
+    uint64_t counters[COUNTER_COUNT];
+
+    /**
+     * Decode failures, indexed by the ErrorCode of the exception. Failures
+     * caused by exceptions that are not wreport::error are counted with
+     * WR_ERR_NONE.
+     */
+    uint64_t decode_failures[ERROR_CLASS_COUNT];
+
+    /// Contents of a latency histogram
+    struct Latency
+    {
+        /// Number of samples in each bucket
+        uint64_t buckets[BUCKET_COUNT];
+        /// Number of samples
+        uint64_t count;
+        /// Sum of all the samples, in nanoseconds
+        uint64_t sum_ns;
+
+        /**
+         * Upper bound in microseconds of the bucket that contains the given
+         * percentile (0 to 100) of the samples, or 0 if there are no samples
+         */
+        double percentile(double p) const;
+    };
+
+    /// Latency histograms, indexed by Histogram
+    Latency histograms[HISTOGRAM_COUNT];
+
+    /// Print all metrics, one `name value` line per metric
+    void print(FILE* out) const;
+};
+
+/// Name of a counter, as used by Snapshot::print
+const char* counter_name(Counter counter);
+
+/// Name of a histogram, as used by Snapshot::print
+const char* histogram_name(Histogram histogram);
+
+/// Name of an error class, as used by Snapshot::print
+const char* error_class_name(ErrorCode code);
+
+/// Read the current values of all metrics
+Snapshot snapshot();
+
+/// Add \a value to a counter of the current thread
+void add(Counter counter, uint64_t value=1);
+
+/// Add a sample, in nanoseconds, to a histogram of the current thread
+void record(Histogram histogram, uint64_t ns);
+
+/// Account a successful decode of \a size bytes into \a bulletin
+void decoded(const Bulletin& bulletin, size_t size, uint64_t ns);
+
+/// Account a decode that failed with \a e
+void decode_failed(const std::exception& e, uint64_t ns);
+
+/// Account the encoding of \a bulletin into \a size bytes
+void encoded(const Bulletin& bulletin, size_t size, uint64_t ns);
+
+}
+}
+
+#endif
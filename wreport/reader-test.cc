@@ -0,0 +1,184 @@
+#include "tests.h"
+#include "reader.h"
+#include "bulletin.h"
+
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Check that reader returns the same messages as Bulletin::read
+template<typename Bltn, typename Reader>
+void check_read(const std::string& fname)
+{
+    string pathname = tests::datafile(fname);
+    Reader reader(pathname);
+
+    FILE* in = fopen(pathname.c_str(), "rb");
+    string buf;
+    off_t offset;
+    const char* data;
+    size_t size;
+    off_t data_offset;
+    unsigned count = 0;
+    while (Bltn::read(in, buf, pathname.c_str(), &offset))
+    {
+        wassert(actual(reader.next(data, size, data_offset)).istrue());
+        wassert(actual(data_offset) == offset);
+        wassert(actual(string(data, size)) == buf);
+        ++count;
+    }
+    fclose(in);
+    wassert(actual(reader.next(data, size, data_offset)).isfalse());
+    wassert(actual(count) > 0u);
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("bufr", []() {
+            wassert((check_read<BufrBulletin, BufrFileReader>("bufr/ed4.bufr")));
+            wassert((check_read<BufrBulletin, BufrFileReader>("bufr/obs0-1.22.bufr")));
+        });
+
+        add_method("crex", []() {
+            wassert((check_read<CrexBulletin, CrexFileReader>("crex/test-synop0.crex")));
+            wassert((check_read<CrexBulletin, CrexFileReader>("crex/test-temp0.crex")));
+        });
+
+        add_method("decode", []() {
+            // Messages can be decoded in place
+            BufrFileReader reader(tests::datafile("bufr/obs0-1.22.bufr"));
+            const char* data;
+            size_t size;
+            off_t offset;
+            wassert(actual(reader.next(data, size, offset)).istrue());
+            auto bulletin = BufrBulletin::decode(data, size, reader.pathname.c_str(), offset);
+            wassert(actual(bulletin->subsets.size()) == 1u);
+            wassert(actual(bulletin->diff(*BufrBulletin::decode(tests::slurpfile("bufr/obs0-1.22.bufr")))) == 0u);
+        });
+
+        add_method("scan", []() {
+            string data("xxBUFR\0\0\x0c\x04""7777BUFR", 18);
+            wassert(actual(scan::find_signature(data.data(), data.size(), 0, "BUFR", 4)) == 2u);
+            wassert(actual(scan::find_signature(data.data(), data.size(), 3, "BUFR", 4)) == 14u);
+            wassert(actual(scan::find_signature(data.data(), data.size(), 15, "BUFR", 4)) == data.size());
+            wassert(actual(scan::bufr_length(data.data() + 2)) == 12u);
+
+            string crex = "CREX++ 1 2 3++\r\r\n7777";
+            size_t end = 0;
+            wassert(actual(scan::find_crex_end(crex.data(), crex.size(), 6, end)).istrue());
+            wassert(actual(end) == crex.size());
+            wassert(actual(scan::find_crex_end(crex.data(), crex.size() - 1, 6, end)).isfalse());
+            wassert(actual(scan::find_crex_end(crex.data(), 12, 6, end)).isfalse());
+        });
+
+        add_method("junk", []() {
+            // Junk between messages is skipped, and invalid messages are
+            // returned or reported in the same way when reading from a
+            // file, from a pipe and from a FileReader
+            string msg1 = tests::slurpfile("bufr/obs0-1.22.bufr");
+            string msg2 = tests::slurpfile("bufr/synop-evapo.bufr");
+            string broken = msg1.substr(0, msg1.size() - 1) + "6";
+            string data = string(20000, 'B') + msg1 + string(300, 'x') + msg2 + broken + "BUFR" + string("\0\0\x05", 3) + string(20, 'x');
+            sys::write_file("test.bufr", data);
+            off_t offset2 = 20000 + msg1.size() + 300;
+
+            for (const char* cmd: { (const char*)nullptr, "cat test.bufr" })
+            {
+                FILE* in = cmd ? popen(cmd, "r") : fopen("test.bufr", "rb");
+                string buf;
+                off_t offset;
+                wassert(actual(BufrBulletin::read(in, buf, "test.bufr", &offset)).istrue());
+                // Offsets are not available on pipes
+                if (!cmd) wassert(actual(offset) == 20000);
+                wassert(actual(buf) == msg1);
+                wassert(actual(BufrBulletin::read(in, buf, "test.bufr", &offset)).istrue());
+                if (!cmd) wassert(actual(offset) == offset2);
+                wassert(actual(buf) == msg2);
+                wassert(actual(BufrBulletin::read(in, buf, "test.bufr", &offset)).istrue());
+                wassert(actual(buf) == broken);
+                try {
+                    BufrBulletin::read(in, buf, "test.bufr", &offset);
+                    throw TestFailed("reading a message shorter than 12 bytes should fail");
+                } catch (error_consistency& e) {
+                    wassert(actual(e.what()).contains("less than the minimum of 12"));
+                }
+                if (cmd) pclose(in); else fclose(in);
+            }
+
+            try {
+                BufrBulletin::decode(broken);
+                throw TestFailed("decoding a message without end section should fail");
+            } catch (error_parse& e) {
+                wassert(actual(e.what()).contains("7777"));
+            }
+
+            BufrFileReader reader("test.bufr");
+            const char* msg;
+            size_t size;
+            off_t offset;
+            wassert(actual(reader.next(msg, size, offset)).istrue());
+            wassert(actual(offset) == 20000);
+            wassert(actual(reader.next(msg, size, offset)).istrue());
+            wassert(actual(offset) == offset2);
+            wassert(actual(string(msg, size)) == msg2);
+            wassert(actual(reader.next(msg, size, offset)).istrue());
+            wassert(actual(string(msg, size)) == broken);
+            try {
+                reader.next(msg, size, offset);
+                throw TestFailed("reading a message shorter than 12 bytes should fail");
+            } catch (error_consistency& e) {
+                wassert(actual(e.what()).contains("less than the minimum of 12"));
+            }
+        });
+
+        add_method("crex_blocks", []() {
+            // The end of CREX messages is found also when it spans across
+            // read blocks
+            for (size_t len = 4080; len < 4100; ++len)
+            {
+                string msg = "CREX++" + string(len, '7') + "++\r\n7777";
+                sys::write_file("test.crex", msg + "\n" + msg);
+                FILE* in = fopen("test.crex", "rb");
+                string buf;
+                off_t offset;
+                wassert(actual(CrexBulletin::read(in, buf, "test.crex", &offset)).istrue());
+                wassert(actual(offset) == 0);
+                wassert(actual(buf) == msg);
+                wassert(actual(CrexBulletin::read(in, buf, "test.crex", &offset)).istrue());
+                wassert(actual(offset) == (off_t)(msg.size() + 1));
+                wassert(actual(buf) == msg);
+                wassert(actual(CrexBulletin::read(in, buf, "test.crex", &offset)).isfalse());
+                fclose(in);
+            }
+        });
+
+        add_method("truncated", []() {
+            string raw = tests::slurpfile("bufr/obs0-1.22.bufr");
+            sys::write_file("test.bufr", raw + raw.substr(0, 20));
+            sys::write_file("empty.bufr", "");
+
+            BufrFileReader reader("test.bufr");
+            const char* data;
+            size_t size;
+            off_t offset;
+            wassert(actual(reader.next(data, size, offset)).istrue());
+            try {
+                reader.next(data, size, offset);
+                throw TestFailed("reading a truncated message should fail");
+            } catch (error_consistency& e) {
+                wassert(actual(e.what()).contains("end of file reached"));
+            }
+
+            BufrFileReader empty("empty.bufr");
+            wassert(actual(empty.next(data, size, offset)).isfalse());
+        });
+    }
+} test("reader");
+
+}
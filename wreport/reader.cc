@@ -0,0 +1,133 @@
+#include "reader.h"
+#include "error.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace wreport {
+
+namespace scan {
+
+size_t find_signature(const char* data, size_t size, size_t pos, const char* sig, size_t sig_len)
+{
+    while (size - pos >= sig_len)
+    {
+        const char* found = (const char*)memchr(data + pos, sig[0], size - pos - sig_len + 1);
+        if (!found) break;
+        pos = found - data;
+        if (memcmp(found, sig, sig_len) == 0)
+            return pos;
+        ++pos;
+    }
+    return size;
+}
+
+size_t bufr_length(const char* data)
+{
+    const uint8_t* len = (const uint8_t*)data + 4;
+    return ((size_t)len[0] << 16) | ((size_t)len[1] << 8) | len[2];
+}
+
+bool find_crex_end(const char* data, size_t size, size_t pos, size_t& end)
+{
+    while (true)
+    {
+        size_t found = find_signature(data, size, pos, "++", 2);
+        if (found == size)
+            return false;
+        size_t cur = found + 2;
+        while (cur < size && (data[cur] == '\r' || data[cur] == '\n'))
+            ++cur;
+        if (cur > found + 2 && size - cur >= 4 && memcmp(data + cur, "7777", 4) == 0)
+        {
+            end = cur + 4;
+            return true;
+        }
+        pos = found + 1;
+    }
+}
+
+}
+
+FileReader::FileReader(const std::string& pathname)
+    : map(MAP_FAILED, 0), pathname(pathname)
+{
+    sys::File in(pathname, O_RDONLY);
+    struct stat st;
+    in.fstat(st);
+    if (S_ISREG(st.st_mode))
+    {
+        size = st.st_size;
+        if (size)
+        {
+            map = in.mmap(size, PROT_READ, MAP_SHARED);
+            data = map;
+        }
+    } else {
+        char buf[4096];
+        while (size_t count = in.read(buf, sizeof(buf)))
+            buffer.append(buf, count);
+        data = buffer.data();
+        size = buffer.size();
+    }
+}
+
+FileReader::~FileReader()
+{
+}
+
+bool BufrFileReader::next(const char*& msg, size_t& msg_size, off_t& offset)
+{
+    /// A BUFR message starts with "BUFR", then the message length encoded in 3 bytes
+    size_t start = scan::find_signature(data, size, pos, "BUFR", 4);
+    if (start == size)
+    {
+        pos = size;
+        return false;
+    }
+    pos = start + 4;
+
+    if (size - start < 8)
+        error_consistency::throwf("cannot read BUFR section 0 from %s: end of file reached", pathname.c_str());
+
+    size_t bufrlen = scan::bufr_length(data + start);
+    if (bufrlen < 12)
+        error_consistency::throwf("%s: the size declared by the BUFR message (%zd) is less than the minimum of 12", pathname.c_str(), bufrlen);
+    if (bufrlen > size - start)
+        error_consistency::throwf("cannot read BUFR message from %s: end of file reached", pathname.c_str());
+
+    msg = data + start;
+    msg_size = bufrlen;
+    offset = start;
+    pos = start + bufrlen;
+    return true;
+}
+
+bool CrexFileReader::next(const char*& msg, size_t& msg_size, off_t& offset)
+{
+    /// A CREX message starts with "CREX++" and ends with "++\r\r\n7777"
+    size_t start = scan::find_signature(data, size, pos, "CREX++", 6);
+    if (start == size)
+    {
+        pos = size;
+        return false;
+    }
+
+    size_t end;
+    if (!scan::find_crex_end(data, size, start + 6, end))
+    {
+        pos = size;
+        throw error_parse(pathname.c_str(), size, "CREX message is incomplete");
+    }
+    pos = end;
+
+    msg = data + start;
+    msg_size = end - start;
+    offset = start;
+    return true;
+}
+
+}
@@ -0,0 +1,113 @@
+#ifndef WREPORT_READER_H
+#define WREPORT_READER_H
+
+#include <wreport/utils/sys.h>
+#include <string>
+#include <sys/types.h>
+
+namespace wreport {
+
+/**
+ * Find the boundaries of encoded messages in memory buffers.
+ *
+ * These are used by the FileReader classes, and by BufrBulletin::read and
+ * CrexBulletin::read on blocks read from the input stream.
+ */
+namespace scan {
+
+/**
+ * Return the offset of the first occurrence of \a sig in \a data, starting
+ * from \a pos, or \a size if it is not found
+ */
+size_t find_signature(const char* data, size_t size, size_t pos, const char* sig, size_t sig_len);
+
+/**
+ * Return the length of a BUFR message as declared in its section 0.
+ *
+ * \a data points to the start of the message, and needs to contain at least
+ * 8 bytes.
+ */
+size_t bufr_length(const char* data);
+
+/**
+ * Find the end of a CREX message, that is, "++" followed by any sequence of
+ * carriage returns and newlines, followed by "7777".
+ *
+ * @retval end
+ *   The offset just past the end of the message
+ * @returns true if the end was found, false if it was not
+ */
+bool find_crex_end(const char* data, size_t size, size_t pos, size_t& end);
+
+}
+
+/**
+ * Read encoded messages from a file without copying them.
+ *
+ * The file is mapped in memory, and messages are returned as pointers into
+ * the mapped data, that can be passed directly to the decode functions of
+ * BufrBulletin and CrexBulletin. Pointers stay valid for as long as the
+ * reader exists.
+ *
+ * Files that cannot be mapped, like pipes, are read in memory instead.
+ */
+class FileReader
+{
+protected:
+    /// Mapped file contents
+    sys::MMap map;
+    /// File contents, if the file could not be mapped
+    std::string buffer;
+    /// Offset where the next message is searched
+    size_t pos = 0;
+
+public:
+    /// Pathname of the file being read
+    std::string pathname;
+    /// File contents
+    const char* data = nullptr;
+    /// Size of the file contents
+    size_t size = 0;
+
+    FileReader(const std::string& pathname);
+    FileReader(const FileReader&) = delete;
+    virtual ~FileReader();
+    FileReader& operator=(const FileReader&) = delete;
+
+    /**
+     * Find the next message in the file.
+     *
+     * Data before and between messages is skipped.
+     *
+     * @retval msg
+     *   Pointer to the start of the message
+     * @retval msg_size
+     *   Size of the message
+     * @retval offset
+     *   Offset of the start of the message in the file
+     * @returns true if a message was found, false on end of file
+     */
+    virtual bool next(const char*& msg, size_t& msg_size, off_t& offset) = 0;
+};
+
+/// FileReader for BUFR messages
+class BufrFileReader : public FileReader
+{
+public:
+    using FileReader::FileReader;
+
+    bool next(const char*& msg, size_t& msg_size, off_t& offset) override;
+};
+
+/// FileReader for CREX messages
+class CrexFileReader : public FileReader
+{
+public:
+    using FileReader::FileReader;
+
+    bool next(const char*& msg, size_t& msg_size, off_t& offset) override;
+};
+
+}
+
+#endif
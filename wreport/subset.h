@@ -23,13 +23,23 @@ struct Subset : public std::vector<Var>
      */
     Subset(const Tables& tables);
     Subset(const Subset& subset) = default;
-    Subset(Subset&& subset)
+
+    /**
+     * Move constructor.
+     *
+     * As with Var, values and attributes allocated in an Arena keep using it:
+     * call Var::detach_arena() on the variables to make them independent
+     * from it.
+     */
+    Subset(Subset&& subset) noexcept
         : std::vector<Var>(move(subset)), tables(subset.tables)
     {
     }
     ~Subset();
     Subset& operator=(const Subset&) = default;
-    Subset& operator=(Subset&& s);
+
+    /// Move assignment, which keeps using Arena memory as the move constructor
+    Subset& operator=(Subset&& s) noexcept;
 
 	/// Store a decoded variable in the message, to be encoded later.
 	void store_variable(const Var& var);
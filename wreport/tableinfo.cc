@@ -23,6 +23,15 @@ bool BufrTableID::operator<(const BufrTableID& o) const
     return false;
 }
 
+bool BufrTableID::operator==(const BufrTableID& o) const
+{
+    return originating_centre == o.originating_centre
+        && originating_subcentre == o.originating_subcentre
+        && master_table_number == o.master_table_number
+        && master_table_version_number == o.master_table_version_number
+        && master_table_version_number_local == o.master_table_version_number_local;
+}
+
 bool BufrTableID::is_acceptable_replacement(const BufrTableID& id) const
 {
     if (id.master_table_number != master_table_number)
@@ -251,6 +260,17 @@ bool CrexTableID::operator<(const CrexTableID& o) const
     return false;
 }
 
+bool CrexTableID::operator==(const CrexTableID& o) const
+{
+    return edition_number == o.edition_number
+        && originating_centre == o.originating_centre
+        && originating_subcentre == o.originating_subcentre
+        && master_table_number == o.master_table_number
+        && master_table_version_number == o.master_table_version_number
+        && master_table_version_number_local == o.master_table_version_number_local
+        && master_table_version_number_bufr == o.master_table_version_number_bufr;
+}
+
 bool CrexTableID::is_acceptable_replacement(const BufrTableID& id) const
 {
     // Master table number must be the same
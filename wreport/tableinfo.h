@@ -27,6 +27,7 @@ struct BufrTableID
           master_table_number(master_table_number), master_table_version_number(master_table_version_number), master_table_version_number_local(master_table_version_number_local) {}
 
     bool operator<(const BufrTableID& o) const;
+    bool operator==(const BufrTableID& o) const;
 
     bool is_acceptable_replacement(const BufrTableID& id) const;
     bool is_acceptable_replacement(const CrexTableID& id) const;
@@ -67,6 +68,7 @@ struct CrexTableID
           master_table_version_number_local(master_table_version_number_local) {}
 
     bool operator<(const CrexTableID& o) const;
+    bool operator==(const CrexTableID& o) const;
 
     bool is_acceptable_replacement(const BufrTableID& id) const;
     bool is_acceptable_replacement(const CrexTableID& id) const;
@@ -50,6 +50,17 @@ void Tables::clear()
     unknown_table.clear();
 }
 
+bool Tables::is_local(Varinfo info) const
+{
+    for (const auto& i: bitmap_table)
+        if (&i.second == info) return true;
+    for (const auto& i: chardata_table)
+        if (&i.second == info) return true;
+    for (const auto& i: unknown_table)
+        if (&i.second == info) return true;
+    return false;
+}
+
 void Tables::load_bufr(const BufrTableID& id)
 {
     auto& tabledir = tabledir::Tabledirs::get();
@@ -41,6 +41,9 @@ struct Tables
     /// Clear btable, datable and all locally generated Varinfos
     void clear();
 
+    /// Check if \a info is one of the locally generated Varinfos
+    bool is_local(Varinfo info) const;
+
     /// Load BUFR B and D tables
     void load_bufr(const BufrTableID& id);
 
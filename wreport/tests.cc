@@ -22,6 +22,7 @@
 #include "tests.h"
 #include "utils/string.h"
 #include "internals/fs.h"
+#include "reader.h"
 #include <cstdlib>
 #include <cstring>
 #include <unistd.h>
@@ -76,6 +77,26 @@ std::vector<std::string> all_test_files(const std::string& encoding)
     return res;
 }
 
+std::vector<TestMessage> all_bufr_messages()
+{
+    vector<TestMessage> res;
+    for (const auto& name: all_test_files("bufr"))
+    {
+        string fname = datafile(name);
+        BufrFileReader reader(fname);
+        const char* data;
+        size_t size;
+        off_t offset;
+        try {
+            while (reader.next(data, size, offset))
+                res.push_back(TestMessage{fname, string(data, size)});
+        } catch (error_consistency&) {
+            // Stop at the truncated message at the end of the file
+        }
+    }
+    return res;
+}
+
 void track_bulletin(Bulletin& b, const char* tag, const char* fname)
 {
     string dumpfname = "/tmp/bulletin-" + str::basename(fname) + "-" + tag;
@@ -52,6 +52,21 @@ std::string slurpfile(const std::string& name);
  */
 std::vector<std::string> all_test_files(const std::string& encoding);
 
+/// Raw message read from a test file
+struct TestMessage
+{
+    /// Pathname of the file containing the message
+    std::string fname;
+    /// Encoded message
+    std::string data;
+};
+
+/**
+ * Read all the messages in the BUFR test files, skipping the truncated
+ * messages at the end of some files
+ */
+std::vector<TestMessage> all_bufr_messages();
+
 void track_bulletin(Bulletin& b, const char* tag, const char* fname);
 
 template<typename BULLETIN>
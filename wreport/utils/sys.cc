@@ -207,6 +207,7 @@ MMap::~MMap()
 
 void MMap::munmap()
 {
+    if (addr == MAP_FAILED) return;
     if (::munmap(addr, length) == -1)
         throw std::system_error(errno, std::system_category(), "cannot unmap memory");
     addr = MAP_FAILED;
@@ -702,7 +703,7 @@ void write_file(const std::string& file, const std::string& data, mode_t mode)
 
 void write_file(const std::string& file, const void* data, size_t size, mode_t mode)
 {
-    File out(file, O_WRONLY | O_CREAT, mode);
+    File out(file, O_WRONLY | O_CREAT | O_TRUNC, mode);
     out.write_all_or_retry(data, size);
     out.close();
 }
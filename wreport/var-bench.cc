@@ -1,5 +1,6 @@
 #include "benchmark.h"
 #include "var.h"
+#include "vartable.h"
 #include <vector>
 #include <cstdlib>
 
@@ -14,6 +15,7 @@ struct VarBenchmark : Benchmark
     _Varinfo varinfo_int;
     _Varinfo varinfo_double;
     _Varinfo varinfo_string;
+    _Varinfo varinfo_short_string;
     _Varinfo varinfo_binary;
     static const unsigned vars_count = 30000;
     Var* vars_unset;
@@ -36,6 +38,12 @@ struct VarBenchmark : Benchmark
     Task setd;
     Task setc;
     Task setb;
+    Task create_c_short;
+    Task create_c_long;
+    Task setc_short;
+    Task setc_long;
+    Task copy_c_short;
+    Task copy_c_long;
 
     VarBenchmark(const std::string& name)
         : Benchmark(name),
@@ -53,7 +61,13 @@ struct VarBenchmark : Benchmark
           seti(this, "seti"),
           setd(this, "setd"),
           setc(this, "setc"),
-          setb(this, "setb")
+          setb(this, "setb"),
+          create_c_short(this, "newc_short"),
+          create_c_long(this, "newc_long"),
+          setc_short(this, "setc_short"),
+          setc_long(this, "setc_long"),
+          copy_c_short(this, "copyc_short"),
+          copy_c_long(this, "copyc_long")
     {
         repetitions = 100;
     }
@@ -64,6 +78,8 @@ struct VarBenchmark : Benchmark
         varinfo_int.set_bufr(WR_VAR(0, 0, 0), "test integer variable", "number", 0, 10, 0, 10);
         varinfo_double.set_bufr(WR_VAR(0, 0, 0), "test double variable", "number", 5, 10, -100000, 10);
         varinfo_string.set_string(WR_VAR(0, 0, 0), "test string variable", 32);
+        // Short enough to be stored inside the Var
+        varinfo_short_string.set_string(WR_VAR(0, 0, 0), "test short string variable", 7);
         varinfo_binary.set_binary(WR_VAR(0, 0, 0), "test binary variable", 20);
         // Allocate space for the test vars
         vars_unset = (Var*)malloc(vars_count * sizeof(Var));
@@ -247,8 +263,116 @@ struct VarBenchmark : Benchmark
                 vars_b[i].setc("\xf0\xf0");
             }
         });
+        // Create, set and copy string variables that fit inside Var, and
+        // variables that do not
+        create_c_short.collect([&]() {
+            for (unsigned i = 0; i < vars_count; ++i)
+            {
+                Var a(&varinfo_short_string, "");
+                Var b(&varinfo_short_string, "D-ABCD");
+                Var c(&varinfo_short_string, "ABCDEFG");
+            }
+        });
+        create_c_long.collect([&]() {
+            for (unsigned i = 0; i < vars_count; ++i)
+            {
+                Var a(&varinfo_string, "");
+                Var b(&varinfo_string, "D-ABCD");
+                Var c(&varinfo_string, "lorem ipsum dolor sit antani");
+            }
+        });
+        setc_short.collect([&]() {
+            Var var(&varinfo_short_string);
+            for (unsigned i = 0; i < vars_count; ++i)
+            {
+                var.setc("");
+                var.setc("D-ABCD");
+                var.setc("ABCDEFG");
+            }
+        });
+        setc_long.collect([&]() {
+            Var var(&varinfo_string);
+            for (unsigned i = 0; i < vars_count; ++i)
+            {
+                var.setc("");
+                var.setc("D-ABCD");
+                var.setc("lorem ipsum dolor sit antani");
+            }
+        });
+        copy_c_short.collect([&]() {
+            Var var(&varinfo_short_string, "D-ABCD");
+            for (unsigned i = 0; i < vars_count; ++i)
+            {
+                Var a(var);
+                Var b(a);
+                Var c(b);
+            }
+        });
+        copy_c_long.collect([&]() {
+            Var var(&varinfo_string, "lorem ipsum dolor sit antani");
+            for (unsigned i = 0; i < vars_count; ++i)
+            {
+                Var a(var);
+                Var b(a);
+                Var c(b);
+            }
+        });
     }
 } test("var");
 
+struct VartableBenchmark : Benchmark
+{
+    const Vartable* table = nullptr;
+    vector<Varcode> codes;
+    Task query;
+    Task contains;
+    Task query_altered;
+
+    VartableBenchmark(const std::string& name)
+        : Benchmark(name),
+          query(this, "query"),
+          contains(this, "contains"),
+          query_altered(this, "query_altered")
+    {
+        repetitions = 100;
+    }
+
+    void setup_main()
+    {
+        Benchmark::setup_main();
+        table = Vartable::get_bufr("B0000000000000024000");
+        table->iterate([&](Varinfo info) {
+            codes.push_back(info->code);
+            return true;
+        });
+    }
+
+    void main() override
+    {
+        query.collect([&]() {
+            for (unsigned i = 0; i < 100; ++i)
+                for (auto code: codes)
+                    table->query(code);
+        });
+        contains.collect([&]() {
+            for (unsigned i = 0; i < 100; ++i)
+                for (auto code: codes)
+                {
+                    table->contains(code);
+                    // Also look for codes that are not in the table
+                    table->contains(code + 1);
+                }
+        });
+        query_altered.collect([&]() {
+            for (unsigned i = 0; i < 100; ++i)
+                for (auto code: codes)
+                {
+                    Varinfo info = table->query(code);
+                    table->query_altered(code, info->scale, info->bit_len);
+                }
+        });
+    }
+} test_vartable("vartable");
+
 }
 
@@ -1,5 +1,6 @@
 #include "tests.h"
 #include "var.h"
+#include "arena.h"
 #include "vartable.h"
 #include "options.h"
 #include <cmath>
@@ -133,6 +134,209 @@ class Tests : public TestCase
             wassert(actual(var) != var1);
             wassert(actual(var1) != var);
         });
+        add_method("assign_different_info", []() {
+            // Assigning variables with different Varinfos
+            const Vartable* table = Vartable::get_bufr("B0000000000000014000");
+            Varinfo name = table->query(WR_VAR(0, 1, 19));
+            Varinfo ident = table->query(WR_VAR(0, 1, 8));
+            Varinfo number = table->query(WR_VAR(0, 6, 1));
+            wassert(actual(name->len) > ident->len);
+
+            Var var(ident, "ABCDEFGH");
+            Var longname(name, "Budapest Pestszentlorinc");
+            var = longname;
+            wassert(actual(var.code()) == WR_VAR(0, 1, 19));
+            wassert(actual(var.enqc()) == "Budapest Pestszentlorinc");
+
+            var = Var(ident, "IJKLMNOP");
+            wassert(actual(var.code()) == WR_VAR(0, 1, 8));
+            wassert(actual(var.enqc()) == "IJKLMNOP");
+
+            var = Var(number, 234);
+            wassert(actual(var.code()) == WR_VAR(0, 6, 1));
+            wassert(actual(var.enqi()) == 234);
+
+            var = longname;
+            wassert(actual(var.enqc()) == "Budapest Pestszentlorinc");
+
+            var = Var(number);
+            wassert(actual(var.code()) == WR_VAR(0, 6, 1));
+            wassert(actual(var.isset()).isfalse());
+
+            var = Var(ident);
+            var.setc("QRSTUVWX");
+            wassert(actual(var.enqc()) == "QRSTUVWX");
+        });
+        add_method("arena", []() {
+            // Values and attributes allocated in an Arena
+            const Vartable* table = Vartable::get_bufr("B0000000000000014000");
+            Varinfo ident = table->query(WR_VAR(0, 1, 8));
+            Varinfo name = table->query(WR_VAR(0, 1, 19));
+            Arena arena;
+
+            // Short strings are stored inside the Var
+            Var short_var(table->query(WR_VAR(0, 1, 18)));
+            short_var.use_arena(arena);
+            wassert(actual(arena.allocated()) == 0u);
+
+            Var var(name);
+            var.use_arena(arena);
+            wassert(actual(arena.allocated()) == name->len + 1);
+            var.setc("Budapest Pestszentlorinc");
+            var.seta(Var(table->query(WR_VAR(0, 33, 7)), 50));
+            var.seta(ident, arena).setc("ABCDEFGH");
+            var.seta(table->query(WR_VAR(0, 33, 2)), arena).seti(1);
+            wassert(actual(var.enqc()) == "Budapest Pestszentlorinc");
+            wassert(actual(var.enqa(WR_VAR(0, 1, 8))->enqc()) == "ABCDEFGH");
+            wassert(actual(var.enqa(WR_VAR(0, 33, 2))->enqi()) == 1);
+            wassert(actual(var.enqa(WR_VAR(0, 33, 7))->enqi()) == 50);
+
+            // The buffer is reused when setting a new value
+            size_t allocated = arena.allocated();
+            var.setc("Pestszentlorinc Budapest");
+            wassert(actual(arena.allocated()) == allocated);
+
+            // Replacing an arena attribute
+            var.seta(Var(table->query(WR_VAR(0, 33, 2)), 2));
+            wassert(actual(var.enqa(WR_VAR(0, 33, 2))->enqi()) == 2);
+
+            // Copies do not use the arena, moves keep using it until
+            // detach_arena() is called
+            Var copy(var);
+            const char* buf = var.enqc();
+            Var moved(std::move(var));
+            wassert(actual(moved.enqc() == buf).istrue());
+            wassert(actual(moved.enqc()) == "Pestszentlorinc Budapest");
+            moved.detach_arena();
+            wassert(actual(moved.enqc() == buf).isfalse());
+            Var assigned(ident);
+            var.use_arena(arena);
+            var.setc("Budapest Pestszentlorinc");
+            var.seta(ident, arena).setc("IJKLMNOP");
+            buf = var.enqc();
+            assigned = std::move(var);
+            wassert(actual(assigned.enqc() == buf).istrue());
+            assigned.detach_arena();
+
+            // forget_arena drops what is allocated in the arena
+            Var forgotten(name);
+            forgotten.use_arena(arena);
+            forgotten.setc("Budapest Pestszentlorinc");
+            forgotten.seta(ident, arena).setc("ABCDEFGH");
+            forgotten.seta(Var(table->query(WR_VAR(0, 33, 7)), 50));
+            forgotten.forget_arena();
+            wassert(actual(forgotten.isset()).isfalse());
+            wassert(actual(forgotten.enqa(WR_VAR(0, 1, 8)) == nullptr).istrue());
+            wassert(actual(forgotten.enqa(WR_VAR(0, 33, 7))->enqi()) == 50);
+            arena.clear();
+
+            wassert(actual(copy.enqc()) == "Pestszentlorinc Budapest");
+            wassert(actual(copy.enqa(WR_VAR(0, 1, 8))->enqc()) == "ABCDEFGH");
+            wassert(actual(moved.enqc()) == "Pestszentlorinc Budapest");
+            wassert(actual(moved.enqa(WR_VAR(0, 1, 8))->enqc()) == "ABCDEFGH");
+            wassert(actual(moved.enqa(WR_VAR(0, 33, 2))->enqi()) == 2);
+            wassert(actual(moved.enqa(WR_VAR(0, 33, 7))->enqi()) == 50);
+            wassert(actual(assigned.enqc()) == "Budapest Pestszentlorinc");
+            wassert(actual(assigned.enqa(WR_VAR(0, 1, 8))->enqc()) == "IJKLMNOP");
+            moved.setc("Budapest");
+            wassert(actual(moved.enqc()) == "Budapest");
+        });
+        add_method("share_value", []() {
+            // Variables sharing a value buffer allocated in an Arena
+            const Vartable* table = Vartable::get_bufr("B0000000000000014000");
+            Varinfo name = table->query(WR_VAR(0, 1, 19));
+            Arena arena;
+
+            Var var(name);
+            var.use_arena(arena);
+            var.setc("Budapest Pestszentlorinc");
+            size_t allocated = arena.allocated();
+
+            Var shared1(name);
+            Var shared2(name, "Budapest");
+            shared1.share_value(var);
+            shared2.share_value(var);
+            wassert(actual(arena.allocated()) == allocated);
+            wassert(actual(shared1.enqc() == var.enqc()).istrue());
+            wassert(actual(shared2.enqc() == var.enqc()).istrue());
+            wassert(actual(shared2) == var);
+
+            // Changing a shared value does not change the others
+            shared1.setc("Pestszentlorinc");
+            var.setc("Pestszentlorinc Budapest");
+            wassert(actual(shared1.enqc()) == "Pestszentlorinc");
+            wassert(actual(var.enqc()) == "Pestszentlorinc Budapest");
+            wassert(actual(shared2.enqc()) == "Budapest Pestszentlorinc");
+            wassert(actual(arena.allocated()) == allocated);
+
+            // Copies and moves
+            Var copy(shared2);
+            wassert(actual(copy.enqc() == shared2.enqc()).isfalse());
+            const char* buf = shared2.enqc();
+            Var moved(std::move(shared2));
+            wassert(actual(moved.enqc() == buf).istrue());
+            moved.detach_arena();
+            arena.clear();
+            wassert(actual(moved.enqc()) == "Budapest Pestszentlorinc");
+            wassert(actual(copy.enqc()) == "Budapest Pestszentlorinc");
+            wassert(actual(shared1.enqc()) == "Pestszentlorinc");
+
+            // Values not in an arena are copied
+            copy.share_value(shared1);
+            wassert(actual(copy.enqc() == shared1.enqc()).isfalse());
+            wassert(actual(copy.enqc()) == "Pestszentlorinc");
+            Var short_name(table->query(WR_VAR(0, 1, 18)), "ABCDE");
+            Var short_copy(short_name.info());
+            short_copy.share_value(short_name);
+            wassert(actual(short_copy.enqc()) == "ABCDE");
+
+            try {
+                short_copy.share_value(copy);
+                throw TestFailed("share_value with a different Varinfo should have failed");
+            } catch (error_consistency& e) {
+                wassert(actual(e.what()).contains("cannot share"));
+            }
+        });
+        add_method("inline_storage", []() {
+            // Values stored inside the Var, and values stored outside
+            const Vartable* table = Vartable::get_bufr("B0000000000000014000");
+            Varinfo short_name = table->query(WR_VAR(0, 1, 18));
+            Varinfo name = table->query(WR_VAR(0, 1, 19));
+            _Varinfo binary;
+            binary.set_binary(WR_VAR(0, 0, 0), "test binary variable", 7 * 8);
+
+            Var short_var(short_name, "ABCDE");
+            Var long_var(name, "Budapest Pestszentlorinc");
+            Var bin_var(&binary, "01234567");
+            wassert(actual(bin_var.info()->len) == 7u);
+            wassert(actual(memcmp(bin_var.enqc(), "0123456", 7)) == 0);
+
+            // Copy and move between inline values
+            Var copy(short_var);
+            wassert(actual(copy.enqc()) == "ABCDE");
+            Var moved(std::move(copy));
+            wassert(actual(moved.enqc()) == "ABCDE");
+            wassert(actual(copy.isset()).isfalse());
+            copy = moved;
+            wassert(actual(copy) == moved);
+            copy.setc("FGHI");
+            wassert(actual(copy.enqc()) == "FGHI");
+            wassert(actual(moved.enqc()) == "ABCDE");
+
+            // Switch between inline and allocated values
+            copy = long_var;
+            wassert(actual(copy.enqc()) == "Budapest Pestszentlorinc");
+            copy = std::move(moved);
+            wassert(actual(copy.enqc()) == "ABCDE");
+            copy = Var(long_var);
+            wassert(actual(copy.enqc()) == "Budapest Pestszentlorinc");
+            copy = bin_var;
+            wassert(actual(copy) == bin_var);
+            copy = Var(table->query(WR_VAR(0, 6, 1)), 123);
+            wassert(actual(copy.enqi()) == 123);
+            copy = short_var;
+            wassert(actual(copy.enqc()) == "ABCDE");
+        });
         add_method("missing", []() {
             // Test missing checks
             const Vartable* table = Vartable::get_bufr("B0000000000000014000");
@@ -184,6 +388,66 @@ class Tests : public TestCase
             // Query it back: it should be NULL
             wassert(actual(var.enqa(WR_VAR(0, 33, 7))).isfalse());
         });
+        add_method("attribute_array", []() {
+            // Attributes are kept sorted in an array that grows as needed
+            const Vartable* table = Vartable::get_bufr("B0000000000000014000");
+            Var var(table->query(WR_VAR(0, 12, 101)), 273.15);
+
+            auto codes = [](const Var& var) {
+                string res;
+                for (const Var* a = var.next_attr(); a; a = a->next_attr())
+                {
+                    if (!res.empty()) res += " ";
+                    res += varcode_format(a->code());
+                }
+                return res;
+            };
+
+            var.seta(Var(table->query(WR_VAR(0, 33, 7)), 50));
+            var.seta(Var(table->query(WR_VAR(0, 1, 19)), "Budapest Pestszentlorinc"));
+            var.seta(Var(table->query(WR_VAR(0, 33, 2)), 1));
+            var.seta(Var(table->query(WR_VAR(0, 1, 18)), "ABCDE"));
+            var.seta(Var(table->query(WR_VAR(0, 33, 5)), 3));
+            wassert(actual(codes(var)) == "B01018 B01019 B33002 B33005 B33007");
+            wassert(actual(var.enqa(WR_VAR(0, 1, 19))->enqc()) == "Budapest Pestszentlorinc");
+            wassert(actual(var.enqa(WR_VAR(0, 33, 3)) == nullptr).istrue());
+
+            // Replace
+            var.seta(Var(table->query(WR_VAR(0, 1, 19)), "Pestszentlorinc Budapest"));
+            wassert(actual(codes(var)) == "B01018 B01019 B33002 B33005 B33007");
+            wassert(actual(var.enqa(WR_VAR(0, 1, 19))->enqc()) == "Pestszentlorinc Budapest");
+            var.seta(*var.enqa(WR_VAR(0, 33, 5)));
+            wassert(actual(var.enqa(WR_VAR(0, 33, 5))->enqi()) == 3);
+
+            // Remove first, middle, last and missing
+            var.unseta(WR_VAR(0, 1, 18));
+            var.unseta(WR_VAR(0, 33, 2));
+            var.unseta(WR_VAR(0, 33, 7));
+            var.unseta(WR_VAR(0, 33, 3));
+            wassert(actual(codes(var)) == "B01019 B33005");
+            wassert(actual(var.enqa(WR_VAR(0, 1, 19))->enqc()) == "Pestszentlorinc Budapest");
+            wassert(actual(var.enqa(WR_VAR(0, 33, 5))->enqi()) == 3);
+
+            // Copy and move
+            Var copy(var);
+            wassert(actual(codes(copy)) == "B01019 B33005");
+            wassert(actual(copy) == var);
+            Var moved(std::move(copy));
+            wassert(actual(codes(moved)) == "B01019 B33005");
+            wassert(actual(copy.next_attr() == nullptr).istrue());
+            copy = moved;
+            wassert(actual(copy) == var);
+            copy = Var(table->query(WR_VAR(0, 12, 101)), 273.15);
+            wassert(actual(copy.next_attr() == nullptr).istrue());
+
+            // Cleared attributes can be set again
+            var.clear_attrs();
+            wassert(actual(var.next_attr() == nullptr).istrue());
+            wassert(actual(var.enqa(WR_VAR(0, 33, 5)) == nullptr).istrue());
+            var.seta(Var(table->query(WR_VAR(0, 33, 7)), 70));
+            wassert(actual(codes(var)) == "B33007");
+            wassert(actual(var) != moved);
+        });
         add_method("enq", []() {
             // Test templated enq
             const Vartable* table = Vartable::get_bufr("B0000000000000014000");
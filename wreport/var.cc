@@ -1,4 +1,5 @@
 #include "var.h"
+#include "arena.h"
 #include "notes.h"
 #include "options.h"
 #include "vartable.h"
@@ -10,6 +11,7 @@
 #include <cctype>
 #include <cmath>
 #include <iostream>
+#include <new>
 
 using namespace std;
 
@@ -123,11 +125,10 @@ Var::Var(const Var& var)
     setattrs(var);
 }
 
-Var::Var(Var&& var)
-    : m_info(var.m_info), m_isset(false), m_value{}, m_attrs(var.m_attrs)
+Var::Var(Var&& var) noexcept
+    : m_info(var.m_info), m_isset(false), m_value{}, m_attrs(nullptr)
 {
-    move_value(var);
-    var.m_attrs = nullptr;
+    steal(var);
 }
 
 Var::Var(Varinfo info, const Var& var)
@@ -142,7 +143,7 @@ Var& Var::operator=(const Var& var)
     if (&var == this) return *this;
 
     // Copy info
-    m_info = var.m_info;
+    change_info(var.m_info);
 
     // Copy value
     copy_value(var);
@@ -152,13 +153,12 @@ Var& Var::operator=(const Var& var)
     return *this;
 }
 
-Var& Var::operator=(Var&& var)
+Var& Var::operator=(Var&& var) noexcept
 {
     if (&var == this) return *this;
-    move_value(var);
-    delete m_attrs;
-    m_attrs = var.m_attrs;
-    var.m_attrs = nullptr;
+    change_info(var.m_info);
+    free_attrs();
+    steal(var);
     return *this;
 }
 
@@ -168,13 +168,14 @@ Var::~Var()
     {
         case Vartype::Binary:
         case Vartype::String:
-            delete[] m_value.c;
+            if (!value_inline())
+                free_value();
             break;
         case Vartype::Integer:
         case Vartype::Decimal:
             break;
     }
-    delete m_attrs;
+    free_attrs();
 }
 
 bool Var::operator==(const Var& var) const
@@ -183,17 +184,186 @@ bool Var::operator==(const Var& var) const
     if (!value_equals(var)) return false;
 
     // Compare attrs
-    if (!m_attrs && !var.m_attrs) return true;
-    if (!m_attrs || !var.m_attrs) return false;
-    return *m_attrs == *var.m_attrs;
+    const Var* a = next_attr();
+    const Var* b = var.next_attr();
+    if (!a && !b) return true;
+    if (!a || !b) return false;
+    return *a == *b;
 }
 
 void Var::allocate()
 {
+    if (value_inline()) return;
+    if (m_buffer == Buffer::Shared)
+    {
+        // Leave the shared buffer to the other variables
+        m_value.c = nullptr;
+        m_buffer = Buffer::Owned;
+    }
     if (!m_value.c && !(m_value.c = new char[m_info->len + 1]))
         throw error_alloc("allocating space for Var value");
 }
 
+void Var::free_value()
+{
+    if (m_buffer == Buffer::Owned)
+        delete[] m_value.c;
+    m_value.c = nullptr;
+    m_buffer = Buffer::Owned;
+}
+
+void Var::steal(Var& var)
+{
+    move_value(var);
+    if (var.m_attr_capacity)
+    {
+        m_attrs = var.m_attrs;
+        m_attr_count = var.m_attr_count;
+        m_attr_capacity = var.m_attr_capacity;
+        m_arena_attrs = var.m_arena_attrs;
+        var.m_attrs = nullptr;
+        var.m_attr_count = var.m_attr_capacity = 0;
+        var.m_arena_attrs = false;
+    }
+}
+
+void Var::relocate_attr(Var* dst, Var& src)
+{
+    new (dst) Var(std::move(src));
+    dst->m_arena_var = src.m_arena_var;
+    src.~Var();
+}
+
+void Var::link_attrs()
+{
+    for (unsigned i = 0; i < m_attr_count; ++i)
+        m_attrs[i].m_attrs = i + 1 < m_attr_count ? m_attrs + i + 1 : nullptr;
+}
+
+void Var::move_attrs(unsigned capacity, Arena* arena)
+{
+    if (capacity > UINT16_MAX)
+        error_consistency::throwf("cannot store more than %u attributes in a variable", (unsigned)UINT16_MAX);
+
+    Var* attrs;
+    if (arena)
+        attrs = (Var*)arena->allocate(capacity * sizeof(Var), alignof(Var));
+    else
+        attrs = (Var*)::operator new(capacity * sizeof(Var));
+
+    for (unsigned i = 0; i < m_attr_count; ++i)
+        relocate_attr(attrs + i, m_attrs[i]);
+    if (m_attr_capacity && !m_arena_attrs)
+        ::operator delete(m_attrs);
+
+    m_attrs = attrs;
+    m_attr_capacity = capacity;
+    m_arena_attrs = arena != nullptr;
+    link_attrs();
+}
+
+void Var::free_attrs()
+{
+    if (!m_attr_capacity) return;
+    clear_attrs();
+    if (!m_arena_attrs)
+        ::operator delete(m_attrs);
+    m_attrs = nullptr;
+    m_attr_capacity = 0;
+    m_arena_attrs = false;
+}
+
+void Var::detach_arena()
+{
+    if (m_buffer != Buffer::Owned)
+    {
+        char* buf = nullptr;
+        if (m_isset)
+        {
+            buf = new char[m_info->len + 1];
+            memcpy(buf, m_value.c, m_info->len + 1);
+        }
+        m_value.c = buf;
+        m_buffer = Buffer::Owned;
+    }
+
+    if (!m_attr_capacity) return;
+
+    if (m_arena_attrs)
+    {
+        if (!m_attr_count)
+        {
+            m_attrs = nullptr;
+            m_attr_capacity = 0;
+            m_arena_attrs = false;
+            return;
+        }
+        move_attrs(m_attr_count, nullptr);
+    }
+    for (unsigned i = 0; i < m_attr_count; ++i)
+    {
+        m_attrs[i].detach_arena();
+        m_attrs[i].m_arena_var = false;
+    }
+}
+
+void Var::forget_arena()
+{
+    if (m_buffer != Buffer::Owned)
+    {
+        m_value.c = nullptr;
+        m_buffer = Buffer::Owned;
+        m_isset = false;
+    }
+
+    if (!m_attr_capacity) return;
+
+    // Remove the attributes created in an arena
+    unsigned count = 0;
+    for (unsigned i = 0; i < m_attr_count; ++i)
+    {
+        if (m_attrs[i].m_arena_var)
+            m_attrs[i].~Var();
+        else
+        {
+            m_attrs[i].forget_arena();
+            if (i != count)
+                relocate_attr(m_attrs + count, m_attrs[i]);
+            ++count;
+        }
+    }
+    m_attr_count = count;
+
+    if (!m_arena_attrs)
+        link_attrs();
+    else if (count)
+        // Move the remaining attributes out of the arena
+        move_attrs(count, nullptr);
+    else
+    {
+        m_attrs = nullptr;
+        m_attr_capacity = 0;
+        m_arena_attrs = false;
+    }
+}
+
+void Var::change_info(Varinfo info)
+{
+    if (info == m_info) return;
+
+    bool has_buffer = (m_info->type == Vartype::String || m_info->type == Vartype::Binary)
+        && !value_inline();
+    bool needs_buffer = (info->type == Vartype::String || info->type == Vartype::Binary)
+        && info->len >= sizeof(m_value.s);
+    if (!has_buffer)
+        m_value.c = nullptr;
+    else if (!needs_buffer || info->len > m_info->len)
+        free_value();
+
+    m_info = info;
+    m_isset = false;
+}
+
 void Var::copy_value(const Var& var)
 {
     m_isset = var.m_isset;
@@ -203,11 +373,11 @@ void Var::copy_value(const Var& var)
     {
         case Vartype::Binary:
             allocate();
-            memcpy(m_value.c, var.m_value.c, m_info->len);
+            memcpy(value_buffer(), var.value_buffer(), m_info->len);
             break;
         case Vartype::String:
             allocate();
-            memcpy(m_value.c, var.m_value.c, m_info->len + 1);
+            memcpy(value_buffer(), var.value_buffer(), m_info->len + 1);
             break;
         case Vartype::Integer:
         case Vartype::Decimal:
@@ -225,9 +395,17 @@ void Var::move_value(Var& var)
     {
         case Vartype::Binary:
         case Vartype::String:
-            if (m_value.c) delete[] m_value.c;
+            if (value_inline())
+            {
+                memcpy(m_value.s, var.m_value.s, m_info->len + 1);
+                var.m_isset = false;
+                break;
+            }
+            free_value();
             m_value.c = var.m_value.c;
+            m_buffer = var.m_buffer;
             var.m_value.c = nullptr;
+            var.m_buffer = Buffer::Owned;
             var.m_isset = false;
             break;
         case Vartype::Integer:
@@ -238,6 +416,25 @@ void Var::move_value(Var& var)
     }
 }
 
+void Var::share_value(Var& var)
+{
+    if (var.m_info != m_info)
+        error_consistency::throwf("cannot share the value of %01d%02d%03d with %01d%02d%03d",
+                WR_VAR_FXY(var.code()), WR_VAR_FXY(code()));
+    if (&var == this) return;
+
+    if (!var.m_isset || value_inline() || var.m_buffer == Buffer::Owned)
+    {
+        copy_value(var);
+        return;
+    }
+
+    free_value();
+    m_value.c = var.m_value.c;
+    m_buffer = var.m_buffer = Buffer::Shared;
+    m_isset = true;
+}
+
 bool Var::value_equals(const Var& var) const
 {
     if (!m_isset && !var.m_isset) return true;
@@ -247,9 +444,9 @@ bool Var::value_equals(const Var& var) const
     switch (m_info->type)
     {
         case Vartype::Binary:
-            return memcmp(m_value.c, var.m_value.c, m_info->len) == 0;
+            return memcmp(value_buffer(), var.value_buffer(), m_info->len) == 0;
         case Vartype::String:
-            return strcmp(m_value.c, var.m_value.c) == 0;
+            return strcmp(value_buffer(), var.value_buffer()) == 0;
         case Vartype::Integer:
         case Vartype::Decimal:
             return m_value.i == var.m_value.i;
@@ -259,8 +456,9 @@ bool Var::value_equals(const Var& var) const
 
 void Var::clear_attrs()
 {
-    delete m_attrs;
-    m_attrs = 0;
+    for (unsigned i = 0; i < m_attr_count; ++i)
+        m_attrs[i].~Var();
+    m_attr_count = 0;
 }
 
 int Var::enqi() const
@@ -356,7 +554,7 @@ const char* Var::enqc() const
     {
         case Vartype::String:
         case Vartype::Binary:
-            return m_value.c;
+            return value_buffer();
         case Vartype::Integer:
         case Vartype::Decimal: {
             // Access tl_buf just once, to prevent a lot of calls to __tls_get_addr
@@ -380,7 +578,7 @@ std::string Var::enqs() const
     {
         case Vartype::String:
         case Vartype::Binary:
-            return m_value.c;
+            return value_buffer();
         case Vartype::Integer:
         case Vartype::Decimal:
             return int32_to_stdstr(m_value.i);
@@ -433,16 +631,17 @@ void Var::assign_d_checked(double val)
 void Var::assign_b_checked(uint8_t* val, unsigned size)
 {
     allocate();
+    char* buf = value_buffer();
     if (size < m_info->len)
     {
         // If val is too short, copy it and zero pad the rest
-        memcpy(m_value.c, val, size);
+        memcpy(buf, val, size);
         for (unsigned i = size; i < m_info->len; ++i)
-            m_value.c[i] = 0;
+            buf[i] = 0;
     } else {
-        memcpy(m_value.c, val, m_info->len);
+        memcpy(buf, val, m_info->len);
         if (m_info->bit_len % 8)
-            m_value.c[m_info->len - 1] &= (1 << (m_info->bit_len % 8)) - 1;
+            buf[m_info->len - 1] &= (1 << (m_info->bit_len % 8)) - 1;
     }
     m_isset = true;
 }
@@ -450,13 +649,14 @@ void Var::assign_b_checked(uint8_t* val, unsigned size)
 void Var::assign_c_checked(const char* val, unsigned size)
 {
     allocate();
+    char* buf = value_buffer();
     if (size < m_info->len)
     {
-        strncpy(m_value.c, val, size);
-        m_value.c[size] = 0;
+        strncpy(buf, val, size);
+        buf[size] = 0;
     } else {
-        strncpy(m_value.c, val, m_info->len);
-        m_value.c[m_info->len] = 0;
+        strncpy(buf, val, m_info->len);
+        buf[m_info->len] = 0;
     }
     m_isset = true;
 }
@@ -574,67 +774,93 @@ void Var::unset()
 
 const Var* Var::enqa(Varcode code) const
 {
-    for (const Var* cur = m_attrs; cur && cur->code() <= code; cur = cur->m_attrs)
-        if (cur->code() == code)
-            return cur;
+    for (unsigned i = 0; i < m_attr_count && m_attrs[i].code() <= code; ++i)
+        if (m_attrs[i].code() == code)
+            return m_attrs + i;
     return nullptr;
 }
 
 void Var::seta(const Var& attr)
 {
-    seta(unique_ptr<Var>(new Var(attr)));
+    // Setting an attribute to itself
+    if (enqa(attr.code()) == &attr) return;
+    Var& dest = obtain_attr(attr.m_info, nullptr);
+    dest.copy_value(attr);
 }
 
 void Var::seta(Var&& attr)
 {
-    seta(unique_ptr<Var>(new Var(attr)));
+    if (enqa(attr.code()) == &attr) return;
+    Var& dest = obtain_attr(attr.m_info, nullptr);
+    dest.move_value(attr);
 }
 
 void Var::seta(unique_ptr<Var>&& attr)
 {
-    // Ensure that the attribute does not have attributes of its own
-    attr->clear_attrs();
+    seta(std::move(*attr));
+    attr.reset();
+}
+
+Var& Var::seta(Varinfo info, Arena& arena)
+{
+    Var& attr = obtain_attr(info, &arena);
+    attr.m_arena_var = true;
+    attr.use_arena(arena);
+    return attr;
+}
 
-    if (!m_attrs || m_attrs->code() > attr->code())
-    {
-        // Append / insert
-        attr->m_attrs = m_attrs;
-        m_attrs = attr.release();
-    }
-    else if (m_attrs->code() == attr->code())
+Var& Var::obtain_attr(Varinfo info, Arena* arena)
+{
+    unsigned pos = 0;
+    while (pos < m_attr_count && m_attrs[pos].code() < info->code)
+        ++pos;
+
+    if (pos < m_attr_count && m_attrs[pos].code() == info->code)
     {
         // Replace existing
-        attr->m_attrs = m_attrs->m_attrs;
-        Var* old_attrs = m_attrs;
-        m_attrs = attr.release();
-        old_attrs->m_attrs = nullptr;
-        delete old_attrs;
+        Var& attr = m_attrs[pos];
+        attr.change_info(info);
+        attr.unset();
+        if (!arena)
+        {
+            // Do not keep referring to an arena that the caller does not know
+            // about
+            if (attr.m_buffer != Buffer::Owned)
+                attr.free_value();
+            attr.m_arena_var = false;
+        }
+        return attr;
     }
-    else
-        // Recursively proceed along the chain
-        m_attrs->seta(move(attr));
+
+    // Append / insert
+    if (m_attr_count == m_attr_capacity)
+        move_attrs(m_attr_capacity ? m_attr_capacity * 2 : 1, arena);
+    for (unsigned i = m_attr_count; i > pos; --i)
+        relocate_attr(m_attrs + i, m_attrs[i - 1]);
+    Var* attr = new (m_attrs + pos) Var(info);
+    ++m_attr_count;
+    link_attrs();
+    return *attr;
 }
 
 void Var::unseta(Varcode code)
 {
-    if (!m_attrs || m_attrs->code() > code)
-        // Past the end, nothing to do
-        return;
-    else if (m_attrs->code() == code)
+    for (unsigned pos = 0; pos < m_attr_count && m_attrs[pos].code() <= code; ++pos)
     {
-        // Got the right item, unlink and delete it
-        Var* old_attrs = m_attrs;
-        m_attrs = m_attrs->m_attrs;
-        old_attrs->m_attrs = nullptr;
-        delete old_attrs;
+        if (m_attrs[pos].code() != code) continue;
+        m_attrs[pos].~Var();
+        for (unsigned i = pos + 1; i < m_attr_count; ++i)
+            relocate_attr(m_attrs + i - 1, m_attrs[i]);
+        --m_attr_count;
+        link_attrs();
+        return;
     }
-    else
-        // Recursively proceed along the chain
-        m_attrs->unseta(code);
 }
 
 const Var* Var::next_attr() const
 {
+    if (m_attr_capacity)
+        return m_attr_count ? m_attrs : nullptr;
     return m_attrs;
 }
 
@@ -660,8 +886,21 @@ void Var::setval(const Var& src)
 void Var::setattrs(const Var& src)
 {
     clear_attrs();
-    if (src.m_attrs)
-        m_attrs = new Var(*src.m_attrs);
+
+    unsigned count = 0;
+    for (const Var* a = src.next_attr(); a; a = a->next_attr())
+        ++count;
+    if (!count) return;
+
+    if (count > m_attr_capacity)
+        move_attrs(count, nullptr);
+    for (const Var* a = src.next_attr(); a; a = a->next_attr())
+    {
+        Var* attr = new (m_attrs + m_attr_count) Var(a->m_info);
+        ++m_attr_count;
+        attr->copy_value(*a);
+    }
+    link_attrs();
 }
 
 std::string Var::format(const char* ifundef) const
@@ -675,12 +914,12 @@ std::string Var::format(const char* ifundef) const
             for (unsigned i = 0; i < info()->len; ++i)
             {
                 char buf[4];
-                snprintf(buf, 4, "%02hhX", ((uint8_t*)m_value.c)[i]);
+                snprintf(buf, 4, "%02hhX", ((const uint8_t*)value_buffer())[i]);
                 res += buf;
             }
             return res;
         }
-        case Vartype::String: return m_value.c;
+        case Vartype::String: return value_buffer();
         case Vartype::Integer:
         case Vartype::Decimal: {
             Varinfo i = info();
@@ -703,10 +942,10 @@ void Var::format(FILE* out, const char* ifundef) const
     {
         case Vartype::Binary:
             for (unsigned i = 0; i < info()->len; ++i)
-                fprintf(out, "%02hhX", ((uint8_t*)m_value.c)[i]);
+                fprintf(out, "%02hhX", ((const uint8_t*)value_buffer())[i]);
             return;
         case Vartype::String:
-            fputs(m_value.c, out);
+            fputs(value_buffer(), out);
             return;
         case Vartype::Integer:
         case Vartype::Decimal: {
@@ -803,7 +1042,7 @@ unsigned Var::diff(const Var& var) const
                         m_info->bit_len, var.info()->bit_len);
                 return 1;
             }
-            if (memcmp(m_value.c, var.m_value.c, m_info->len) != 0)
+            if (memcmp(value_buffer(), var.value_buffer(), m_info->len) != 0)
             {
                 string dump1 = format();
                 string dump2 = var.format();
@@ -813,10 +1052,10 @@ unsigned Var::diff(const Var& var) const
             }
             break;
         case Vartype::String:
-            if (strcmp(m_value.c, var.m_value.c) != 0)
+            if (strcmp(value_buffer(), var.value_buffer()) != 0)
             {
                 notes::logf("[%d%02d%03d %s] values differ: first is \"%s\", second is \"%s\"\n",
-                        WR_VAR_FXY(code()), m_info->desc, m_value.c, var.m_value.c);
+                        WR_VAR_FXY(code()), m_info->desc, value_buffer(), var.value_buffer());
                 return 1;
             }
             break;
@@ -840,9 +1079,9 @@ unsigned Var::diff(const Var& var) const
             break;
     }
 
-    if ((m_attrs != 0) != (var.m_attrs != 0))
+    if ((next_attr() != nullptr) != (var.next_attr() != nullptr))
     {
-        if (m_attrs)
+        if (next_attr())
         {
             notes::logf("[%d%02d%03d %s] attributes differ: first has attributes, second does not\n",
                     WR_VAR_F(code()), WR_VAR_X(code()), WR_VAR_Y(code()),
@@ -3,6 +3,7 @@
 
 #include <wreport/error.h>
 #include <wreport/varinfo.h>
+#include <wreport/arena.h>
 #include <cstdio>
 #include <string>
 #include <memory>
@@ -19,6 +20,14 @@ namespace wreport {
  * \li a value, that can be integer, floating point, string or opaque binary
  *     data as specified by the Varinfo
  * \li zero or more attributes, represented by other wreport::Var objects
+ *
+ * The memory for string values and attributes can be taken from an Arena
+ * (see use_arena() and seta(Varinfo, Arena&)), as it happens for the
+ * variables decoded into a Bulletin. In that case the variable is only valid
+ * until the Arena is cleared or destroyed. Moving the variable keeps using
+ * the Arena, while copying it or calling detach_arena() creates a variable
+ * that is independent from it. Variables with the same value can also share
+ * a single buffer in the Arena (see share_value()).
  */
 class Var
 {
@@ -29,6 +38,60 @@ protected:
     /// True if the variable is set, false otherwise
     bool m_isset;
 
+    /**
+     * How the buffer of a string or binary value that is not stored inline
+     * (see value_inline()) has been allocated
+     */
+    enum class Buffer : uint8_t
+    {
+        /// Allocated with new[] and owned by this variable
+        Owned,
+        /// Allocated in an Arena, and reused as the value changes
+        Arena,
+        /**
+         * Allocated in an Arena and shared with other variables (see
+         * share_value()): it is never modified, and setting a new value
+         * allocates a new buffer
+         */
+        Shared,
+    };
+
+    /**
+     * How the buffer in m_value.c has been allocated.
+     *
+     * It only applies to string and binary values that are not stored
+     * inline: m_value.c can be nullptr if no buffer has been allocated yet.
+     */
+    Buffer m_buffer = Buffer::Owned;
+
+    /**
+     * True if this variable is an attribute created by
+     * seta(Varinfo, Arena&). forget_arena() on the variable that owns it
+     * removes it, and detach_arena() makes it a normal attribute.
+     */
+    bool m_arena_var = false;
+
+    /**
+     * True if the m_attrs array is allocated in an Arena, and is not freed
+     * with the variable
+     */
+    bool m_arena_attrs = false;
+
+    /**
+     * Number of attributes in use in the m_attrs array.
+     *
+     * It is always 0 for the attributes themselves.
+     */
+    uint16_t m_attr_count = 0;
+
+    /**
+     * Number of attributes that fit in the m_attrs array.
+     *
+     * It is 0 if the variable has no attribute array, and always 0 for the
+     * attributes themselves.
+     */
+    uint16_t m_attr_capacity = 0;
+
     /**
      * Value of the variable
      *
@@ -39,18 +102,92 @@ protected:
      *
      * For binary values, it is a raw buffer where the first m_info->bit_len
      * bits are the binary value, and the rest is set to 0.
+     *
+     * String and binary buffers that fit in s are stored inline, the others
+     * are allocated and pointed by c (see value_inline()).
      */
     union {
         int32_t i;
         char* c;
+        char s[8];
     } m_value;
 
-    /// Attribute list (ordered by Varcode)
+    /**
+     * Attributes (ordered by Varcode)
+     *
+     * If m_attr_capacity is not 0, it is an array with space for
+     * m_attr_capacity attributes, of which the first m_attr_count are in use.
+     *
+     * In the attributes themselves, it points to the next attribute in the
+     * array, or is nullptr for the last one, so that next_attr() can be used
+     * to iterate them.
+     */
     Var* m_attrs;
 
-    /// Make sure that m_value is allocated. It does nothing if it already is.
+    /// Check if the string or binary value buffer is stored inside m_value
+    bool value_inline() const { return m_info->len < sizeof(m_value.s); }
+
+    /// Buffer with the string or binary value
+    char* value_buffer() { return value_inline() ? m_value.s : m_value.c; }
+
+    /// Buffer with the string or binary value
+    const char* value_buffer() const { return value_inline() ? m_value.s : m_value.c; }
+
+    /**
+     * Make sure that the string or binary value buffer is allocated and can
+     * be written to. It does nothing if it already is.
+     *
+     * A Shared buffer is replaced with a new Owned one, and a buffer is
+     * allocated with new[] if the variable does not have one.
+     */
     void allocate();
 
+    /// Deallocate m_value, which must be a string or binary value buffer
+    void free_value();
+
+    /**
+     * Return the attribute with the given Varinfo, adding it if it does not
+     * exist.
+     *
+     * If the attribute array needs to grow, the new one is allocated from
+     * \a arena, or from the heap if \a arena is nullptr.
+     */
+    Var& obtain_attr(Varinfo info, Arena* arena);
+
+    /**
+     * Move the attributes to a new array with space for \a capacity
+     * attributes, allocated from \a arena or from the heap if \a arena is
+     * nullptr
+     */
+    void move_attrs(unsigned capacity, Arena* arena);
+
+    /// Point each attribute to the next one in the array
+    void link_attrs();
+
+    /// Destroy all attributes and deallocate the attribute array
+    void free_attrs();
+
+    /**
+     * Take the value and attributes of \a var, which must have the same
+     * Varinfo, leaving it unset and without attributes.
+     *
+     * Only pointers are transferred, and memory allocated in an Arena is
+     * kept, so it does not allocate.
+     */
+    void steal(Var& var);
+
+    /**
+     * Move-construct \a dst from \a src, as an attribute of the same
+     * variable, and destroy \a src. Memory allocated in an Arena is kept.
+     */
+    static void relocate_attr(Var* dst, Var& src);
+
+    /**
+     * Switch to a different Varinfo, leaving the variable unset.
+     *
+     * The value buffer is kept if it is big enough for the new Varinfo.
+     */
+    void change_info(Varinfo info);
     /// Copy the value from var. var is assumed to have the same varinfo as us.
     void copy_value(const Var& var);
     /// Move the value from var. var is assumed to have the same varinfo as us. var is left unset.
@@ -96,8 +233,12 @@ public:
      *
      * After movement, \a var will still a valid variable, but it will be unset
      * and without attributes.
+     *
+     * Values and attributes allocated in an Arena are not copied, and the
+     * new variable keeps using the Arena: use detach_arena() to make it
+     * independent from it.
      */
-    Var(Var&& var);
+    Var(Var&& var) noexcept;
 
     ~Var();
 
@@ -109,8 +250,12 @@ public:
      *
      * After movement, \a var will still a valid variable, but it will be unset
      * and without attributes.
+     *
+     * Values and attributes allocated in an Arena are not copied, and the
+     * variable keeps using the Arena: use detach_arena() to make it
+     * independent from it.
      */
-    Var& operator=(Var&& var);
+    Var& operator=(Var&& var) noexcept;
 
     bool operator==(const Var& var) const;
     bool operator!=(const Var& var) const { return !operator==(var); }
@@ -211,7 +356,56 @@ public:
     /// Unset the value
     void unset();
 
-    /// Remove all attributes
+    /**
+     * Allocate the buffer for string and binary values from \a arena, if the
+     * variable does not have one yet and the value does not fit inline.
+     *
+     * The buffer is reused as the value changes, and the variable is only
+     * valid as long as \a arena is not cleared or destroyed.
+     */
+    void use_arena(Arena& arena)
+    {
+        if ((m_info->type == Vartype::String || m_info->type == Vartype::Binary)
+                && !value_inline() && !m_value.c)
+        {
+            m_value.c = (char*)arena.allocate(m_info->len + 1, 1);
+            m_buffer = Buffer::Arena;
+        }
+    }
+
+    /**
+     * Set the value to the value of \a var, sharing its buffer instead of
+     * copying it.
+     *
+     * \a var must have the same Varinfo. Only string and binary buffers
+     * allocated in an Arena (see use_arena()) are shared, other values are
+     * copied. Shared buffers are never modified: setting a new value to
+     * either variable allocates a new buffer for it.
+     *
+     * Attributes are not changed.
+     */
+    void share_value(Var& var);
+
+    /**
+     * Copy to the heap the value and the attributes allocated in an Arena, so
+     * that the variable stays valid after the Arena is cleared.
+     */
+    void detach_arena();
+
+    /**
+     * Stop using memory allocated from an Arena.
+     *
+     * Attributes allocated in an Arena are removed, and if the value is
+     * stored in an Arena, the variable is unset. This is used to keep the
+     * variable around when the Arena is cleared.
+     */
+    void forget_arena();
+
+    /**
+     * Remove all attributes.
+     *
+     * The space for the attributes is kept, to be reused by the next seta().
+     */
     void clear_attrs();
 
     /**
@@ -222,6 +416,7 @@ public:
      * @returns attr
      *   A pointer to the attribute if it exists, else NULL.  The pointer points to
      *   the internal representation and must not be deallocated by the caller.
+     *   It is valid until the attributes of the variable are changed.
      */
     const Var* enqa(Varcode code) const;
 
@@ -255,6 +450,17 @@ public:
      */
     void seta(std::unique_ptr<Var>&& attr);
 
+    /**
+     * Create an attribute of the variable, allocating it in \a arena.  An
+     * existing attribute with the same wreport::Varcode will be replaced.
+     *
+     * @returns
+     *   The new attribute, unset, whose value is also allocated in \a arena.
+     *   The reference is valid until the attributes of the variable are
+     *   changed.
+     */
+    Var& seta(Varinfo info, Arena& arena);
+
     /// Remove the attribute with the given code
     void unseta(Varcode code);
 
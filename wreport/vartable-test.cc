@@ -1,8 +1,13 @@
 #include "tests.h"
 #include "vartable.h"
 #include "utils/string.h"
+#include "utils/sys.h"
+#include "internals/tablecache.h"
+#include <cstddef>
 #include <cstring>
 #include <cstdlib>
+#include <thread>
+#include <vector>
 
 using namespace wreport;
 using namespace wreport::tests;
@@ -29,6 +34,19 @@ string table_pathname(const std::string& basename)
     return str::joinpath(dir, basename);
 }
 
+// Count the entries of a table, skipping alterations
+unsigned count_entries(const Vartable* table)
+{
+    unsigned count = 0;
+    Varcode last = 0;
+    table->iterate([&](Varinfo info) {
+        if (info->code != last) ++count;
+        last = info->code;
+        return true;
+    });
+    return count;
+}
+
 class Tests : public TestCase
 {
     using TestCase::TestCase;
@@ -214,6 +232,155 @@ class Tests : public TestCase
             /* table = */ Vartable::get_bufr("B0000000000000013000");
             /* table = */ Vartable::get_bufr("B0000000000000014000");
         });
+        add_method("lookup", []() {
+            // Every entry can be looked up, and codes in between are not found
+            const Vartable* table = Vartable::get_bufr("B0000000000000024000");
+            Varcode last = 0;
+            unsigned count = 0;
+            table->iterate([&](Varinfo info) {
+                if (info->code == last) return true;
+                wassert(actual(table->query(info->code) == info).istrue());
+                for (Varcode code = last + 1; code < info->code; ++code)
+                    wassert(actual(table->contains(code)).isfalse());
+                last = info->code;
+                ++count;
+                return true;
+            });
+            wassert(actual(count) > 100u);
+            wassert(actual(table->contains(WR_VAR(3, 1, 1))).isfalse());
+            wassert(actual(table->contains(WR_VAR(0, 63, 255))).isfalse());
+        });
+        add_method("compiled", []() {
+            // Loading a text table writes its compiled version, which is then
+            // used by further loads
+            string text = sys::read_file(table_pathname("B0000000000000024000.txt"));
+            sys::write_file("B0000000000000024000.txt", text);
+            string bin = Vartable::compile_bufr("B0000000000000024000.txt");
+            wassert(actual(bin).startswith(getenv("WREPORT_TABLE_CACHE")));
+            sys::unlink(bin);
+
+            const Vartable* parsed = Vartable::load_bufr("./B0000000000000024000.txt");
+            wassert(actual(sys::exists(bin)).istrue());
+
+            // Use a different pathname to skip the in-memory cache of tables
+            const Vartable* compiled = Vartable::load_bufr("././B0000000000000024000.txt");
+            wassert(actual(compiled != parsed).istrue());
+            wassert(actual(count_entries(compiled)) == count_entries(parsed));
+            parsed->iterate([&](Varinfo info) {
+                Varinfo other = compiled->query(info->code);
+                wassert(actual(other->desc) == info->desc);
+                wassert(actual(other->unit) == info->unit);
+                wassert(actual(other->type) == info->type);
+                wassert(actual(other->scale) == info->scale);
+                wassert(actual(other->len) == info->len);
+                wassert(actual(other->bit_ref) == info->bit_ref);
+                wassert(actual(other->bit_len) == info->bit_len);
+                wassert(actual(other->imin) == info->imin);
+                wassert(actual(other->imax) == info->imax);
+                return true;
+            });
+            wassert(actual(compiled->query_altered(WR_VAR(0, 12, 101), 1, 12)->bit_len) == 12u);
+
+            // Changing the text table rebuilds the compiled version
+            size_t pos = 0;
+            for (unsigned i = 0; i < 10; ++i)
+                pos = text.find('\n', pos) + 1;
+            sys::write_file("B0000000000000024000.txt", text.substr(0, pos));
+            const Vartable* changed = Vartable::load_bufr("./././B0000000000000024000.txt");
+            wassert(actual(count_entries(changed)) == 10u);
+            changed = Vartable::load_bufr("././././B0000000000000024000.txt");
+            wassert(actual(count_entries(changed)) == 10u);
+
+            // Compiled tables can be written explicitly
+            sys::unlink(bin);
+            wassert(actual(Vartable::compile_bufr("./B0000000000000024000.txt")) == bin);
+            wassert(actual(sys::exists(bin)).istrue());
+
+            // Tables with the same name in different directories have
+            // different compiled versions
+            sys::makedirs("other");
+            sys::write_file("other/B0000000000000024000.txt", text);
+            string other_bin = Vartable::compile_bufr("other/B0000000000000024000.txt");
+            wassert(actual(other_bin != bin).istrue());
+            wassert(actual(count_entries(Vartable::load_bufr("./other/B0000000000000024000.txt"))) > 10u);
+            wassert(actual(count_entries(Vartable::load_bufr("./././././B0000000000000024000.txt"))) == 10u);
+        });
+
+        add_method("compiled_corrupted", []() {
+            // Corrupted compiled tables are ignored, and the text table is
+            // parsed instead
+            sys::makedirs("corrupted");
+            sys::write_file("corrupted/B0000000000000024000.txt", sys::read_file(table_pathname("B0000000000000024000.txt")));
+            string bin = Vartable::compile_bufr("corrupted/B0000000000000024000.txt");
+            string compiled = sys::read_file(bin);
+            // Offset of the first record, after the header
+            size_t first = sizeof(tablecache::Header);
+
+            string corrupted = compiled;
+            // Remove the terminating zero of the first description
+            memset(&corrupted[first + offsetof(_Varinfo, desc)], 'x', sizeof(_Varinfo::desc));
+            sys::write_file(bin, corrupted);
+            const Vartable* table = Vartable::load_bufr("./corrupted/B0000000000000024000.txt");
+            wassert(actual(table->query(WR_VAR(0, 0, 1))->desc) == "Table A: entry");
+
+            corrupted = compiled;
+            // Remove the terminating zero of the first unit
+            memset(&corrupted[first + offsetof(_Varinfo, unit)], 'x', sizeof(_Varinfo::unit));
+            sys::write_file(bin, corrupted);
+            table = Vartable::load_bufr("././corrupted/B0000000000000024000.txt");
+            wassert(actual(table->query(WR_VAR(0, 0, 1))->unit) == "CCITTIA5");
+
+            corrupted = compiled;
+            // Make the first record sort after the second one
+            memset(&corrupted[first + offsetof(_Varinfo, code)], 0xff, sizeof(Varcode));
+            sys::write_file(bin, corrupted);
+            table = Vartable::load_bufr("./././corrupted/B0000000000000024000.txt");
+            wassert(actual(table->query(WR_VAR(0, 0, 1))->desc) == "Table A: entry");
+            wassert(actual(table->contains(WR_VAR(0, 63, 255))).isfalse());
+        });
+
+        add_method("threads", []() {
+            // Load tables and create alterations from many threads at once:
+            // all threads need to see the same tables and alterations
+            static const unsigned thread_count = 8;
+            static const unsigned rounds = 200;
+            const char* names[] = { "B0000000000000012000", "B0000000000000013000", "B0000000000000014000", "B0000000000000015000" };
+            std::vector<std::vector<Varinfo>> seen(thread_count);
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < thread_count; ++t)
+                threads.emplace_back([&, t]() {
+                    for (unsigned i = 0; i < rounds; ++i)
+                    {
+                        const Vartable* table = Vartable::get_bufr(names[i % 4]);
+                        Varinfo info = table->query_altered(WR_VAR(0, 12, 101), i % 5, 16 + i % 7);
+                        seen[t].push_back(info);
+                    }
+                });
+            for (auto& t: threads)
+                t.join();
+
+            for (unsigned t = 1; t < thread_count; ++t)
+                for (unsigned i = 0; i < rounds; ++i)
+                    wassert(actual(seen[t][i] == seen[0][i]).istrue());
+            for (unsigned i = 0; i < rounds; ++i)
+            {
+                wassert(actual(seen[0][i]->scale) == (int)(i % 5));
+                wassert(actual(seen[0][i]->bit_len) == 16 + i % 7);
+            }
+
+            // Each alteration has been created only once
+            for (auto name: names)
+            {
+                std::vector<Varinfo> versions;
+                Vartable::get_bufr(name)->iterate([&](Varinfo info) {
+                    if (info->code == WR_VAR(0, 12, 101)) versions.push_back(info);
+                    return true;
+                });
+                for (unsigned i = 0; i < versions.size(); ++i)
+                    for (unsigned j = i + 1; j < versions.size(); ++j)
+                        wassert(actual(versions[i]->scale != versions[j]->scale || versions[i]->bit_len != versions[j]->bit_len).istrue());
+            }
+        });
     }
 } test("vartable");
 
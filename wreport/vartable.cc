@@ -8,9 +8,13 @@
 #include "vartable.h"
 #include "tableinfo.h"
 #include "error.h"
+#include "metrics.h"
 #include "internals/tabledir.h"
+#include "internals/concurrent.h"
+#include "internals/tablecache.h"
 #include <memory>
-#include <map>
+#include <mutex>
+#include <atomic>
 #include <cstring>
 #include <cmath>
 #include <climits>
@@ -121,13 +125,20 @@ struct VartableEntry
      * Altered versions of a Varinfo are stored in this chain. The first
      * element of the chain is always the original Varinfo defined in the B
      * table.
+     *
+     * The chain is only ever prepended to, and can be walked without locking.
      */
-    mutable VartableEntry* alterations = nullptr;
+    mutable std::atomic<VartableEntry*> alterations;
+
+    VartableEntry() : alterations(nullptr) {}
 
-    VartableEntry() = default;
+    VartableEntry(const VartableEntry& other)
+        : varinfo(other.varinfo), alterations(other.alterations.load(std::memory_order_relaxed))
+    {
+    }
 
     VartableEntry(const VartableEntry& other, int new_scale, unsigned new_bit_len)
-        : varinfo(other.varinfo), alterations(other.alterations)
+        : varinfo(other.varinfo), alterations(other.alterations.load(std::memory_order_acquire))
     {
 #if 0
         fprintf(stderr, "Before alteration(w:%d,s:%d): bl %d len %d scale %d\n",
@@ -182,11 +193,10 @@ struct VartableEntry
      */
     const VartableEntry* get_alteration(int new_scale, unsigned new_bit_len) const
     {
-        if (varinfo.scale == new_scale && varinfo.bit_len == new_bit_len)
-            return this;
-        if (alterations == nullptr)
-            return nullptr;
-        return alterations->get_alteration(new_scale, new_bit_len);
+        for (const VartableEntry* e = this; e; e = e->alterations.load(std::memory_order_acquire))
+            if (e->varinfo.scale == new_scale && e->varinfo.bit_len == new_bit_len)
+                return e;
+        return nullptr;
     }
 };
 
@@ -199,8 +209,7 @@ struct VartableBase : public Vartable
     /**
      * Entries in this Vartable.
      *
-     * The entries are sorted by varcode, so that we can look them up by binary
-     * search.
+     * The entries are sorted by varcode, and are looked up using index.
      *
      * Since we are handing out pointers to _Varinfo structures inside the
      * vector, those pointers will be invalidated if a vector reallocation gets
@@ -209,6 +218,20 @@ struct VartableBase : public Vartable
      */
     std::vector<VartableEntry> entries;
 
+    /**
+     * Direct index of entries, built once the table has been loaded.
+     *
+     * It is indexed by the F and X parts of a varcode, and each element is
+     * either nullptr if the table has no entries with that F and X, or a
+     * block of 256 entry pointers indexed by the Y part of the varcode.
+     */
+    const VartableEntry* const* index[256] = {};
+
+    /// Storage for the blocks pointed to by index
+    std::vector<const VartableEntry*> index_blocks;
+
+    /// Serialises the creation of new alterations
+    mutable std::mutex alterations_mutex;
 
     VartableBase(const std::string& pathname)
         : m_pathname(pathname)
@@ -227,30 +250,118 @@ struct VartableBase : public Vartable
             throw error_parse(m_pathname.c_str(), line_no, "input file is not sorted");
 
         // Append a new entry;
-        entries.emplace_back(VartableEntry());
+        entries.emplace_back();
         _Varinfo* entry = &entries.back().varinfo;
         entry->code = code;
         return entry;
     }
 
-    const VartableEntry* query_entry(Varcode code) const
+    /**
+     * Load entries from the compiled version of the table, if it exists and
+     * it is up to date.
+     *
+     * @returns true if the entries have been loaded
+     */
+    bool load_compiled(const char* signature)
     {
-        int begin, end;
+        tablecache::CompiledTable compiled(m_pathname);
+        if (!compiled.load(signature, sizeof(_Varinfo)))
+            return false;
+
+        // Entries are copied, since their alteration chains are modified
+        // after loading
+        const _Varinfo* records = (const _Varinfo*)compiled.records;
+        if (!compiled_is_valid(records, compiled.record_count))
+            return false;
+        entries.reserve(compiled.record_count);
+        for (unsigned i = 0; i < compiled.record_count; ++i)
+        {
+            entries.emplace_back();
+            entries.back().varinfo = records[i];
+        }
+        build_index();
+        return true;
+    }
 
-        // Binary search
-        begin = -1, end = entries.size();
-        while (end - begin > 1)
+    /**
+     * Check that the records of a compiled table are sorted by code, as
+     * query() requires, and that their strings are zero-terminated
+     */
+    static bool compiled_is_valid(const _Varinfo* records, unsigned count)
+    {
+        for (unsigned i = 0; i < count; ++i)
         {
-            int cur = (end + begin) / 2;
-            if (entries[cur].varinfo.code > code)
-                end = cur;
-            else
-                begin = cur;
+            const _Varinfo& r = records[i];
+            if (!memchr(r.desc, 0, sizeof(r.desc)) || !memchr(r.unit, 0, sizeof(r.unit)))
+                return false;
+            if (i > 0 && records[i - 1].code >= r.code)
+                return false;
         }
-        if (begin == -1 || entries[begin].varinfo.code != code)
-            return nullptr;
-        else
-            return &entries[begin];
+        return true;
+    }
+
+    /// Write the compiled version of the table
+    void write_compiled(const char* signature) const
+    {
+        std::vector<_Varinfo> records;
+        records.reserve(entries.size());
+        for (const auto& e: entries)
+            records.push_back(e.varinfo);
+        tablecache::CompiledTable compiled(m_pathname);
+        compiled.write(signature, records.data(), sizeof(_Varinfo), records.size());
+    }
+
+    /**
+     * Write the compiled version of the table, ignoring errors.
+     *
+     * Failing to write it is not an error, as it only makes loading the table
+     * slower next time.
+     */
+    void try_write_compiled(const char* signature) const
+    {
+        try {
+            write_compiled(signature);
+        } catch (std::exception& e) {
+            TRACE("cannot write compiled table for %s: %s\n", m_pathname.c_str(), e.what());
+        }
+    }
+
+    /// Build index once all entries have been loaded
+    void build_index()
+    {
+        // Count the blocks needed
+        unsigned blocks = 0;
+        int last_fx = -1;
+        for (const auto& e: entries)
+        {
+            int fx = e.varinfo.code >> 8;
+            if (fx != last_fx) ++blocks;
+            last_fx = fx;
+        }
+
+        // Point each entry from its block
+        index_blocks.assign(blocks * 256, nullptr);
+        const VartableEntry** block = nullptr;
+        unsigned used = 0;
+        last_fx = -1;
+        for (const auto& e: entries)
+        {
+            int fx = e.varinfo.code >> 8;
+            if (fx != last_fx)
+            {
+                block = index_blocks.data() + 256 * used++;
+                index[fx] = block;
+            }
+            block[e.varinfo.code & 0xff] = &e;
+            last_fx = fx;
+        }
+    }
+
+    const VartableEntry* query_entry(Varcode code) const
+    {
+        const VartableEntry* const* block = index[(code >> 8) & 0xff];
+        if (!block) return nullptr;
+        return block[code & 0xff];
     }
 
     Varinfo query(Varcode code) const override
@@ -280,7 +391,11 @@ struct VartableBase : public Vartable
 
         // Look for an existing alteration
         const VartableEntry* alt = start->get_alteration(new_scale, new_bit_len);
-        if (alt) return &(alt->varinfo);
+        if (alt)
+        {
+            metrics::add(metrics::ALTERATION_HITS);
+            return &(alt->varinfo);
+        }
 
         switch (start->varinfo.type)
         {
@@ -297,20 +412,31 @@ struct VartableBase : public Vartable
         }
 
 
-        // Not found: we need to create it, duplicating the original varinfo
+        // Not found: we need to create it, duplicating the original varinfo.
+        // Check again with the lock held, in case another thread created it
+        // in the meantime
+        std::lock_guard<std::mutex> lock(alterations_mutex);
+        alt = start->get_alteration(new_scale, new_bit_len);
+        if (alt)
+        {
+            metrics::add(metrics::ALTERATION_HITS);
+            return &(alt->varinfo);
+        }
+        metrics::add(metrics::ALTERATION_MISSES);
         unique_ptr<VartableEntry> newvi(new VartableEntry(*start, new_scale, new_bit_len));
 
         // Add the new alteration as the first alteration in the list after the
         // original value
-        start->alterations = newvi.release();
+        VartableEntry* res = newvi.release();
+        start->alterations.store(res, std::memory_order_release);
 
-        return &(start->alterations->varinfo);
+        return &(res->varinfo);
     }
 
     bool iterate(std::function<bool(Varinfo)> dest) const override
     {
         for (const auto& entry: entries)
-            for (const VartableEntry* e = &entry; e; e = e->alterations)
+            for (const VartableEntry* e = &entry; e; e = e->alterations.load(std::memory_order_acquire))
                 if (!dest(&(e->varinfo)))
                     return false;
         return true;
@@ -329,9 +455,14 @@ static void normalise_unit(char* unit)
 
 struct BufrVartable : public VartableBase
 {
+    static constexpr const char* signature = "WRBUFRB";
+
     /// Create and load a BUFR B table
-    BufrVartable(const std::string& pathname) : VartableBase(pathname)
+    BufrVartable(const std::string& pathname, bool use_compiled=true) : VartableBase(pathname)
     {
+        if (use_compiled && load_compiled(signature))
+            return;
+
         FILE* in = fopen(pathname.c_str(), "rt");
         if (!in) error_system::throwf("cannot open BUFR table file %s", pathname.c_str());
         fd_closer closer(in); // Close in on exit
@@ -397,14 +528,23 @@ struct BufrVartable : public VartableBase
                     bcode, entry->len, entry->scale, entry->type, entry->desc);
             */
         }
+
+        build_index();
+        if (use_compiled)
+            try_write_compiled(signature);
     }
 };
 
 struct CrexVartable : public VartableBase
 {
+    static constexpr const char* signature = "WRCREXB";
+
     /// Create and load a CREX B table
-    CrexVartable(const std::string& pathname) : VartableBase(pathname)
+    CrexVartable(const std::string& pathname, bool use_compiled=true) : VartableBase(pathname)
     {
+        if (use_compiled && load_compiled(signature))
+            return;
+
         FILE* in = fopen(pathname.c_str(), "rt");
         if (!in) error_system::throwf("cannot open CREX table file %s", pathname.c_str());
         fd_closer closer(in); // Close in on exit
@@ -470,6 +610,10 @@ struct CrexVartable : public VartableBase
                     bcode, entry->len, entry->scale, entry->type, entry->desc);
             */
         }
+
+        build_index();
+        if (use_compiled)
+            try_write_compiled(signature);
     }
 };
 
@@ -478,30 +622,36 @@ struct CrexVartable : public VartableBase
 
 const Vartable* Vartable::load_bufr(const std::string& pathname)
 {
-    static std::map<string, BufrVartable*>* tables = 0;
-    if (!tables) tables = new std::map<string, BufrVartable*>;
-
-    // Return it from cache if we have it
-    auto i = tables->find(pathname);
-    if (i != tables->end())
-        return i->second;
-
-    // Else, instantiate it
-    return (*tables)[pathname] = new BufrVartable(pathname);
+    static auto* tables = new ConcurrentMap<string, const Vartable*>;
+    return tables->obtain(pathname, [&]() {
+        metrics::add(metrics::TABLES_LOADED);
+        return make_pair(pathname, (const Vartable*)new BufrVartable(pathname));
+    });
 }
 
 const Vartable* Vartable::load_crex(const std::string& pathname)
 {
-    static std::map<string, CrexVartable*>* tables = 0;
-    if (!tables) tables = new std::map<string, CrexVartable*>;
+    static auto* tables = new ConcurrentMap<string, const Vartable*>;
+    return tables->obtain(pathname, [&]() {
+        metrics::add(metrics::TABLES_LOADED);
+        return make_pair(pathname, (const Vartable*)new CrexVartable(pathname));
+    });
+}
 
-    // Return it from cache if we have it
-    auto i = tables->find(pathname);
-    if (i != tables->end())
-        return i->second;
+std::string Vartable::compile_bufr(const std::string& pathname)
+{
+    BufrVartable table(pathname, false);
+    tablecache::CompiledTable compiled(pathname);
+    table.write_compiled(BufrVartable::signature);
+    return compiled.pathname;
+}
 
-    // Else, instantiate it
-    return (*tables)[pathname] = new CrexVartable(pathname);
+std::string Vartable::compile_crex(const std::string& pathname)
+{
+    CrexVartable table(pathname, false);
+    tablecache::CompiledTable compiled(pathname);
+    table.write_compiled(CrexVartable::signature);
+    return compiled.pathname;
 }
 
 const Vartable* Vartable::get_bufr(const BufrTableID& id)
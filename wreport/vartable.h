@@ -88,6 +88,32 @@ struct Vartable
      */
     static const Vartable* load_crex(const std::string& pathname);
 
+    /**
+     * Write the compiled version of a BUFR vartable.
+     *
+     * Compiled tables are loaded with mmap instead of being parsed, and are
+     * written automatically the first time a text table is loaded, when the
+     * file system allows it. They are stored in the directory named by the
+     * WREPORT_TABLE_CACHE environment variable if set, or else in
+     * $XDG_CACHE_HOME/wreport or $HOME/.cache/wreport, under a name that
+     * depends on the full pathname of the text table. Setting
+     * WREPORT_TABLE_CACHE to an empty value disables compiled tables.
+     *
+     * A compiled table is ignored and rebuilt if the text table has been
+     * modified after it was written.
+     *
+     * @returns the pathname of the compiled table, or an empty string if
+     * compiled tables are disabled
+     */
+    static std::string compile_bufr(const std::string& pathname);
+
+    /**
+     * Write the compiled version of a CREX vartable.
+     *
+     * @see compile_bufr()
+     */
+    static std::string compile_crex(const std::string& pathname);
+
     /// Find a BUFR table
     static const Vartable* get_bufr(const BufrTableID& id);
 
@@ -0,0 +1,119 @@
+#include "visitor.h"
+#include "error.h"
+
+namespace wreport {
+
+DecodedValue::DecodedValue(const Var& var)
+    : info(var.info()), missing(!var.isset())
+{
+    if (missing) return;
+    switch (info->type)
+    {
+        case Vartype::String:
+        case Vartype::Binary:
+            cval = var.enqc();
+            break;
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            ival = var.enqi();
+            break;
+    }
+}
+
+int DecodedValue::enqi() const
+{
+    if (missing)
+        error_notfound::throwf("enqi: %01d%02d%03d (%s) is not defined",
+                WR_VAR_FXY(info->code), info->desc);
+    switch (info->type)
+    {
+        case Vartype::String:
+            error_type::throwf("enqi: %01d%02d%03d (%s) is a string",
+                    WR_VAR_FXY(info->code), info->desc);
+        case Vartype::Binary:
+            error_type::throwf("enqi: %01d%02d%03d (%s) is an opaque binary",
+                    WR_VAR_FXY(info->code), info->desc);
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            return ival;
+    }
+    error_consistency::throwf("unknown variable type %d", (int)info->type);
+}
+
+double DecodedValue::enqd() const
+{
+    if (missing)
+        error_notfound::throwf("enqd: %01d%02d%03d (%s) is not defined",
+                WR_VAR_FXY(info->code), info->desc);
+    switch (info->type)
+    {
+        case Vartype::String:
+            error_type::throwf("enqd: %01d%02d%03d (%s) is a string",
+                    WR_VAR_FXY(info->code), info->desc);
+        case Vartype::Binary:
+            error_type::throwf("enqd: %01d%02d%03d (%s) is an opaque binary",
+                    WR_VAR_FXY(info->code), info->desc);
+        case Vartype::Integer:
+            return ival;
+        case Vartype::Decimal:
+            return info->decode_decimal(ival);
+    }
+    error_consistency::throwf("unknown variable type %d", (int)info->type);
+}
+
+const char* DecodedValue::enqc() const
+{
+    if (missing)
+        error_notfound::throwf("enqc: %01d%02d%03d (%s) is not defined",
+                WR_VAR_FXY(info->code), info->desc);
+    switch (info->type)
+    {
+        case Vartype::String:
+        case Vartype::Binary:
+            return cval;
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            error_type::throwf("enqc: %01d%02d%03d (%s) is a number, use DecodedValue::var to format it",
+                    WR_VAR_FXY(info->code), info->desc);
+    }
+    error_consistency::throwf("unknown variable type %d", (int)info->type);
+}
+
+Var DecodedValue::var() const
+{
+    Var res(info);
+    set(res);
+    return res;
+}
+
+void DecodedValue::set(Var& dest) const
+{
+    if (missing)
+    {
+        dest.unset();
+        return;
+    }
+    switch (info->type)
+    {
+        case Vartype::String:
+        case Vartype::Binary:
+            dest.setc(cval);
+            break;
+        case Vartype::Integer:
+        case Vartype::Decimal:
+            dest.seti(ival);
+            break;
+    }
+}
+
+
+DecodeVisitor::~DecodeVisitor() {}
+void DecodeVisitor::begin_bulletin(const BufrBulletin& bulletin, unsigned subset_count) {}
+void DecodeVisitor::begin_subset(unsigned subset) {}
+void DecodeVisitor::attribute(unsigned subset, unsigned pos, const DecodedValue& val) {}
+void DecodeVisitor::begin_replication(unsigned subset, Varcode code, unsigned count) {}
+void DecodeVisitor::end_replication(unsigned subset, Varcode code) {}
+void DecodeVisitor::end_subset(unsigned subset) {}
+void DecodeVisitor::end_bulletin() {}
+
+}
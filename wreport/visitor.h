@@ -0,0 +1,112 @@
+#ifndef WREPORT_VISITOR_H
+#define WREPORT_VISITOR_H
+
+#include <wreport/var.h>
+#include <cstdint>
+
+namespace wreport {
+struct BufrBulletin;
+
+/**
+ * A value decoded from a BUFR message, as sent to a DecodeVisitor.
+ *
+ * Integer and decimal values are stored as in Var, as integers that can be
+ * converted to decimal values using Varinfo::decode_decimal. String and binary
+ * values point to a buffer owned by the decoder, which is only valid for the
+ * duration of the callback.
+ */
+struct DecodedValue
+{
+    /// Description of the value
+    Varinfo info;
+
+    /// True if the value is missing
+    bool missing = true;
+
+    /// Integer and decimal value, encoded as in Var
+    int32_t ival = 0;
+
+    /// String or binary value
+    const char* cval = nullptr;
+
+    explicit DecodedValue(Varinfo info) : info(info) {}
+
+    /// Create a DecodedValue with the value of \a var, which must outlive it
+    explicit DecodedValue(const Var& var);
+
+    /// Check if the value is set
+    bool isset() const { return !missing; }
+
+    /// Get the value as an integer, like Var::enqi
+    int enqi() const;
+
+    /// Get the value as a double, like Var::enqd
+    double enqd() const;
+
+    /// Get the value as a string, like Var::enqc
+    const char* enqc() const;
+
+    /// Create a Var with this value
+    Var var() const;
+
+    /// Set \a dest to this value
+    void set(Var& dest) const;
+};
+
+/**
+ * Interface for receiving the contents of a BUFR message while it is decoded,
+ * without building Subset and Var objects.
+ *
+ * Subsets are visited in order in uncompressed messages. Compressed messages
+ * store each variable for all subsets together, so begin_subset() is called
+ * for all subsets first, then each variable is sent for all the subsets in
+ * turn, and finally end_subset() is called for all subsets.
+ *
+ * @see BufrBulletin::decode_visit()
+ */
+struct DecodeVisitor
+{
+    virtual ~DecodeVisitor();
+
+    /**
+     * Start decoding the data section of \a bulletin.
+     *
+     * \a bulletin has been decoded up to the data description section, and
+     * has the tables needed to decode it; its list of subsets is empty.
+     */
+    virtual void begin_bulletin(const BufrBulletin& bulletin, unsigned subset_count);
+
+    /// Start decoding a subset
+    virtual void begin_subset(unsigned subset);
+
+    /// A variable has been decoded in subset \a subset
+    virtual void value(unsigned subset, const DecodedValue& val) = 0;
+
+    /**
+     * An attribute has been decoded for the variable at position \a pos in
+     * the sequence of values sent for subset \a subset.
+     */
+    virtual void attribute(unsigned subset, unsigned pos, const DecodedValue& val);
+
+    /**
+     * Start a replicated section of subset \a subset introduced by the
+     * replication code \a code, that is going to be repeated \a count times.
+     *
+     * In case of delayed replication, the replication factor has already been
+     * sent with value().
+     */
+    virtual void begin_replication(unsigned subset, Varcode code, unsigned count);
+
+    /// End a replicated section started with begin_replication()
+    virtual void end_replication(unsigned subset, Varcode code);
+
+    /// End decoding a subset
+    virtual void end_subset(unsigned subset);
+
+    /// End decoding the data section
+    virtual void end_bulletin();
+};
+
+}
+
+#endif